@@ -0,0 +1,93 @@
+﻿#include "Animation.h"
+
+aiVector3D Lerp(const aiVector3D& a, const aiVector3D& b, float t) {
+    return a + (b - a) * t;
+}
+
+aiQuaternion Slerp(const aiQuaternion& a, const aiQuaternion& b, float t) {
+    aiQuaternion out;
+    aiQuaternion::Interpolate(out, a, b, t);
+    return out;
+}
+
+void SampleBoneAnim(const BoneAnimCache& cache, float animTime,
+    aiVector3D& pos, aiQuaternion& rot, aiVector3D& scale)
+{
+    // 插值位置
+    pos = aiVector3D(0, 0, 0);
+    if (!cache.positions.empty()) {
+        if (cache.positions.size() == 1) {
+            pos = cache.positions[0].mValue;
+        }
+        else {
+            size_t idx = FindKeyIndex(cache.positions, animTime);
+            float t = float((animTime - cache.positions[idx].mTime) /
+                (cache.positions[idx + 1].mTime - cache.positions[idx].mTime));
+            pos = Lerp(cache.positions[idx].mValue, cache.positions[idx + 1].mValue, t);
+        }
+    }
+
+    // 插值旋转
+    rot = aiQuaternion();
+    if (!cache.rotations.empty()) {
+        if (cache.rotations.size() == 1) {
+            rot = cache.rotations[0].mValue;
+        }
+        else {
+            size_t idx = FindKeyIndex(cache.rotations, animTime);
+            float t = float((animTime - cache.rotations[idx].mTime) /
+                (cache.rotations[idx + 1].mTime - cache.rotations[idx].mTime));
+            rot = Slerp(cache.rotations[idx].mValue, cache.rotations[idx + 1].mValue, t);
+        }
+    }
+
+    // 插值缩放
+    scale = aiVector3D(1, 1, 1);
+    if (!cache.scalings.empty()) {
+        if (cache.scalings.size() == 1) {
+            scale = cache.scalings[0].mValue;
+        }
+        else {
+            size_t idx = FindKeyIndex(cache.scalings, animTime);
+            float t = float((animTime - cache.scalings[idx].mTime) /
+                (cache.scalings[idx + 1].mTime - cache.scalings[idx].mTime));
+            scale = Lerp(cache.scalings[idx].mValue, cache.scalings[idx + 1].mValue, t);
+        }
+    }
+}
+
+aiMatrix4x4 ComposeTRS(const aiVector3D& pos, const aiQuaternion& rot, const aiVector3D& scale)
+{
+    aiMatrix4x4 matScale, matRot, matTrans;
+    aiMatrix4x4::Scaling(scale, matScale);
+    matRot = aiMatrix4x4(rot.GetMatrix());
+    aiMatrix4x4::Translation(pos, matTrans);
+    return matTrans * matRot * matScale;
+}
+
+aiMatrix4x4 SampleLocalTransform(const aiNode* node,
+    const std::map<std::string, BoneAnimCache>& boneAnimCache, float animTime)
+{
+    auto it = boneAnimCache.find(node->mName.C_Str());
+    if (it == boneAnimCache.end())
+        return node->mTransformation;
+
+    aiVector3D pos, scale;
+    aiQuaternion rot;
+    SampleBoneAnim(it->second, animTime, pos, rot, scale);
+    return ComposeTRS(pos, rot, scale);
+}
+
+void CollectAnimatedNodeTransforms(
+    const aiNode* node,
+    const aiMatrix4x4& parentTransform,
+    const std::map<std::string, BoneAnimCache>& boneAnimCache,
+    float animTime,
+    std::map<std::string, aiMatrix4x4>& nodeGlobalTransforms)
+{
+    aiMatrix4x4 globalTransform = parentTransform * SampleLocalTransform(node, boneAnimCache, animTime);
+    nodeGlobalTransforms[node->mName.C_Str()] = globalTransform;
+
+    for (unsigned int i = 0; i < node->mNumChildren; ++i)
+        CollectAnimatedNodeTransforms(node->mChildren[i], globalTransform, boneAnimCache, animTime, nodeGlobalTransforms);
+}
@@ -0,0 +1,47 @@
+﻿#pragma once
+#include <vector>
+#include <map>
+#include <string>
+#include <assimp/scene.h>
+
+// 单个节点的动画关键帧缓存
+struct BoneAnimCache {
+    std::vector<aiVectorKey> positions;
+    std::vector<aiQuatKey> rotations;
+    std::vector<aiVectorKey> scalings;
+};
+
+// 线性插值
+aiVector3D Lerp(const aiVector3D& a, const aiVector3D& b, float t);
+
+// 四元数球面插值
+aiQuaternion Slerp(const aiQuaternion& a, const aiQuaternion& b, float t);
+
+// 查找关键帧索引
+template<typename T>
+size_t FindKeyIndex(const std::vector<T>& keys, float time) {
+    for (size_t i = 0; i + 1 < keys.size(); ++i) {
+        if (time < static_cast<float>(keys[i + 1].mTime))
+            return i;
+    }
+    return keys.size() - 2;
+}
+
+// 按时间插值一个通道，得到本地 TRS
+void SampleBoneAnim(const BoneAnimCache& cache, float animTime,
+    aiVector3D& pos, aiQuaternion& rot, aiVector3D& scale);
+
+// 组装本地变换 T * R * S
+aiMatrix4x4 ComposeTRS(const aiVector3D& pos, const aiQuaternion& rot, const aiVector3D& scale);
+
+// 节点在 animTime 的本地变换：有动画通道就插值，否则用节点原始变换
+aiMatrix4x4 SampleLocalTransform(const aiNode* node,
+    const std::map<std::string, BoneAnimCache>& boneAnimCache, float animTime);
+
+// 递归遍历（未折叠的）节点树，收集每个节点的动画全局变换
+void CollectAnimatedNodeTransforms(
+    const aiNode* node,
+    const aiMatrix4x4& parentTransform,
+    const std::map<std::string, BoneAnimCache>& boneAnimCache,
+    float animTime,
+    std::map<std::string, aiMatrix4x4>& nodeGlobalTransforms);
@@ -1,5 +1,6 @@
 ﻿#include <windows.h>
 #include <d3d11.h>
+#include <d3d11_1.h>
 #pragma comment(lib, "d3d11.lib")
 
 #include <assimp/Importer.hpp>
@@ -7,6 +8,8 @@
 #include <assimp/postprocess.h>
 
 #include "App.h"
+#include "Benchmark.h"
+#include "Skinning.h"
 #include <memory>
 #include <d3dcompiler.h>
 #pragma comment(lib, "d3dcompiler.lib") 
@@ -27,6 +30,7 @@ HWND g_hWnd = nullptr;
 D3D_FEATURE_LEVEL g_featureLevel = D3D_FEATURE_LEVEL_11_0;
 ID3D11Device* g_pd3dDevice = nullptr;
 ID3D11DeviceContext* g_pImmediateContext = nullptr;
+ID3D11DeviceContext1* g_pImmediateContext1 = nullptr; // D3D11.1，支持常量缓冲区局部更新时非空
 IDXGISwapChain* g_pSwapChain = nullptr;
 ID3D11RenderTargetView* g_pRenderTargetView = nullptr;
 ID3D11Texture2D* g_pDepthStencil = nullptr;
@@ -42,6 +46,7 @@ Assimp::Importer importer;
 UINT g_width = 1024, g_height = 768; // 全局变量
 
 void UpdateConstant(App* App, float time);
+void DrawSkinnedMesh(App* App);
 
 void RedirectIOToConsole()
 {
@@ -53,28 +58,6 @@ void RedirectIOToConsole()
     std::ios::sync_with_stdio();
 }
 
-// 线性插值
-aiVector3D Lerp(const aiVector3D& a, const aiVector3D& b, float t) {
-    return a + (b - a) * t;
-}
-
-// 四元数球面插值
-aiQuaternion Slerp(const aiQuaternion& a, const aiQuaternion& b, float t) {
-    aiQuaternion out;
-    aiQuaternion::Interpolate(out, a, b, t);
-    return out;
-}
-
-// 查找关键帧索引
-template<typename T>
-size_t FindKeyIndex(const std::vector<T>& keys, float time) {
-    for (size_t i = 0; i + 1 < keys.size(); ++i) {
-        if (time < static_cast<float>(keys[i + 1].mTime))
-            return i;
-    }
-    return keys.size() - 2;
-}
-
 void ResizeRenderTarget(UINT width, UINT height)
 {
     g_width = width;
@@ -215,6 +198,14 @@ HRESULT InitD3D()
     if (FAILED(hr))
         return hr;
 
+    // 常量缓冲区局部更新（骨骼调色板只上传脏区间）需要 D3D11.1
+    D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+    if (SUCCEEDED(g_pd3dDevice->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options)))
+        && options.ConstantBufferPartialUpdate)
+    {
+        g_pImmediateContext->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&g_pImmediateContext1);
+    }
+
     // 创建渲染目标视图
     ID3D11Texture2D* pBackBuffer = nullptr;
     hr = g_pSwapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (void**)&pBackBuffer);
@@ -274,10 +265,39 @@ void Cleanup()
     if (g_pImmediateContext) g_pImmediateContext->ClearState();
     if (g_pRenderTargetView) g_pRenderTargetView->Release();
     if (g_pSwapChain) g_pSwapChain->Release();
+    if (g_pImmediateContext1) g_pImmediateContext1->Release();
     if (g_pImmediateContext) g_pImmediateContext->Release();
     if (g_pd3dDevice) g_pd3dDevice->Release();
 }
 
+// 释放 App 创建的 D3D 资源，在 Cleanup 之前调用
+void ReleaseAppResources(App* app)
+{
+    if (app->vertexShader) app->vertexShader->Release();
+    if (app->pixelShader) app->pixelShader->Release();
+    if (app->inputLayout) app->inputLayout->Release();
+    for (ID3D11VertexShader* shader : app->influenceShaders)
+        if (shader) shader->Release();
+    if (app->rigidShader) app->rigidShader->Release();
+    if (app->boneLineVS) app->boneLineVS->Release();
+    if (app->boneLinePS) app->boneLinePS->Release();
+    if (app->boneLineLayout) app->boneLineLayout->Release();
+
+    if (app->vertexBuffer) app->vertexBuffer->Release();
+    if (app->influenceBuffer) app->influenceBuffer->Release();
+    if (app->indexBuffer) app->indexBuffer->Release();
+    for (ID3D11Buffer* buffer : app->lodVertexBuffers)
+        if (buffer) buffer->Release();
+    for (ID3D11Buffer* buffer : app->lodIndexBuffers)
+        if (buffer) buffer->Release();
+    if (app->morphBuffer) app->morphBuffer->Release();
+    if (app->constantBuffer) app->constantBuffer->Release();
+    if (app->boneMatrixBuffer) app->boneMatrixBuffer->Release();
+    if (app->boneScaleBuffer) app->boneScaleBuffer->Release();
+    if (app->boneLineVB) app->boneLineVB->Release();
+    if (app->ikQuadVB) app->ikQuadVB->Release();
+}
+
 // 主消息循环和渲染
 int Run(App* app)
 {
@@ -309,10 +329,18 @@ int Run(App* app)
             g_pImmediateContext->IASetInputLayout(app->inputLayout);
 
             // 2. 设置缓冲区
-            UINT stride = sizeof(Vertex);
+            UINT stride = app->packedVertices ? app->packedMesh.format.stride : UINT(sizeof(Vertex));
             UINT offset = 0;
             g_pImmediateContext->IASetVertexBuffers(0, 1, &app->vertexBuffer, &stride, &offset);
-            g_pImmediateContext->IASetIndexBuffer(app->indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+            if (app->influenceBuffer) {
+                UINT influenceStride = sizeof(VertexInfluences);
+                g_pImmediateContext->IASetVertexBuffers(1, 1, &app->influenceBuffer, &influenceStride, &offset);
+            }
+            if (app->morphBuffer) {
+                UINT morphStride = sizeof(MorphDelta);
+                g_pImmediateContext->IASetVertexBuffers(2, 1, &app->morphBuffer, &morphStride, &offset);
+            }
+            // 索引缓冲区按子网格的格式和偏移在 DrawSkinnedMesh 中绑定
             g_pImmediateContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
             // 3. 更新常量缓冲区
@@ -329,7 +357,7 @@ int Run(App* app)
             g_pImmediateContext->PSSetConstantBuffers(0, 1, &app->constantBuffer);
 
             // 5. 绘制
-            g_pImmediateContext->DrawIndexed((UINT)app->indices.size(), 0, 0);
+            DrawSkinnedMesh(app);
 
             // 2. 渲染骨骼线
             // 禁用深度测试
@@ -422,165 +450,245 @@ void CollectBoneLines(aiNode* node, const std::map<std::string, aiVector3D>& bon
     }
 }
 
-void CollectAnimatedBonePositions(
-    aiNode* node,
-    const aiMatrix4x4& parentTransform,
-    const std::map<std::string, BoneAnimCache>& boneAnimCache,
-    float animTime,
-    std::map<std::string, aiVector3D>& bonePositions)
+// 由骨架全局变换生成骨骼连线（父子关节各一个端点）
+void CollectSkeletonBoneLines(const Skeleton& skeleton, const std::vector<aiMatrix4x4>& globals,
+    std::vector<aiVector3D>& lineVertices)
 {
-    // 默认用节点原始变换
-    aiMatrix4x4 localTransform = node->mTransformation;
-
-    // 如果有动画通道，插值动画
-    auto it = boneAnimCache.find(node->mName.C_Str());
-    if (it != boneAnimCache.end()) {
-        const BoneAnimCache& cache = it->second;
-
-        // 插值位置
-        aiVector3D pos(0, 0, 0);
-        if (!cache.positions.empty()) {
-            if (cache.positions.size() == 1) {
-                pos = cache.positions[0].mValue;
-            }
-            else {
-                size_t idx = FindKeyIndex(cache.positions, animTime);
-                float t = float((animTime - cache.positions[idx].mTime) /
-                    (cache.positions[idx + 1].mTime - cache.positions[idx].mTime));
-                pos = Lerp(cache.positions[idx].mValue, cache.positions[idx + 1].mValue, t);
-            }
-        }
+    for (size_t i = 0; i < skeleton.joints.size(); ++i)
+    {
+        int parent = skeleton.joints[i].parent;
+        if (parent < 0) continue;
+        const aiMatrix4x4& p = globals[parent];
+        const aiMatrix4x4& c = globals[i];
+        lineVertices.push_back(aiVector3D(p.a4, p.b4, p.c4));
+        lineVertices.push_back(aiVector3D(c.a4, c.b4, c.c4));
+    }
+}
 
-        // 插值旋转
-        aiQuaternion rot;
-        if (!cache.rotations.empty()) {
-            if (cache.rotations.size() == 1) {
-                rot = cache.rotations[0].mValue;
-            }
-            else {
-                size_t idx = FindKeyIndex(cache.rotations, animTime);
-                float t = float((animTime - cache.rotations[idx].mTime) /
-                    (cache.rotations[idx + 1].mTime - cache.rotations[idx].mTime));
-                rot = Slerp(cache.rotations[idx].mValue, cache.rotations[idx + 1].mValue, t);
-            }
-        }
+// 当前调色板格式对应的 CPU 端数据及每个骨骼的字节数
+const void* GetBonePaletteData(App* App, UINT& boneSize)
+{
+    switch (App->paletteFormat) {
+    case PaletteFormat::Affine3x4:
+        boneSize = sizeof(BoneMatrix3x4);
+        return &App->boneMatrixData3x4;
+    case PaletteFormat::DualQuaternion:
+        boneSize = sizeof(BoneDualQuat);
+        return &App->boneDualQuatData;
+    default:
+        boneSize = sizeof(aiMatrix4x4);
+        return &App->boneMatrixData;
+    }
+}
 
-        // 插值缩放
-        aiVector3D scale(1, 1, 1);
-        if (!cache.scalings.empty()) {
-            if (cache.scalings.size() == 1) {
-                scale = cache.scalings[0].mValue;
-            }
-            else {
-                size_t idx = FindKeyIndex(cache.scalings, animTime);
-                float t = float((animTime - cache.scalings[idx].mTime) /
-                    (cache.scalings[idx + 1].mTime - cache.scalings[idx].mTime));
-                scale = Lerp(cache.scalings[idx].mValue, cache.scalings[idx + 1].mValue, t);
-            }
-        }
+// 只上传 [firstBone, lastBone] 区间（不支持 D3D11.1 时整块上传）
+void UploadBoneRange(ID3D11Buffer* buffer, const void* data, UINT boneSize, int firstBone, int lastBone)
+{
+    const char* bytes = static_cast<const char*>(data);
+    if (g_pImmediateContext1) {
+        D3D11_BOX box = {};
+        box.left = boneSize * firstBone;
+        box.right = boneSize * (lastBone + 1);
+        box.bottom = 1;
+        box.back = 1;
+        g_pImmediateContext1->UpdateSubresource1(buffer, 0, &box, bytes + box.left, 0, 0, 0);
+    }
+    else {
+        g_pImmediateContext->UpdateSubresource(buffer, 0, nullptr, bytes, 0, 0);
+    }
+}
 
-        // 组装本地变换
-        aiMatrix4x4 matScale, matRot, matTrans;
-        aiMatrix4x4::Scaling(scale, matScale);
-        matRot = aiMatrix4x4(rot.GetMatrix());
-        aiMatrix4x4::Translation(pos, matTrans);
-        localTransform = matTrans * matRot * matScale;
+template<typename T>
+void GatherPalette(const std::vector<T>& fullPalette, const std::vector<int>& table, T* localPalette)
+{
+    for (size_t slot = 0; slot < table.size(); ++slot)
+        localPalette[slot] = fullPalette[table[slot]];
+}
+
+// 同上，并把子网格的位置还原折进每个矩阵，每帧每骨骼一次，代替逐顶点还原
+template<typename T>
+void GatherPalette(const std::vector<T>& fullPalette, const std::vector<int>& table,
+    const PositionQuantization& quantization, T* localPalette)
+{
+    for (size_t slot = 0; slot < table.size(); ++slot)
+        localPalette[slot] = FoldPositionQuantization(fullPalette[table[slot]], quantization);
+}
+
+// 高亮骨骼在当前子网格调色板中的槽位；未划分时即全局下标，不在本子网格中时为 -1（不高亮）
+UINT LocalTargetBone(App* App, const SkinnedSubmesh& submesh)
+{
+    if (!App->paletteSplit)
+        return App->cb.targetBoneIndex;
+    const std::vector<int>& table = submesh.bonePalette;
+    auto it = std::find(table.begin(), table.end(), int(App->cb.targetBoneIndex));
+    return it != table.end() ? UINT(it - table.begin()) : UINT(-1);
+}
+
+// 子网格的常量：高亮骨骼换算为局部槽位；DQS 的量化位置在着色器中还原，换成该子网格的包围盒
+ConstantBuffer SubmeshConstants(App* App, size_t submeshIndex)
+{
+    ConstantBuffer cb = App->cb;
+    cb.targetBoneIndex = LocalTargetBone(App, App->gpuMesh.submeshes[submeshIndex]);
+    if (!App->foldPositionQuantization && submeshIndex < App->packedMesh.positionRanges.size()) {
+        const PositionQuantization& range = App->packedMesh.positionRanges[submeshIndex];
+        cb.positionScale = { range.scale, range.scale, range.scale, 0.0f };
+        cb.positionOffset = { range.offset.x, range.offset.y, range.offset.z, 0.0f };
     }
+    return cb;
+}
 
-    aiMatrix4x4 globalTransform = parentTransform * localTransform;
-    bonePositions[node->mName.C_Str()] = aiVector3D(globalTransform.a4, globalTransform.b4, globalTransform.c4);
+// 收集子网格用到的骨骼到局部调色板并上传
+void UploadSubmeshPalette(App* App, size_t submeshIndex)
+{
+    const SkinnedSubmesh& submesh = App->gpuMesh.submeshes[submeshIndex];
+    const std::vector<int>& table = submesh.bonePalette;
+    if (table.empty())
+        return;
+
+    const PositionQuantization* quantization = App->foldPositionQuantization ? &App->packedMesh.positionRanges[submeshIndex] : nullptr;
+    switch (App->paletteFormat) {
+    case PaletteFormat::Affine3x4:
+        if (quantization)
+            GatherPalette(App->fullPalette3x4, table, *quantization, App->boneMatrixData3x4.boneMatrices);
+        else
+            GatherPalette(App->fullPalette3x4, table, App->boneMatrixData3x4.boneMatrices);
+        break;
+    case PaletteFormat::DualQuaternion:
+        GatherPalette(App->fullPaletteDualQuat, table, App->boneDualQuatData.boneDualQuats);
+        if (App->boneScaleBuffer) {
+            GatherPalette(App->fullPaletteScale, table, App->boneScaleData.boneScales);
+            UploadBoneRange(App->boneScaleBuffer, &App->boneScaleData, sizeof(BoneScale), 0, int(table.size()) - 1);
+        }
+        break;
+    default:
+        if (quantization)
+            GatherPalette(App->fullPalette, table, *quantization, App->boneMatrixData.boneMatrices);
+        else
+            GatherPalette(App->fullPalette, table, App->boneMatrixData.boneMatrices);
+        break;
+    }
 
-    for (unsigned int i = 0; i < node->mNumChildren; ++i)
-        CollectAnimatedBonePositions(node->mChildren[i], globalTransform, boneAnimCache, animTime, bonePositions);
+    UINT boneSize = 0;
+    const void* paletteData = GetBonePaletteData(App, boneSize);
+    UploadBoneRange(App->boneMatrixBuffer, paletteData, boneSize, 0, int(table.size()) - 1);
 
+    ConstantBuffer cb = SubmeshConstants(App, submeshIndex);
+    g_pImmediateContext->UpdateSubresource(App->constantBuffer, 0, nullptr, &cb, 0, 0);
 }
 
-void CollectAnimatedBoneMatrices(
-    aiNode* node,
-    const aiMatrix4x4& parentTransform,
-    const std::map<std::string, BoneAnimCache>& boneAnimCache,
-    const std::map<std::string, int>& boneNameToIndex,
-    const std::map<std::string, aiMatrix4x4>& boneOffsetMatrices,
-    float animTime,
-    std::map<std::string, aiMatrix4x4>& nodeGlobalTransforms, // 可选，调试用
-    DirectX::XMMATRIX* outBoneMatrices, // 128个
-    int maxBones
-)
+// 由 world * view * proj 提取模型空间的 6 个视锥平面（D3D 裁剪空间 z 在 [0, w]），法线指向内侧
+void ExtractFrustumPlanes(App* App, float planes[6][4])
 {
-    // 1. 计算本地变换（和你原来的 CollectAnimatedBonePositions 一样）
-    aiMatrix4x4 localTransform = node->mTransformation;
-    auto it = boneAnimCache.find(node->mName.C_Str());
-    if (it != boneAnimCache.end()) {
-        const BoneAnimCache& cache = it->second;
-        // ...（插值代码同你原来的 CollectAnimatedBonePositions）...
-        aiVector3D pos(0, 0, 0);
-        if (!cache.positions.empty()) {
-            if (cache.positions.size() == 1) pos = cache.positions[0].mValue;
-            else {
-                size_t idx = FindKeyIndex(cache.positions, animTime);
-                float t = float((animTime - cache.positions[idx].mTime) /
-                    (cache.positions[idx + 1].mTime - cache.positions[idx].mTime));
-                pos = Lerp(cache.positions[idx].mValue, cache.positions[idx + 1].mValue, t);
-            }
+    // App->cb 中存的是转置后的矩阵，proj * view * world 即 (world * view * proj) 的转置，它的行就是原矩阵的列
+    DirectX::XMFLOAT4X4 m;
+    DirectX::XMStoreFloat4x4(&m, DirectX::XMMatrixMultiply(DirectX::XMMatrixMultiply(App->cb.proj, App->cb.view), App->cb.world));
+    const float* x = m.m[0];
+    const float* y = m.m[1];
+    const float* z = m.m[2];
+    const float* w = m.m[3];
+    for (int k = 0; k < 4; ++k) {
+        planes[0][k] = w[k] + x[k];     // 左
+        planes[1][k] = w[k] - x[k];     // 右
+        planes[2][k] = w[k] + y[k];     // 下
+        planes[3][k] = w[k] - y[k];     // 上
+        planes[4][k] = z[k];            // 近
+        planes[5][k] = w[k] - z[k];     // 远
+    }
+}
+
+// 每个子网格按影响数桶各一次 DrawIndexed，索引相对子网格的起始顶点（BaseVertexLocation）；
+// 未划分时只有一个子网格，调色板已在 UpdateConstant 中上传
+void DrawSkinnedMesh(App* App)
+{
+    // 整个角色的包围盒在视锥外时什么都不画，只在状态变化时打印
+    if (App->skinnedBoundsValid) {
+        float planes[6][4];
+        ExtractFrustumPlanes(App, planes);
+        MeshletBounds bounds;
+        bounds.min = App->skinnedBounds.min;
+        bounds.max = App->skinnedBounds.max;
+        bool culled = !MeshletBoundsVisible(bounds, planes);
+        if (culled != App->characterCulled) {
+            std::cout << "[Bounds] character " << (culled ? "outside" : "inside") << " the view frustum" << std::endl;
+            App->characterCulled = culled;
         }
-        aiQuaternion rot;
-        if (!cache.rotations.empty()) {
-            if (cache.rotations.size() == 1) rot = cache.rotations[0].mValue;
-            else {
-                size_t idx = FindKeyIndex(cache.rotations, animTime);
-                float t = float((animTime - cache.rotations[idx].mTime) /
-                    (cache.rotations[idx + 1].mTime - cache.rotations[idx].mTime));
-                rot = Slerp(cache.rotations[idx].mValue, cache.rotations[idx + 1].mValue, t);
+        if (culled)
+            return;
+    }
+
+    // 远处绘制简化后的 LOD：整个网格一次 DrawIndexed，用与本级影响数对应的 MAX_INFLUENCES 变体（已编译时）
+    if (App->lodLevel > 0 && size_t(App->lodLevel) <= App->lodVertexBuffers.size()) {
+        const MeshLodLevel& level = App->lodChain.levels[App->lodLevel - 1];
+        ID3D11VertexShader* shader = App->influenceShaders[InfluenceBucketIndex(level.influenceCount)];
+        g_pImmediateContext->VSSetShader(shader ? shader : App->vertexShader, nullptr, 0);
+        UINT stride = sizeof(Vertex);
+        UINT offset = 0;
+        g_pImmediateContext->IASetVertexBuffers(0, 1, &App->lodVertexBuffers[App->lodLevel - 1], &stride, &offset);
+        g_pImmediateContext->IASetIndexBuffer(App->lodIndexBuffers[App->lodLevel - 1], DXGI_FORMAT_R32_UINT, 0);
+        g_pImmediateContext->DrawIndexed(UINT(level.indices.size()), 0, 0);
+        return;
+    }
+
+    // meshlet 剔除：调色板按全局骨骼下标，划分时是完整调色板，否则就是上传的调色板
+    float planes[6][4];
+    bool cullMeshlets = App->meshletCulling && !App->meshlets.meshlets.empty();
+    if (cullMeshlets) {
+        if (App->paletteFormat == PaletteFormat::Affine3x4)
+            ComputeMeshletBounds(App->meshlets, App->paletteSplit ? App->fullPalette3x4.data() : App->boneMatrixData3x4.boneMatrices,
+                App->meshletBounds.data(), &App->jobs);
+        else
+            ComputeMeshletBounds(App->meshlets, App->paletteSplit ? App->fullPalette.data() : App->boneMatrixData.boneMatrices,
+                App->meshletBounds.data(), &App->jobs);
+        ExtractFrustumPlanes(App, planes);
+    }
+    size_t meshletCursor = 0;
+
+    ID3D11VertexShader* currentShader = App->vertexShader;
+    for (size_t s = 0; s < App->gpuMesh.submeshes.size(); ++s) {
+        const SkinnedSubmesh& submesh = App->gpuMesh.submeshes[s];
+        if (App->paletteSplit)
+            UploadSubmeshPalette(App, s);
+        const SubmeshIndexRange& indexRange = App->indexData.submeshes[s];
+        g_pImmediateContext->IASetIndexBuffer(App->indexBuffer,
+            indexRange.wide ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT, indexRange.byteOffset);
+        for (size_t d = 0; d < submesh.draws.size(); ++d) {
+            const InfluenceDraw& draw = submesh.draws[d];
+            // 未分桶时没有桶变体，沿用 Run 中设置的完整变体
+            ID3D11VertexShader* shader = draw.influences == 0 ? App->rigidShader
+                : App->influenceShaders[InfluenceBucketIndex(draw.influences)];
+            if (shader && shader != currentShader) {
+                g_pImmediateContext->VSSetShader(shader, nullptr, 0);
+                currentShader = shader;
             }
-        }
-        aiVector3D scale(1, 1, 1);
-        if (!cache.scalings.empty()) {
-            if (cache.scalings.size() == 1) scale = cache.scalings[0].mValue;
-            else {
-                size_t idx = FindKeyIndex(cache.scalings, animTime);
-                float t = float((animTime - cache.scalings[idx].mTime) /
-                    (cache.scalings[idx + 1].mTime - cache.scalings[idx].mTime));
-                scale = Lerp(cache.scalings[idx].mValue, cache.scalings[idx + 1].mValue, t);
+            // 刚性段：每次 draw 只换常量缓冲区里的一个骨骼槽位，顶点不再读取骨骼下标和权重
+            if (draw.influences == 0) {
+                ConstantBuffer cb = SubmeshConstants(App, s);
+                cb.rigidBoneIndex = UINT(draw.rigidBone);
+                g_pImmediateContext->UpdateSubresource(App->constantBuffer, 0, nullptr, &cb, 0, 0);
             }
-        }
-        aiMatrix4x4 matScale, matRot, matTrans;
-        aiMatrix4x4::Scaling(scale, matScale);
-        matRot = aiMatrix4x4(rot.GetMatrix());
-        aiMatrix4x4::Translation(pos, matTrans);
-        localTransform = matTrans * matRot * matScale;
-    }
-
-    // 2. 计算全局变换
-    aiMatrix4x4 globalTransform = parentTransform * localTransform;
-    nodeGlobalTransforms[node->mName.C_Str()] = globalTransform;
-
-    // 3. 如果是骨骼节点，计算最终蒙皮矩阵
-    auto idxIt = boneNameToIndex.find(node->mName.C_Str());
-    if (idxIt != boneNameToIndex.end()) {
-        int boneIdx = idxIt->second;
-        if (boneIdx < maxBones) {
-            // offsetMatrix * globalTransform
-            aiMatrix4x4 offset = boneOffsetMatrices.at(node->mName.C_Str());
-            aiMatrix4x4 finalTransform = globalTransform * offset;
-
-            // 转成 XMMATRIX
-            outBoneMatrices[boneIdx] = DirectX::XMMATRIX(
-                finalTransform.a1, finalTransform.b1, finalTransform.c1, finalTransform.d1,
-                finalTransform.a2, finalTransform.b2, finalTransform.c2, finalTransform.d2,
-                finalTransform.a3, finalTransform.b3, finalTransform.c3, finalTransform.d3,
-                finalTransform.a4, finalTransform.b4, finalTransform.c4, finalTransform.d4
-            );
-            outBoneMatrices[boneIdx] = DirectX::XMMatrixTranspose(outBoneMatrices[boneIdx]);
+            if (!cullMeshlets) {
+                g_pImmediateContext->DrawIndexed(draw.indexCount, draw.indexStart - submesh.indexStart, INT(submesh.vertexStart));
+                continue;
+            }
+            // meshlet 按 draw 顺序排列且连续，相邻的可见 meshlet 合并为一次 DrawIndexed
+            const std::vector<Meshlet>& meshlets = App->meshlets.meshlets;
+            uint32_t runStart = 0, runCount = 0;
+            for (; meshletCursor < meshlets.size() && meshlets[meshletCursor].submesh == s && meshlets[meshletCursor].draw == d; ++meshletCursor) {
+                const Meshlet& meshlet = meshlets[meshletCursor];
+                if (MeshletBoundsVisible(App->meshletBounds[meshletCursor], planes)) {
+                    if (runCount == 0)
+                        runStart = meshlet.indexStart;
+                    runCount += meshlet.triangleCount * 3;
+                }
+                else if (runCount > 0) {
+                    g_pImmediateContext->DrawIndexed(runCount, runStart - submesh.indexStart, INT(submesh.vertexStart));
+                    runCount = 0;
+                }
+            }
+            if (runCount > 0)
+                g_pImmediateContext->DrawIndexed(runCount, runStart - submesh.indexStart, INT(submesh.vertexStart));
         }
     }
-
-    // 递归
-    for (unsigned int i = 0; i < node->mNumChildren; ++i)
-        CollectAnimatedBoneMatrices(
-            node->mChildren[i], globalTransform,
-            boneAnimCache, boneNameToIndex, boneOffsetMatrices,
-            animTime, nodeGlobalTransforms, outBoneMatrices, maxBones
-        );
 }
 
 // 递归打印aiNode信息
@@ -610,6 +718,20 @@ void PrintNodeInfo(aiNode* node, int depth = 0)
     }
 }
 
+// 变形通道按名称对应到网格：名称等于网格名，或等于引用这些网格的节点名（FBX、glTF 以节点命名）
+void FindMorphChannelMeshes(const aiScene* scene, const aiNode* node, const std::string& name, std::vector<unsigned int>& meshes)
+{
+    if (node == scene->mRootNode) {
+        for (unsigned int m = 0; m < scene->mNumMeshes; ++m)
+            if (name == scene->mMeshes[m]->mName.C_Str())
+                meshes.push_back(m);
+    }
+    if (name == node->mName.C_Str())
+        meshes.insert(meshes.end(), node->mMeshes, node->mMeshes + node->mNumMeshes);
+    for (unsigned int i = 0; i < node->mNumChildren; ++i)
+        FindMorphChannelMeshes(scene, node->mChildren[i], name, meshes);
+}
+
 bool LoadModel(const std::string& filePath, App* App)
 {
 
@@ -631,13 +753,22 @@ bool LoadModel(const std::string& filePath, App* App)
     App->boneOffsetMatrices.clear();
     App->vertices.clear();
     App->indices.clear();
-
+    App->extraInfluences.clear();
+
+    // 先收集每个顶点的全部骨骼影响，所有网格读完后再统一裁剪到 N 个
+    std::vector<std::vector<BoneInfluence>> rawInfluences;
+    std::vector<MeshSourceRange> sourceMeshes;
+    // 变形目标先按导入顺序的顶点存放，顶点重排、划分完成后再换到 GPU 顶点顺序；
+    // meshFirstMorph[i] 为第 i 个网格的第一个目标在 importMorphs.targets 中的下标
+    MorphTargetSet importMorphs;
+    std::vector<size_t> meshFirstMorph(App->scene->mNumMeshes, 0);
     int boneCount = 0;
     for (unsigned int i = 0; i < App->scene->mNumMeshes; ++i)
     {
         aiMesh* mesh = App->scene->mMeshes[i];
 
         size_t baseVertex = App->vertices.size();
+        size_t baseIndex = App->indices.size();
 
         for (unsigned int v = 0; v < mesh->mNumVertices; ++v)
         {
@@ -649,12 +780,9 @@ bool LoadModel(const std::string& filePath, App* App)
             vert.position = { pos.x, pos.y, pos.z };
             vert.normal = { normal.x, normal.y, normal.z };
             vert.texcoord = { uv.x, uv.y };
-            for (int i = 0; i < 4; ++i) {
-                vert.boneIndices[i] = 0;
-                vert.boneWeights[i] = 0.0f;
-            }
             App->vertices.push_back(vert);
         }
+        rawInfluences.resize(App->vertices.size());
 
         for (unsigned int f = 0; f < mesh->mNumFaces; ++f)
         {
@@ -665,6 +793,17 @@ bool LoadModel(const std::string& filePath, App* App)
             }
         }
 
+        MeshSourceRange source;
+        source.vertexStart = uint32_t(baseVertex);
+        source.vertexCount = mesh->mNumVertices;
+        source.indexStart = uint32_t(baseIndex);
+        source.indexCount = uint32_t(App->indices.size() - baseIndex);
+        sourceMeshes.push_back(source);
+
+        meshFirstMorph[i] = importMorphs.targets.size();
+        if (App->loadMorphTargets && mesh->mNumAnimMeshes > 0)
+            AddMorphTargets(mesh, uint32_t(baseVertex), importMorphs);
+
         // 代码加在这里，打印aiMesh* mesh的信息
         // 打印该 mesh 的所有骨骼名称和位置
         if (mesh->HasBones()) {
@@ -689,20 +828,13 @@ bool LoadModel(const std::string& filePath, App* App)
                     App->boneNameToIndex[boneName] = boneCount++;
             }
 
-            // 2. 填充顶点的骨骼索引和权重
+            // 2. 收集顶点的骨骼索引和权重
             for (unsigned int b = 0; b < mesh->mNumBones; ++b) {
                 int boneIndex = App->boneNameToIndex[mesh->mBones[b]->mName.C_Str()];
                 for (unsigned int w = 0; w < mesh->mBones[b]->mNumWeights; ++w) {
                     unsigned int vId = mesh->mBones[b]->mWeights[w].mVertexId + baseVertex;
                     float weight = mesh->mBones[b]->mWeights[w].mWeight;
-                    Vertex& v = App->vertices[vId];
-                    for (int i = 0; i < 4; ++i) {
-                        if (v.boneWeights[i] == 0.0f) {
-                            v.boneIndices[i] = boneIndex;
-                            v.boneWeights[i] = weight;
-                            break;
-                        }
-                    }
+                    rawInfluences[vId].push_back({ uint32_t(boneIndex), weight });
                 }
             }
 
@@ -713,6 +845,58 @@ bool LoadModel(const std::string& filePath, App* App)
         }
     }
 
+    // 3. 每个顶点保留权重最大的 N 个影响并重新归一化，N 按资源选 4 或 8
+    int influenceCount = App->maxInfluences > 0 ? App->maxInfluences : ChooseInfluenceCount(rawInfluences);
+    ApplyInfluences(rawInfluences, influenceCount, App->vertices, App->extraInfluences, App->influenceStats);
+    const InfluenceStats& influenceStats = App->influenceStats;
+    std::cout << "[Influences] " << influenceStats.influenceCount << " per vertex (source max "
+        << influenceStats.maxSourceInfluences << "), " << influenceStats.prunedVertices << " vertices pruned, dropped weight max "
+        << influenceStats.maxDroppedWeight << " / mean " << influenceStats.meanDroppedWeight << ", "
+        << influenceStats.unweightedVertices << " unweighted vertices" << std::endl;
+
+    // LOD 链基于未裁剪的完整影响生成（每级按自己的影响数裁剪），每个源网格 × 级别一个任务
+    if (App->generateLods) {
+        auto lodBegin = std::chrono::steady_clock::now();
+        BuildMeshLodChain(App->vertices, rawInfluences, App->indices, sourceMeshes, DefaultMeshLodSettings(), App->lodChain, &App->jobs);
+        double lodMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - lodBegin).count();
+        size_t sourceTriangles = std::max<size_t>(App->indices.size() / 3, 1);
+        for (size_t l = 0; l < App->lodChain.levels.size(); ++l) {
+            const MeshLodLevel& level = App->lodChain.levels[l];
+            std::cout << "[LOD] level " << l + 1 << ": " << level.indices.size() / 3 << " triangles ("
+                << 100.0f * float(level.indices.size() / 3) / float(sourceTriangles) << "%), " << level.vertices.size()
+                << " vertices, " << level.influenceCount << " influence(s) (" << level.influenceStats.prunedVertices
+                << " vertices pruned, dropped weight max " << level.influenceStats.maxDroppedWeight << "), error "
+                << level.error << ", below screen size " << level.screenSize << std::endl;
+        }
+        std::cout << "[LOD] " << App->lodChain.levels.size() << " level(s) from " << sourceMeshes.size() << " mesh(es) in "
+            << lodMs << " ms on " << App->jobs.WorkerCount() << " worker(s), bounding radius " << App->lodChain.radius << std::endl;
+    }
+
+    // 跨网格去重：LOD 链依赖各源网格连续的顶点区间，放在它之后；被变形目标引用的顶点不合并。
+    // dedupSource[新下标] = 导入下标，下面的 vertexImportIndex 由它开始
+    std::vector<uint32_t> dedupSource;
+    if (App->dedupVertices) {
+        std::vector<unsigned char> locked;
+        if (!importMorphs.touchedVertices.empty()) {
+            locked.assign(App->vertices.size(), 0);
+            for (uint32_t v : importMorphs.touchedVertices)
+                locked[v] = 1;
+        }
+        VertexDedupStats dedup;
+        auto dedupBegin = std::chrono::steady_clock::now();
+        dedupSource = DeduplicateVertices(App->vertices, App->extraInfluences, App->indices, App->dedupEpsilon, &locked, &dedup);
+        double dedupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - dedupBegin).count();
+        std::vector<std::vector<BoneInfluence>> keptInfluences(dedupSource.size());
+        for (size_t v = 0; v < dedupSource.size(); ++v)
+            keptInfluences[v].swap(rawInfluences[dedupSource[v]]);
+        rawInfluences.swap(keptInfluences);
+        size_t removed = dedup.verticesBefore - dedup.verticesAfter;
+        std::cout << "[Dedup] " << dedup.verticesBefore << " -> " << dedup.verticesAfter << " vertices (-" << removed << ", "
+            << 100.0 * double(removed) / double(std::max<size_t>(dedup.verticesBefore, 1)) << "%) across " << sourceMeshes.size()
+            << " mesh(es), epsilon " << App->dedupEpsilon << ", " << dedup.lockedVertices << " morph vertices kept, "
+            << dedup.degenerateTriangles << " degenerate triangles dropped, " << dedupMs << " ms" << std::endl;
+    }
+
     // 1. 收集所有骨骼节点的世界空间位置
     std::map<std::string, aiVector3D> bonePositions;
     CollectBonePositions(App->scene->mRootNode, aiMatrix4x4(), bonePositions);
@@ -754,6 +938,111 @@ bool LoadModel(const std::string& filePath, App* App)
             App->boneAnimCache[channel->mNodeName.C_Str()] = std::move(cache);
         }
 
+        // 变形权重通道与骨骼通道共用时间轴，拆成每个目标一条轨道
+        if (!importMorphs.targets.empty()) {
+            for (unsigned int ch = 0; ch < anim->mNumMorphMeshChannels; ++ch) {
+                const aiMeshMorphAnim* channel = anim->mMorphMeshChannels[ch];
+                std::vector<unsigned int> meshes;
+                FindMorphChannelMeshes(App->scene, App->scene->mRootNode, channel->mName.C_Str(), meshes);
+                std::sort(meshes.begin(), meshes.end());
+                meshes.erase(std::unique(meshes.begin(), meshes.end()), meshes.end());
+                for (unsigned int m : meshes)
+                    AddMorphWeightTracks(channel, meshFirstMorph[m], App->scene->mMeshes[m]->mNumAnimMeshes, importMorphs);
+                if (meshes.empty())
+                    std::cout << "[Morph] channel " << channel->mName.C_Str() << " matches no mesh" << std::endl;
+            }
+        }
+
+    }
+
+    // 构建扁平骨架，折叠 FBX 枢轴辅助节点
+    BuildSkeleton(App->scene->mRootNode, App->boneAnimCache, App->boneNameToIndex, App->boneOffsetMatrices, App->skeleton);
+    std::cout << "[Skeleton] " << App->skeleton.joints.size() << " joints, "
+        << App->skeleton.foldedHelperNodes << " $AssimpFbx$ helper nodes folded, "
+        << App->skeleton.unfoldedHelperNodes << " kept as joints (fold error above " << SKELETON_FOLD_TOLERANCE << "), "
+        << App->skeleton.tracks.size() << " tracks" << std::endl;
+    if (App->scene->HasAnimations()) {
+        float maxError = VerifySkeletonAgainstHierarchy(App->skeleton, App->scene->mRootNode, App->boneAnimCache, App->animDuration);
+        std::cout << "[Skeleton] max relative error vs. unfolded hierarchy: " << maxError
+            << (maxError > SKELETON_FOLD_TOLERANCE ? " (above SKELETON_FOLD_TOLERANCE)" : "") << std::endl;
+    }
+    InitSkeletonPose(App->skeleton, App->pose);
+
+    // 裁剪引入的误差：在若干帧上对比全部影响与保留的影响的 CPU 蒙皮结果
+    if (influenceStats.prunedVertices > 0 && App->skeleton.boneCount > 0) {
+        const int sampleFrames = 8;
+        float maxError = 0.0f;
+        std::vector<aiMatrix4x4> palette(App->skeleton.boneCount);
+        for (int frame = 0; frame < sampleFrames; ++frame) {
+            SkeletonPose pose;
+            InitSkeletonPose(App->skeleton, pose);
+            SampleSkeletonPose(App->skeleton, App->animDuration * frame / sampleFrames, pose);
+            UpdateSkeletonPose(App->skeleton, pose, palette.data(), App->skeleton.boneCount);
+            maxError = std::max(maxError, MeasurePruningError(rawInfluences, App->vertices, App->extraInfluences, palette.data()));
+        }
+        std::cout << "[Influences] max position error from pruning over " << sampleFrames << " frames: " << maxError << std::endl;
+    }
+
+    // 有变形目标时记录 App->vertices 中每个顶点的导入下标，随下面的重排一起移动
+    std::vector<uint32_t> vertexImportIndex;
+    if (!importMorphs.targets.empty()) {
+        vertexImportIndex.resize(App->vertices.size());
+        for (size_t v = 0; v < vertexImportIndex.size(); ++v)
+            vertexImportIndex[v] = dedupSource.empty() ? uint32_t(v) : dedupSource[v];
+    }
+
+    // 顶点按影响数分桶排序，CPU 蒙皮按桶调用特化版本
+    App->influenceBuckets.clear();
+    if (App->bucketByInfluence) {
+        std::vector<uint32_t> sortRemap;
+        SortVerticesByInfluenceCount(App->vertices, App->extraInfluences, App->indices, App->rigidSegments, App->influenceBuckets, &sortRemap);
+        ApplyVertexRemap(vertexImportIndex, sortRemap);
+        size_t rigidSegmentCount = 0, rigidVertices = 0;
+        std::cout << "[Influences] vertex buckets:";
+        for (const InfluenceBucket& bucket : App->influenceBuckets) {
+            if (bucket.influences == 0) {
+                ++rigidSegmentCount;
+                rigidVertices += bucket.vertexCount;
+                continue;
+            }
+            std::cout << " " << bucket.influences << "x" << bucket.vertexCount;
+        }
+        std::cout << ", rigid " << rigidVertices << " vertices in " << rigidSegmentCount << " segment(s), average " << AverageBucketInfluences(App->influenceBuckets) << " influence iterations per vertex (was "
+            << influenceCount << ")" << std::endl;
+    }
+
+    // CPU 端同样按三角形的首次使用给顶点重新编号（只在各桶内移动，分桶蒙皮不受影响），
+    // 按三角形读取蒙皮结果的代码（碰撞、拾取等）沿缓存行前进，蒙皮本身仍是顺序读取
+    if (App->optimizeVertexFetch) {
+        std::vector<VertexRange> ranges;
+        for (const InfluenceBucket& bucket : App->influenceBuckets) {
+            VertexRange range;
+            range.start = bucket.vertexStart;
+            range.count = bucket.vertexCount;
+            ranges.push_back(range);
+        }
+        VertexFetchStats before = AnalyzeVertexFetch(App->indices.data(), App->indices.size(), App->vertices.size(), sizeof(Vertex));
+        std::vector<uint32_t> remap = BuildVertexFetchRemap(App->indices.data(), App->indices.size(), App->vertices.size(), ranges);
+        ApplyVertexRemap(App->vertices, remap);
+        ApplyVertexRemap(App->extraInfluences, remap);
+        ApplyVertexRemap(vertexImportIndex, remap);
+        RemapIndices(App->indices.data(), App->indices.size(), remap);
+        VertexFetchStats after = AnalyzeVertexFetch(App->indices.data(), App->indices.size(), App->vertices.size(), sizeof(Vertex));
+        std::cout << "[VertexFetch] CPU overfetch " << before.overfetch << " -> " << after.overfetch
+            << " (renumbered within " << std::max<size_t>(ranges.size(), 1) << " vertex range(s))" << std::endl;
+    }
+
+    App->boneMatrixData = BoneMatrixBuffer();
+    App->boneMatrixData3x4 = BoneMatrixBuffer3x4();
+    App->boneDualQuatData = BoneDualQuatBuffer();
+    App->boneScaleData = BoneScaleBuffer();
+
+    // 对偶四元数不能表示缩放；只有动画中确实出现缩放时才启用单独的缩放调色板
+    if (App->paletteFormat == PaletteFormat::DualQuaternion) {
+        float scaleDeviation = MaxSkinningScaleDeviation(App->skeleton, App->animDuration);
+        App->paletteHasScale = scaleDeviation > 1e-3f;
+        std::cout << "[DQS] max skinning scale deviation: " << scaleDeviation
+            << (App->paletteHasScale ? ", using per-bone scale palette" : ", rigid palette") << std::endl;
     }
 
     if (App->scene && App->scene->mRootNode) {
@@ -764,22 +1053,330 @@ bool LoadModel(const std::string& filePath, App* App)
 
     App->vbd = {};
     App->vbd.Usage = D3D11_USAGE_DEFAULT;
-    App->vbd.ByteWidth = sizeof(Vertex) * App->vertices.size();
+    // 骨骼数超过常量缓冲区容量时，把网格划分为各自调色板放得下的子网格
+    PartitionMeshByBones(App->vertices, App->extraInfluences, App->indices, BONE_PALETTE_CAPACITY, App->gpuMesh);
+    App->paletteSplit = App->gpuMesh.submeshes.size() > 1;
+    if (App->bucketByInfluence) {
+        float gpuIterations = BucketTrianglesByInfluence(App->gpuMesh, App->rigidSegments);
+        size_t drawCount = 0;
+        for (const SkinnedSubmesh& submesh : App->gpuMesh.submeshes)
+            drawCount += submesh.draws.size();
+        std::cout << "[Influences] " << drawCount << " bucketed draw(s), average " << gpuIterations
+            << " influence iterations per vertex shader invocation (was " << influenceCount << ")" << std::endl;
+    }
+    std::cout << "[Mesh] " << App->skeleton.boneCount << " bones, " << App->gpuMesh.submeshes.size()
+        << " submesh draw(s), " << App->gpuMesh.duplicatedVertices << " duplicated vertices" << std::endl;
+
+    // 导入顺序的三角形对后变换缓存不友好，每个 draw 内重新排序（确定性，不依赖 aiProcess_ImproveCacheLocality）
+    if (App->optimizeVertexCache) {
+        const std::vector<uint32_t>& indices = App->gpuMesh.indices;
+        size_t vertexCount = App->gpuMesh.vertices.size();
+        VertexCacheStats before = AnalyzeVertexCache(indices.data(), indices.size(), vertexCount);
+        auto optimizeBegin = std::chrono::steady_clock::now();
+        OptimizeMeshVertexCache(App->gpuMesh);
+        double optimizeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - optimizeBegin).count();
+        VertexCacheStats after = AnalyzeVertexCache(indices.data(), indices.size(), vertexCount);
+        std::cout << "[VertexCache] ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr
+            << " (FIFO " << VERTEX_CACHE_FIFO_SIZE << "), vertex shader invocations " << before.misses << " -> " << after.misses
+            << ", " << optimizeMs << " ms" << std::endl;
+    }
+
+    // 三角形重排后顶点仍是导入顺序，按首次使用重新编号（子网格内），使顶点读取沿缓存行前进。
+    // 顶点步长要等压缩格式确定后才知道（位置量化可能被放弃），统计在打包之后输出
+    std::vector<uint32_t> fetchIndicesBefore;
+    if (App->optimizeVertexFetch) {
+        fetchIndicesBefore = App->gpuMesh.indices;
+        OptimizeMeshVertexFetch(App->gpuMesh);
+    }
+
+    // GPU 顶点顺序已确定，变形目标换到这个顺序（子网格复制出的顶点各自一份增量）
+    App->morphTargets = MorphTargetSet();
+    if (!importMorphs.targets.empty()) {
+        std::vector<uint32_t> gpuSource(App->gpuMesh.sourceVertices.size());
+        for (size_t v = 0; v < gpuSource.size(); ++v)
+            gpuSource[v] = vertexImportIndex[App->gpuMesh.sourceVertices[v]];
+        RemapMorphTargets(importMorphs, gpuSource, App->morphTargets);
+
+        size_t entries = 0, animated = 0;
+        for (const MorphTarget& target : App->morphTargets.targets) {
+            entries += target.vertices.size();
+            animated += target.weights.empty() ? 0 : 1;
+        }
+        size_t targetCount = App->morphTargets.targets.size();
+        std::cout << "[Morph] " << targetCount << " targets (" << animated << " with weight tracks), "
+            << double(entries) / double(targetCount) << " non-zero deltas per target, "
+            << App->morphTargets.touchedVertices.size() << " of " << gpuSource.size() << " vertices touched, "
+            << entries * (sizeof(MorphDelta) + sizeof(uint32_t)) / 1024 << " KB sparse (dense "
+            << targetCount * gpuSource.size() * sizeof(MorphDelta) / 1024 << " KB)" << std::endl;
+    }
+
+    // 整个角色的包围体：每个骨骼影响的顶点在骨骼空间中的包围盒，变形目标可能的位移一并计入。
+    // App->vertices 已是最终的 CPU 顶点顺序（全局骨骼下标），每帧只变换这些盒子
+    App->boneBounds = BoneBoundsSet();
+    App->skinnedBoundsValid = false;
+    if (App->paletteFormat == PaletteFormat::DualQuaternion) {
+        std::cout << "[Bounds] per-bone bounds disabled: DQS positions are not bounded by the bone transforms" << std::endl;
+    }
+    else if (App->skeleton.boneCount > 0) {
+        std::vector<float> displacement;
+        if (!importMorphs.targets.empty()) {
+            std::vector<float> importDisplacement;
+            ComputeMorphDisplacementBounds(importMorphs, importDisplacement);
+            displacement.resize(App->vertices.size());
+            for (size_t v = 0; v < displacement.size(); ++v)
+                displacement[v] = importDisplacement[vertexImportIndex[v]];
+        }
+        auto boundsBegin = std::chrono::steady_clock::now();
+        BuildBoneBounds(App->vertices, App->extraInfluences, App->skeleton,
+            displacement.empty() ? nullptr : displacement.data(), App->boneBounds);
+        double boundsMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - boundsBegin).count();
+        std::cout << "[Bounds] " << App->boneBounds.bones.size() << " bone boxes"
+            << (App->boneBounds.hasStatic ? " + 1 static box" : "") << " from " << App->vertices.size() << " vertices, "
+            << boundsMs << " ms" << std::endl;
+    }
+
+    // 拾取用的 BVH：按绑定姿态构建，之后每帧只 refit（拓扑不变）
+    App->bvh = SkinnedBvh();
+    App->bvhHitBone = -1;
+    if (App->buildBvh && !App->indices.empty()) {
+        App->bvhPositions.resize(App->vertices.size());
+        App->bvhNormals.resize(App->vertices.size());
+        for (size_t v = 0; v < App->vertices.size(); ++v)
+            App->bvhPositions[v] = App->vertices[v].position;
+        auto bvhBegin = std::chrono::steady_clock::now();
+        BuildSkinnedBvh(App->bvhPositions.data(), App->bvhPositions.size(), App->indices.data(), App->indices.size(), App->bvh);
+        double bvhMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - bvhBegin).count();
+        std::cout << "[BVH] " << App->indices.size() / 3 << " triangles, " << App->bvh.nodes.size() << " nodes, "
+            << App->bvh.leaves.size() << " leaves, " << bvhMs << " ms" << std::endl;
+    }
+
+    // 碰撞胶囊：与包围体一样由调色板变换，DQS 不适用
+    App->boneCapsules = BoneCapsuleSet();
+    App->capsuleHitBone = -1;
+    if (App->buildCapsules && App->paletteFormat == PaletteFormat::DualQuaternion) {
+        std::cout << "[Capsule] disabled: DQS palettes are not matrices" << std::endl;
+    }
+    else if (App->buildCapsules && App->skeleton.boneCount > 0) {
+        CapsuleFitStats fit;
+        auto capsuleBegin = std::chrono::steady_clock::now();
+        BuildBoneCapsules(App->vertices, App->extraInfluences, App->boneCapsules, &fit);
+        double capsuleMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - capsuleBegin).count();
+        App->capsuleBatch.Resize(App->boneCapsules.capsules.size());
+        std::cout << "[Capsule] " << App->boneCapsules.capsules.size() << " capsules from " << fit.vertices << " vertices, mean gap "
+            << fit.meanGap * 100.0f << "% of the radius, " << capsuleMs << " ms" << std::endl;
+    }
+
+    // 三角形顺序已确定，切成 meshlet 并记录各自的骨骼集合，每帧据此剔除视锥外的部分
+    if (App->meshletCulling && App->paletteFormat == PaletteFormat::DualQuaternion) {
+        std::cout << "[Meshlet] culling disabled: DQS positions are not bounded by the bone transforms" << std::endl;
+        App->meshletCulling = false;
+    }
+    if (App->meshletCulling) {
+        auto buildBegin = std::chrono::steady_clock::now();
+        BuildMeshlets(App->gpuMesh, App->meshlets);
+        double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildBegin).count();
+        App->meshletBounds.resize(App->meshlets.meshlets.size());
+        // 变形在蒙皮之前移动顶点：绑定包围球按簇内顶点可能的最大位移放大
+        if (!App->morphTargets.targets.empty()) {
+            std::vector<float> displacement;
+            ComputeMorphDisplacementBounds(App->morphTargets, displacement);
+            for (Meshlet& meshlet : App->meshlets.meshlets) {
+                float grow = 0.0f;
+                for (uint32_t i = meshlet.indexStart; i < meshlet.indexStart + meshlet.triangleCount * 3; ++i)
+                    grow = std::max(grow, displacement[App->gpuMesh.indices[i]]);
+                meshlet.radius += grow;
+            }
+        }
+        size_t meshletCount = std::max<size_t>(App->meshlets.meshlets.size(), 1);
+        std::cout << "[Meshlet] " << App->meshlets.meshlets.size() << " meshlets, avg "
+            << double(App->gpuMesh.indices.size() / 3) / meshletCount << " triangles, "
+            << double(App->meshlets.bones.size()) / meshletCount << " bones per meshlet, " << buildMs << " ms" << std::endl;
+    }
+    // 压缩顶点：GPU 子网格的下标是局部调色板槽位（不超过 BONE_PALETTE_CAPACITY），8 位即可
+    if (App->packedVertices) {
+        // 每个子网格的位置在自己的包围盒内量化，误差超过容差时放弃量化
+        std::vector<PositionQuantization> ranges;
+        for (const SkinnedSubmesh& submesh : App->gpuMesh.submeshes) {
+            PositionQuantization range;
+            range.vertexStart = submesh.vertexStart;
+            range.vertexCount = submesh.vertexCount;
+            ranges.push_back(range);
+        }
+        PackedVertexFormat format = MakePackedVertexFormat(App->quantizePositions, false, App->wideWeights);
+        PackVertices(App->gpuMesh.vertices.data(), App->gpuMesh.vertices.size(), format, App->packedMesh, ranges);
+        if (App->quantizePositions) {
+            float quantizationError = MaxQuantizationError(App->packedMesh);
+            size_t floatBytes = size_t(MakePackedVertexFormat(false, false, App->wideWeights).stride) * App->gpuMesh.vertices.size();
+            if (quantizationError > App->positionTolerance) {
+                std::cout << "[Packed] position quantization rejected: max error " << quantizationError
+                    << " exceeds tolerance " << App->positionTolerance << ", keeping float3 positions" << std::endl;
+                format = MakePackedVertexFormat(false, false, App->wideWeights);
+                PackVertices(App->gpuMesh.vertices.data(), App->gpuMesh.vertices.size(), format, App->packedMesh);
+            }
+            else {
+                std::cout << "[Packed] 16-bit positions in " << App->packedMesh.positionRanges.size()
+                    << " submesh box(es), max error " << quantizationError << " (tolerance " << App->positionTolerance
+                    << "), saved " << (floatBytes - App->packedMesh.data.size()) / 1024 << " KB over float3 positions" << std::endl;
+            }
+        }
+
+        // DQS 不能携带缩放，还原留在着色器中；矩阵调色板在收集子网格调色板时折进矩阵
+        App->foldPositionQuantization = format.quantizedPosition && App->paletteFormat != PaletteFormat::DualQuaternion;
+        if (App->foldPositionQuantization)
+            App->paletteSplit = true;
+        if (format.quantizedPosition) {
+            const PositionQuantization& range = App->packedMesh.positionRanges[0];
+            App->cb.positionScale = { range.scale, range.scale, range.scale, 0.0f };
+            App->cb.positionOffset = { range.offset.x, range.offset.y, range.offset.z, 0.0f };
+        }
+
+        size_t originalBytes = sizeof(Vertex) * App->gpuMesh.vertices.size();
+        PackingError error = MeasurePackingError(App->gpuMesh.vertices, App->packedMesh);
+        std::cout << "[Packed] " << sizeof(Vertex) << " -> " << format.stride << " bytes per vertex, "
+            << originalBytes / 1024 << " KB -> " << App->packedMesh.data.size() / 1024 << " KB (saved "
+            << 100.0f * (1.0f - float(App->packedMesh.data.size()) / float(std::max<size_t>(originalBytes, 1))) << "%)" << std::endl;
+        std::cout << "[Packed] max error: position " << error.position << ", normal " << error.normalDegrees
+            << " deg, texcoord " << error.texcoord << ", weight " << error.weight << std::endl;
+
+        // 蒙皮后的误差：CPU 端用全局下标（骨骼超过 256 时需要 16 位）打包 vertices，在动画中间帧对比
+        if (App->skeleton.boneCount > 0) {
+            PackedVertexBuffer cpuPacked;
+            PackVertices(App->vertices.data(), App->vertices.size(),
+                MakePackedVertexFormat(format.quantizedPosition, App->skeleton.boneCount > 256, App->wideWeights), cpuPacked);
+            std::vector<aiMatrix4x4> palette(App->skeleton.boneCount);
+            SkeletonPose pose;
+            InitSkeletonPose(App->skeleton, pose);
+            SampleSkeletonPose(App->skeleton, App->animDuration * 0.5f, pose);
+            UpdateSkeletonPose(App->skeleton, pose, palette.data(), App->skeleton.boneCount);
+
+            size_t count = App->vertices.size();
+            std::vector<Float3> positions(count), normals(count), packedPositions(count), packedNormals(count);
+            const VertexInfluences* extra = App->extraInfluences.empty() ? nullptr : App->extraInfluences.data();
+            SkinningKernel kernel = BestSkinningKernel();
+            SkinVerticesParallel(nullptr, App->vertices.data(), count, palette.data(), positions.data(), normals.data(), kernel, extra);
+            SkinPackedVertices(nullptr, cpuPacked, palette.data(), packedPositions.data(), packedNormals.data(), kernel, extra);
+            float maxError = 0.0f;
+            for (size_t v = 0; v < count; ++v) {
+                float dx = positions[v].x - packedPositions[v].x;
+                float dy = positions[v].y - packedPositions[v].y;
+                float dz = positions[v].z - packedPositions[v].z;
+                maxError = std::max(maxError, std::sqrt(dx * dx + dy * dy + dz * dz));
+            }
+            std::cout << "[Packed] max skinned position error at mid-animation: " << maxError << std::endl;
+        }
+    }
+
+    // 顶点取数统计用实际上传的顶点步长：64 字节的 Vertex 正好一个缓存行，重新编号主要改善压缩顶点（24~36 字节）的取数
+    if (App->optimizeVertexFetch) {
+        const std::vector<uint32_t>& indices = App->gpuMesh.indices;
+        size_t vertexCount = App->gpuMesh.vertices.size();
+        size_t vertexSize = App->packedVertices ? App->packedMesh.format.stride : sizeof(Vertex);
+        VertexFetchStats before = AnalyzeVertexFetch(fetchIndicesBefore.data(), fetchIndicesBefore.size(), vertexCount, vertexSize);
+        VertexFetchStats after = AnalyzeVertexFetch(indices.data(), indices.size(), vertexCount, vertexSize);
+        std::cout << "[VertexFetch] GPU overfetch " << before.overfetch << " -> " << after.overfetch << ", "
+            << before.bytesFetched / 1024 << " KB -> " << after.bytesFetched / 1024 << " KB per draw pass ("
+            << vertexSize << " B vertices)" << std::endl;
+    }
+
+    // 位置还原折进调色板时顶点位置是子网格包围盒内的 [0, 1] 坐标，位置增量同样除以该子网格的缩放
+    if (App->foldPositionQuantization && !App->morphTargets.targets.empty()) {
+        std::vector<float> invScale(App->gpuMesh.vertices.size(), 1.0f);
+        for (const PositionQuantization& range : App->packedMesh.positionRanges)
+            for (uint32_t v = range.vertexStart; v < range.vertexStart + range.vertexCount; ++v)
+                invScale[v] = range.scale > 0.0f ? 1.0f / range.scale : 1.0f;
+        for (MorphTarget& target : App->morphTargets.targets)
+            for (size_t i = 0; i < target.vertices.size(); ++i)
+                for (int k = 0; k < 3; ++k)
+                    target.deltas[i].position[k] *= invScale[target.vertices[i]];
+    }
+
+    if (App->paletteSplit) {
+        App->fullPalette.assign(App->skeleton.boneCount, aiMatrix4x4());
+        App->fullPalette3x4.assign(App->skeleton.boneCount, BoneMatrix3x4());
+        App->fullPaletteDualQuat.assign(App->skeleton.boneCount, BoneDualQuat());
+        App->fullPaletteScale.assign(App->skeleton.boneCount, BoneScale());
+    }
+
+    App->vbd.ByteWidth = sizeof(Vertex) * App->gpuMesh.vertices.size();
     App->vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 
     App->vinitData = {};
-    App->vinitData.pSysMem = App->vertices.data();
+    App->vinitData.pSysMem = App->gpuMesh.vertices.data();
+
+    if (App->packedVertices) {
+        App->vbd.ByteWidth = UINT(App->packedMesh.data.size());
+        App->vinitData.pSysMem = App->packedMesh.data.data();
+    }
 
     App->vertexBuffer = nullptr;
     g_pd3dDevice->CreateBuffer(&App->vbd, &App->vinitData, &App->vertexBuffer);
 
+    // 第 5~8 个影响单独一个顶点流，4 影响资源不创建
+    App->influenceBuffer = nullptr;
+    if (!App->gpuMesh.extraInfluences.empty()) {
+        D3D11_BUFFER_DESC influenceDesc = App->vbd;
+        influenceDesc.ByteWidth = UINT(sizeof(VertexInfluences) * App->gpuMesh.extraInfluences.size());
+        D3D11_SUBRESOURCE_DATA influenceData = {};
+        influenceData.pSysMem = App->gpuMesh.extraInfluences.data();
+        g_pd3dDevice->CreateBuffer(&influenceDesc, &influenceData, &App->influenceBuffer);
+    }
+
+    // 变形增量也是单独一个顶点流（槽2），每帧在 UpdateConstant 中更新
+    App->morphBuffer = nullptr;
+    App->morphActiveTargets = 0;
+    if (!App->morphTargets.targets.empty()) {
+        App->morphWeights.assign(App->morphTargets.targets.size(), 0.0f);
+        App->morphDeltas.assign(App->gpuMesh.vertices.size(), MorphDelta());
+        D3D11_BUFFER_DESC morphDesc = App->vbd;
+        morphDesc.ByteWidth = UINT(sizeof(MorphDelta) * App->morphDeltas.size());
+        D3D11_SUBRESOURCE_DATA morphData = {};
+        morphData.pSysMem = App->morphDeltas.data();
+        g_pd3dDevice->CreateBuffer(&morphDesc, &morphData, &App->morphBuffer);
+    }
+
+    // 索引相对子网格的起始顶点，顶点不超过 65536 的子网格用 16 位
+    BuildSubmeshIndexBuffer(App->gpuMesh, App->indexData);
+    std::cout << "[Mesh] index buffer " << App->indexData.data.size() / 1024 << " KB (was "
+        << sizeof(UINT) * App->gpuMesh.indices.size() / 1024 << " KB as 32-bit), "
+        << App->gpuMesh.submeshes.size() - App->indexData.wideSubmeshes << " of " << App->gpuMesh.submeshes.size()
+        << " submesh(es) use 16-bit indices" << std::endl;
+
+    // LOD 顶点是全局骨骼下标的 float 顶点，与未划分、未压缩的原网格共用输入布局和调色板
+    bool lodDrawable = !App->paletteSplit && !App->packedVertices && App->gpuMesh.extraInfluences.empty() && !App->morphBuffer;
+    for (const MeshLodLevel& level : App->lodChain.levels)
+        lodDrawable = lodDrawable && level.extraInfluences.empty();
+    if (lodDrawable) {
+        for (const MeshLodLevel& level : App->lodChain.levels) {
+            D3D11_BUFFER_DESC desc = {};
+            desc.Usage = D3D11_USAGE_DEFAULT;
+            desc.ByteWidth = UINT(sizeof(Vertex) * level.vertices.size());
+            desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+            D3D11_SUBRESOURCE_DATA data = {};
+            data.pSysMem = level.vertices.data();
+            ID3D11Buffer* vertexBuffer = nullptr;
+            g_pd3dDevice->CreateBuffer(&desc, &data, &vertexBuffer);
+
+            desc.ByteWidth = UINT(sizeof(uint32_t) * level.indices.size());
+            desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+            data.pSysMem = level.indices.data();
+            ID3D11Buffer* indexBuffer = nullptr;
+            g_pd3dDevice->CreateBuffer(&desc, &data, &indexBuffer);
+
+            App->lodVertexBuffers.push_back(vertexBuffer);
+            App->lodIndexBuffers.push_back(indexBuffer);
+        }
+    }
+    else if (!App->lodChain.levels.empty()) {
+        std::cout << "[LOD] levels are selected but not drawn: the mesh uses palette split, packed vertices, 8 influences or morph targets" << std::endl;
+    }
+
     App->ibd = {};
     App->ibd.Usage = D3D11_USAGE_DEFAULT;
-    App->ibd.ByteWidth = sizeof(UINT) * App->indices.size();
+    App->ibd.ByteWidth = UINT(App->indexData.data.size());
     App->ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
 
     App->iinitData = {};
-    App->iinitData.pSysMem = App->indices.data();
+    App->iinitData.pSysMem = App->indexData.data.data();
 
     App->indexBuffer = nullptr;
     g_pd3dDevice->CreateBuffer(&App->ibd, &App->iinitData, &App->indexBuffer);
@@ -794,10 +1391,20 @@ bool LoadModel(const std::string& filePath, App* App)
 
     D3D11_BUFFER_DESC bd = {};
     bd.Usage = D3D11_USAGE_DEFAULT;
-    bd.ByteWidth = sizeof(BoneMatrixBuffer);
+    UINT boneSize = 0;
     bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
     bd.CPUAccessFlags = 0;
-    g_pd3dDevice->CreateBuffer(&bd, nullptr, &App->boneMatrixBuffer);
+    // 用单位矩阵初始化，之后每帧只局部更新脏区间
+    D3D11_SUBRESOURCE_DATA boneInitData = {};
+    boneInitData.pSysMem = GetBonePaletteData(App, boneSize);
+    bd.ByteWidth = boneSize * BONE_PALETTE_CAPACITY;
+    g_pd3dDevice->CreateBuffer(&bd, &boneInitData, &App->boneMatrixBuffer);
+
+    if (App->paletteFormat == PaletteFormat::DualQuaternion && App->paletteHasScale) {
+        bd.ByteWidth = sizeof(BoneScaleBuffer);
+        boneInitData.pSysMem = &App->boneScaleData;
+        g_pd3dDevice->CreateBuffer(&bd, &boneInitData, &App->boneScaleBuffer);
+    }
 
     return true;
 }
@@ -806,11 +1413,37 @@ bool LoadModel(const std::string& filePath, App* App)
 bool InitShaders(App* app)
 {
     // 编译 Vertex Shader
+    // 默认使用 PhongShader.hlsl；紧凑调色板、DQS、压缩顶点、8 影响和变形目标使用 SkinningShader.hlsl 的对应变体。
+    // baseDefines 是调色板与顶点格式宏，所有变体共用
+    const wchar_t* shaderFile = L"data/PhongShader.hlsl";
+    bool eightInfluences = app->influenceBuffer != nullptr;
+    std::vector<D3D_SHADER_MACRO> baseDefines;
+    if (app->paletteFormat == PaletteFormat::Affine3x4)
+        baseDefines.push_back({ "BONE_PALETTE_3X4", "1" });
+    else if (app->paletteFormat == PaletteFormat::DualQuaternion) {
+        baseDefines.push_back({ "SKINNING_DQS", "1" });
+        baseDefines.push_back({ "DQS_SCALE", app->paletteHasScale ? "1" : "0" });
+    }
+    if (app->packedVertices) {
+        baseDefines.push_back({ "PACKED_VERTEX", "1" });
+        bool shaderDequantize = app->packedMesh.format.quantizedPosition && !app->foldPositionQuantization;
+        baseDefines.push_back({ "QUANTIZED_POSITION", shaderDequantize ? "1" : "0" });
+    }
+    if (app->morphBuffer)
+        baseDefines.push_back({ "MORPH_TARGETS", "1" });
+    std::vector<D3D_SHADER_MACRO> shaderDefines = baseDefines;
+    if (eightInfluences)
+        shaderDefines.push_back({ "MAX_INFLUENCES", "8" });
+    if (!shaderDefines.empty())
+        shaderFile = L"data/SkinningShader.hlsl";
+    shaderDefines.push_back({ nullptr, nullptr });
+    const D3D_SHADER_MACRO* defines = shaderDefines.data();
+
     ID3DBlob* vsBlob = nullptr;
     ID3DBlob* errorBlob = nullptr;
     HRESULT hr = D3DCompileFromFile(
-        L"data/PhongShader.hlsl",
-        nullptr, nullptr,
+        shaderFile,
+        defines, nullptr,
         "VSMain", "vs_5_0",
         D3DCOMPILE_ENABLE_STRICTNESS, 0,
         &vsBlob, &errorBlob);
@@ -836,8 +1469,8 @@ bool InitShaders(App* app)
     // 编译 Pixel Shader
     ID3DBlob* psBlob = nullptr;
     hr = D3DCompileFromFile(
-        L"data/PhongShader.hlsl",
-        nullptr, nullptr,
+        shaderFile,
+        defines, nullptr,
         "PSMain", "ps_5_0",
         D3DCOMPILE_ENABLE_STRICTNESS, 0,
         &psBlob, &errorBlob);
@@ -861,18 +1494,94 @@ bool InitShaders(App* app)
         return false;
     }
 
+    // 影响数分桶：为每个用到的桶编译一个 MAX_INFLUENCES 变体，输入签名都是完整变体的子集，共用同一个输入布局
+    if (app->bucketByInfluence)
+    {
+        // 最后一项为刚性段变体
+        bool bucketUsed[INFLUENCE_BUCKET_COUNT + 1] = {};
+        for (const SkinnedSubmesh& submesh : app->gpuMesh.submeshes)
+            for (const InfluenceDraw& draw : submesh.draws)
+                bucketUsed[draw.influences == 0 ? INFLUENCE_BUCKET_COUNT : InfluenceBucketIndex(draw.influences)] = true;
+
+        for (int b = 0; b <= INFLUENCE_BUCKET_COUNT; ++b)
+        {
+            if (!bucketUsed[b])
+                continue;
+            bool rigid = b == INFLUENCE_BUCKET_COUNT;
+            std::string influences = std::to_string(rigid ? 1 : InfluenceBucketSize(b));
+            std::vector<D3D_SHADER_MACRO> bucketDefines = baseDefines;
+            bucketDefines.push_back({ "MAX_INFLUENCES", influences.c_str() });
+            if (rigid)
+                bucketDefines.push_back({ "RIGID_SEGMENT", "1" });
+            bucketDefines.push_back({ nullptr, nullptr });
+
+            ID3DBlob* bucketBlob = nullptr;
+            hr = D3DCompileFromFile(
+                L"data/SkinningShader.hlsl",
+                bucketDefines.data(), nullptr,
+                "VSMain", "vs_5_0",
+                D3DCOMPILE_ENABLE_STRICTNESS, 0,
+                &bucketBlob, &errorBlob);
+            if (FAILED(hr))
+            {
+                if (errorBlob)
+                {
+                    OutputDebugStringA((char*)errorBlob->GetBufferPointer());
+                    errorBlob->Release();
+                }
+                vsBlob->Release();
+                return false;
+            }
+            hr = g_pd3dDevice->CreateVertexShader(bucketBlob->GetBufferPointer(), bucketBlob->GetBufferSize(), nullptr,
+                rigid ? &app->rigidShader : &app->influenceShaders[b]);
+            bucketBlob->Release();
+            if (FAILED(hr))
+            {
+                vsBlob->Release();
+                return false;
+            }
+        }
+    }
+
     // 定义顶点输入布局
-    D3D11_INPUT_ELEMENT_DESC layout[] =
+    std::vector<D3D11_INPUT_ELEMENT_DESC> layout =
     {
         { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0,                             D3D11_INPUT_PER_VERTEX_DATA, 0 },
         { "NORMAL",   0, DXGI_FORMAT_R32G32B32_FLOAT, 0, sizeof(float) * 3,              D3D11_INPUT_PER_VERTEX_DATA, 0 },
         { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,    0, sizeof(float) * 6,              D3D11_INPUT_PER_VERTEX_DATA, 0 },
         { "BONEINDICES", 0, DXGI_FORMAT_R32G32B32A32_UINT,  0, sizeof(float) * 8,           D3D11_INPUT_PER_VERTEX_DATA, 0 },
         { "BONEWEIGHTS", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, sizeof(float) * 8 + sizeof(UINT) * 4, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        // 第 5~8 个影响（VertexInfluences，槽1），只有 8 影响变体使用
+        { "BONEINDICES", 1, DXGI_FORMAT_R32G32B32A32_UINT,  1, offsetof(VertexInfluences, boneIndices), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        { "BONEWEIGHTS", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, offsetof(VertexInfluences, boneWeights), D3D11_INPUT_PER_VERTEX_DATA, 0 },
     };
 
+    if (app->packedVertices)
+    {
+        // 压缩顶点：语义不变，格式和偏移按 PackedVertexFormat，由输入装配器完成 UNORM/SNORM/半精度到 float 的转换
+        const PackedVertexFormat& format = app->packedMesh.format;
+        layout[0].Format = format.quantizedPosition ? DXGI_FORMAT_R16G16B16A16_UNORM : DXGI_FORMAT_R32G32B32_FLOAT;
+        layout[0].AlignedByteOffset = format.positionOffset;
+        layout[1].Format = DXGI_FORMAT_R16G16_SNORM;
+        layout[1].AlignedByteOffset = format.normalOffset;
+        layout[2].Format = DXGI_FORMAT_R16G16_FLOAT;
+        layout[2].AlignedByteOffset = format.texcoordOffset;
+        layout[3].Format = format.wideBoneIndices ? DXGI_FORMAT_R16G16B16A16_UINT : DXGI_FORMAT_R8G8B8A8_UINT;
+        layout[3].AlignedByteOffset = format.boneIndicesOffset;
+        layout[4].Format = format.wideWeights ? DXGI_FORMAT_R16G16B16A16_UNORM : DXGI_FORMAT_R8G8B8A8_UNORM;
+        layout[4].AlignedByteOffset = format.boneWeightsOffset;
+    }
+    if (!eightInfluences)
+        layout.resize(layout.size() - 2);
+    if (app->morphBuffer)
+    {
+        // 变形增量（MorphDelta，槽2）
+        layout.push_back({ "MORPHPOSITION", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 2, 0,                 D3D11_INPUT_PER_VERTEX_DATA, 0 });
+        layout.push_back({ "MORPHNORMAL",   0, DXGI_FORMAT_R32G32B32A32_FLOAT, 2, sizeof(float) * 4, D3D11_INPUT_PER_VERTEX_DATA, 0 });
+    }
+
     hr = g_pd3dDevice->CreateInputLayout(
-        layout, ARRAYSIZE(layout),
+        layout.data(), UINT(layout.size()),
         vsBlob->GetBufferPointer(),
         vsBlob->GetBufferSize(),
         &app->inputLayout);
@@ -949,6 +1658,19 @@ void UpdateConstant(App* App, float time)
 
     DirectX::XMMATRIX projectionMatrix = DirectX::XMMatrixPerspectiveFovLH(fovAngleY, aspectRatio, nearZ, farZ);
 
+    // LOD 选级：世界矩阵为单位矩阵，包围球中心即世界空间位置。有蒙皮包围体时用上一帧动画后的包围球
+    if (!App->lodChain.levels.empty()) {
+        const Float3& center = App->skinnedBoundsValid ? App->skinnedBounds.center : App->lodChain.center;
+        float radius = App->skinnedBoundsValid ? App->skinnedBounds.radius : App->lodChain.radius;
+        float dx = camX - center.x, dy = camY - center.y, dz = camZ - center.z;
+        float screenSize = ProjectedScreenSize(radius, std::sqrt(dx * dx + dy * dy + dz * dz), fovAngleY);
+        int lod = SelectMeshLod(App->lodChain, screenSize);
+        if (lod != App->lodLevel) {
+            std::cout << "[LOD] switched to level " << lod << " (screen size " << screenSize << ")" << std::endl;
+            App->lodLevel = lod;
+        }
+    }
+
     App->cb.world = DirectX::XMMatrixTranspose(worldMatrix);
     App->cb.view = DirectX::XMMatrixTranspose(viewMatrix);
     App->cb.proj = DirectX::XMMatrixTranspose(projectionMatrix);
@@ -995,39 +1717,163 @@ void UpdateConstant(App* App, float time)
     float ticksPerSecond = App->animTicksPerSecond > 0 ? App->animTicksPerSecond : 25.0f;
     float animTime = fmod(time * ticksPerSecond, App->animDuration);
 
-    // 递归收集骨骼变换并填充矩阵
+    // 变形权重与骨骼通道在同一时刻采样；只上传被目标触及的顶点区间，权重连续两帧全为 0 时不上传
+    if (App->morphBuffer) {
+        SampleMorphWeights(App->morphTargets, animTime, App->morphWeights.data());
+        size_t active = AccumulateMorphDeltas(App->morphTargets, App->morphWeights.data(), App->morphDeltas.data());
+        const std::vector<uint32_t>& touched = App->morphTargets.touchedVertices;
+        if ((active > 0 || App->morphActiveTargets > 0) && !touched.empty()) {
+            D3D11_BOX box = {};
+            box.left = UINT(sizeof(MorphDelta) * touched.front());
+            box.right = UINT(sizeof(MorphDelta) * (touched.back() + 1));
+            box.bottom = 1;
+            box.back = 1;
+            g_pImmediateContext->UpdateSubresource(App->morphBuffer, 0, &box, &App->morphDeltas[touched.front()], 0, 0);
+        }
+        App->morphActiveTargets = active;
+    }
+
+    // 采样动画，只重算脏关节及其子孙的全局变换和蒙皮矩阵
     if (App->scene && App->scene->mRootNode) {
-        // 清零
-        for (int i = 0; i < 128; ++i)
-            App->boneMatrixData.boneMatrices[i] = DirectX::XMMatrixIdentity();
-
-        std::map<std::string, aiMatrix4x4> nodeGlobalTransforms; // 可选
-        CollectAnimatedBoneMatrices(
-            App->scene->mRootNode, aiMatrix4x4(),
-            App->boneAnimCache,
-            App->boneNameToIndex,
-            App->boneOffsetMatrices,
-            animTime,
-            nodeGlobalTransforms,
-            App->boneMatrixData.boneMatrices,
-            128
-        );
-
-        // 更新到 GPU
-        g_pImmediateContext->UpdateSubresource(App->boneMatrixBuffer, 0, nullptr, &App->boneMatrixData, 0, 0);
+        SampleSkeletonPose(App->skeleton, animTime, App->pose, &App->jobs);
+        PoseUpdateResult update;
+        if (App->paletteSplit) {
+            // 子网格划分时写入完整调色板，在 DrawSkinnedMesh 中按子网格收集上传
+            int boneCount = App->skeleton.boneCount;
+            switch (App->paletteFormat) {
+            case PaletteFormat::Affine3x4:
+                update = UpdateSkeletonPose(App->skeleton, App->pose, App->fullPalette3x4.data(), boneCount, &App->jobs);
+                break;
+            case PaletteFormat::DualQuaternion:
+                update = UpdateSkeletonPose(App->skeleton, App->pose, App->fullPaletteDualQuat.data(),
+                    App->boneScaleBuffer ? App->fullPaletteScale.data() : nullptr, boneCount, &App->jobs);
+                break;
+            default:
+                update = UpdateSkeletonPose(App->skeleton, App->pose, App->fullPalette.data(), boneCount, &App->jobs);
+                break;
+            }
+        }
+        else {
+            switch (App->paletteFormat) {
+            case PaletteFormat::Affine3x4:
+                update = UpdateSkeletonPose(App->skeleton, App->pose, App->boneMatrixData3x4.boneMatrices, BONE_PALETTE_CAPACITY, &App->jobs);
+                break;
+            case PaletteFormat::DualQuaternion:
+                update = UpdateSkeletonPose(App->skeleton, App->pose, App->boneDualQuatData.boneDualQuats,
+                    App->boneScaleBuffer ? App->boneScaleData.boneScales : nullptr, BONE_PALETTE_CAPACITY, &App->jobs);
+                break;
+            default:
+                update = UpdateSkeletonPose(App->skeleton, App->pose, App->boneMatrixData.boneMatrices, BONE_PALETTE_CAPACITY, &App->jobs);
+                break;
+            }
+        }
+
+        // 更新到 GPU：只上传被改写的调色板区间
+        if (update.PaletteChanged() && !App->paletteSplit) {
+            UINT boneSize = 0;
+            const void* paletteData = GetBonePaletteData(App, boneSize);
+            UploadBoneRange(App->boneMatrixBuffer, paletteData, boneSize, update.firstBone, update.lastBone);
+            if (App->boneScaleBuffer)
+                UploadBoneRange(App->boneScaleBuffer, &App->boneScaleData, sizeof(BoneScale), update.firstBone, update.lastBone);
+        }
+        // 整个角色的包围体：由本帧的调色板变换各骨骼的盒子，世界矩阵为单位矩阵
+        if (!App->boneBounds.bones.empty() && (update.PaletteChanged() || !App->skinnedBoundsValid)) {
+            if (App->paletteFormat == PaletteFormat::Affine3x4)
+                ComputeSkinnedBounds(App->boneBounds, App->paletteSplit ? App->fullPalette3x4.data() : App->boneMatrixData3x4.boneMatrices,
+                    aiMatrix4x4(), App->skinnedBounds);
+            else
+                ComputeSkinnedBounds(App->boneBounds, App->paletteSplit ? App->fullPalette.data() : App->boneMatrixData.boneMatrices,
+                    aiMatrix4x4(), App->skinnedBounds);
+            App->skinnedBoundsValid = true;
+        }
+
+        // CPU 蒙皮（与 GPU 相同的调色板，不含变形目标增量）后 refit BVH，拾取相机视线上的骨骼
+        if (!App->bvh.nodes.empty() && update.PaletteChanged()) {
+            const VertexInfluences* extra = App->extraInfluences.empty() ? nullptr : App->extraInfluences.data();
+            const InfluenceBucket* buckets = App->influenceBuckets.data();
+            size_t bucketCount = App->influenceBuckets.size();
+            Float3* positions = App->bvhPositions.data();
+            Float3* normals = App->bvhNormals.data();
+            size_t count = App->vertices.size();
+            SkinningKernel kernel = BestSkinningKernel();
+            switch (App->paletteFormat) {
+            case PaletteFormat::Affine3x4: {
+                const BoneMatrix3x4* palette = App->paletteSplit ? App->fullPalette3x4.data() : App->boneMatrixData3x4.boneMatrices;
+                if (bucketCount > 0)
+                    SkinVerticesBucketed(&App->jobs, App->vertices.data(), extra, buckets, bucketCount, palette, positions, normals, kernel);
+                else
+                    SkinVerticesParallel(&App->jobs, App->vertices.data(), count, palette, positions, normals, kernel, extra);
+                break;
+            }
+            case PaletteFormat::DualQuaternion: {
+                const BoneDualQuat* palette = App->paletteSplit ? App->fullPaletteDualQuat.data() : App->boneDualQuatData.boneDualQuats;
+                const BoneScale* scales = !App->boneScaleBuffer ? nullptr :
+                    (App->paletteSplit ? App->fullPaletteScale.data() : App->boneScaleData.boneScales);
+                if (bucketCount > 0)
+                    SkinVerticesBucketed(&App->jobs, App->vertices.data(), extra, buckets, bucketCount, palette, scales, positions, normals, kernel);
+                else
+                    SkinVerticesParallel(&App->jobs, App->vertices.data(), count, palette, scales, positions, normals, kernel, extra);
+                break;
+            }
+            default: {
+                const aiMatrix4x4* palette = App->paletteSplit ? App->fullPalette.data() : App->boneMatrixData.boneMatrices;
+                if (bucketCount > 0)
+                    SkinVerticesBucketed(&App->jobs, App->vertices.data(), extra, buckets, bucketCount, palette, positions, normals, kernel);
+                else
+                    SkinVerticesParallel(&App->jobs, App->vertices.data(), count, palette, positions, normals, kernel, extra);
+                break;
+            }
+            }
+            RefitSkinnedBvh(App->bvh, positions, &App->jobs);
+
+            BvhRay ray;
+            ray.origin = { camX, camY, camZ };
+            ray.direction = { -camX, 100.0f - camY, -camZ };
+            BvhHit hit;
+            IntersectRays(App->bvh, positions, App->vertices.data(), extra, &ray, 1, &hit);
+            if (hit.bone != App->bvhHitBone) {
+                App->bvhHitBone = hit.bone;
+                if (hit.bone < 0)
+                    std::cout << "[BVH] view ray misses the character" << std::endl;
+                else
+                    std::cout << "[BVH] view ray hits triangle " << hit.triangle << " at t=" << hit.t << ", bone "
+                        << (hit.bone < (int)boneNames.size() ? boneNames[hit.bone] : std::string("?")) << " (index=" << hit.bone << ")" << std::endl;
+            }
+        }
+
+        // 碰撞胶囊：变换到本帧姿态，用同一条视线测试
+        if (!App->boneCapsules.capsules.empty() && update.PaletteChanged()) {
+            if (App->paletteFormat == PaletteFormat::Affine3x4)
+                TransformBoneCapsules(App->boneCapsules, App->paletteSplit ? App->fullPalette3x4.data() : App->boneMatrixData3x4.boneMatrices,
+                    aiMatrix4x4(), 0, App->capsuleBatch, 0);
+            else
+                TransformBoneCapsules(App->boneCapsules, App->paletteSplit ? App->fullPalette.data() : App->boneMatrixData.boneMatrices,
+                    aiMatrix4x4(), 0, App->capsuleBatch, 0);
+            BvhRay ray;
+            ray.origin = { camX, camY, camZ };
+            ray.direction = { -camX, 100.0f - camY, -camZ };
+            CapsuleHit hit;
+            IntersectRaysCapsules(App->capsuleBatch, &ray, 1, &hit);
+            int bone = hit.capsule != CAPSULE_NO_HIT ? int(App->capsuleBatch.bone[hit.capsule]) : -1;
+            if (bone != App->capsuleHitBone) {
+                App->capsuleHitBone = bone;
+                if (bone < 0)
+                    std::cout << "[Capsule] view ray misses the character" << std::endl;
+                else
+                    std::cout << "[Capsule] view ray hits bone " << (bone < (int)boneNames.size() ? boneNames[bone] : std::string("?"))
+                        << " (index=" << bone << ") at t=" << hit.t << std::endl;
+            }
+        }
+
         // 绑定到 VS 常量缓冲区槽1（假设槽0是普通常量缓冲区）
         g_pImmediateContext->VSSetConstantBuffers(1, 1, &App->boneMatrixBuffer);
-    }
-
+        if (App->boneScaleBuffer)
+            g_pImmediateContext->VSSetConstantBuffers(2, 1, &App->boneScaleBuffer);
 
-    // 更新动画骨骼位置
-    std::map<std::string, aiVector3D> bonePositions;
-    if (App->scene && App->scene->mRootNode)
-        CollectAnimatedBonePositions(App->scene->mRootNode, aiMatrix4x4(), App->boneAnimCache, animTime, bonePositions);
-    {
-        // 1. 利用动画后的 bonePositions 生成骨骼连线
+        // 1. 利用动画后的关节位置生成骨骼连线（姿态没变则沿用上一帧）
         std::vector<aiVector3D> boneLines;
-        CollectBoneLines(App->scene->mRootNode, bonePositions, boneLines);
+        if (update.updatedJoints > 0)
+            CollectSkeletonBoneLines(App->skeleton, App->pose.globals, boneLines);
 
         // 2. 重新创建骨骼线顶点缓冲区
         if (!boneLines.empty()) {
@@ -1107,6 +1953,31 @@ void UpdateConstant(App* App, float time)
 }
 
 
+// 以 "--bench" 启动时在加载模型后运行各项性能测试
+void RunBenchmarks(App* App)
+{
+    std::cout << "==== Benchmarks ====" << std::endl;
+    BenchmarkJointQueries(App->skeleton, App->animDuration);
+    BenchmarkCrowdUpdate(App->skeleton, App->animDuration, App->boneBounds.bones.empty() ? nullptr : &App->boneBounds);
+    BenchmarkLargeSkeleton(App->skeleton, App->animDuration);
+    BenchmarkCpuSkinning(App->vertices, App->skeleton, App->animDuration);
+    BenchmarkParallelSkinning(App->vertices, App->skeleton, App->animDuration);
+    BenchmarkPaletteFormats(App->vertices, App->skeleton, App->animDuration);
+    BenchmarkDualQuatSkinning(App->vertices, App->skeleton, App->animDuration);
+    BenchmarkInfluenceBuckets(App->vertices, App->extraInfluences, App->influenceBuckets, App->skeleton, App->animDuration);
+    BenchmarkRigidSegments(App->vertices, App->influenceBuckets, App->skeleton, App->animDuration);
+    BenchmarkVertexCache(App->indices, App->vertices.size());
+    BenchmarkMeshlets(App->gpuMesh, App->skeleton, App->animDuration);
+    BenchmarkMeshLod(App->vertices, App->extraInfluences, App->indices);
+    BenchmarkMorphTargets(App->morphTargets, App->animDuration);
+    BenchmarkSkinnedBounds(App->vertices, App->extraInfluences, App->skeleton, App->animDuration);
+    BenchmarkSkinnedBvh(App->vertices, App->extraInfluences, App->indices, App->skeleton, App->animDuration);
+    BenchmarkBoneCapsules(App->vertices, App->extraInfluences, App->skeleton, App->animDuration);
+    BenchmarkVertexDedup(App->vertices, App->extraInfluences, App->indices);
+    std::cout << "====================" << std::endl;
+}
+
+
 void CreateRasterizerStates()
 {
     D3D11_RASTERIZER_DESC rsDesc = {};
@@ -1119,7 +1990,7 @@ void CreateRasterizerStates()
 }
 
 
-int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int nCmdShow)
+int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR pCmdLine, int nCmdShow)
 {
     std::unique_ptr<App> app_inst = std::make_unique<App>();
 
@@ -1135,25 +2006,68 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR, int nCmdShow)
 
     CreateRasterizerStates();
 
-    if (FAILED(InitShaders(app_inst.get())))
+    if (pCmdLine && wcsstr(pCmdLine, L"--palette3x4"))
+        app_inst->paletteFormat = PaletteFormat::Affine3x4;
+    if (pCmdLine && wcsstr(pCmdLine, L"--dqs"))
+        app_inst->paletteFormat = PaletteFormat::DualQuaternion;
+    if (pCmdLine && wcsstr(pCmdLine, L"--influences4"))
+        app_inst->maxInfluences = 4;
+    if (pCmdLine && wcsstr(pCmdLine, L"--influences8"))
+        app_inst->maxInfluences = 8;
+    if (pCmdLine && wcsstr(pCmdLine, L"--influence-buckets"))
+        app_inst->bucketByInfluence = true;
+    if (pCmdLine && wcsstr(pCmdLine, L"--no-rigid-segments"))
+        app_inst->rigidSegments = false;
+    if (pCmdLine && wcsstr(pCmdLine, L"--no-vertex-cache-opt"))
+        app_inst->optimizeVertexCache = false;
+    if (pCmdLine && wcsstr(pCmdLine, L"--no-vertex-fetch-opt"))
+        app_inst->optimizeVertexFetch = false;
+    if (pCmdLine && wcsstr(pCmdLine, L"--no-morph-targets"))
+        app_inst->loadMorphTargets = false;
+    if (pCmdLine && wcsstr(pCmdLine, L"--bvh"))
+        app_inst->buildBvh = true;
+    if (pCmdLine && wcsstr(pCmdLine, L"--capsules"))
+        app_inst->buildCapsules = true;
+    if (pCmdLine && wcsstr(pCmdLine, L"--dedup-vertices"))
+        app_inst->dedupVertices = true;
+    if (pCmdLine && wcsstr(pCmdLine, L"--lods"))
+        app_inst->generateLods = true;
+    if (pCmdLine && wcsstr(pCmdLine, L"--meshlet-culling"))
+        app_inst->meshletCulling = true;
+    if (pCmdLine && wcsstr(pCmdLine, L"--packed-vertices"))
+        app_inst->packedVertices = true;
+    if (pCmdLine && wcsstr(pCmdLine, L"--quantize-positions"))
+        app_inst->packedVertices = app_inst->quantizePositions = true;
+    if (pCmdLine && wcsstr(pCmdLine, L"--weights16"))
+        app_inst->packedVertices = app_inst->wideWeights = true;
+
+    // 先加载模型：DQS 着色器变体取决于动画是否带缩放
+    if (!LoadModel("data/Taunt.fbx", app_inst.get()))
+    {
+        ReleaseAppResources(app_inst.get());
+        Cleanup();
+        return 0;
+    }
+
+    if (!InitShaders(app_inst.get()))
     {
+		ReleaseAppResources(app_inst.get());
 		Cleanup();
 		return 0;
 	}
 
     if (!InitBoneLineShader(app_inst.get())) {
+        ReleaseAppResources(app_inst.get());
         Cleanup();
         return 0;
     }
 
-    if (!LoadModel("data/Taunt.fbx", app_inst.get()))
-    {
-        Cleanup();
-        return 0;
-    }
+    if (pCmdLine && wcsstr(pCmdLine, L"--bench"))
+        RunBenchmarks(app_inst.get());
 
     int ret = Run(app_inst.get());
 
+    ReleaseAppResources(app_inst.get());
     Cleanup();
 
     return ret;
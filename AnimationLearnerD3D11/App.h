@@ -1,25 +1,51 @@
 #pragma once
 #include <vector>
+#include <cstddef>
 #include <DirectXMath.h>
 #include <windows.h>
 #include <d3d11.h>
 #include <map>
 #include <string>
 #include <assimp/scene.h>
+#include "Animation.h"
+#include "BoneCapsules.h"
+#include "Skeleton.h"
+#include "JobSystem.h"
+#include "Vertex.h"
+#include "MeshPartition.h"
+#include "Influences.h"
+#include "PackedVertex.h"
+#include "VertexCache.h"
+#include "VertexDedup.h"
+#include "Meshlet.h"
+#include "MeshLod.h"
+#include "Morph.h"
+#include "SkinnedBounds.h"
+#include "SkinnedBvh.h"
 #pragma comment(lib, "d3d11.lib")
 
+//  XMMatrixTranspose  XMMATRIX ڴ沼һ£ֱϴ
 struct BoneMatrixBuffer
 {
-    DirectX::XMMATRIX boneMatrices[128];
+    aiMatrix4x4 boneMatrices[BONE_PALETTE_CAPACITY];
 };
 
-struct Vertex {
-    DirectX::XMFLOAT3 position;
-    DirectX::XMFLOAT3 normal;
-    DirectX::XMFLOAT2 texcoord;
+// յɫ壺ÿֻǰУ BoneMatrixBuffer С 25%
+struct BoneMatrixBuffer3x4
+{
+    BoneMatrix3x4 boneMatrices[BONE_PALETTE_CAPACITY];
+};
+
+// żԪɫ壨DQSÿ 32 ֽ
+struct BoneDualQuatBuffer
+{
+    BoneDualQuat boneDualQuats[BONE_PALETTE_CAPACITY];
+};
 
-    UINT boneIndices[4] = { 0 };
-    float boneWeights[4] = { 0 };
+// DQS ÿţֻڶʱʹ
+struct BoneScaleBuffer
+{
+    BoneScale boneScales[BONE_PALETTE_CAPACITY];
 };
 
 struct ConstantBuffer
@@ -29,14 +55,19 @@ struct ConstantBuffer
     DirectX::XMMATRIX proj;
     DirectX::XMFLOAT3 lightDir;
     UINT targetBoneIndex;
+    UINT rigidBoneIndex;    // Զ draw ʹõĵɫλRIGID_SEGMENT 壩
     float padding1[3];
+    DirectX::XMFLOAT4 positionScale;   // DQS ʱǰλõĻԭQUANTIZED_POSITION 壩 PositionQuantization
+    DirectX::XMFLOAT4 positionOffset;
 };
-
-struct BoneAnimCache {
-    std::vector<aiVectorKey> positions;
-    std::vector<aiQuatKey> rotations;
-    std::vector<aiVectorKey> scalings;
-};
+//  SkinningShader.hlsl  cbuffer ConstantBuffer  HLSL ֶζ루float3  uint ռͬһĴ
+static_assert(sizeof(ConstantBuffer) % 16 == 0, "ConstantBuffer size must be a multiple of 16 bytes");
+static_assert(offsetof(ConstantBuffer, lightDir) == 192, "lightDir must follow the three matrices");
+static_assert(offsetof(ConstantBuffer, targetBoneIndex) == 204, "targetBoneIndex must pack after lightDir in c12");
+static_assert(offsetof(ConstantBuffer, rigidBoneIndex) == 208, "rigidBoneIndex must start c13");
+static_assert(offsetof(ConstantBuffer, positionScale) == 224, "positionScale must start c14");
+static_assert(offsetof(ConstantBuffer, positionOffset) == 240, "positionOffset must start c15");
+static_assert(sizeof(ConstantBuffer) == 256, "ConstantBuffer must match the HLSL cbuffer size");
 
 class App
 {
@@ -44,13 +75,82 @@ class App
 	std::vector<Vertex> vertices;
 	std::vector<UINT> indices;
 
+    // ÿӰ0 ΪԴԶѡ񣨼 ChooseInfluenceCount"--influences4" / "--influences8" ǿָ
+    int maxInfluences = 0;
+    InfluenceStats influenceStats;
+    std::vector<VertexInfluences> extraInfluences;  // 8 ӰԴĵ 5~8 Ӱ죬 vertices һһӦΪ
+    // ϲȥأ"--dedup-vertices"֮ dedupEpsilon ĺϲΪһ
+    bool dedupVertices = false;
+    float dedupEpsilon = VERTEX_DEDUP_EPSILON;
+
+    // ӰͰ"--influence-buckets" vertices ͰGPU ÿͰһɫ
+    bool bucketByInfluence = false;
+    bool rigidSegments = true;  // ͰʱѸԶεóÿһ"--no-rigid-segments" رգ
+    std::vector<InfluenceBucket> influenceBuckets;
+
+    // ϴ GPU 񣺹ɫʱ񻮷֣ÿһ draw
+    PartitionedMesh gpuMesh;
+    bool optimizeVertexCache = true;  // ʱÿ draw ڰ任㻺Σ"--no-vertex-cache-opt" رգ
+    bool optimizeVertexFetch = true;  // ״ʹ˳±Ŷ㣬CPU ڷͰڽУ"--no-vertex-fetch-opt" رգ
+    // Ϊ true ʱɫ壬ÿ draw ǰıռϴ񻮷ֻλ۽ɫʱ
+    bool paletteSplit = false;
+
+    // ѹʽ"--packed-vertices"㻺ϴ packedMesh  gpuMesh.vertices
+    // "--quantize-positions" λΪΧڵ 16 λ"--weights16" ʹ UNORM16 Ȩ
+    bool packedVertices = false;
+    bool quantizePositions = false;
+    bool wideWeights = false;
+    float positionTolerance = POSITION_QUANTIZATION_TOLERANCE;  // ʱλñ float3
+    PackedVertexBuffer packedMesh;       // λʱ positionRanges  gpuMesh.submeshes һһӦ
+    bool foldPositionQuantization = false;  // ɫ壺λûԭռɫʱ۽
+
     D3D11_BUFFER_DESC vbd = {};
     D3D11_SUBRESOURCE_DATA vinitData = {};
     ID3D11Buffer* vertexBuffer = nullptr;
+    ID3D11Buffer* influenceBuffer = nullptr;  // gpuMesh.extraInfluences󶨵1
 
     D3D11_BUFFER_DESC ibd = {};
     D3D11_SUBRESOURCE_DATA iinitData = {};
     ID3D11Buffer* indexBuffer = nullptr;
+    SubmeshIndexBuffer indexData;   // ݣ16/32 λʼ
+    // meshlet ޳"--meshlet-culling"ÿ֡ɹ任 meshlet ıذΧУ׶Ĳƣ
+    // ڵĿɼ meshlet ϲΪһ DrawIndexedDQS Ľڹ任͹ڣʱ
+    bool meshletCulling = false;
+    MeshletMesh meshlets;
+    std::vector<MeshletBounds> meshletBounds;
+    // LOD "--lods"ʱԴ  мɣÿ֡ΧĻߴѡ
+    // ʹȫֹ± float ʽֻδ֡δѹ 4 ӰŴʵʻ
+    bool generateLods = false;
+    MeshLodChain lodChain;
+    int lodLevel = 0;                               // ǰƵļ0 Ϊԭ
+    std::vector<ID3D11Buffer*> lodVertexBuffers;    //  lodChain.levels һһӦ
+    std::vector<ID3D11Buffer*> lodIndexBuffers;
+    // Ŀ꣨aiMesh::mAnimMeshes"--no-morph-targets" أ gpuMesh Ķ˳ŵϡ
+    // ÿ֡Ȩۼӵ morphDeltasϴ morphBuffer2Ƥ֮ǰӵλúͷ
+    bool loadMorphTargets = true;
+    MorphTargetSet morphTargets;
+    std::vector<float> morphWeights;
+    std::vector<MorphDelta> morphDeltas;
+    ID3D11Buffer* morphBuffer = nullptr;
+    size_t morphActiveTargets = 0;  // һ֡ۼӵĿ
+    // ɫİΧ壺ʱÿĹռΧУÿ֡ɵɫ任õ skinnedBoundsռ䣩
+    // ׶޳ LOD ѡDQS ʱʹ
+    BoneBoundsSet boneBounds;
+    SkinnedBounds skinnedBounds;
+    bool skinnedBoundsValid = false;
+    bool characterCulled = false;
+    // Ƥε BVH"--bvh"ʱ̬ÿ֡ CPU Ƥ refit
+    // עӵʰȡɫе仯ʱӡ
+    bool buildBvh = false;
+    SkinnedBvh bvh;
+    std::vector<Float3> bvhPositions;
+    std::vector<Float3> bvhNormals;
+    int bvhHitBone = -1;
+    // ײң"--capsules"ʱϣÿ֡ɵɫ任вԡDQS ʱʹ
+    bool buildCapsules = false;
+    BoneCapsuleSet boneCapsules;
+    CapsuleBatch capsuleBatch;
+    int capsuleHitBone = -1;
 
     ID3D11Buffer* constantBuffer = nullptr;
     D3D11_BUFFER_DESC cbd = {};
@@ -59,6 +159,8 @@ class App
     ID3D11VertexShader* vertexShader = nullptr;
     ID3D11PixelShader* pixelShader = nullptr;
     ID3D11InputLayout* inputLayout = nullptr;
+    ID3D11VertexShader* influenceShaders[INFLUENCE_BUCKET_COUNT] = {};  // ӰͰĶɫδʹõͰΪ
+    ID3D11VertexShader* rigidShader = nullptr;                          // ԶεĶɫ
 
     ID3D11VertexShader* boneLineVS = nullptr;
     ID3D11PixelShader* boneLinePS = nullptr;
@@ -74,11 +176,28 @@ class App
     aiScene* scene;
 
     ID3D11Buffer* boneMatrixBuffer = nullptr;
+    PaletteFormat paletteFormat = PaletteFormat::Matrix4x4; // "--palette3x4" ʹýոʽ"--dqs" ʹöżԪƤ
     BoneMatrixBuffer boneMatrixData;
+    BoneMatrixBuffer3x4 boneMatrixData3x4;
+    BoneDualQuatBuffer boneDualQuatData;
+
+    ID3D11Buffer* boneScaleBuffer = nullptr;  //  DQS  paletteHasScale ʱ󶨵2
+    BoneScaleBuffer boneScaleData;
+    bool paletteHasScale = false;             // ƤǷвɺԵ
+
+    // paletteSplit ʱȫֹ±ŵɫ壨ֻʹõǰʽӦһ
+    std::vector<aiMatrix4x4> fullPalette;
+    std::vector<BoneMatrix3x4> fullPalette3x4;
+    std::vector<BoneDualQuat> fullPaletteDualQuat;
+    std::vector<BoneScale> fullPaletteScale;
 
     std::map<std::string, int> boneNameToIndex;
     std::map<std::string, aiMatrix4x4> boneOffsetMatrices;
 
+    Skeleton skeleton;      // ۵ڵıƽǼ
+    SkeletonPose pose;      // ǰ̬ǣ£
+    JobSystem jobs;         // ȡ̳߳أǼܲиµȣ
+
     ID3D11Buffer* ikQuadVB = nullptr;
 };
 
@@ -0,0 +1,1352 @@
+﻿#include "Benchmark.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include "Crowd.h"
+#include "Skinning.h"
+#include "VertexCache.h"
+
+namespace
+{
+    // 防止被测结果被优化掉
+    volatile float g_sink = 0.0f;
+
+    float SampleTime(int i, float animDuration)
+    {
+        return animDuration > 0.0f ? float(i % 997) / 997.0f * animDuration : 0.0f;
+    }
+
+    // 把骨架复制多份挂到同一个新根节点下，直到关节数不少于 minJoints
+    Skeleton MakeReplicatedSkeleton(const Skeleton& source, int minJoints)
+    {
+        Skeleton result;
+        SkeletonJoint root;
+        root.name = "ReplicatedRoot";
+        result.joints.push_back(root);
+
+        int sourceCount = int(source.joints.size());
+        for (int copy = 0; int(result.joints.size()) < minJoints; ++copy) {
+            int jointBase = int(result.joints.size());
+            int trackBase = int(result.tracks.size());
+            result.tracks.insert(result.tracks.end(), source.tracks.begin(), source.tracks.end());
+            for (int i = 0; i < sourceCount; ++i) {
+                SkeletonJoint joint = source.joints[i];
+                joint.name += "#" + std::to_string(copy);
+                joint.parent = joint.parent >= 0 ? joint.parent + jointBase : 0;
+                if (joint.track >= 0) joint.track += trackBase;
+                if (joint.boneIndex >= 0) joint.boneIndex += copy * source.boneCount;
+                result.jointIndex[joint.name] = int(result.joints.size());
+                result.joints.push_back(joint);
+                result.boneCount = std::max(result.boneCount, joint.boneIndex + 1);
+            }
+        }
+        PartitionSkeleton(result, SKELETON_CHUNK_TARGET_SIZE);
+        return result;
+    }
+
+    // animTime 时刻的蒙皮调色板，至少 128 项以覆盖顶点中可能出现的任何骨骼下标
+    std::vector<aiMatrix4x4> MakePalette(const Skeleton& skeleton, float animTime)
+    {
+        std::vector<aiMatrix4x4> palette(std::max(skeleton.boneCount, 128));
+        SkeletonPose pose;
+        InitSkeletonPose(skeleton, pose);
+        SampleSkeletonPose(skeleton, animTime, pose);
+        UpdateSkeletonPose(skeleton, pose, palette.data(), int(palette.size()));
+        return palette;
+    }
+
+    float MaxDifference(const std::vector<Float3>& a, const std::vector<Float3>& b)
+    {
+        float maxDiff = 0.0f;
+        for (size_t i = 0; i < a.size(); ++i) {
+            maxDiff = std::max(maxDiff, std::fabs(a[i].x - b[i].x));
+            maxDiff = std::max(maxDiff, std::fabs(a[i].y - b[i].y));
+            maxDiff = std::max(maxDiff, std::fabs(a[i].z - b[i].z));
+        }
+        return maxDiff;
+    }
+
+    // 去重用的合成网格：半径 1 的圆管沿 y 轴每 0.3 一圈，共 rings 圈、每圈 segments 个顶点，按高度切成 parts 段，
+    // 每段一个子网格并各自复制与下一段共用的边界环（接缝）。每段顶部再加一圈只高 0.5 * epsilon 的窄条，
+    // 焊接后窄条的三角形退化。去重后应剩 rings * segments 个顶点、删除 parts * 2 * segments 个三角形
+    void MakeSeamTube(int rings, int segments, int parts, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+    {
+        vertices.clear();
+        indices.clear();
+        int ringsPerPart = (rings - 1 + parts - 1) / parts;
+        for (int part = 0; part < parts; ++part) {
+            int first = part * ringsPerPart;
+            int last = std::min(rings - 1, first + ringsPerPart);
+            uint32_t base = uint32_t(vertices.size());
+            // 最后一圈是窄条的上沿
+            for (int r = first; r <= last + 1; ++r) {
+                float y = float(std::min(r, last)) * 0.3f + (r > last ? 0.5f * VERTEX_DEDUP_EPSILON : 0.0f);
+                for (int s = 0; s < segments; ++s) {
+                    float angle = 6.2831853f * float(s) / float(segments);
+                    Vertex vertex;
+                    vertex.position = { std::cos(angle), y, std::sin(angle) };
+                    vertex.normal = { std::cos(angle), 0.0f, std::sin(angle) };
+                    vertex.texcoord = { float(s) / float(segments), float(std::min(r, last)) / float(rings) };
+                    vertex.boneIndices[0] = uint32_t(std::min(r, last) / 4);
+                    vertex.boneWeights[0] = 1.0f;
+                    vertices.push_back(vertex);
+                }
+            }
+            for (int r = 0; r <= last - first; ++r) {
+                for (int s = 0; s < segments; ++s) {
+                    uint32_t a = base + uint32_t(r * segments + s);
+                    uint32_t b = base + uint32_t(r * segments + (s + 1) % segments);
+                    uint32_t c = a + uint32_t(segments), d = b + uint32_t(segments);
+                    uint32_t quad[6] = { a, c, b, b, c, d };
+                    indices.insert(indices.end(), quad, quad + 6);
+                }
+            }
+        }
+    }
+
+    // 1, 2, 4, ... 直到硬件线程数（包含硬件线程数本身）
+    std::vector<unsigned int> WorkerCounts()
+    {
+        unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<unsigned int> counts;
+        for (unsigned int n = 1; n < hardware; n *= 2)
+            counts.push_back(n);
+        counts.push_back(hardware);
+        return counts;
+    }
+}
+
+void BenchmarkJointQueries(const Skeleton& skeleton, float animDuration)
+{
+    if (skeleton.joints.empty()) return;
+
+    // 查询手脚；模型里没有这些名字时退化为最后一个关节
+    std::vector<int> targets;
+    for (const char* name : { "mixamorig:RightHand", "mixamorig:LeftHand", "mixamorig:RightFoot", "mixamorig:LeftFoot" }) {
+        int joint = FindJoint(skeleton, name);
+        if (joint >= 0) targets.push_back(joint);
+    }
+    if (targets.empty())
+        targets.push_back(int(skeleton.joints.size() - 1));
+
+    const int iterations = 20000;
+    std::vector<aiMatrix4x4> globals;
+    std::vector<aiMatrix4x4> results(targets.size());
+    JointQueryScratch scratch;
+
+    double fullNs = MeasureNanoseconds(iterations, [&](int i) {
+        EvaluateSkeleton(skeleton, SampleTime(i, animDuration), globals);
+        g_sink = g_sink + globals[targets[0]].a4;
+    });
+    double singleNs = MeasureNanoseconds(iterations, [&](int i) {
+        g_sink = g_sink + QueryJointGlobal(skeleton, targets[0], SampleTime(i, animDuration)).a4;
+    });
+    double batchNs = MeasureNanoseconds(iterations, [&](int i) {
+        QueryJointGlobals(skeleton, targets.data(), targets.size(), SampleTime(i, animDuration), scratch, results.data());
+        g_sink = g_sink + results[0].a4;
+    });
+    double separateNs = MeasureNanoseconds(iterations, [&](int i) {
+        for (int joint : targets)
+            g_sink = g_sink + QueryJointGlobal(skeleton, joint, SampleTime(i, animDuration)).a4;
+    });
+
+    std::cout << "[Bench] joint queries (" << skeleton.joints.size() << " joints, "
+        << targets.size() << " targets)" << std::endl;
+    std::cout << "  full skeleton      : " << fullNs << " ns" << std::endl;
+    std::cout << "  single chain       : " << singleNs << " ns" << std::endl;
+    std::cout << "  separate chains x" << targets.size() << " : " << separateNs << " ns" << std::endl;
+    std::cout << "  batched chains x" << targets.size() << "  : " << batchNs << " ns" << std::endl;
+}
+
+void BenchmarkCrowdUpdate(const Skeleton& skeleton, float animDuration, const BoneBoundsSet* boneBounds)
+{
+    if (skeleton.joints.empty()) return;
+
+    std::cout << "[Bench] crowd update (" << skeleton.joints.size() << " joints, "
+        << skeleton.boneCount << " bones per character" << (boneBounds ? ", with skinned bounds" : "") << ")" << std::endl;
+
+    for (size_t characterCount : { size_t(100), size_t(1000), size_t(10000) }) {
+        std::vector<CharacterInstance> characters;
+        InitCrowd(skeleton, animDuration, characterCount, characters);
+
+        int iterations = std::max(3, int(100000 / characterCount));
+        double baseNs = 0.0;
+        for (unsigned int workers : WorkerCounts()) {
+            JobSystem jobs(workers);
+            std::vector<AnimationScratch> scratch;
+            UpdateCrowd(skeleton, animDuration, 1.0f, characters, jobs, scratch, boneBounds); // 预热，分配临时内存
+
+            double ns = MeasureNanoseconds(iterations, [&](int) {
+                UpdateCrowd(skeleton, animDuration, 1.0f, characters, jobs, scratch, boneBounds);
+            });
+            if (workers == 1) baseNs = ns;
+
+            std::cout << "  " << characterCount << " characters, " << workers << " workers: "
+                << ns / 1e6 << " ms/update, " << ns / characterCount << " ns/character, speedup x"
+                << baseNs / ns << std::endl;
+        }
+        if (!characters[0].palette.empty())
+            g_sink = g_sink + characters[0].palette[0].a4;
+        g_sink = g_sink + characters[0].bounds.radius;
+    }
+}
+
+void BenchmarkLargeSkeleton(const Skeleton& skeleton, float animDuration)
+{
+    if (skeleton.joints.empty()) return;
+
+    Skeleton large = MakeReplicatedSkeleton(skeleton, 800);
+    std::cout << "[Bench] large skeleton pose update (" << large.joints.size() << " joints, "
+        << large.trunkJoints.size() << " trunk joints, " << large.chunks.size() << " chunks)" << std::endl;
+
+    // 串行参考结果
+    SkeletonPose serialPose;
+    std::vector<aiMatrix4x4> serialPalette(large.boneCount);
+    InitSkeletonPose(large, serialPose);
+
+    const int iterations = 2000;
+    double serialNs = MeasureNanoseconds(iterations, [&](int i) {
+        SampleSkeletonPose(large, SampleTime(i, animDuration), serialPose);
+        UpdateSkeletonPose(large, serialPose, serialPalette.data(), large.boneCount);
+    });
+    std::cout << "  serial: " << serialNs / 1000.0 << " us" << std::endl;
+
+    for (unsigned int workers : WorkerCounts()) {
+        JobSystem jobs(workers);
+        SkeletonPose pose;
+        std::vector<aiMatrix4x4> palette(large.boneCount);
+        InitSkeletonPose(large, pose);
+
+        double ns = MeasureNanoseconds(iterations, [&](int i) {
+            SampleSkeletonPose(large, SampleTime(i, animDuration), pose, &jobs);
+            UpdateSkeletonPose(large, pose, palette.data(), large.boneCount, &jobs);
+        });
+
+        // 两边最后一次都是同一时间，结果必须逐位相同
+        bool identical = std::memcmp(pose.globals.data(), serialPose.globals.data(), sizeof(aiMatrix4x4) * pose.globals.size()) == 0
+            && std::memcmp(palette.data(), serialPalette.data(), sizeof(aiMatrix4x4) * palette.size()) == 0;
+
+        std::cout << "  " << workers << " workers: " << ns / 1000.0 << " us, speedup x" << serialNs / ns
+            << (identical ? ", bit-identical" : ", MISMATCH") << std::endl;
+    }
+}
+
+void BenchmarkCpuSkinning(const std::vector<Vertex>& vertices, const Skeleton& skeleton, float animDuration)
+{
+    if (vertices.empty()) return;
+
+    std::vector<aiMatrix4x4> palette = MakePalette(skeleton, animDuration * 0.37f);
+    size_t count = vertices.size();
+    std::cout << "[Bench] CPU skinning (" << count << " vertices)" << std::endl;
+
+    // 标量版本作为参考
+    std::vector<Float3> refPositions(count), refNormals(count);
+    SkinVertices(vertices.data(), count, palette.data(), refPositions.data(), refNormals.data(), SkinningKernel::Scalar);
+
+    // 每种实现大约处理 2000 万个顶点
+    int iterations = int(std::max<size_t>(10, 20000000 / count));
+    std::vector<Float3> positions(count), normals(count);
+    double scalarNs = 0.0;
+    for (SkinningKernel kernel : { SkinningKernel::Scalar, SkinningKernel::SSE, SkinningKernel::AVX2 }) {
+        if (!IsSkinningKernelSupported(kernel)) {
+            std::cout << "  " << SkinningKernelName(kernel) << ": not supported" << std::endl;
+            continue;
+        }
+
+        double ns = MeasureNanoseconds(iterations, [&](int) {
+            SkinVertices(vertices.data(), count, palette.data(), positions.data(), normals.data(), kernel);
+            g_sink = g_sink + positions[0].x;
+        });
+        if (kernel == SkinningKernel::Scalar)
+            scalarNs = ns;
+
+        std::cout << "  " << SkinningKernelName(kernel) << ": " << ns / 1000.0 << " us, "
+            << double(count) / ns * 1000.0 << " M verts/s, x" << scalarNs / ns
+            << ", max diff vs scalar pos " << MaxDifference(positions, refPositions)
+            << " normal " << MaxDifference(normals, refNormals) << std::endl;
+    }
+}
+
+void BenchmarkParallelSkinning(const std::vector<Vertex>& vertices, const Skeleton& skeleton, float animDuration)
+{
+    if (vertices.empty()) return;
+
+    std::vector<aiMatrix4x4> palette = MakePalette(skeleton, animDuration * 0.37f);
+    SkinningKernel kernel = BestSkinningKernel();
+
+    // 模型网格 + 重复模型顶点得到的 10 万顶点网格
+    std::vector<Vertex> largeMesh;
+    largeMesh.reserve(100000);
+    while (largeMesh.size() < 100000)
+        largeMesh.push_back(vertices[largeMesh.size() % vertices.size()]);
+
+    const std::vector<Vertex>* meshes[] = { &vertices, &largeMesh };
+    for (const std::vector<Vertex>* mesh : meshes) {
+        size_t count = mesh->size();
+        std::cout << "[Bench] parallel CPU skinning (" << count << " vertices, "
+            << SkinningKernelName(kernel) << ", " << SKINNING_CHUNK_VERTICES << "-vertex chunks)" << std::endl;
+
+        // 输出缓冲区只分配一次，测量的是纯蒙皮开销
+        std::vector<Float3> positions(count), normals(count);
+        int iterations = int(std::max<size_t>(10, 20000000 / count));
+
+        double singleNs = MeasureNanoseconds(iterations, [&](int) {
+            SkinVertices(mesh->data(), count, palette.data(), positions.data(), normals.data(), kernel);
+            g_sink = g_sink + positions[0].x;
+        });
+        std::cout << "  single-threaded: " << singleNs / 1000.0 << " us, "
+            << double(count) / singleNs * 1000.0 << " M verts/s" << std::endl;
+
+        for (unsigned int workers : WorkerCounts()) {
+            JobSystem jobs(workers);
+            double ns = MeasureNanoseconds(iterations, [&](int) {
+                SkinVerticesParallel(&jobs, mesh->data(), count, palette.data(), positions.data(), normals.data(), kernel);
+                g_sink = g_sink + positions[0].x;
+            });
+            std::cout << "  " << workers << " workers: " << ns / 1000.0 << " us, "
+                << double(count) / ns * 1000.0 << " M verts/s, speedup x" << singleNs / ns << std::endl;
+        }
+    }
+}
+
+void BenchmarkPaletteFormats(const std::vector<Vertex>& vertices, const Skeleton& skeleton, float animDuration)
+{
+    if (skeleton.joints.empty()) return;
+
+    int bones = std::max(skeleton.boneCount, 1);
+    std::cout << "[Bench] palette formats (" << bones << " bones)" << std::endl;
+    std::cout << "  upload per frame: 4x4 " << bones * sizeof(aiMatrix4x4) << " B, 3x4 "
+        << bones * sizeof(BoneMatrix3x4) << " B; 1000 characters: "
+        << 1000 * bones * sizeof(aiMatrix4x4) / 1024 << " KB vs. "
+        << 1000 * bones * sizeof(BoneMatrix3x4) / 1024 << " KB" << std::endl;
+
+    // 调色板生成：每次换一个时间，所有关节都要重算
+    const int iterations = 20000;
+    std::vector<aiMatrix4x4> palette4x4(std::max(skeleton.boneCount, 128));
+    std::vector<BoneMatrix3x4> palette3x4(palette4x4.size());
+    SkeletonPose pose;
+    InitSkeletonPose(skeleton, pose);
+
+    double ns4x4 = MeasureNanoseconds(iterations, [&](int i) {
+        SampleSkeletonPose(skeleton, SampleTime(i, animDuration), pose);
+        UpdateSkeletonPose(skeleton, pose, palette4x4.data(), int(palette4x4.size()));
+    });
+    double ns3x4 = MeasureNanoseconds(iterations, [&](int i) {
+        SampleSkeletonPose(skeleton, SampleTime(i, animDuration), pose);
+        UpdateSkeletonPose(skeleton, pose, palette3x4.data(), int(palette3x4.size()));
+    });
+    std::cout << "  palette generation: 4x4 " << ns4x4 / 1000.0 << " us, 3x4 " << ns3x4 / 1000.0 << " us" << std::endl;
+
+    if (vertices.empty()) return;
+
+    // 同一时刻的两种调色板蒙皮，结果应完全一致
+    float animTime = animDuration * 0.37f;
+    InitSkeletonPose(skeleton, pose);
+    SampleSkeletonPose(skeleton, animTime, pose);
+    UpdateSkeletonPose(skeleton, pose, palette4x4.data(), int(palette4x4.size()));
+    InitSkeletonPose(skeleton, pose);
+    SampleSkeletonPose(skeleton, animTime, pose);
+    UpdateSkeletonPose(skeleton, pose, palette3x4.data(), int(palette3x4.size()));
+
+    size_t count = vertices.size();
+    SkinningKernel kernel = BestSkinningKernel();
+    std::vector<Float3> positions4x4(count), normals4x4(count), positions3x4(count), normals3x4(count);
+    int skinIterations = int(std::max<size_t>(10, 20000000 / count));
+
+    double skin4x4 = MeasureNanoseconds(skinIterations, [&](int) {
+        SkinVertices(vertices.data(), count, palette4x4.data(), positions4x4.data(), normals4x4.data(), kernel);
+        g_sink = g_sink + positions4x4[0].x;
+    });
+    double skin3x4 = MeasureNanoseconds(skinIterations, [&](int) {
+        SkinVertices(vertices.data(), count, palette3x4.data(), positions3x4.data(), normals3x4.data(), kernel);
+        g_sink = g_sink + positions3x4[0].x;
+    });
+    std::cout << "  CPU skinning (" << SkinningKernelName(kernel) << "): 4x4 "
+        << double(count) / skin4x4 * 1000.0 << " M verts/s, 3x4 " << double(count) / skin3x4 * 1000.0
+        << " M verts/s, max diff " << std::max(MaxDifference(positions4x4, positions3x4), MaxDifference(normals4x4, normals3x4))
+        << std::endl;
+}
+
+void BenchmarkDualQuatSkinning(const std::vector<Vertex>& vertices, const Skeleton& skeleton, float animDuration)
+{
+    if (skeleton.joints.empty()) return;
+
+    int bones = std::max(skeleton.boneCount, 1);
+    std::cout << "[Bench] dual quaternion skinning vs. LBS (" << bones << " bones)" << std::endl;
+    std::cout << "  palette size: LBS " << bones * sizeof(aiMatrix4x4) << " B, DQS " << bones * sizeof(BoneDualQuat)
+        << " B (+" << bones * sizeof(BoneScale) << " B when bones scale)" << std::endl;
+
+    const int iterations = 20000;
+    size_t paletteSize = size_t(std::max(skeleton.boneCount, 128));
+    std::vector<aiMatrix4x4> matrices(paletteSize);
+    std::vector<BoneDualQuat> dualQuats(paletteSize);
+    std::vector<BoneScale> scales(paletteSize);
+    SkeletonPose pose;
+    InitSkeletonPose(skeleton, pose);
+
+    double lbsBuildNs = MeasureNanoseconds(iterations, [&](int i) {
+        SampleSkeletonPose(skeleton, SampleTime(i, animDuration), pose);
+        UpdateSkeletonPose(skeleton, pose, matrices.data(), int(paletteSize));
+    });
+    double dqsBuildNs = MeasureNanoseconds(iterations, [&](int i) {
+        SampleSkeletonPose(skeleton, SampleTime(i, animDuration), pose);
+        UpdateSkeletonPose(skeleton, pose, dualQuats.data(), nullptr, int(paletteSize));
+    });
+    double dqsScaleBuildNs = MeasureNanoseconds(iterations, [&](int i) {
+        SampleSkeletonPose(skeleton, SampleTime(i, animDuration), pose);
+        UpdateSkeletonPose(skeleton, pose, dualQuats.data(), scales.data(), int(paletteSize));
+    });
+    std::cout << "  palette build: LBS " << lbsBuildNs / 1000.0 << " us, DQS " << dqsBuildNs / 1000.0
+        << " us, DQS + scale " << dqsScaleBuildNs / 1000.0 << " us" << std::endl;
+
+    if (vertices.empty()) return;
+
+    // 同一时刻的两种调色板
+    float animTime = animDuration * 0.37f;
+    InitSkeletonPose(skeleton, pose);
+    SampleSkeletonPose(skeleton, animTime, pose);
+    UpdateSkeletonPose(skeleton, pose, matrices.data(), int(paletteSize));
+    InitSkeletonPose(skeleton, pose);
+    SampleSkeletonPose(skeleton, animTime, pose);
+    UpdateSkeletonPose(skeleton, pose, dualQuats.data(), scales.data(), int(paletteSize));
+
+    size_t count = vertices.size();
+    std::vector<Float3> lbsPositions(count), lbsNormals(count), positions(count), normals(count);
+    int skinIterations = int(std::max<size_t>(10, 20000000 / count));
+
+    for (SkinningKernel kernel : { SkinningKernel::Scalar, BestSkinningKernel() }) {
+        double lbsNs = MeasureNanoseconds(skinIterations, [&](int) {
+            SkinVertices(vertices.data(), count, matrices.data(), lbsPositions.data(), lbsNormals.data(), kernel);
+            g_sink = g_sink + lbsPositions[0].x;
+        });
+        double dqsNs = MeasureNanoseconds(skinIterations, [&](int) {
+            SkinVertices(vertices.data(), count, dualQuats.data(), nullptr, positions.data(), normals.data(), kernel);
+            g_sink = g_sink + positions[0].x;
+        });
+        double dqsScaleNs = MeasureNanoseconds(skinIterations, [&](int) {
+            SkinVertices(vertices.data(), count, dualQuats.data(), scales.data(), positions.data(), normals.data(), kernel);
+            g_sink = g_sink + positions[0].x;
+        });
+        std::cout << "  skinning (" << SkinningKernelName(kernel) << "): LBS " << double(count) / lbsNs * 1000.0
+            << " M verts/s, DQS " << double(count) / dqsNs * 1000.0 << " M verts/s, DQS + scale "
+            << double(count) / dqsScaleNs * 1000.0 << " M verts/s" << std::endl;
+
+        if (kernel == BestSkinningKernel())
+            break;
+    }
+
+    // 两者只在多骨骼混合处不同（DQS 保持体积），差异大小供参考
+    std::cout << "  max position difference DQS vs. LBS: " << MaxDifference(positions, lbsPositions) << std::endl;
+}
+
+void BenchmarkInfluenceBuckets(const std::vector<Vertex>& vertices, const std::vector<VertexInfluences>& extraInfluences,
+    const std::vector<InfluenceBucket>& buckets, const Skeleton& skeleton, float animDuration)
+{
+    if (vertices.empty() || buckets.empty()) return;
+
+    const VertexInfluences* extra = extraInfluences.empty() ? nullptr : extraInfluences.data();
+    int fixedInfluences = extra ? 8 : 4;
+    size_t count = vertices.size();
+    std::cout << "[Bench] influence buckets (" << count << " vertices):";
+    for (const InfluenceBucket& bucket : buckets)
+        std::cout << " " << bucket.influences << "x" << bucket.vertexCount;
+    float average = AverageBucketInfluences(buckets);
+    std::cout << std::endl << "  influence iterations per vertex: " << average << " vs. " << fixedInfluences
+        << " (" << 100.0f * (1.0f - average / fixedInfluences) << "% fewer)" << std::endl;
+
+    std::vector<aiMatrix4x4> palette = MakePalette(skeleton, animDuration * 0.37f);
+    std::vector<Float3> refPositions(count), refNormals(count), positions(count), normals(count);
+    int iterations = int(std::max<size_t>(10, 20000000 / count));
+
+    for (SkinningKernel kernel : { SkinningKernel::Scalar, SkinningKernel::SSE, SkinningKernel::AVX2 }) {
+        if (!IsSkinningKernelSupported(kernel))
+            continue;
+        double fixedNs = MeasureNanoseconds(iterations, [&](int) {
+            SkinVertices(vertices.data(), count, palette.data(), refPositions.data(), refNormals.data(), kernel, extra);
+            g_sink = g_sink + refPositions[0].x;
+        });
+        double bucketedNs = MeasureNanoseconds(iterations, [&](int) {
+            SkinVerticesBucketed(nullptr, vertices.data(), extra, buckets.data(), buckets.size(), palette.data(),
+                positions.data(), normals.data(), kernel);
+            g_sink = g_sink + positions[0].x;
+        });
+        std::cout << "  " << SkinningKernelName(kernel) << ": fixed " << double(count) / fixedNs * 1000.0
+            << " M verts/s, bucketed " << double(count) / bucketedNs * 1000.0 << " M verts/s, speedup x"
+            << fixedNs / bucketedNs << ", max diff " << MaxDifference(positions, refPositions) << std::endl;
+    }
+
+    // 合成混合：同样的顶点，按 50% 1 影响、30% 2 影响、10% 3 影响、10% 4 影响重新绑定，与固定 4 影响循环对比
+    const int mixInfluences[4] = { 1, 2, 3, 4 };
+    const size_t mixPercent[4] = { 50, 30, 10, 10 };
+    int boneCount = std::max(skeleton.boneCount, 1);
+    std::vector<Vertex> mix = vertices;
+    std::vector<InfluenceBucket> mixBuckets;
+    size_t start = 0;
+    for (int b = 0; b < 4; ++b) {
+        InfluenceBucket bucket;
+        bucket.vertexStart = uint32_t(start);
+        bucket.vertexCount = uint32_t(b == 3 ? count - start : count * mixPercent[b] / 100);
+        bucket.influences = mixInfluences[b];
+        for (uint32_t v = bucket.vertexStart; v < bucket.vertexStart + bucket.vertexCount; ++v) {
+            for (int i = 0; i < 4; ++i) {
+                mix[v].boneIndices[i] = i < bucket.influences ? uint32_t((v + i) % boneCount) : 0;
+                mix[v].boneWeights[i] = i < bucket.influences ? 1.0f / bucket.influences : 0.0f;
+            }
+        }
+        mixBuckets.push_back(bucket);
+        start += bucket.vertexCount;
+    }
+    average = AverageBucketInfluences(mixBuckets);
+    std::cout << "  synthetic mix (50% 1, 30% 2, 10% 3, 10% 4): influence iterations per vertex " << average
+        << " vs. 4 (" << 100.0f * (1.0f - average / 4.0f) << "% fewer)" << std::endl;
+    for (SkinningKernel kernel : { SkinningKernel::Scalar, SkinningKernel::SSE, SkinningKernel::AVX2 }) {
+        if (!IsSkinningKernelSupported(kernel))
+            continue;
+        double fixedNs = MeasureNanoseconds(iterations, [&](int) {
+            SkinVertices(mix.data(), count, palette.data(), refPositions.data(), refNormals.data(), kernel);
+            g_sink = g_sink + refPositions[0].x;
+        });
+        double bucketedNs = MeasureNanoseconds(iterations, [&](int) {
+            SkinVerticesBucketed(nullptr, mix.data(), nullptr, mixBuckets.data(), mixBuckets.size(), palette.data(),
+                positions.data(), normals.data(), kernel);
+            g_sink = g_sink + positions[0].x;
+        });
+        std::cout << "  synthetic mix " << SkinningKernelName(kernel) << ": fixed " << double(count) / fixedNs * 1000.0
+            << " M verts/s, bucketed " << double(count) / bucketedNs * 1000.0 << " M verts/s, speedup x"
+            << fixedNs / bucketedNs << ", max diff " << MaxDifference(positions, refPositions) << std::endl;
+    }
+}
+
+void BenchmarkRigidSegments(const std::vector<Vertex>& vertices, const std::vector<InfluenceBucket>& buckets,
+    const Skeleton& skeleton, float animDuration)
+{
+    if (vertices.empty()) return;
+
+    size_t rigidVertices = 0, rigidSegments = 0;
+    for (const InfluenceBucket& bucket : buckets) {
+        if (bucket.influences == 0) {
+            rigidVertices += bucket.vertexCount;
+            ++rigidSegments;
+        }
+    }
+    std::cout << "[Bench] rigid segments: model has " << rigidVertices << " / " << vertices.size() << " rigid vertices in "
+        << rigidSegments << " segment(s)" << std::endl;
+
+    // 硬表面代理：同样的顶点，每 1024 个一段以权重 1 绑定到一个骨骼
+    const size_t segmentSize = 1024;
+    std::vector<aiMatrix4x4> palette = MakePalette(skeleton, animDuration * 0.37f);
+    int boneCount = std::max(skeleton.boneCount, 1);
+    std::vector<Vertex> proxy = vertices;
+    std::vector<InfluenceBucket> rigidBuckets, singleBuckets;
+    for (size_t start = 0; start < proxy.size(); start += segmentSize) {
+        InfluenceBucket bucket;
+        bucket.vertexStart = uint32_t(start);
+        bucket.vertexCount = uint32_t(std::min(segmentSize, proxy.size() - start));
+        bucket.influences = 0;
+        bucket.rigidBone = int(start / segmentSize) % boneCount;
+        for (uint32_t v = bucket.vertexStart; v < bucket.vertexStart + bucket.vertexCount; ++v) {
+            Vertex& vert = proxy[v];
+            for (int i = 0; i < 4; ++i) {
+                vert.boneIndices[i] = i == 0 ? uint32_t(bucket.rigidBone) : 0;
+                vert.boneWeights[i] = i == 0 ? 1.0f : 0.0f;
+            }
+        }
+        rigidBuckets.push_back(bucket);
+        bucket.influences = 1;
+        singleBuckets.push_back(bucket);
+    }
+
+    size_t count = proxy.size();
+    std::vector<Float3> refPositions(count), refNormals(count), positions(count), normals(count);
+    int iterations = int(std::max<size_t>(10, 20000000 / count));
+    for (SkinningKernel kernel : { SkinningKernel::Scalar, BestSkinningKernel() }) {
+        double fixedNs = MeasureNanoseconds(iterations, [&](int) {
+            SkinVertices(proxy.data(), count, palette.data(), refPositions.data(), refNormals.data(), kernel);
+            g_sink = g_sink + refPositions[0].x;
+        });
+        double singleNs = MeasureNanoseconds(iterations, [&](int) {
+            SkinVerticesBucketed(nullptr, proxy.data(), nullptr, singleBuckets.data(), singleBuckets.size(), palette.data(),
+                positions.data(), normals.data(), kernel);
+            g_sink = g_sink + positions[0].x;
+        });
+        double rigidNs = MeasureNanoseconds(iterations, [&](int) {
+            SkinVerticesBucketed(nullptr, proxy.data(), nullptr, rigidBuckets.data(), rigidBuckets.size(), palette.data(),
+                positions.data(), normals.data(), kernel);
+            g_sink = g_sink + positions[0].x;
+        });
+        std::cout << "  hard-surface proxy (" << SkinningKernelName(kernel) << "): 4 influences " << double(count) / fixedNs * 1000.0
+            << " M verts/s, 1 influence " << double(count) / singleNs * 1000.0 << " M verts/s, rigid "
+            << double(count) / rigidNs * 1000.0 << " M verts/s (x" << fixedNs / rigidNs << "), max diff "
+            << MaxDifference(positions, refPositions) << std::endl;
+
+        if (kernel == BestSkinningKernel())
+            break;
+    }
+}
+
+void BenchmarkVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount)
+{
+    if (indices.empty()) return;
+
+    // 最坏情况：三角形随机打乱（固定种子）
+    size_t triangleCount = indices.size() / 3;
+    std::vector<uint32_t> order(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t)
+        order[t] = uint32_t(t);
+    std::shuffle(order.begin(), order.end(), std::mt19937(12345));
+    std::vector<uint32_t> shuffled(triangleCount * 3);
+    for (size_t t = 0; t < triangleCount; ++t)
+        std::copy(&indices[order[t] * 3], &indices[order[t] * 3] + 3, &shuffled[t * 3]);
+
+    const char* names[] = { "import order", "shuffled" };
+    const std::vector<uint32_t>* inputs[] = { &indices, &shuffled };
+    for (int i = 0; i < 2; ++i) {
+        std::vector<uint32_t> optimized;
+        double ns = MeasureNanoseconds(3, [&](int) {
+            optimized = *inputs[i];
+            OptimizeVertexCache(optimized.data(), optimized.size(), vertexCount);
+        });
+        std::cout << "[Bench] vertex cache (" << names[i] << ", " << triangleCount << " triangles): optimize "
+            << ns / 1e6 << " ms (" << double(triangleCount) / ns * 1000.0 << " M tris/s)" << std::endl;
+        for (int cacheSize : { 16, 32 }) {
+            VertexCacheStats before = AnalyzeVertexCache(inputs[i]->data(), inputs[i]->size(), vertexCount, cacheSize);
+            VertexCacheStats after = AnalyzeVertexCache(optimized.data(), optimized.size(), vertexCount, cacheSize);
+            std::cout << "  FIFO " << cacheSize << ": ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr
+                << " -> " << after.atvr << ", vertex shader invocations " << before.misses << " -> " << after.misses << std::endl;
+        }
+    }
+}
+
+void BenchmarkMeshlets(const PartitionedMesh& mesh, const Skeleton& skeleton, float animDuration)
+{
+    if (mesh.indices.empty()) return;
+
+    MeshletMesh meshlets;
+    double buildNs = MeasureNanoseconds(3, [&](int) {
+        BuildMeshlets(mesh, meshlets);
+    });
+    size_t count = meshlets.meshlets.size();
+    size_t triangleCount = mesh.indices.size() / 3;
+    size_t vertexRefs = 0;
+    for (const Meshlet& meshlet : meshlets.meshlets)
+        vertexRefs += meshlet.vertexCount;
+    std::cout << "[Bench] meshlets (" << triangleCount << " triangles, max " << MESHLET_MAX_VERTICES << " vertices / "
+        << MESHLET_MAX_TRIANGLES << " triangles): " << count << " meshlets, avg " << double(triangleCount) / count
+        << " triangles, " << double(vertexRefs) / count << " vertices, " << double(meshlets.bones.size()) / count
+        << " bones; build " << buildNs / 1e6 << " ms" << std::endl;
+
+    std::vector<aiMatrix4x4> palette = MakePalette(skeleton, animDuration * 0.37f);
+    std::vector<BoneMatrix3x4> palette3x4(palette.size());
+    for (size_t b = 0; b < palette.size(); ++b)
+        StoreBoneMatrix3x4(palette[b], palette3x4[b]);
+
+    std::vector<MeshletBounds> bounds(count);
+    int iterations = int(std::max<size_t>(100, 5000000 / count));
+    double ns4x4 = MeasureNanoseconds(iterations, [&](int) {
+        ComputeMeshletBounds(meshlets, palette.data(), bounds.data());
+        g_sink = g_sink + bounds[0].min.x;
+    });
+    double ns3x4 = MeasureNanoseconds(iterations, [&](int) {
+        ComputeMeshletBounds(meshlets, palette3x4.data(), bounds.data());
+        g_sink = g_sink + bounds[0].min.x;
+    });
+    std::cout << "  bounds per frame: 4x4 " << ns4x4 / 1000.0 << " us, 3x4 " << ns3x4 / 1000.0 << " us ("
+        << ns3x4 / count << " ns per meshlet)" << std::endl;
+    for (unsigned int workers : WorkerCounts()) {
+        JobSystem jobs(workers);
+        double ns = MeasureNanoseconds(iterations, [&](int) {
+            ComputeMeshletBounds(meshlets, palette3x4.data(), bounds.data(), &jobs);
+            g_sink = g_sink + bounds[0].min.x;
+        });
+        std::cout << "  " << workers << " workers: " << ns / 1000.0 << " us, speedup x" << ns3x4 / ns << std::endl;
+    }
+
+    // 保守性：各子网格用自己的局部调色板蒙皮（槽位 -> 全局骨骼），每个顶点都应落在所属 meshlet 的包围盒内；
+    // 紧致度：包围盒对角线与蒙皮后顶点的紧包围盒对角线之比
+    std::vector<Float3> positions(mesh.vertices.size()), normals(mesh.vertices.size());
+    size_t outside = 0;
+    double diagonalRatio = 0.0;
+    size_t ratioSamples = 0;
+    const int samples = 8;
+    for (int sample = 0; sample < samples; ++sample) {
+        palette = MakePalette(skeleton, animDuration * float(sample) / float(samples));
+        ComputeMeshletBounds(meshlets, palette.data(), bounds.data());
+        for (const SkinnedSubmesh& submesh : mesh.submeshes) {
+            std::vector<aiMatrix4x4> local = palette;
+            for (size_t slot = 0; slot < submesh.bonePalette.size(); ++slot)
+                local[slot] = palette[submesh.bonePalette[slot]];
+            SkinVertices(&mesh.vertices[submesh.vertexStart], submesh.vertexCount, local.data(),
+                &positions[submesh.vertexStart], &normals[submesh.vertexStart], BestSkinningKernel(),
+                mesh.extraInfluences.empty() ? nullptr : &mesh.extraInfluences[submesh.vertexStart]);
+        }
+        for (size_t m = 0; m < count; ++m) {
+            const Meshlet& meshlet = meshlets.meshlets[m];
+            const MeshletBounds& box = bounds[m];
+            float tolerance = 1e-4f * (std::fabs(box.max.x - box.min.x) + std::fabs(box.max.y - box.min.y)
+                + std::fabs(box.max.z - box.min.z) + 1.0f);
+            Float3 lo = { 1e30f, 1e30f, 1e30f }, hi = { -1e30f, -1e30f, -1e30f };
+            for (uint32_t i = meshlet.indexStart; i < meshlet.indexStart + meshlet.triangleCount * 3; ++i) {
+                const Float3& p = positions[mesh.indices[i]];
+                if (p.x < box.min.x - tolerance || p.y < box.min.y - tolerance || p.z < box.min.z - tolerance ||
+                    p.x > box.max.x + tolerance || p.y > box.max.y + tolerance || p.z > box.max.z + tolerance)
+                    ++outside;
+                lo.x = std::min(lo.x, p.x); lo.y = std::min(lo.y, p.y); lo.z = std::min(lo.z, p.z);
+                hi.x = std::max(hi.x, p.x); hi.y = std::max(hi.y, p.y); hi.z = std::max(hi.z, p.z);
+            }
+            float tight = std::sqrt((hi.x - lo.x) * (hi.x - lo.x) + (hi.y - lo.y) * (hi.y - lo.y) + (hi.z - lo.z) * (hi.z - lo.z));
+            float conservative = std::sqrt((box.max.x - box.min.x) * (box.max.x - box.min.x)
+                + (box.max.y - box.min.y) * (box.max.y - box.min.y) + (box.max.z - box.min.z) * (box.max.z - box.min.z));
+            if (tight > 0.0f) {
+                diagonalRatio += conservative / tight;
+                ++ratioSamples;
+            }
+        }
+    }
+    std::cout << "  " << samples << " poses: " << outside << " vertex reference(s) outside their meshlet bounds, "
+        << "avg bounds diagonal x" << diagonalRatio / std::max<size_t>(ratioSamples, 1) << " of the tight skinned box" << std::endl;
+}
+
+void BenchmarkMeshLod(const std::vector<Vertex>& vertices, const std::vector<VertexInfluences>& extraInfluences,
+    const std::vector<uint32_t>& indices)
+{
+    if (indices.empty()) return;
+
+    // 由加载时裁剪后的影响还原每个顶点的影响列表
+    std::vector<std::vector<BoneInfluence>> influences(vertices.size());
+    for (size_t v = 0; v < vertices.size(); ++v) {
+        for (int k = 0; k < 4; ++k)
+            if (vertices[v].boneWeights[k] > 0.0f)
+                influences[v].push_back({ vertices[v].boneIndices[k], vertices[v].boneWeights[k] });
+        if (!extraInfluences.empty())
+            for (int k = 0; k < 4; ++k)
+                if (extraInfluences[v].boneWeights[k] > 0.0f)
+                    influences[v].push_back({ extraInfluences[v].boneIndices[k], extraInfluences[v].boneWeights[k] });
+    }
+
+    size_t triangleCount = indices.size() / 3;
+    std::vector<uint32_t> simplified(indices.size());
+    std::cout << "[Bench] mesh LOD simplification (" << triangleCount << " triangles, " << vertices.size()
+        << " vertices, influence tolerance " << LOD_INFLUENCE_TOLERANCE << ")" << std::endl;
+    for (float ratio : { 0.5f, 0.25f, 0.125f }) {
+        SimplifyStats stats;
+        size_t count = 0;
+        double ns = MeasureNanoseconds(3, [&](int) {
+            count = SimplifySkinnedMesh(vertices.data(), influences.data(), vertices.size(), indices.data(), indices.size(),
+                size_t(float(triangleCount) * ratio) * 3, SimplifyOptions(), simplified.data(), &stats);
+        });
+        std::cout << "  target " << ratio << ": " << count / 3 << " triangles (" << float(count / 3) / float(triangleCount)
+            << "), error " << stats.error << ", " << stats.collapses << " collapses, " << stats.lockedVertices
+            << " locked vertices, rejected " << stats.rejectedInfluence << " by influence / " << stats.rejectedFlip
+            << " by flip, " << ns / 1e6 << " ms" << std::endl;
+    }
+
+    // 8 个源网格模拟多个 aiMesh：每个（源网格, 级别）一个任务
+    const int copies = 8;
+    std::vector<Vertex> replicatedVertices;
+    std::vector<std::vector<BoneInfluence>> replicatedInfluences;
+    std::vector<uint32_t> replicatedIndices;
+    std::vector<MeshSourceRange> sources(copies);
+    for (int c = 0; c < copies; ++c) {
+        sources[c].vertexStart = uint32_t(replicatedVertices.size());
+        sources[c].vertexCount = uint32_t(vertices.size());
+        sources[c].indexStart = uint32_t(replicatedIndices.size());
+        sources[c].indexCount = uint32_t(indices.size());
+        for (uint32_t index : indices)
+            replicatedIndices.push_back(index + sources[c].vertexStart);
+        replicatedVertices.insert(replicatedVertices.end(), vertices.begin(), vertices.end());
+        replicatedInfluences.insert(replicatedInfluences.end(), influences.begin(), influences.end());
+    }
+
+    std::vector<MeshLodSettings> settings = DefaultMeshLodSettings();
+    double singleNs = 0.0;
+    for (unsigned int workers : WorkerCounts()) {
+        JobSystem jobs(workers);
+        MeshLodChain chain;
+        double ns = MeasureNanoseconds(1, [&](int) {
+            BuildMeshLodChain(replicatedVertices, replicatedInfluences, replicatedIndices, sources, settings, chain, &jobs);
+        });
+        if (workers == 1)
+            singleNs = ns;
+        std::cout << "  LOD chain (" << copies << " meshes x " << chain.levels.size() << " levels), " << workers
+            << " workers: " << ns / 1e6 << " ms, speedup x" << singleNs / ns << std::endl;
+    }
+}
+
+void BenchmarkMorphTargets(const MorphTargetSet& morphTargets, float animDuration)
+{
+    // 合成头部：约 2 万个顶点的球面网格；每个目标是一块球冠，沿法线平滑隆起，相当于脸部的局部表情
+    const int rings = 140, segments = 143;
+    const float radius = 10.0f;
+    std::vector<Float3> positions, normals;
+    for (int r = 0; r < rings; ++r) {
+        float theta = 3.14159265f * (float(r) + 0.5f) / float(rings);
+        for (int s = 0; s < segments; ++s) {
+            float phi = 2.0f * 3.14159265f * float(s) / float(segments);
+            Float3 n = { std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi) };
+            normals.push_back(n);
+            positions.push_back({ n.x * radius, n.y * radius, n.z * radius });
+        }
+    }
+    size_t vertexCount = positions.size();
+
+    const int targetCount = 50;
+    const int keyCount = 32;
+    std::mt19937 rng(46);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    MorphTargetSet head;
+    head.vertexCount = vertexCount;
+    for (int t = 0; t < targetCount; ++t) {
+        MorphTarget target;
+        target.name = "shape" + std::to_string(t);
+        const Float3& center = normals[size_t(unit(rng) * float(vertexCount - 1))];
+        float cosExtent = 0.92f;    // 球冠约占球面的 4%
+        for (size_t v = 0; v < vertexCount; ++v) {
+            const Float3& n = normals[v];
+            float c = n.x * center.x + n.y * center.y + n.z * center.z;
+            if (c <= cosExtent)
+                continue;
+            float falloff = (c - cosExtent) / (1.0f - cosExtent);
+            MorphDelta delta;
+            delta.position[0] = n.x * falloff * 0.5f;
+            delta.position[1] = n.y * falloff * 0.5f;
+            delta.position[2] = n.z * falloff * 0.5f;
+            delta.normal[0] = (center.x - n.x) * falloff * 0.1f;
+            delta.normal[1] = (center.y - n.y) * falloff * 0.1f;
+            delta.normal[2] = (center.z - n.z) * falloff * 0.1f;
+            target.vertices.push_back(uint32_t(v));
+            target.deltas.push_back(delta);
+        }
+        for (int k = 0; k < keyCount; ++k) {
+            MorphWeightKey key;
+            key.mTime = double(k) / double(keyCount - 1) * 100.0;
+            key.mValue = unit(rng);
+            target.weights.push_back(key);
+        }
+        head.targets.push_back(target);
+    }
+    // 恒等映射的 RemapMorphTargets 顺便整理出 touchedVertices
+    std::vector<uint32_t> identity(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        identity[v] = uint32_t(v);
+    MorphTargetSet set;
+    RemapMorphTargets(head, identity, set);
+
+    size_t entries = 0;
+    for (const MorphTarget& target : set.targets)
+        entries += target.vertices.size();
+    size_t denseBytes = size_t(targetCount) * vertexCount * sizeof(MorphDelta);
+    size_t sparseBytes = entries * (sizeof(MorphDelta) + sizeof(uint32_t));
+    std::cout << "[Bench] morph targets (" << vertexCount << " vertices, " << targetCount << " targets, "
+        << double(entries) / targetCount << " vertices per target, " << set.touchedVertices.size()
+        << " touched): sparse " << sparseBytes / 1024 << " KB vs dense " << denseBytes / 1024 << " KB" << std::endl;
+
+    // 稠密累加作为参考：每个目标遍历全部顶点
+    std::vector<MorphDelta> denseTargets(size_t(targetCount) * vertexCount);
+    for (int t = 0; t < targetCount; ++t)
+        for (size_t i = 0; i < set.targets[t].vertices.size(); ++i)
+            denseTargets[size_t(t) * vertexCount + set.targets[t].vertices[i]] = set.targets[t].deltas[i];
+
+    std::vector<float> weights(targetCount);
+    for (int t = 0; t < targetCount; ++t)
+        weights[t] = 0.1f + 0.9f * unit(rng);
+    std::vector<MorphDelta> reference(vertexCount), dense(vertexCount);
+    const int iterations = 200;
+    double denseNs = MeasureNanoseconds(iterations, [&](int) {
+        std::fill(reference.begin(), reference.end(), MorphDelta());
+        for (int t = 0; t < targetCount; ++t) {
+            const MorphDelta* src = &denseTargets[size_t(t) * vertexCount];
+            for (size_t v = 0; v < vertexCount; ++v)
+                for (int k = 0; k < 3; ++k) {
+                    reference[v].position[k] += weights[t] * src[v].position[k];
+                    reference[v].normal[k] += weights[t] * src[v].normal[k];
+                }
+        }
+        g_sink = g_sink + reference[0].position[0];
+    });
+    std::cout << "  dense, 50 active: " << denseNs / 1000.0 << " us" << std::endl;
+
+    auto maxDiff = [&]() {
+        float diff = 0.0f;
+        for (size_t v = 0; v < vertexCount; ++v)
+            for (int k = 0; k < 3; ++k) {
+                diff = std::max(diff, std::fabs(dense[v].position[k] - reference[v].position[k]));
+                diff = std::max(diff, std::fabs(dense[v].normal[k] - reference[v].normal[k]));
+            }
+        return diff;
+    };
+
+    // 大部分表情权重为 0 的一帧：只有 8 个目标在动
+    std::vector<float> sparseWeights(targetCount, 0.0f);
+    for (int i = 0; i < 8; ++i)
+        sparseWeights[i * (targetCount / 8)] = weights[i * (targetCount / 8)];
+
+    for (SkinningKernel kernel : { SkinningKernel::Scalar, SkinningKernel::SSE, SkinningKernel::AVX2 }) {
+        if (!IsSkinningKernelSupported(kernel)) {
+            std::cout << "  " << SkinningKernelName(kernel) << ": not supported" << std::endl;
+            continue;
+        }
+        std::fill(dense.begin(), dense.end(), MorphDelta());
+        double ns = MeasureNanoseconds(iterations, [&](int) {
+            AccumulateMorphDeltas(set, weights.data(), dense.data(), kernel);
+            g_sink = g_sink + dense[0].position[0];
+        });
+        float diff = maxDiff();
+        size_t active = 0;
+        double skipNs = MeasureNanoseconds(iterations, [&](int) {
+            active = AccumulateMorphDeltas(set, sparseWeights.data(), dense.data(), kernel);
+            g_sink = g_sink + dense[0].position[0];
+        });
+        std::cout << "  sparse " << SkinningKernelName(kernel) << ", 50 active: " << ns / 1000.0 << " us (x"
+            << denseNs / ns << " vs dense), max diff " << diff << "; " << active << " active, "
+            << targetCount - active << " skipped: " << skipNs / 1000.0 << " us" << std::endl;
+    }
+
+    double sampleNs = MeasureNanoseconds(10000, [&](int i) {
+        SampleMorphWeights(set, float(i % 997) / 997.0f * 100.0f, weights.data());
+        g_sink = g_sink + weights[0];
+    });
+    std::cout << "  weight sampling (" << targetCount << " tracks x " << keyCount << " keys): " << sampleNs / 1000.0 << " us" << std::endl;
+
+    if (morphTargets.targets.empty())
+        return;
+    std::vector<float> modelWeights(morphTargets.targets.size());
+    std::vector<MorphDelta> modelDeltas(morphTargets.vertexCount);
+    size_t modelActive = 0;
+    double modelNs = MeasureNanoseconds(iterations, [&](int i) {
+        SampleMorphWeights(morphTargets, SampleTime(i, animDuration), modelWeights.data());
+        modelActive = AccumulateMorphDeltas(morphTargets, modelWeights.data(), modelDeltas.data());
+        g_sink = g_sink + float(modelActive);
+    });
+    std::cout << "  model: " << morphTargets.targets.size() << " targets, " << morphTargets.touchedVertices.size()
+        << " touched vertices, sample + accumulate " << modelNs / 1000.0 << " us (" << SkinningKernelName(BestSkinningKernel())
+        << ")" << std::endl;
+}
+
+void BenchmarkSkinnedBounds(const std::vector<Vertex>& vertices, const std::vector<VertexInfluences>& extraInfluences,
+    const Skeleton& skeleton, float animDuration)
+{
+    if (vertices.empty() || skeleton.boneCount == 0) return;
+
+    BoneBoundsSet boneBounds;
+    double buildNs = MeasureNanoseconds(3, [&](int) {
+        BuildBoneBounds(vertices, extraInfluences, skeleton, nullptr, boneBounds);
+    });
+    size_t count = vertices.size();
+    std::cout << "[Bench] skinned bounds (" << count << " vertices, " << boneBounds.bones.size() << " bone boxes), build "
+        << buildNs / 1e6 << " ms" << std::endl;
+
+    // 每帧：只变换骨骼盒子 vs. 蒙皮全部顶点后求包围盒
+    const VertexInfluences* extra = extraInfluences.empty() ? nullptr : extraInfluences.data();
+    std::vector<aiMatrix4x4> palette = MakePalette(skeleton, animDuration * 0.37f);
+    std::vector<Float3> positions(count), normals(count);
+    aiMatrix4x4 world;
+    SkinnedBounds bounds;
+    double boundsNs = MeasureNanoseconds(10000, [&](int) {
+        ComputeSkinnedBounds(boneBounds, palette.data(), world, bounds);
+        g_sink = g_sink + bounds.radius;
+    });
+    double bruteNs = MeasureNanoseconds(20, [&](int) {
+        SkinVertices(vertices.data(), count, palette.data(), positions.data(), normals.data(), BestSkinningKernel(), extra);
+        Float3 lo = positions[0], hi = positions[0];
+        for (const Float3& p : positions) {
+            lo.x = std::min(lo.x, p.x); lo.y = std::min(lo.y, p.y); lo.z = std::min(lo.z, p.z);
+            hi.x = std::max(hi.x, p.x); hi.y = std::max(hi.y, p.y); hi.z = std::max(hi.z, p.z);
+        }
+        g_sink = g_sink + lo.x + hi.x;
+    });
+    std::cout << "  per frame: bone boxes " << boneBounds.bones.size() << " -> " << boundsNs / 1000.0
+        << " us, skin all vertices + AABB " << bruteNs / 1000.0 << " us (x" << bruteNs / boundsNs << ")" << std::endl;
+
+    // 包含性与松紧：包围盒 / 包围球相对本帧紧包围盒的对角线 / 外接球半径
+    const int frames = 16;
+    size_t outside = 0;
+    double diagonalRatio = 0.0, radiusRatio = 0.0;
+    for (int frame = 0; frame < frames; ++frame) {
+        palette = MakePalette(skeleton, animDuration * float(frame) / float(frames));
+        ComputeSkinnedBounds(boneBounds, palette.data(), world, bounds);
+        SkinVertices(vertices.data(), count, palette.data(), positions.data(), normals.data(), SkinningKernel::Scalar, extra);
+        Float3 lo = positions[0], hi = positions[0];
+        float maxDistance = 0.0f;
+        for (const Float3& p : positions) {
+            float tolerance = 1e-3f * (1.0f + std::fabs(p.x) + std::fabs(p.y) + std::fabs(p.z));
+            if (p.x < bounds.min.x - tolerance || p.y < bounds.min.y - tolerance || p.z < bounds.min.z - tolerance ||
+                p.x > bounds.max.x + tolerance || p.y > bounds.max.y + tolerance || p.z > bounds.max.z + tolerance)
+                ++outside;
+            float dx = p.x - bounds.center.x, dy = p.y - bounds.center.y, dz = p.z - bounds.center.z;
+            maxDistance = std::max(maxDistance, std::sqrt(dx * dx + dy * dy + dz * dz));
+            lo.x = std::min(lo.x, p.x); lo.y = std::min(lo.y, p.y); lo.z = std::min(lo.z, p.z);
+            hi.x = std::max(hi.x, p.x); hi.y = std::max(hi.y, p.y); hi.z = std::max(hi.z, p.z);
+        }
+        if (maxDistance > bounds.radius * (1.0f + 1e-4f) + 1e-3f)
+            ++outside;
+        auto diagonal = [](const Float3& a, const Float3& b) {
+            return std::sqrt((b.x - a.x) * (b.x - a.x) + (b.y - a.y) * (b.y - a.y) + (b.z - a.z) * (b.z - a.z));
+        };
+        float tight = std::max(diagonal(lo, hi), 1e-6f);
+        diagonalRatio += diagonal(bounds.min, bounds.max) / tight;
+        radiusRatio += bounds.radius / (0.5f * tight);
+    }
+    std::cout << "  over " << frames << " frames: " << outside << " vertices outside, box diagonal x"
+        << diagonalRatio / frames << " and sphere radius x" << radiusRatio / frames << " of the tight skinned box" << std::endl;
+
+    // 人群：每个角色在调色板之后多一步包围体
+    const size_t characterCount = 1000;
+    std::vector<CharacterInstance> characters;
+    InitCrowd(skeleton, animDuration, characterCount, characters);
+    JobSystem jobs(1);
+    std::vector<AnimationScratch> scratch;
+    UpdateCrowd(skeleton, animDuration, 1.0f, characters, jobs, scratch, &boneBounds);
+    double plainNs = MeasureNanoseconds(20, [&](int) {
+        UpdateCrowd(skeleton, animDuration, 1.0f, characters, jobs, scratch);
+    });
+    double withBoundsNs = MeasureNanoseconds(20, [&](int) {
+        UpdateCrowd(skeleton, animDuration, 1.0f, characters, jobs, scratch, &boneBounds);
+    });
+    g_sink = g_sink + characters[0].bounds.radius;
+    std::cout << "  crowd of " << characterCount << ": " << plainNs / characterCount << " ns/character, with bounds "
+        << withBoundsNs / characterCount << " ns/character" << std::endl;
+}
+
+void BenchmarkSkinnedBvh(const std::vector<Vertex>& vertices, const std::vector<VertexInfluences>& extraInfluences,
+    const std::vector<uint32_t>& indices, const Skeleton& skeleton, float animDuration)
+{
+    if (indices.empty()) return;
+
+    size_t count = vertices.size();
+    size_t triangleCount = indices.size() / 3;
+    std::vector<Float3> bindPositions(count);
+    for (size_t v = 0; v < count; ++v)
+        bindPositions[v] = vertices[v].position;
+
+    SkinnedBvh bvh;
+    double buildNs = MeasureNanoseconds(3, [&](int) {
+        BuildSkinnedBvh(bindPositions.data(), count, indices.data(), indices.size(), bvh);
+    });
+    std::cout << "[Bench] skinned BVH (" << triangleCount << " triangles): " << bvh.nodes.size() << " nodes, "
+        << bvh.leaves.size() << " leaves, " << bvh.levels.size() << " internal levels, depth " << bvh.maxDepth << ", build " << buildNs / 1e6 << " ms" << std::endl;
+
+    // 动画中的一帧：蒙皮 + refit，与同一姿态下重建对比
+    const VertexInfluences* extra = extraInfluences.empty() ? nullptr : extraInfluences.data();
+    std::vector<aiMatrix4x4> palette = MakePalette(skeleton, animDuration * 0.37f);
+    std::vector<Float3> positions(count), normals(count);
+    SkinVertices(vertices.data(), count, palette.data(), positions.data(), normals.data(), BestSkinningKernel(), extra);
+
+    double singleNs = 0.0;
+    for (unsigned int workers : WorkerCounts()) {
+        JobSystem jobs(workers);
+        double skinNs = MeasureNanoseconds(20, [&](int) {
+            SkinVerticesParallel(&jobs, vertices.data(), count, palette.data(), positions.data(), normals.data(), BestSkinningKernel(), extra);
+        });
+        double refitNs = MeasureNanoseconds(50, [&](int) {
+            RefitSkinnedBvh(bvh, positions.data(), &jobs);
+        });
+        if (workers == 1)
+            singleNs = refitNs;
+        std::cout << "  " << workers << " workers: refit " << refitNs / 1000.0 << " us (speedup x" << singleNs / refitNs
+            << "), skinning " << skinNs / 1000.0 << " us" << std::endl;
+    }
+    SkinnedBvh rebuilt;
+    double rebuildNs = MeasureNanoseconds(3, [&](int) {
+        BuildSkinnedBvh(positions.data(), count, indices.data(), indices.size(), rebuilt);
+    });
+    std::cout << "  rebuild at the same pose: " << rebuildNs / 1000.0 << " us" << std::endl;
+
+    // 射线：从包围盒外接球上的随机点射向盒内的随机点
+    Float3 lo = positions[0], hi = positions[0];
+    for (const Float3& p : positions) {
+        lo.x = std::min(lo.x, p.x); lo.y = std::min(lo.y, p.y); lo.z = std::min(lo.z, p.z);
+        hi.x = std::max(hi.x, p.x); hi.y = std::max(hi.y, p.y); hi.z = std::max(hi.z, p.z);
+    }
+    Float3 center = { (lo.x + hi.x) * 0.5f, (lo.y + hi.y) * 0.5f, (lo.z + hi.z) * 0.5f };
+    float radius = 0.5f * std::sqrt((hi.x - lo.x) * (hi.x - lo.x) + (hi.y - lo.y) * (hi.y - lo.y) + (hi.z - lo.z) * (hi.z - lo.z));
+    const size_t rayCount = 100000;
+    std::vector<BvhRay> rays(rayCount);
+    std::mt19937 rng(48);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (BvhRay& ray : rays) {
+        float z = unit(rng) * 2.0f - 1.0f, phi = unit(rng) * 6.2831853f, s = std::sqrt(std::max(0.0f, 1.0f - z * z));
+        ray.origin = { center.x + radius * s * std::cos(phi), center.y + radius * z, center.z + radius * s * std::sin(phi) };
+        Float3 target = { lo.x + (hi.x - lo.x) * unit(rng), lo.y + (hi.y - lo.y) * unit(rng), lo.z + (hi.z - lo.z) * unit(rng) };
+        ray.direction = { target.x - ray.origin.x, target.y - ray.origin.y, target.z - ray.origin.z };
+    }
+
+    std::vector<BvhHit> hits(rayCount);
+    double singleRayNs = 0.0;
+    for (unsigned int workers : WorkerCounts()) {
+        JobSystem jobs(workers);
+        double ns = MeasureNanoseconds(3, [&](int) {
+            IntersectRays(bvh, positions.data(), vertices.data(), extra, rays.data(), rayCount, hits.data(), &jobs);
+        });
+        if (workers == 1)
+            singleRayNs = ns;
+        std::cout << "  " << rayCount << " rays, " << workers << " workers: " << ns / 1e6 << " ms, "
+            << double(rayCount) / ns * 1000.0 << " M rays/s, speedup x" << singleRayNs / ns << std::endl;
+    }
+    size_t hitCount = 0, withBone = 0;
+    for (const BvhHit& hit : hits) {
+        hitCount += hit.triangle != BVH_NO_HIT ? 1 : 0;
+        withBone += hit.bone >= 0 ? 1 : 0;
+    }
+
+    // 前 1000 条射线与暴力求交对比：一个装下全部三角形的叶子即逐个三角形测试
+    SkinnedBvh flat;
+    flat.nodes.resize(1);
+    flat.nodes[0].min = lo;
+    flat.nodes[0].max = hi;
+    flat.nodes[0].count = uint32_t(triangleCount);
+    flat.indices = indices;
+    flat.triangles.resize(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t)
+        flat.triangles[t] = uint32_t(t);
+    const size_t checkCount = std::min<size_t>(1000, rayCount);
+    size_t mismatches = 0;
+    for (size_t r = 0; r < checkCount; ++r) {
+        BvhHit brute;
+        IntersectRays(flat, positions.data(), nullptr, nullptr, &rays[r], 1, &brute);
+        bool same = (brute.triangle == BVH_NO_HIT) == (hits[r].triangle == BVH_NO_HIT) &&
+            (brute.triangle == BVH_NO_HIT || std::fabs(brute.t - hits[r].t) <= 1e-5f * (1.0f + brute.t));
+        mismatches += same ? 0 : 1;
+    }
+
+    double refitRayNs = MeasureNanoseconds(3, [&](int) {
+        IntersectRays(bvh, positions.data(), nullptr, nullptr, rays.data(), rayCount, hits.data());
+    });
+    double rebuiltRayNs = MeasureNanoseconds(3, [&](int) {
+        IntersectRays(rebuilt, positions.data(), nullptr, nullptr, rays.data(), rayCount, hits.data());
+    });
+    std::cout << "  hit rate " << 100.0 * double(hitCount) / double(rayCount) << "%, " << withBone << " hits with a dominant bone, "
+        << mismatches << " of " << checkCount << " differ from brute force; refit tree costs x"
+        << refitRayNs / rebuiltRayNs << " of a rebuilt tree per query" << std::endl;
+}
+
+void BenchmarkBoneCapsules(const std::vector<Vertex>& vertices, const std::vector<VertexInfluences>& extraInfluences,
+    const Skeleton& skeleton, float animDuration)
+{
+    if (vertices.empty() || skeleton.boneCount == 0) return;
+
+    BoneCapsuleSet capsules;
+    CapsuleFitStats fit;
+    double buildNs = MeasureNanoseconds(3, [&](int) {
+        BuildBoneCapsules(vertices, extraInfluences, capsules, &fit);
+    });
+    if (capsules.capsules.empty()) return;
+    Float3 lo = vertices[0].position, hi = vertices[0].position;
+    for (const Vertex& v : vertices) {
+        lo.x = std::min(lo.x, v.position.x); lo.y = std::min(lo.y, v.position.y); lo.z = std::min(lo.z, v.position.z);
+        hi.x = std::max(hi.x, v.position.x); hi.y = std::max(hi.y, v.position.y); hi.z = std::max(hi.z, v.position.z);
+    }
+    float boxVolume = std::max((hi.x - lo.x) * (hi.y - lo.y) * (hi.z - lo.z), 1e-6f);
+    std::cout << "[Bench] bone capsules (" << fit.vertices << " weighted vertices): " << capsules.capsules.size()
+        << " capsules, fit " << buildNs / 1e6 << " ms, mean gap " << fit.meanGap * 100.0f << "% of the radius, max radius "
+        << fit.maxRadius << ", total volume x" << fit.volume / boxVolume << " of the bind box" << std::endl;
+
+    // 动画中的贴合程度：蒙皮后的顶点到它主导骨骼的胶囊的距离（混合顶点会被拉出胶囊）
+    std::vector<int> capsuleOfBone(std::max(skeleton.boneCount, 128), -1);
+    for (size_t i = 0; i < capsules.capsules.size(); ++i)
+        if (capsules.capsules[i].bone < capsuleOfBone.size())
+            capsuleOfBone[capsules.capsules[i].bone] = int(i);
+    std::vector<int> owner(vertices.size(), -1);
+    bool hasExtra = !extraInfluences.empty();
+    for (size_t v = 0; v < vertices.size(); ++v) {
+        float bestWeight = 0.0f;
+        for (int i = 0; i < (hasExtra ? 8 : 4); ++i) {
+            uint32_t bone = i < 4 ? vertices[v].boneIndices[i] : extraInfluences[v].boneIndices[i - 4];
+            float weight = i < 4 ? vertices[v].boneWeights[i] : extraInfluences[v].boneWeights[i - 4];
+            if (weight > bestWeight && bone < capsuleOfBone.size()) {
+                bestWeight = weight;
+                owner[v] = capsuleOfBone[bone];
+            }
+        }
+    }
+    const VertexInfluences* extra = hasExtra ? extraInfluences.data() : nullptr;
+    std::vector<Float3> positions(vertices.size()), normals(vertices.size());
+    CapsuleBatch single;
+    single.Resize(capsules.capsules.size());
+    const int frames = 16;
+    size_t outside = 0, tested = 0;
+    float maxExcursion = 0.0f;
+    for (int frame = 0; frame < frames; ++frame) {
+        std::vector<aiMatrix4x4> palette = MakePalette(skeleton, animDuration * float(frame) / float(frames));
+        SkinVertices(vertices.data(), vertices.size(), palette.data(), positions.data(), normals.data(), SkinningKernel::Scalar, extra);
+        TransformBoneCapsules(capsules, palette.data(), aiMatrix4x4(), 0, single, 0);
+        for (size_t v = 0; v < vertices.size(); ++v) {
+            if (owner[v] < 0)
+                continue;
+            size_t c = size_t(owner[v]);
+            Float3 a = { single.ax[c], single.ay[c], single.az[c] }, b = { single.bx[c], single.by[c], single.bz[c] };
+            Float3 ba = { b.x - a.x, b.y - a.y, b.z - a.z }, pa = { positions[v].x - a.x, positions[v].y - a.y, positions[v].z - a.z };
+            float baba = ba.x * ba.x + ba.y * ba.y + ba.z * ba.z;
+            float s = baba > 0.0f ? std::min(std::max((pa.x * ba.x + pa.y * ba.y + pa.z * ba.z) / baba, 0.0f), 1.0f) : 0.0f;
+            float dx = pa.x - s * ba.x, dy = pa.y - s * ba.y, dz = pa.z - s * ba.z;
+            float excursion = std::sqrt(dx * dx + dy * dy + dz * dz) - single.radius[c];
+            ++tested;
+            if (excursion > 1e-3f * single.radius[c]) {
+                ++outside;
+                maxExcursion = std::max(maxExcursion, excursion / single.radius[c]);
+            }
+        }
+    }
+    std::cout << "  over " << frames << " frames: " << 100.0 * double(outside) / double(std::max<size_t>(tested, 1))
+        << "% of skinned vertices outside their capsule, worst by " << maxExcursion * 100.0f << "% of its radius" << std::endl;
+
+    // 人群：角色排成网格，所有胶囊一批 SoA
+    const size_t characterCount = 100;
+    std::vector<CharacterInstance> characters;
+    InitCrowd(skeleton, animDuration, characterCount, characters);
+    JobSystem jobs(1);
+    std::vector<AnimationScratch> scratch;
+    UpdateCrowd(skeleton, animDuration, 1.0f, characters, jobs, scratch);
+    float spacing = 2.0f * std::max(std::max(hi.x - lo.x, hi.z - lo.z), 1e-3f);
+    size_t columns = 10;
+    for (size_t c = 0; c < characterCount; ++c)
+        aiMatrix4x4::Translation(aiVector3D(float(c % columns) * spacing, 0.0f, float(c / columns) * spacing), characters[c].world);
+    CapsuleBatch batch;
+    double gatherNs = MeasureNanoseconds(100, [&](int) {
+        GatherCrowdCapsules(capsules, characters, batch);
+    });
+    std::cout << "  crowd of " << characterCount << ": " << batch.Size() << " capsules, transform " << gatherNs / 1000.0 << " us" << std::endl;
+
+    // 射线从人群上方斜射向地面上的随机点；球在人群所在的区域内随机分布
+    float extentX = float(columns) * spacing, extentZ = float((characterCount + columns - 1) / columns) * spacing;
+    const size_t queryCount = 10000;
+    std::vector<BvhRay> rays(queryCount);
+    std::vector<CollisionSphere> spheres(queryCount);
+    std::mt19937 rng(49);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    float height = hi.y - lo.y;
+    for (size_t q = 0; q < queryCount; ++q) {
+        rays[q].origin = { extentX * unit(rng), lo.y + height * 2.0f, extentZ * unit(rng) };
+        Float3 target = { extentX * unit(rng), lo.y + height * unit(rng), extentZ * unit(rng) };
+        rays[q].direction = { target.x - rays[q].origin.x, target.y - rays[q].origin.y, target.z - rays[q].origin.z };
+        spheres[q].center = { extentX * unit(rng), lo.y + height * unit(rng), extentZ * unit(rng) };
+        spheres[q].radius = 0.02f * height;
+    }
+
+    std::vector<CapsuleHit> refRays(queryCount), refSpheres(queryCount), hits(queryCount);
+    double scalarRayNs = 0.0, scalarSphereNs = 0.0;
+    for (SkinningKernel kernel : { SkinningKernel::Scalar, SkinningKernel::SSE, SkinningKernel::AVX2 }) {
+        if (!IsSkinningKernelSupported(kernel)) {
+            std::cout << "  " << SkinningKernelName(kernel) << ": not supported" << std::endl;
+            continue;
+        }
+        double rayNs = MeasureNanoseconds(3, [&](int) {
+            IntersectRaysCapsules(batch, rays.data(), queryCount, hits.data(), kernel);
+        });
+        size_t rayMismatches = 0, rayHits = 0;
+        if (kernel == SkinningKernel::Scalar) {
+            refRays = hits;
+            scalarRayNs = rayNs;
+        }
+        for (size_t q = 0; q < queryCount; ++q) {
+            rayHits += hits[q].capsule != CAPSULE_NO_HIT ? 1 : 0;
+            bool same = hits[q].capsule == refRays[q].capsule ||
+                (hits[q].capsule != CAPSULE_NO_HIT && refRays[q].capsule != CAPSULE_NO_HIT && std::fabs(hits[q].t - refRays[q].t) <= 1e-4f);
+            rayMismatches += same ? 0 : 1;
+        }
+        double sphereNs = MeasureNanoseconds(3, [&](int) {
+            OverlapSpheresCapsules(batch, spheres.data(), queryCount, hits.data(), kernel);
+        });
+        size_t sphereMismatches = 0, sphereHits = 0;
+        if (kernel == SkinningKernel::Scalar) {
+            refSpheres = hits;
+            scalarSphereNs = sphereNs;
+        }
+        for (size_t q = 0; q < queryCount; ++q) {
+            sphereHits += hits[q].capsule != CAPSULE_NO_HIT ? 1 : 0;
+            bool same = hits[q].capsule == refSpheres[q].capsule ||
+                (hits[q].capsule != CAPSULE_NO_HIT && refSpheres[q].capsule != CAPSULE_NO_HIT &&
+                    std::fabs(hits[q].t - refSpheres[q].t) <= 1e-4f * (1.0f + height));
+            sphereMismatches += same ? 0 : 1;
+        }
+        double pairs = double(queryCount) * double(batch.Size());
+        std::cout << "  " << SkinningKernelName(kernel) << ": rays " << rayNs / 1e6 << " ms (" << pairs / rayNs
+            << " G ray-capsule tests/s, x" << scalarRayNs / rayNs << ", " << rayHits << " hits, " << rayMismatches
+            << " differ), spheres " << sphereNs / 1e6 << " ms (" << pairs / sphereNs << " G tests/s, x" << scalarSphereNs / sphereNs
+            << ", " << sphereHits << " overlaps, " << sphereMismatches << " differ)" << std::endl;
+    }
+}
+
+void BenchmarkVertexDedup(const std::vector<Vertex>& vertices, const std::vector<VertexInfluences>& extraInfluences,
+    const std::vector<uint32_t>& indices)
+{
+    if (vertices.empty()) return;
+
+    VertexDedupStats stats;
+    auto printStats = [&](double ns) {
+        std::cout << stats.verticesBefore << " -> " << stats.verticesAfter << " vertices (-"
+            << 100.0 * double(stats.verticesBefore - stats.verticesAfter) / double(std::max<size_t>(stats.verticesBefore, 1)) << "%), "
+            << stats.degenerateTriangles << " degenerate triangles dropped, " << ns / 1e6 << " ms, "
+            << double(stats.verticesBefore) / ns * 1000.0 << " M vertices/s";
+    };
+
+    // 已知答案的合成网格：接缝与窄条
+    {
+        const int rings = 200, segments = 100, parts = 4;
+        std::vector<Vertex> tube;
+        std::vector<uint32_t> tubeIndices;
+        MakeSeamTube(rings, segments, parts, tube, tubeIndices);
+        std::vector<Vertex> work;
+        std::vector<VertexInfluences> workExtra;
+        std::vector<uint32_t> workIndices;
+        double ns = MeasureNanoseconds(3, [&](int) {
+            work = tube;
+            workExtra.clear();
+            workIndices = tubeIndices;
+            DeduplicateVertices(work, workExtra, workIndices, VERTEX_DEDUP_EPSILON, nullptr, &stats);
+        });
+        std::cout << "[Bench] vertex dedup, " << parts << "-submesh seam tube: ";
+        printStats(ns);
+        std::cout << " (expected " << rings * segments << " vertices, " << parts * 2 * segments << " triangles)" << std::endl;
+    }
+
+    // 当前网格本身
+    std::vector<Vertex> deduped;
+    std::vector<VertexInfluences> dedupedExtra;
+    std::vector<uint32_t> dedupedIndices;
+    double ns = MeasureNanoseconds(3, [&](int) {
+        deduped = vertices;
+        dedupedExtra = extraInfluences;
+        dedupedIndices = indices;
+        DeduplicateVertices(deduped, dedupedExtra, dedupedIndices, VERTEX_DEDUP_EPSILON, nullptr, &stats);
+    });
+    std::cout << "[Bench] vertex dedup, model: ";
+    printStats(ns);
+    std::cout << std::endl;
+
+    // 把网格复制一份作为第二个子网格，位置偏移小于 epsilon 时应恰好合并回去，大于 epsilon 时一个都不应合并
+    for (float jitter : { 0.4f * VERTEX_DEDUP_EPSILON, 4.0f * VERTEX_DEDUP_EPSILON }) {
+        std::vector<Vertex> doubled = deduped;
+        std::vector<VertexInfluences> doubledExtra = dedupedExtra;
+        std::vector<uint32_t> doubledIndices = dedupedIndices;
+        size_t base = deduped.size();
+        for (size_t v = 0; v < base; ++v) {
+            Vertex copy = deduped[v];
+            copy.position.x += (v & 1) ? jitter : -jitter;
+            copy.position.z += 0.5f * jitter;
+            doubled.push_back(copy);
+            if (!dedupedExtra.empty())
+                doubledExtra.push_back(dedupedExtra[v]);
+        }
+        for (uint32_t index : dedupedIndices)
+            doubledIndices.push_back(index + uint32_t(base));
+        std::vector<Vertex> work;
+        std::vector<VertexInfluences> workExtra;
+        std::vector<uint32_t> workIndices;
+        double doubledNs = MeasureNanoseconds(3, [&](int) {
+            work = doubled;
+            workExtra = doubledExtra;
+            workIndices = doubledIndices;
+            DeduplicateVertices(work, workExtra, workIndices, VERTEX_DEDUP_EPSILON, nullptr, &stats);
+        });
+        size_t wrongIndices = 0;
+        for (size_t i = 0; i < dedupedIndices.size(); ++i)
+            wrongIndices += i >= workIndices.size() || workIndices[i] != dedupedIndices[i] ? 1 : 0;
+        std::cout << "  duplicated as a second submesh, jitter " << jitter << ": " << stats.verticesBefore << " -> "
+            << stats.verticesAfter << " (expected " << (jitter <= VERTEX_DEDUP_EPSILON ? base : 2 * base) << "), "
+            << doubledNs / 1e6 << " ms, " << wrongIndices << " first-submesh indices changed" << std::endl;
+    }
+}
@@ -0,0 +1,95 @@
+﻿#pragma once
+#include <chrono>
+#include <vector>
+#include "BoneCapsules.h"
+#include "Influences.h"
+#include "Meshlet.h"
+#include "MeshLod.h"
+#include "Morph.h"
+#include "Skeleton.h"
+#include "SkinnedBounds.h"
+#include "SkinnedBvh.h"
+#include "Vertex.h"
+#include "VertexDedup.h"
+
+// 以 "--bench" 启动时运行的性能测试，结果打印到控制台
+
+// 重复执行 func，返回每次调用的平均耗时（纳秒）
+template<typename Func>
+double MeasureNanoseconds(int iterations, Func&& func)
+{
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+        func(i);
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - begin).count() / iterations;
+}
+
+// 祖先链查询 vs. 整棵骨架求值
+void BenchmarkJointQueries(const Skeleton& skeleton, float animDuration);
+
+// 多角色动画更新在 1..N 个 worker 上的扩展性（100 / 1000 / 10000 个角色）；boneBounds 非空时每个角色同时更新包围体
+void BenchmarkCrowdUpdate(const Skeleton& skeleton, float animDuration, const BoneBoundsSet* boneBounds = nullptr);
+
+// 大骨架（把模型骨架复制到 800+ 关节）串行 vs. 子树块并行的姿态更新，并逐位校验结果
+void BenchmarkLargeSkeleton(const Skeleton& skeleton, float animDuration);
+
+// CPU 蒙皮各实现（标量 / SSE / AVX2）的吞吐量（顶点/秒），并与标量结果对比误差
+void BenchmarkCpuSkinning(const std::vector<Vertex>& vertices, const Skeleton& skeleton, float animDuration);
+
+// 分块多线程 CPU 蒙皮在 1..N 个 worker 上的扩展性（模型网格，以及复制到 10 万顶点的网格）
+void BenchmarkParallelSkinning(const std::vector<Vertex>& vertices, const Skeleton& skeleton, float animDuration);
+
+// 4x4 与 3x4 调色板：上传字节数、调色板生成耗时、CPU 蒙皮吞吐量
+void BenchmarkPaletteFormats(const std::vector<Vertex>& vertices, const Skeleton& skeleton, float animDuration);
+
+// 对偶四元数蒙皮 vs. LBS：调色板大小、调色板生成耗时、CPU 蒙皮吞吐量
+void BenchmarkDualQuatSkinning(const std::vector<Vertex>& vertices, const Skeleton& skeleton, float animDuration);
+
+// 按影响数分桶的特化蒙皮 vs. 固定影响数循环：各桶顶点数、平均循环次数、CPU 蒙皮吞吐量；
+// 再把同样的顶点重新绑定为 50% 1 / 30% 2 / 10% 3 / 10% 4 影响的合成混合测一次。
+// vertices 已按 buckets 排好序（SortVerticesByInfluenceCount）
+void BenchmarkInfluenceBuckets(const std::vector<Vertex>& vertices, const std::vector<VertexInfluences>& extraInfluences,
+    const std::vector<InfluenceBucket>& buckets, const Skeleton& skeleton, float animDuration);
+
+// 刚性段快速路径：模型自身的刚性顶点比例，以及硬表面代理网格（每 1024 个顶点整段绑定到一个骨骼）上
+// 刚性路径 vs. 1 影响特化 vs. 固定 4 影响循环的 CPU 蒙皮吞吐量
+void BenchmarkRigidSegments(const std::vector<Vertex>& vertices, const std::vector<InfluenceBucket>& buckets,
+    const Skeleton& skeleton, float animDuration);
+
+// 后变换顶点缓存优化：导入顺序与随机打乱的三角形在优化前后的 ACMR / ATVR（FIFO 16 / 32），以及优化耗时
+void BenchmarkVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount);
+
+// meshlet 构建耗时与统计（每簇三角形 / 顶点 / 骨骼数），每帧保守包围盒的计算耗时（4x4 / 3x4，1..N 个 worker），
+// 并在若干时刻 CPU 蒙皮检查包围盒确实包含簇内所有顶点、相对紧包围盒的大小
+void BenchmarkMeshlets(const PartitionedMesh& mesh, const Skeleton& skeleton, float animDuration);
+
+// LOD 简化：各目标比例的三角形数、几何误差、被影响差异 / 翻转拒绝的折叠数与耗时；
+// 把模型复制为 8 个源网格后整条 LOD 链在 1..N 个 worker 上的生成耗时
+void BenchmarkMeshLod(const std::vector<Vertex>& vertices, const std::vector<VertexInfluences>& extraInfluences,
+    const std::vector<uint32_t>& indices);
+
+// 变形目标：合成的 2 万顶点头部 + 50 个局部目标上，稀疏累加（标量 / SSE / AVX2）vs. 稠密累加的耗时，
+// 大部分权重接近 0 时跳过目标的收益，以及 50 条权重轨道的采样耗时；模型自带目标时也测一次
+void BenchmarkMorphTargets(const MorphTargetSet& morphTargets, float animDuration);
+
+// 每骨骼包围盒求角色包围体：构建耗时，每帧耗时 vs. 蒙皮全部顶点再求包围盒，若干时刻的包含性检查和相对紧包围盒的大小，
+// 以及 1000 个角色的人群更新附带包围体的额外开销
+void BenchmarkSkinnedBounds(const std::vector<Vertex>& vertices, const std::vector<VertexInfluences>& extraInfluences,
+    const Skeleton& skeleton, float animDuration);
+
+// 蒙皮 BVH：建树耗时，每帧 refit vs. 重建（1..N 个 worker），批量射线查询的吞吐量（1..N 个 worker），
+// 与暴力求交对比最近交点，以及 refit 后的树与在同一姿态重建的树的查询耗时之比
+void BenchmarkSkinnedBvh(const std::vector<Vertex>& vertices, const std::vector<VertexInfluences>& extraInfluences,
+    const std::vector<uint32_t>& indices, const Skeleton& skeleton, float animDuration);
+
+// 骨骼胶囊：拟合耗时和绑定姿态下的空隙，若干时刻蒙皮顶点落在主导骨骼胶囊外的比例，
+// 100 个角色的胶囊变换耗时，以及射线 / 球对全部胶囊的批量测试吞吐量（标量 / SSE / AVX2，与标量结果对比）
+void BenchmarkBoneCapsules(const std::vector<Vertex>& vertices, const std::vector<VertexInfluences>& extraInfluences,
+    const Skeleton& skeleton, float animDuration);
+
+// 顶点去重：先在已知答案的合成圆管（4 个子网格、复制的接缝环和焊接后退化的窄条）上检查合并数与删除的三角形数，
+// 再测当前网格的重复顶点数与耗时；把网格复制一份作为第二个子网格、加上小于 / 大于 epsilon 的位置扰动，
+// 检查是否恰好全部合并 / 全部保留
+void BenchmarkVertexDedup(const std::vector<Vertex>& vertices, const std::vector<VertexInfluences>& extraInfluences,
+    const std::vector<uint32_t>& indices);
@@ -0,0 +1,693 @@
+﻿#include "BoneCapsules.h"
+#include "Crowd.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CAPSULE_X86 1
+#include <immintrin.h>
+#endif
+
+// 与 Skinning.cpp 相同：GCC/Clang 按函数打开 AVX2 目标特性，运行时由 IsSkinningKernelSupported 检查
+#if defined(CAPSULE_X86) && !defined(_MSC_VER)
+#define CAPSULE_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CAPSULE_TARGET_AVX2
+#endif
+
+#if defined(CAPSULE_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define CAPSULE_HAS_SSE 1
+#endif
+
+namespace
+{
+    // 每个 worker 一次处理的射线 / 球数、角色数
+    const size_t kQueryGrain = 64;
+    const size_t kCharacterGrain = 16;
+    // 线段长度的平方小于它时按球处理，避免除零
+    const float kDegenerateLength2 = 1e-12f;
+
+    float Dot(const Float3& a, const Float3& b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    Float3 Sub(const Float3& a, const Float3& b)
+    {
+        return { a.x - b.x, a.y - b.y, a.z - b.z };
+    }
+
+    // 对称 3x3 协方差矩阵的最大特征向量（幂迭代），点集退化时返回 y 轴
+    Float3 PrincipalAxis(const double cov[3][3])
+    {
+        int column = 0;
+        for (int k = 1; k < 3; ++k)
+            if (cov[k][k] > cov[column][column])
+                column = k;
+        double v[3] = { cov[0][column], cov[1][column], cov[2][column] };
+        for (int iteration = 0; iteration < 32; ++iteration) {
+            double w[3];
+            for (int r = 0; r < 3; ++r)
+                w[r] = cov[r][0] * v[0] + cov[r][1] * v[1] + cov[r][2] * v[2];
+            double length = std::sqrt(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]);
+            if (length <= 1e-30)
+                return { 0.0f, 1.0f, 0.0f };
+            for (int r = 0; r < 3; ++r)
+                v[r] = w[r] / length;
+        }
+        return { float(v[0]), float(v[1]), float(v[2]) };
+    }
+
+    // 点到线段 [a, b] 的距离
+    float SegmentDistance(const Float3& p, const Float3& a, const Float3& b)
+    {
+        Float3 ba = Sub(b, a), pa = Sub(p, a);
+        float baba = Dot(ba, ba);
+        float s = baba > kDegenerateLength2 ? std::min(std::max(Dot(pa, ba) / baba, 0.0f), 1.0f) : 0.0f;
+        Float3 d = { pa.x - s * ba.x, pa.y - s * ba.y, pa.z - s * ba.z };
+        return std::sqrt(Dot(d, d));
+    }
+
+    void FitCapsule(const std::vector<Float3>& points, BoneCapsule& capsule)
+    {
+        double mean[3] = { 0.0, 0.0, 0.0 };
+        for (const Float3& p : points) {
+            mean[0] += p.x; mean[1] += p.y; mean[2] += p.z;
+        }
+        for (double& m : mean)
+            m /= double(points.size());
+        double cov[3][3] = {};
+        for (const Float3& p : points) {
+            double d[3] = { p.x - mean[0], p.y - mean[1], p.z - mean[2] };
+            for (int r = 0; r < 3; ++r)
+                for (int c = 0; c < 3; ++c)
+                    cov[r][c] += d[r] * d[c];
+        }
+        Float3 axis = PrincipalAxis(cov);
+        Float3 center = { float(mean[0]), float(mean[1]), float(mean[2]) };
+
+        // 半径取到轴的最大距离；两端从投影的极值向内收，直到端部的半球恰好包住最外侧的点
+        float radius2 = 0.0f;
+        for (const Float3& p : points) {
+            Float3 d = Sub(p, center);
+            float t = Dot(d, axis);
+            radius2 = std::max(radius2, Dot(d, d) - t * t);
+        }
+        float tLo = FLT_MAX, tHi = -FLT_MAX;
+        for (const Float3& p : points) {
+            Float3 d = Sub(p, center);
+            float t = Dot(d, axis);
+            float cap = std::sqrt(std::max(radius2 - (Dot(d, d) - t * t), 0.0f));
+            tLo = std::min(tLo, t + cap);
+            tHi = std::max(tHi, t - cap);
+        }
+        if (tLo > tHi) {
+            // 点集比直径还短：退化为球，半径改为到中点的最大距离
+            tLo = tHi = 0.5f * (tLo + tHi);
+            Float3 c = { center.x + axis.x * tLo, center.y + axis.y * tLo, center.z + axis.z * tLo };
+            radius2 = 0.0f;
+            for (const Float3& p : points) {
+                Float3 d = Sub(p, c);
+                radius2 = std::max(radius2, Dot(d, d));
+            }
+        }
+        capsule.a = { center.x + axis.x * tLo, center.y + axis.y * tLo, center.z + axis.z * tLo };
+        capsule.b = { center.x + axis.x * tHi, center.y + axis.y * tHi, center.z + axis.z * tHi };
+        // 舍入误差可能让最外侧的点略微露在外面，放大一点
+        capsule.radius = std::sqrt(radius2) * (1.0f + 1e-5f) + 1e-6f;
+        capsule.vertexCount = uint32_t(points.size());
+    }
+
+    // 两种调色板的前三行在内存中都是连续的 12 个 float，只是骨骼间的步长不同
+    void TransformCapsules(const BoneCapsuleSet& set, const float* palette, size_t boneStride, const aiMatrix4x4& world,
+        uint32_t character, CapsuleBatch& batch, size_t first)
+    {
+        for (size_t i = 0; i < set.capsules.size(); ++i) {
+            const BoneCapsule& capsule = set.capsules[i];
+            const float* r = palette + size_t(capsule.bone) * boneStride;
+            aiMatrix4x4 bone(r[0], r[1], r[2], r[3], r[4], r[5], r[6], r[7], r[8], r[9], r[10], r[11], 0.0f, 0.0f, 0.0f, 1.0f);
+            aiMatrix4x4 m = world * bone;
+            aiVector3D a = m * aiVector3D(capsule.a.x, capsule.a.y, capsule.a.z);
+            aiVector3D b = m * aiVector3D(capsule.b.x, capsule.b.y, capsule.b.z);
+            float scale2 = std::max(std::max(m.a1 * m.a1 + m.a2 * m.a2 + m.a3 * m.a3, m.b1 * m.b1 + m.b2 * m.b2 + m.b3 * m.b3),
+                m.c1 * m.c1 + m.c2 * m.c2 + m.c3 * m.c3);
+            size_t k = first + i;
+            batch.ax[k] = a.x; batch.ay[k] = a.y; batch.az[k] = a.z;
+            batch.bx[k] = b.x; batch.by[k] = b.y; batch.bz[k] = b.z;
+            batch.radius[k] = capsule.radius * std::sqrt(scale2);
+            batch.bone[k] = capsule.bone;
+            batch.character[k] = character;
+        }
+    }
+
+    // 射线归一化后的参数：胶囊测试按距离计算，结果再换回 direction 长度的单位
+    struct RaySetup
+    {
+        float ox, oy, oz;
+        float dx, dy, dz;
+        float tMax;         // 距离
+        float toParameter;  // 1 / |direction|
+    };
+
+    RaySetup SetupRay(const BvhRay& ray)
+    {
+        RaySetup setup;
+        float length = std::sqrt(Dot(ray.direction, ray.direction));
+        float inv = length > 0.0f ? 1.0f / length : 0.0f;
+        setup.ox = ray.origin.x; setup.oy = ray.origin.y; setup.oz = ray.origin.z;
+        setup.dx = ray.direction.x * inv; setup.dy = ray.direction.y * inv; setup.dz = ray.direction.z * inv;
+        setup.tMax = ray.tMax < FLT_MAX / std::max(length, 1.0f) ? ray.tMax * length : FLT_MAX;
+        setup.toParameter = inv;
+        return setup;
+    }
+
+    // 射线与胶囊的进入距离：圆柱侧面与两端的球分别求交取最近；起点在胶囊内或未命中返回 FLT_MAX
+    float RayCapsule(const RaySetup& ray, const CapsuleBatch& batch, size_t i)
+    {
+        float bax = batch.bx[i] - batch.ax[i], bay = batch.by[i] - batch.ay[i], baz = batch.bz[i] - batch.az[i];
+        float oax = ray.ox - batch.ax[i], oay = ray.oy - batch.ay[i], oaz = ray.oz - batch.az[i];
+        float rr = batch.radius[i] * batch.radius[i];
+        float baba = bax * bax + bay * bay + baz * baz;
+        float bard = bax * ray.dx + bay * ray.dy + baz * ray.dz;
+        float baoa = bax * oax + bay * oay + baz * oaz;
+        float rdoa = ray.dx * oax + ray.dy * oay + ray.dz * oaz;
+        float oaoa = oax * oax + oay * oay + oaz * oaz;
+
+        float s = std::min(std::max(baoa / std::max(baba, kDegenerateLength2), 0.0f), 1.0f);
+        if (oaoa - 2.0f * s * baoa + s * s * baba <= rr)
+            return FLT_MAX;
+
+        float t = FLT_MAX;
+        float k2 = baba - bard * bard;
+        float k1 = baba * rdoa - baoa * bard;
+        float k0 = baba * oaoa - baoa * baoa - rr * baba;
+        float h = k1 * k1 - k2 * k0;
+        if (h >= 0.0f && k2 > kDegenerateLength2) {
+            float body = (-k1 - std::sqrt(h)) / k2;
+            float y = baoa + body * bard;
+            if (y > 0.0f && y < baba && body >= 0.0f)
+                t = body;
+        }
+        h = rdoa * rdoa - (oaoa - rr);
+        if (h >= 0.0f) {
+            float cap = -rdoa - std::sqrt(h);
+            if (cap >= 0.0f)
+                t = std::min(t, cap);
+        }
+        float rdob = rdoa - bard;
+        float obob = oaoa - 2.0f * baoa + baba;
+        h = rdob * rdob - (obob - rr);
+        if (h >= 0.0f) {
+            float cap = -rdob - std::sqrt(h);
+            if (cap >= 0.0f)
+                t = std::min(t, cap);
+        }
+        return t;
+    }
+
+    // 球与胶囊的穿透深度，不重叠时 <= 0
+    float SphereCapsule(const CollisionSphere& sphere, const CapsuleBatch& batch, size_t i)
+    {
+        float bax = batch.bx[i] - batch.ax[i], bay = batch.by[i] - batch.ay[i], baz = batch.bz[i] - batch.az[i];
+        float pax = sphere.center.x - batch.ax[i], pay = sphere.center.y - batch.ay[i], paz = sphere.center.z - batch.az[i];
+        float baba = bax * bax + bay * bay + baz * baz;
+        float s = std::min(std::max((pax * bax + pay * bay + paz * baz) / std::max(baba, kDegenerateLength2), 0.0f), 1.0f);
+        float dx = pax - s * bax, dy = pay - s * bay, dz = paz - s * baz;
+        return batch.radius[i] + sphere.radius - std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+
+    // 标量实现同时负责 SIMD 版本凑不满一组的尾部
+    void RayTail(const RaySetup& ray, const CapsuleBatch& batch, size_t begin, float& bestT, uint32_t& best)
+    {
+        for (size_t i = begin; i < batch.Size(); ++i) {
+            float t = RayCapsule(ray, batch, i);
+            if (t < bestT) {
+                bestT = t;
+                best = uint32_t(i);
+            }
+        }
+    }
+
+    void SphereTail(const CollisionSphere& sphere, const CapsuleBatch& batch, size_t begin, float& bestDepth, uint32_t& best)
+    {
+        for (size_t i = begin; i < batch.Size(); ++i) {
+            float depth = SphereCapsule(sphere, batch, i);
+            if (depth > bestDepth) {
+                bestDepth = depth;
+                best = uint32_t(i);
+            }
+        }
+    }
+
+    // 各通道的最优值合并为一个（相同时取下标小的，与标量的扫描顺序一致）
+    template<typename Better>
+    void ReduceLanes(const float* values, const int32_t* lanes, int width, float& bestValue, uint32_t& best, Better better)
+    {
+        for (int k = 0; k < width; ++k) {
+            if (lanes[k] < 0)
+                continue;
+            if (better(values[k], bestValue) || (values[k] == bestValue && uint32_t(lanes[k]) < best)) {
+                bestValue = values[k];
+                best = uint32_t(lanes[k]);
+            }
+        }
+    }
+
+    void RaysScalar(const CapsuleBatch& batch, const BvhRay* rays, CapsuleHit* hits, size_t begin, size_t end)
+    {
+        for (size_t r = begin; r < end; ++r) {
+            RaySetup ray = SetupRay(rays[r]);
+            float bestT = ray.tMax;
+            uint32_t best = CAPSULE_NO_HIT;
+            RayTail(ray, batch, 0, bestT, best);
+            hits[r].capsule = best;
+            hits[r].t = best != CAPSULE_NO_HIT ? bestT * ray.toParameter : 0.0f;
+        }
+    }
+
+    void SpheresScalar(const CapsuleBatch& batch, const CollisionSphere* spheres, CapsuleHit* hits, size_t begin, size_t end)
+    {
+        for (size_t q = begin; q < end; ++q) {
+            float bestDepth = 0.0f;
+            uint32_t best = CAPSULE_NO_HIT;
+            SphereTail(spheres[q], batch, 0, bestDepth, best);
+            hits[q].capsule = best;
+            hits[q].t = best != CAPSULE_NO_HIT ? bestDepth : 0.0f;
+        }
+    }
+
+#if defined(CAPSULE_HAS_SSE)
+    // SSE2 没有 blendv：mask ? a : b
+    inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+    {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+
+    inline __m128 Clamp01(__m128 x)
+    {
+        return _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    }
+
+    void RaysSSE(const CapsuleBatch& batch, const BvhRay* rays, CapsuleHit* hits, size_t begin, size_t end)
+    {
+        const size_t blocks = batch.Size() / 4 * 4;
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 infinity = _mm_set1_ps(FLT_MAX);
+        const __m128 two = _mm_set1_ps(2.0f);
+        const __m128 tiny = _mm_set1_ps(kDegenerateLength2);
+        for (size_t r = begin; r < end; ++r) {
+            RaySetup ray = SetupRay(rays[r]);
+            __m128 ox = _mm_set1_ps(ray.ox), oy = _mm_set1_ps(ray.oy), oz = _mm_set1_ps(ray.oz);
+            __m128 dx = _mm_set1_ps(ray.dx), dy = _mm_set1_ps(ray.dy), dz = _mm_set1_ps(ray.dz);
+            __m128 bestT = _mm_set1_ps(ray.tMax);
+            __m128i bestLane = _mm_set1_epi32(-1);
+            __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+            for (size_t i = 0; i < blocks; i += 4, lane = _mm_add_epi32(lane, _mm_set1_epi32(4))) {
+                __m128 ax = _mm_loadu_ps(&batch.ax[i]), ay = _mm_loadu_ps(&batch.ay[i]), az = _mm_loadu_ps(&batch.az[i]);
+                __m128 bax = _mm_sub_ps(_mm_loadu_ps(&batch.bx[i]), ax);
+                __m128 bay = _mm_sub_ps(_mm_loadu_ps(&batch.by[i]), ay);
+                __m128 baz = _mm_sub_ps(_mm_loadu_ps(&batch.bz[i]), az);
+                __m128 oax = _mm_sub_ps(ox, ax), oay = _mm_sub_ps(oy, ay), oaz = _mm_sub_ps(oz, az);
+                __m128 radius = _mm_loadu_ps(&batch.radius[i]);
+                __m128 rr = _mm_mul_ps(radius, radius);
+                __m128 baba = _mm_add_ps(_mm_add_ps(_mm_mul_ps(bax, bax), _mm_mul_ps(bay, bay)), _mm_mul_ps(baz, baz));
+                __m128 bard = _mm_add_ps(_mm_add_ps(_mm_mul_ps(bax, dx), _mm_mul_ps(bay, dy)), _mm_mul_ps(baz, dz));
+                __m128 baoa = _mm_add_ps(_mm_add_ps(_mm_mul_ps(bax, oax), _mm_mul_ps(bay, oay)), _mm_mul_ps(baz, oaz));
+                __m128 rdoa = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, oax), _mm_mul_ps(dy, oay)), _mm_mul_ps(dz, oaz));
+                __m128 oaoa = _mm_add_ps(_mm_add_ps(_mm_mul_ps(oax, oax), _mm_mul_ps(oay, oay)), _mm_mul_ps(oaz, oaz));
+
+                __m128 s = Clamp01(_mm_div_ps(baoa, _mm_max_ps(baba, tiny)));
+                __m128 inside2 = _mm_add_ps(_mm_sub_ps(oaoa, _mm_mul_ps(_mm_mul_ps(two, s), baoa)), _mm_mul_ps(_mm_mul_ps(s, s), baba));
+                __m128 outside = _mm_cmpgt_ps(inside2, rr);
+
+                __m128 k2 = _mm_sub_ps(baba, _mm_mul_ps(bard, bard));
+                __m128 k1 = _mm_sub_ps(_mm_mul_ps(baba, rdoa), _mm_mul_ps(baoa, bard));
+                __m128 k0 = _mm_sub_ps(_mm_sub_ps(_mm_mul_ps(baba, oaoa), _mm_mul_ps(baoa, baoa)), _mm_mul_ps(rr, baba));
+                __m128 h = _mm_sub_ps(_mm_mul_ps(k1, k1), _mm_mul_ps(k2, k0));
+                __m128 body = _mm_div_ps(_mm_sub_ps(_mm_sub_ps(zero, k1), _mm_sqrt_ps(_mm_max_ps(h, zero))), _mm_max_ps(k2, tiny));
+                __m128 y = _mm_add_ps(baoa, _mm_mul_ps(body, bard));
+                __m128 valid = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(h, zero), _mm_cmpgt_ps(k2, tiny)),
+                    _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(y, zero), _mm_cmplt_ps(y, baba)), _mm_cmpge_ps(body, zero)));
+                __m128 t = Select(valid, body, infinity);
+
+                h = _mm_sub_ps(_mm_mul_ps(rdoa, rdoa), _mm_sub_ps(oaoa, rr));
+                __m128 cap = _mm_sub_ps(_mm_sub_ps(zero, rdoa), _mm_sqrt_ps(_mm_max_ps(h, zero)));
+                valid = _mm_and_ps(_mm_cmpge_ps(h, zero), _mm_cmpge_ps(cap, zero));
+                t = _mm_min_ps(t, Select(valid, cap, infinity));
+
+                __m128 rdob = _mm_sub_ps(rdoa, bard);
+                __m128 obob = _mm_add_ps(_mm_sub_ps(oaoa, _mm_mul_ps(two, baoa)), baba);
+                h = _mm_sub_ps(_mm_mul_ps(rdob, rdob), _mm_sub_ps(obob, rr));
+                cap = _mm_sub_ps(_mm_sub_ps(zero, rdob), _mm_sqrt_ps(_mm_max_ps(h, zero)));
+                valid = _mm_and_ps(_mm_cmpge_ps(h, zero), _mm_cmpge_ps(cap, zero));
+                t = _mm_min_ps(t, Select(valid, cap, infinity));
+
+                __m128 closer = _mm_and_ps(outside, _mm_cmplt_ps(t, bestT));
+                bestT = Select(closer, t, bestT);
+                bestLane = _mm_castps_si128(Select(closer, _mm_castsi128_ps(lane), _mm_castsi128_ps(bestLane)));
+            }
+            alignas(16) float values[4];
+            alignas(16) int32_t lanes[4];
+            _mm_store_ps(values, bestT);
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), bestLane);
+            float t = ray.tMax;
+            uint32_t best = CAPSULE_NO_HIT;
+            ReduceLanes(values, lanes, 4, t, best, [](float a, float b) { return a < b; });
+            RayTail(ray, batch, blocks, t, best);
+            hits[r].capsule = best;
+            hits[r].t = best != CAPSULE_NO_HIT ? t * ray.toParameter : 0.0f;
+        }
+    }
+
+    void SpheresSSE(const CapsuleBatch& batch, const CollisionSphere* spheres, CapsuleHit* hits, size_t begin, size_t end)
+    {
+        const size_t blocks = batch.Size() / 4 * 4;
+        const __m128 tiny = _mm_set1_ps(kDegenerateLength2);
+        for (size_t q = begin; q < end; ++q) {
+            const CollisionSphere& sphere = spheres[q];
+            __m128 cx = _mm_set1_ps(sphere.center.x), cy = _mm_set1_ps(sphere.center.y), cz = _mm_set1_ps(sphere.center.z);
+            __m128 sphereRadius = _mm_set1_ps(sphere.radius);
+            __m128 bestDepth = _mm_setzero_ps();
+            __m128i bestLane = _mm_set1_epi32(-1);
+            __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+            for (size_t i = 0; i < blocks; i += 4, lane = _mm_add_epi32(lane, _mm_set1_epi32(4))) {
+                __m128 ax = _mm_loadu_ps(&batch.ax[i]), ay = _mm_loadu_ps(&batch.ay[i]), az = _mm_loadu_ps(&batch.az[i]);
+                __m128 bax = _mm_sub_ps(_mm_loadu_ps(&batch.bx[i]), ax);
+                __m128 bay = _mm_sub_ps(_mm_loadu_ps(&batch.by[i]), ay);
+                __m128 baz = _mm_sub_ps(_mm_loadu_ps(&batch.bz[i]), az);
+                __m128 pax = _mm_sub_ps(cx, ax), pay = _mm_sub_ps(cy, ay), paz = _mm_sub_ps(cz, az);
+                __m128 baba = _mm_add_ps(_mm_add_ps(_mm_mul_ps(bax, bax), _mm_mul_ps(bay, bay)), _mm_mul_ps(baz, baz));
+                __m128 paba = _mm_add_ps(_mm_add_ps(_mm_mul_ps(pax, bax), _mm_mul_ps(pay, bay)), _mm_mul_ps(paz, baz));
+                __m128 s = Clamp01(_mm_div_ps(paba, _mm_max_ps(baba, tiny)));
+                __m128 ex = _mm_sub_ps(pax, _mm_mul_ps(s, bax));
+                __m128 ey = _mm_sub_ps(pay, _mm_mul_ps(s, bay));
+                __m128 ez = _mm_sub_ps(paz, _mm_mul_ps(s, baz));
+                __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey)), _mm_mul_ps(ez, ez));
+                __m128 depth = _mm_sub_ps(_mm_add_ps(_mm_loadu_ps(&batch.radius[i]), sphereRadius), _mm_sqrt_ps(d2));
+                __m128 deeper = _mm_cmpgt_ps(depth, bestDepth);
+                bestDepth = Select(deeper, depth, bestDepth);
+                bestLane = _mm_castps_si128(Select(deeper, _mm_castsi128_ps(lane), _mm_castsi128_ps(bestLane)));
+            }
+            alignas(16) float values[4];
+            alignas(16) int32_t lanes[4];
+            _mm_store_ps(values, bestDepth);
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), bestLane);
+            float depth = 0.0f;
+            uint32_t best = CAPSULE_NO_HIT;
+            ReduceLanes(values, lanes, 4, depth, best, [](float a, float b) { return a > b; });
+            SphereTail(sphere, batch, blocks, depth, best);
+            hits[q].capsule = best;
+            hits[q].t = best != CAPSULE_NO_HIT ? depth : 0.0f;
+        }
+    }
+#endif
+
+#if defined(CAPSULE_X86)
+    // 与 SSE 版本逐条对应，一次 8 个胶囊
+    CAPSULE_TARGET_AVX2
+    void RaysAVX2(const CapsuleBatch& batch, const BvhRay* rays, CapsuleHit* hits, size_t begin, size_t end)
+    {
+        const size_t blocks = batch.Size() / 8 * 8;
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 infinity = _mm256_set1_ps(FLT_MAX);
+        const __m256 two = _mm256_set1_ps(2.0f);
+        const __m256 tiny = _mm256_set1_ps(kDegenerateLength2);
+        for (size_t r = begin; r < end; ++r) {
+            RaySetup ray = SetupRay(rays[r]);
+            __m256 ox = _mm256_set1_ps(ray.ox), oy = _mm256_set1_ps(ray.oy), oz = _mm256_set1_ps(ray.oz);
+            __m256 dx = _mm256_set1_ps(ray.dx), dy = _mm256_set1_ps(ray.dy), dz = _mm256_set1_ps(ray.dz);
+            __m256 bestT = _mm256_set1_ps(ray.tMax);
+            __m256i bestLane = _mm256_set1_epi32(-1);
+            __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+            for (size_t i = 0; i < blocks; i += 8, lane = _mm256_add_epi32(lane, _mm256_set1_epi32(8))) {
+                __m256 ax = _mm256_loadu_ps(&batch.ax[i]), ay = _mm256_loadu_ps(&batch.ay[i]), az = _mm256_loadu_ps(&batch.az[i]);
+                __m256 bax = _mm256_sub_ps(_mm256_loadu_ps(&batch.bx[i]), ax);
+                __m256 bay = _mm256_sub_ps(_mm256_loadu_ps(&batch.by[i]), ay);
+                __m256 baz = _mm256_sub_ps(_mm256_loadu_ps(&batch.bz[i]), az);
+                __m256 oax = _mm256_sub_ps(ox, ax), oay = _mm256_sub_ps(oy, ay), oaz = _mm256_sub_ps(oz, az);
+                __m256 radius = _mm256_loadu_ps(&batch.radius[i]);
+                __m256 rr = _mm256_mul_ps(radius, radius);
+                __m256 baba = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(bax, bax), _mm256_mul_ps(bay, bay)), _mm256_mul_ps(baz, baz));
+                __m256 bard = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(bax, dx), _mm256_mul_ps(bay, dy)), _mm256_mul_ps(baz, dz));
+                __m256 baoa = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(bax, oax), _mm256_mul_ps(bay, oay)), _mm256_mul_ps(baz, oaz));
+                __m256 rdoa = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, oax), _mm256_mul_ps(dy, oay)), _mm256_mul_ps(dz, oaz));
+                __m256 oaoa = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(oax, oax), _mm256_mul_ps(oay, oay)), _mm256_mul_ps(oaz, oaz));
+
+                __m256 s = _mm256_min_ps(_mm256_max_ps(_mm256_div_ps(baoa, _mm256_max_ps(baba, tiny)), zero), one);
+                __m256 inside2 = _mm256_add_ps(_mm256_sub_ps(oaoa, _mm256_mul_ps(_mm256_mul_ps(two, s), baoa)),
+                    _mm256_mul_ps(_mm256_mul_ps(s, s), baba));
+                __m256 outside = _mm256_cmp_ps(inside2, rr, _CMP_GT_OQ);
+
+                __m256 k2 = _mm256_sub_ps(baba, _mm256_mul_ps(bard, bard));
+                __m256 k1 = _mm256_sub_ps(_mm256_mul_ps(baba, rdoa), _mm256_mul_ps(baoa, bard));
+                __m256 k0 = _mm256_sub_ps(_mm256_sub_ps(_mm256_mul_ps(baba, oaoa), _mm256_mul_ps(baoa, baoa)), _mm256_mul_ps(rr, baba));
+                __m256 h = _mm256_sub_ps(_mm256_mul_ps(k1, k1), _mm256_mul_ps(k2, k0));
+                __m256 body = _mm256_div_ps(_mm256_sub_ps(_mm256_sub_ps(zero, k1), _mm256_sqrt_ps(_mm256_max_ps(h, zero))),
+                    _mm256_max_ps(k2, tiny));
+                __m256 y = _mm256_add_ps(baoa, _mm256_mul_ps(body, bard));
+                __m256 valid = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(h, zero, _CMP_GE_OQ), _mm256_cmp_ps(k2, tiny, _CMP_GT_OQ)),
+                    _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(y, zero, _CMP_GT_OQ), _mm256_cmp_ps(y, baba, _CMP_LT_OQ)),
+                        _mm256_cmp_ps(body, zero, _CMP_GE_OQ)));
+                __m256 t = _mm256_blendv_ps(infinity, body, valid);
+
+                h = _mm256_sub_ps(_mm256_mul_ps(rdoa, rdoa), _mm256_sub_ps(oaoa, rr));
+                __m256 cap = _mm256_sub_ps(_mm256_sub_ps(zero, rdoa), _mm256_sqrt_ps(_mm256_max_ps(h, zero)));
+                valid = _mm256_and_ps(_mm256_cmp_ps(h, zero, _CMP_GE_OQ), _mm256_cmp_ps(cap, zero, _CMP_GE_OQ));
+                t = _mm256_min_ps(t, _mm256_blendv_ps(infinity, cap, valid));
+
+                __m256 rdob = _mm256_sub_ps(rdoa, bard);
+                __m256 obob = _mm256_add_ps(_mm256_sub_ps(oaoa, _mm256_mul_ps(two, baoa)), baba);
+                h = _mm256_sub_ps(_mm256_mul_ps(rdob, rdob), _mm256_sub_ps(obob, rr));
+                cap = _mm256_sub_ps(_mm256_sub_ps(zero, rdob), _mm256_sqrt_ps(_mm256_max_ps(h, zero)));
+                valid = _mm256_and_ps(_mm256_cmp_ps(h, zero, _CMP_GE_OQ), _mm256_cmp_ps(cap, zero, _CMP_GE_OQ));
+                t = _mm256_min_ps(t, _mm256_blendv_ps(infinity, cap, valid));
+
+                __m256 closer = _mm256_and_ps(outside, _mm256_cmp_ps(t, bestT, _CMP_LT_OQ));
+                bestT = _mm256_blendv_ps(bestT, t, closer);
+                bestLane = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(bestLane), _mm256_castsi256_ps(lane), closer));
+            }
+            alignas(32) float values[8];
+            alignas(32) int32_t lanes[8];
+            _mm256_store_ps(values, bestT);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), bestLane);
+            float t = ray.tMax;
+            uint32_t best = CAPSULE_NO_HIT;
+            ReduceLanes(values, lanes, 8, t, best, [](float a, float b) { return a < b; });
+            RayTail(ray, batch, blocks, t, best);
+            hits[r].capsule = best;
+            hits[r].t = best != CAPSULE_NO_HIT ? t * ray.toParameter : 0.0f;
+        }
+    }
+
+    CAPSULE_TARGET_AVX2
+    void SpheresAVX2(const CapsuleBatch& batch, const CollisionSphere* spheres, CapsuleHit* hits, size_t begin, size_t end)
+    {
+        const size_t blocks = batch.Size() / 8 * 8;
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 tiny = _mm256_set1_ps(kDegenerateLength2);
+        for (size_t q = begin; q < end; ++q) {
+            const CollisionSphere& sphere = spheres[q];
+            __m256 cx = _mm256_set1_ps(sphere.center.x), cy = _mm256_set1_ps(sphere.center.y), cz = _mm256_set1_ps(sphere.center.z);
+            __m256 sphereRadius = _mm256_set1_ps(sphere.radius);
+            __m256 bestDepth = zero;
+            __m256i bestLane = _mm256_set1_epi32(-1);
+            __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+            for (size_t i = 0; i < blocks; i += 8, lane = _mm256_add_epi32(lane, _mm256_set1_epi32(8))) {
+                __m256 ax = _mm256_loadu_ps(&batch.ax[i]), ay = _mm256_loadu_ps(&batch.ay[i]), az = _mm256_loadu_ps(&batch.az[i]);
+                __m256 bax = _mm256_sub_ps(_mm256_loadu_ps(&batch.bx[i]), ax);
+                __m256 bay = _mm256_sub_ps(_mm256_loadu_ps(&batch.by[i]), ay);
+                __m256 baz = _mm256_sub_ps(_mm256_loadu_ps(&batch.bz[i]), az);
+                __m256 pax = _mm256_sub_ps(cx, ax), pay = _mm256_sub_ps(cy, ay), paz = _mm256_sub_ps(cz, az);
+                __m256 baba = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(bax, bax), _mm256_mul_ps(bay, bay)), _mm256_mul_ps(baz, baz));
+                __m256 paba = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(pax, bax), _mm256_mul_ps(pay, bay)), _mm256_mul_ps(paz, baz));
+                __m256 s = _mm256_min_ps(_mm256_max_ps(_mm256_div_ps(paba, _mm256_max_ps(baba, tiny)), zero), one);
+                __m256 ex = _mm256_sub_ps(pax, _mm256_mul_ps(s, bax));
+                __m256 ey = _mm256_sub_ps(pay, _mm256_mul_ps(s, bay));
+                __m256 ez = _mm256_sub_ps(paz, _mm256_mul_ps(s, baz));
+                __m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ex, ex), _mm256_mul_ps(ey, ey)), _mm256_mul_ps(ez, ez));
+                __m256 depth = _mm256_sub_ps(_mm256_add_ps(_mm256_loadu_ps(&batch.radius[i]), sphereRadius), _mm256_sqrt_ps(d2));
+                __m256 deeper = _mm256_cmp_ps(depth, bestDepth, _CMP_GT_OQ);
+                bestDepth = _mm256_blendv_ps(bestDepth, depth, deeper);
+                bestLane = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(bestLane), _mm256_castsi256_ps(lane), deeper));
+            }
+            alignas(32) float values[8];
+            alignas(32) int32_t lanes[8];
+            _mm256_store_ps(values, bestDepth);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), bestLane);
+            float depth = 0.0f;
+            uint32_t best = CAPSULE_NO_HIT;
+            ReduceLanes(values, lanes, 8, depth, best, [](float a, float b) { return a > b; });
+            SphereTail(sphere, batch, blocks, depth, best);
+            hits[q].capsule = best;
+            hits[q].t = best != CAPSULE_NO_HIT ? depth : 0.0f;
+        }
+    }
+#endif
+
+    void RaysRange(const CapsuleBatch& batch, const BvhRay* rays, CapsuleHit* hits, size_t begin, size_t end, SkinningKernel kernel)
+    {
+        switch (kernel) {
+#if defined(CAPSULE_X86)
+        case SkinningKernel::AVX2:
+            RaysAVX2(batch, rays, hits, begin, end);
+            return;
+#endif
+#if defined(CAPSULE_HAS_SSE)
+        case SkinningKernel::SSE:
+            RaysSSE(batch, rays, hits, begin, end);
+            return;
+#endif
+        default:
+            RaysScalar(batch, rays, hits, begin, end);
+            return;
+        }
+    }
+
+    void SpheresRange(const CapsuleBatch& batch, const CollisionSphere* spheres, CapsuleHit* hits, size_t begin, size_t end,
+        SkinningKernel kernel)
+    {
+        switch (kernel) {
+#if defined(CAPSULE_X86)
+        case SkinningKernel::AVX2:
+            SpheresAVX2(batch, spheres, hits, begin, end);
+            return;
+#endif
+#if defined(CAPSULE_HAS_SSE)
+        case SkinningKernel::SSE:
+            SpheresSSE(batch, spheres, hits, begin, end);
+            return;
+#endif
+        default:
+            SpheresScalar(batch, spheres, hits, begin, end);
+            return;
+        }
+    }
+}
+
+void CapsuleBatch::Resize(size_t count)
+{
+    ax.resize(count); ay.resize(count); az.resize(count);
+    bx.resize(count); by.resize(count); bz.resize(count);
+    radius.resize(count);
+    bone.resize(count);
+    character.resize(count);
+}
+
+void BuildBoneCapsules(const std::vector<Vertex>& vertices, const std::vector<VertexInfluences>& extraInfluences,
+    BoneCapsuleSet& out, CapsuleFitStats* stats)
+{
+    out = BoneCapsuleSet();
+
+    // 每个顶点只归入权重最大的骨骼，胶囊之间不会因为关节处的混合顶点而互相膨胀
+    std::vector<std::vector<Float3>> points;
+    std::vector<int> owner(vertices.size(), -1);
+    bool hasExtra = !extraInfluences.empty();
+    for (size_t v = 0; v < vertices.size(); ++v) {
+        float bestWeight = 0.0f;
+        for (int i = 0; i < (hasExtra ? 8 : 4); ++i) {
+            uint32_t bone = i < 4 ? vertices[v].boneIndices[i] : extraInfluences[v].boneIndices[i - 4];
+            float weight = i < 4 ? vertices[v].boneWeights[i] : extraInfluences[v].boneWeights[i - 4];
+            if (weight > bestWeight) {
+                bestWeight = weight;
+                owner[v] = int(bone);
+            }
+        }
+        if (owner[v] < 0)
+            continue;
+        if (size_t(owner[v]) >= points.size())
+            points.resize(owner[v] + 1);
+        points[owner[v]].push_back(vertices[v].position);
+    }
+
+    std::vector<int> capsuleOfBone(points.size(), -1);
+    for (size_t bone = 0; bone < points.size(); ++bone) {
+        if (points[bone].empty())
+            continue;
+        BoneCapsule capsule;
+        capsule.bone = uint32_t(bone);
+        FitCapsule(points[bone], capsule);
+        capsuleOfBone[bone] = int(out.capsules.size());
+        out.capsules.push_back(capsule);
+    }
+
+    if (stats) {
+        *stats = CapsuleFitStats();
+        double gap = 0.0;
+        for (size_t v = 0; v < vertices.size(); ++v) {
+            if (owner[v] < 0)
+                continue;
+            const BoneCapsule& capsule = out.capsules[capsuleOfBone[owner[v]]];
+            gap += (capsule.radius - SegmentDistance(vertices[v].position, capsule.a, capsule.b)) / std::max(capsule.radius, 1e-6f);
+            ++stats->vertices;
+        }
+        stats->meanGap = stats->vertices > 0 ? float(gap / double(stats->vertices)) : 0.0f;
+        for (const BoneCapsule& capsule : out.capsules) {
+            Float3 ab = Sub(capsule.b, capsule.a);
+            float r = capsule.radius;
+            stats->maxRadius = std::max(stats->maxRadius, r);
+            stats->volume += 3.14159265f * r * r * (std::sqrt(Dot(ab, ab)) + 4.0f / 3.0f * r);
+        }
+    }
+}
+
+void TransformBoneCapsules(const BoneCapsuleSet& set, const aiMatrix4x4* palette, const aiMatrix4x4& world,
+    uint32_t character, CapsuleBatch& batch, size_t first)
+{
+    static_assert(sizeof(aiMatrix4x4) == 16 * sizeof(float), "aiMatrix4x4 must be 16 packed floats");
+    TransformCapsules(set, &palette->a1, 16, world, character, batch, first);
+}
+
+void TransformBoneCapsules(const BoneCapsuleSet& set, const BoneMatrix3x4* palette, const aiMatrix4x4& world,
+    uint32_t character, CapsuleBatch& batch, size_t first)
+{
+    TransformCapsules(set, palette->rows[0], 12, world, character, batch, first);
+}
+
+void GatherCrowdCapsules(const BoneCapsuleSet& set, const std::vector<CharacterInstance>& characters,
+    CapsuleBatch& batch, JobSystem* jobs)
+{
+    size_t perCharacter = set.capsules.size();
+    batch.Resize(characters.size() * perCharacter);
+    auto gather = [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c)
+            TransformBoneCapsules(set, characters[c].palette.data(), characters[c].world, uint32_t(c), batch, c * perCharacter);
+    };
+    if (jobs && characters.size() > kCharacterGrain)
+        jobs->ParallelFor(characters.size(), kCharacterGrain, [&](size_t begin, size_t end, int) { gather(begin, end); });
+    else
+        gather(0, characters.size());
+}
+
+void IntersectRaysCapsules(const CapsuleBatch& batch, const BvhRay* rays, size_t rayCount, CapsuleHit* hits,
+    SkinningKernel kernel, JobSystem* jobs)
+{
+    if (!IsSkinningKernelSupported(kernel))
+        kernel = SkinningKernel::Scalar;
+    if (jobs && rayCount > kQueryGrain) {
+        jobs->ParallelFor(rayCount, kQueryGrain, [&](size_t begin, size_t end, int) {
+            RaysRange(batch, rays, hits, begin, end, kernel);
+        });
+    }
+    else {
+        RaysRange(batch, rays, hits, 0, rayCount, kernel);
+    }
+}
+
+void OverlapSpheresCapsules(const CapsuleBatch& batch, const CollisionSphere* spheres, size_t sphereCount, CapsuleHit* hits,
+    SkinningKernel kernel, JobSystem* jobs)
+{
+    if (!IsSkinningKernelSupported(kernel))
+        kernel = SkinningKernel::Scalar;
+    if (jobs && sphereCount > kQueryGrain) {
+        jobs->ParallelFor(sphereCount, kQueryGrain, [&](size_t begin, size_t end, int) {
+            SpheresRange(batch, spheres, hits, begin, end, kernel);
+        });
+    }
+    else {
+        SpheresRange(batch, spheres, hits, 0, sphereCount, kernel);
+    }
+}
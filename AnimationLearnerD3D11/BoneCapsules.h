@@ -0,0 +1,94 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "BonePalette.h"
+#include "Skinning.h"
+#include "SkinnedBvh.h"
+#include "Vertex.h"
+
+class JobSystem;
+struct CharacterInstance;
+
+// 每个骨骼一个碰撞胶囊：加载时对以该骨骼为主导影响（权重最大）的顶点在绑定空间中拟合，
+// 每帧只用调色板变换两个端点，代价与骨骼数成正比。用于不需要精确到三角形的命中判定
+// （精确拾取见 SkinnedBvh.h）。查询把所有角色的胶囊按 SoA 排成一批，SSE / AVX2 一次测 4 / 8 个
+
+// 未命中 / 无重叠时 CapsuleHit::capsule 的值
+#define CAPSULE_NO_HIT 0xffffffffu
+
+// 绑定空间中的线段 [a, b] 加半径；a == b 时退化为球
+struct BoneCapsule
+{
+    uint32_t bone = 0;          // 调色板下标
+    Float3 a;
+    Float3 b;
+    float radius = 0.0f;
+    uint32_t vertexCount = 0;   // 拟合用的顶点数
+};
+
+struct BoneCapsuleSet
+{
+    std::vector<BoneCapsule> capsules;  // 只含至少作为一个顶点主导影响的骨骼，按骨骼下标升序
+};
+
+// 拟合质量（绑定姿态）：所有顶点都在自己的胶囊内，空隙越小越紧
+struct CapsuleFitStats
+{
+    size_t vertices = 0;        // 参与拟合的顶点（有权重的顶点）
+    float meanGap = 0.0f;       // 顶点到胶囊表面距离的平均值 / 半径，0 为全部在表面上
+    float maxRadius = 0.0f;
+    float volume = 0.0f;        // 所有胶囊的体积之和
+};
+
+// 所有角色本帧的胶囊，分量分开连续存放（SoA），SIMD 按 4 / 8 个一组读取
+struct CapsuleBatch
+{
+    std::vector<float> ax, ay, az;
+    std::vector<float> bx, by, bz;
+    std::vector<float> radius;
+    std::vector<uint32_t> bone;
+    std::vector<uint32_t> character;
+
+    size_t Size() const { return radius.size(); }
+    void Resize(size_t count);
+};
+
+// 射线查询与 SkinnedBvh 使用同一个 BvhRay：t 以 direction 的长度为单位
+struct CapsuleHit
+{
+    uint32_t capsule = CAPSULE_NO_HIT;  // CapsuleBatch 中的下标
+    float t = 0.0f;                     // 射线查询：最近的进入距离；球查询：穿透深度
+};
+
+struct CollisionSphere
+{
+    Float3 center;
+    float radius = 0.0f;
+};
+
+// vertices 使用全局骨骼下标（未划分子网格），extraInfluences 为空或一一对应。
+// 轴取顶点的主成分方向，半径为到轴的最大距离，两端再向内收缩到恰好包住所有顶点；没有权重的顶点不参与
+void BuildBoneCapsules(const std::vector<Vertex>& vertices, const std::vector<VertexInfluences>& extraInfluences,
+    BoneCapsuleSet& out, CapsuleFitStats* stats = nullptr);
+
+// 把一个角色的胶囊变换到世界空间（world * palette[bone]），写入 batch 的 [first, first + set.capsules.size())；
+// 半径乘以矩阵线性部分的最大行长度，非均匀缩放时保守
+void TransformBoneCapsules(const BoneCapsuleSet& set, const aiMatrix4x4* palette, const aiMatrix4x4& world,
+    uint32_t character, CapsuleBatch& batch, size_t first);
+
+// 同上，3x4 仿射调色板
+void TransformBoneCapsules(const BoneCapsuleSet& set, const BoneMatrix3x4* palette, const aiMatrix4x4& world,
+    uint32_t character, CapsuleBatch& batch, size_t first);
+
+// 人群中每个角色一段，用各自的 palette 和 world；提供 jobs 时按角色并行
+void GatherCrowdCapsules(const BoneCapsuleSet& set, const std::vector<CharacterInstance>& characters,
+    CapsuleBatch& batch, JobSystem* jobs = nullptr);
+
+// 每条射线取最近的胶囊（射线起点在胶囊内时不算命中该胶囊）。提供 jobs 时按射线分组并行
+void IntersectRaysCapsules(const CapsuleBatch& batch, const BvhRay* rays, size_t rayCount, CapsuleHit* hits,
+    SkinningKernel kernel = BestSkinningKernel(), JobSystem* jobs = nullptr);
+
+// 每个球取穿透最深的胶囊（球心到线段的距离小于两半径之和即重叠）
+void OverlapSpheresCapsules(const CapsuleBatch& batch, const CollisionSphere* spheres, size_t sphereCount, CapsuleHit* hits,
+    SkinningKernel kernel = BestSkinningKernel(), JobSystem* jobs = nullptr);
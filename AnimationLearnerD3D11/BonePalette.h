@@ -0,0 +1,71 @@
+﻿#pragma once
+#include <cstring>
+#include <assimp/types.h>
+
+// 蒙皮调色板格式。蒙皮矩阵的最后一行恒为 (0, 0, 0, 1)，只存前三行即可省下 25% 的内存与上传量
+enum class PaletteFormat
+{
+    Matrix4x4,  // aiMatrix4x4，每骨骼 64 字节
+    Affine3x4,  // BoneMatrix3x4，每骨骼 48 字节
+    DualQuaternion, // BoneDualQuat，每骨骼 32 字节，改用对偶四元数蒙皮（DQS）
+};
+
+// 行主序 3x4 仿射矩阵，即 aiMatrix4x4 的前三行 (a, b, c)。
+// HLSL 中声明为 row_major float3x4，mul(m, float4(p, 1)) 即为蒙皮后的位置
+struct BoneMatrix3x4
+{
+    float rows[3][4] = {
+        { 1.0f, 0.0f, 0.0f, 0.0f },
+        { 0.0f, 1.0f, 0.0f, 0.0f },
+        { 0.0f, 0.0f, 1.0f, 0.0f },
+    };
+};
+
+static_assert(sizeof(BoneMatrix3x4) == 48, "BoneMatrix3x4 must be three float4 registers");
+
+inline void StoreBoneMatrix3x4(const aiMatrix4x4& m, BoneMatrix3x4& out)
+{
+    std::memcpy(out.rows, &m.a1, sizeof(out.rows));
+}
+
+// 单位对偶四元数，表示刚体变换（旋转 + 平移）。分量顺序为 (x, y, z, w)，与 HLSL float4 一致
+struct BoneDualQuat
+{
+    float real[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    float dual[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+};
+
+static_assert(sizeof(BoneDualQuat) == 32, "BoneDualQuat must be two float4 registers");
+
+// 对偶四元数不能表示缩放；骨骼带缩放时另存一份，在绑定空间中先于 DQS 线性混合
+struct BoneScale
+{
+    float scale[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+};
+
+static_assert(sizeof(BoneScale) == 16, "BoneScale must be one float4 register");
+
+// 把蒙皮矩阵分解为 缩放 + 旋转 + 平移；scaleOut 为空时丢弃缩放
+inline void StoreBoneDualQuat(const aiMatrix4x4& m, BoneDualQuat& out, BoneScale* scaleOut)
+{
+    aiVector3D scale, t;
+    aiQuaternion q;
+    m.Decompose(scale, q, t);
+
+    out.real[0] = q.x;
+    out.real[1] = q.y;
+    out.real[2] = q.z;
+    out.real[3] = q.w;
+
+    // dual = 0.5 * (0, t) * q
+    out.dual[0] = 0.5f * (q.w * t.x + t.y * q.z - t.z * q.y);
+    out.dual[1] = 0.5f * (q.w * t.y + t.z * q.x - t.x * q.z);
+    out.dual[2] = 0.5f * (q.w * t.z + t.x * q.y - t.y * q.x);
+    out.dual[3] = -0.5f * (t.x * q.x + t.y * q.y + t.z * q.z);
+
+    if (scaleOut) {
+        scaleOut->scale[0] = scale.x;
+        scaleOut->scale[1] = scale.y;
+        scaleOut->scale[2] = scale.z;
+    }
+}
@@ -0,0 +1,35 @@
+﻿#pragma once
+#include <vector>
+#include "Skeleton.h"
+#include "JobSystem.h"
+#include "SkinnedBounds.h"
+
+// 人群中的一个角色实例：共享骨架与动画，各自的播放时间和蒙皮调色板
+struct CharacterInstance
+{
+    float animTime = 0.0f;
+    float playRate = 1.0f;
+    float blendFromTime = 0.0f;   // 过渡源的片段时间
+    float blendWeight = 0.0f;     // 过渡源权重，0 表示不混合
+    std::vector<aiMatrix4x4> palette;
+    aiMatrix4x4 world;            // 角色的世界变换
+    SkinnedBounds bounds;         // 本帧的世界空间包围盒 / 包围球，只在调用方提供 BoneBoundsSet 时更新，否则保持原值
+};
+
+// 每个 worker 独占的临时内存，热路径上不分配、不加锁
+struct AnimationScratch
+{
+    std::vector<aiMatrix4x4> globals;
+};
+
+// 创建 count 个角色，播放进度和过渡状态错开
+void InitCrowd(const Skeleton& skeleton, float animDuration, size_t count, std::vector<CharacterInstance>& characters);
+
+// 单个角色：采样 + 混合 + 层级合成 + 调色板；boneBounds 非空时再由调色板求包围体
+void UpdateCharacter(const Skeleton& skeleton, CharacterInstance& character, AnimationScratch& scratch,
+    const BoneBoundsSet* boneBounds = nullptr);
+
+// 推进时间并用 JobSystem 的 ParallelFor 并行更新所有角色；workerScratch 按 worker 下标索引
+void UpdateCrowd(const Skeleton& skeleton, float animDuration, float deltaTicks,
+    std::vector<CharacterInstance>& characters, JobSystem& jobs, std::vector<AnimationScratch>& workerScratch,
+    const BoneBoundsSet* boneBounds = nullptr);
@@ -0,0 +1,262 @@
+﻿#include "Influences.h"
+#include <algorithm>
+#include <cmath>
+#include "Skinning.h"
+
+namespace
+{
+    // 按权重降序，同权重按骨骼下标升序，保证结果与 aiBone 的遍历顺序无关
+    void SortInfluences(std::vector<BoneInfluence>& sorted)
+    {
+        std::sort(sorted.begin(), sorted.end(), [](const BoneInfluence& a, const BoneInfluence& b) {
+            return a.weight != b.weight ? a.weight > b.weight : a.bone < b.bone;
+        });
+    }
+
+    // 排序后保留前 keep 个时丢弃的权重占总权重的比例
+    float DroppedWeight(const std::vector<BoneInfluence>& sorted, int keep)
+    {
+        float total = 0.0f, dropped = 0.0f;
+        for (size_t i = 0; i < sorted.size(); ++i) {
+            total += sorted[i].weight;
+            if (int(i) >= keep)
+                dropped += sorted[i].weight;
+        }
+        return total > 0.0f ? dropped / total : 0.0f;
+    }
+}
+
+int ChooseInfluenceCount(const std::vector<std::vector<BoneInfluence>>& influences, float tolerance)
+{
+    std::vector<BoneInfluence> sorted;
+    for (const std::vector<BoneInfluence>& vertexInfluences : influences) {
+        if (vertexInfluences.size() <= 4)
+            continue;
+        sorted = vertexInfluences;
+        SortInfluences(sorted);
+        if (DroppedWeight(sorted, 4) > tolerance)
+            return 8;
+    }
+    return 4;
+}
+
+void ApplyInfluences(const std::vector<std::vector<BoneInfluence>>& influences, int influenceCount,
+    std::vector<Vertex>& vertices, std::vector<VertexInfluences>& extra, InfluenceStats& stats)
+{
+    stats = InfluenceStats();
+    stats.influenceCount = influenceCount;
+    extra.clear();
+    if (influenceCount > 4)
+        extra.resize(vertices.size());
+
+    double droppedSum = 0.0;
+    std::vector<BoneInfluence> sorted;
+    for (size_t v = 0; v < vertices.size(); ++v) {
+        sorted.clear();
+        if (v < influences.size())
+            for (const BoneInfluence& influence : influences[v])
+                if (influence.weight > 0.0f)
+                    sorted.push_back(influence);
+        SortInfluences(sorted);
+
+        stats.maxSourceInfluences = std::max(stats.maxSourceInfluences, int(sorted.size()));
+        if (sorted.empty())
+            ++stats.unweightedVertices;
+        if (int(sorted.size()) > influenceCount) {
+            float dropped = DroppedWeight(sorted, influenceCount);
+            ++stats.prunedVertices;
+            droppedSum += dropped;
+            stats.maxDroppedWeight = std::max(stats.maxDroppedWeight, dropped);
+            sorted.resize(influenceCount);
+        }
+
+        float total = 0.0f;
+        for (const BoneInfluence& influence : sorted)
+            total += influence.weight;
+
+        Vertex& vert = vertices[v];
+        for (int i = 0; i < 4; ++i) {
+            vert.boneIndices[i] = 0;
+            vert.boneWeights[i] = 0.0f;
+        }
+        for (size_t i = 0; i < sorted.size(); ++i) {
+            uint32_t bone = sorted[i].bone;
+            float weight = sorted[i].weight / total;
+            if (i < 4) {
+                vert.boneIndices[i] = bone;
+                vert.boneWeights[i] = weight;
+            }
+            else {
+                extra[v].boneIndices[i - 4] = bone;
+                extra[v].boneWeights[i - 4] = weight;
+            }
+        }
+    }
+
+    if (stats.prunedVertices > 0)
+        stats.meanDroppedWeight = float(droppedSum / double(stats.prunedVertices));
+}
+
+float MeasurePruningError(const std::vector<std::vector<BoneInfluence>>& influences,
+    const std::vector<Vertex>& vertices, const std::vector<VertexInfluences>& extra, const aiMatrix4x4* palette)
+{
+    std::vector<Float3> positions(vertices.size()), normals(vertices.size());
+    SkinVertices(vertices.data(), vertices.size(), palette, positions.data(), normals.data(), SkinningKernel::Scalar,
+        extra.empty() ? nullptr : extra.data());
+
+    float maxError = 0.0f;
+    for (size_t v = 0; v < vertices.size() && v < influences.size(); ++v) {
+        float total = 0.0f;
+        for (const BoneInfluence& influence : influences[v])
+            total += std::max(influence.weight, 0.0f);
+        if (total <= 0.0f)
+            continue;
+
+        // 全部影响，与 SkinVertices 标量版本相同的逐骨骼变换再加权
+        const Float3& p = vertices[v].position;
+        aiVector3D reference(0.0f, 0.0f, 0.0f);
+        for (const BoneInfluence& influence : influences[v]) {
+            if (influence.weight <= 0.0f)
+                continue;
+            reference += (palette[influence.bone] * aiVector3D(p.x, p.y, p.z)) * (influence.weight / total);
+        }
+
+        float dx = reference.x - positions[v].x;
+        float dy = reference.y - positions[v].y;
+        float dz = reference.z - positions[v].z;
+        maxError = std::max(maxError, std::sqrt(dx * dx + dy * dy + dz * dz));
+    }
+    return maxError;
+}
+
+int CountInfluences(const Vertex& vertex, const VertexInfluences* extra)
+{
+    int count = 0;
+    while (count < 4 && vertex.boneWeights[count] != 0.0f)
+        ++count;
+    if (count == 4 && extra)
+        while (count < 8 && extra->boneWeights[count - 4] != 0.0f)
+            ++count;
+    return std::max(count, 1);
+}
+
+void FindRigidVertices(const std::vector<Vertex>& vertices, const std::vector<VertexInfluences>& extra,
+    const std::vector<uint32_t>& indices, std::vector<int>& rigidBone)
+{
+    bool hasExtra = !extra.empty();
+    size_t vertexCount = vertices.size();
+
+    // 并查集：按三角形把顶点合并成连通组
+    std::vector<uint32_t> parent(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        parent[v] = uint32_t(v);
+    auto find = [&](uint32_t v) {
+        while (parent[v] != v) {
+            parent[v] = parent[parent[v]];
+            v = parent[v];
+        }
+        return v;
+    };
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        uint32_t a = find(indices[i]);
+        for (int corner = 1; corner < 3; ++corner) {
+            uint32_t b = find(indices[i + corner]);
+            if (a != b)
+                parent[b] = a;
+        }
+    }
+
+    // 每个组的骨骼：-1 未定，-2 组内有多影响顶点或骨骼不一致
+    std::vector<int> groupBone(vertexCount, -1);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        uint32_t root = find(uint32_t(v));
+        const Vertex& vert = vertices[v];
+        bool single = vert.boneWeights[0] != 0.0f && CountInfluences(vert, hasExtra ? &extra[v] : nullptr) == 1;
+        int bone = single ? int(vert.boneIndices[0]) : -2;
+        if (groupBone[root] == -1)
+            groupBone[root] = bone;
+        else if (groupBone[root] != bone)
+            groupBone[root] = -2;
+    }
+
+    rigidBone.resize(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        int bone = groupBone[find(uint32_t(v))];
+        rigidBone[v] = bone >= 0 ? bone : -1;
+    }
+}
+
+void SortVerticesByInfluenceCount(std::vector<Vertex>& vertices, std::vector<VertexInfluences>& extra,
+    std::vector<uint32_t>& indices, bool rigidSegments, std::vector<InfluenceBucket>& buckets,
+    std::vector<uint32_t>* vertexRemap)
+{
+    buckets.clear();
+    bool hasExtra = !extra.empty();
+
+    // 排序键：刚性段按骨骼在前（0 .. boneCount - 1），其余按影响数桶（boneCount + 桶下标）
+    std::vector<int> rigidBone;
+    int boneCount = 0;
+    if (rigidSegments) {
+        FindRigidVertices(vertices, extra, indices, rigidBone);
+        for (int bone : rigidBone)
+            boneCount = std::max(boneCount, bone + 1);
+    }
+    size_t keyCount = size_t(boneCount) + INFLUENCE_BUCKET_COUNT;
+
+    // 计数排序：桶内保持原有顺序，尽量不破坏顶点的访存局部性
+    std::vector<size_t> keyStart(keyCount + 1, 0);
+    std::vector<uint32_t> keyOf(vertices.size());
+    for (size_t v = 0; v < vertices.size(); ++v) {
+        if (rigidSegments && rigidBone[v] >= 0)
+            keyOf[v] = uint32_t(rigidBone[v]);
+        else
+            keyOf[v] = uint32_t(boneCount + InfluenceBucketIndex(CountInfluences(vertices[v], hasExtra ? &extra[v] : nullptr)));
+        ++keyStart[keyOf[v] + 1];
+    }
+    for (size_t k = 0; k < keyCount; ++k)
+        keyStart[k + 1] += keyStart[k];
+
+    std::vector<uint32_t> remap(vertices.size());
+    std::vector<Vertex> sortedVertices(vertices.size());
+    std::vector<VertexInfluences> sortedExtra(extra.size());
+    std::vector<size_t> next(keyStart.begin(), keyStart.end() - 1);
+    for (size_t v = 0; v < vertices.size(); ++v) {
+        size_t target = next[keyOf[v]]++;
+        remap[v] = uint32_t(target);
+        sortedVertices[target] = vertices[v];
+        if (hasExtra)
+            sortedExtra[target] = extra[v];
+    }
+    vertices.swap(sortedVertices);
+    extra.swap(sortedExtra);
+    for (uint32_t& index : indices)
+        index = remap[index];
+    if (vertexRemap)
+        vertexRemap->swap(remap);
+
+    for (size_t k = 0; k < keyCount; ++k) {
+        if (keyStart[k + 1] == keyStart[k])
+            continue;
+        InfluenceBucket bucket;
+        bucket.vertexStart = uint32_t(keyStart[k]);
+        bucket.vertexCount = uint32_t(keyStart[k + 1] - keyStart[k]);
+        if (int(k) < boneCount) {
+            bucket.influences = 0;
+            bucket.rigidBone = int(k);
+        }
+        else {
+            bucket.influences = InfluenceBucketSize(int(k) - boneCount);
+        }
+        buckets.push_back(bucket);
+    }
+}
+
+float AverageBucketInfluences(const std::vector<InfluenceBucket>& buckets)
+{
+    double work = 0.0, vertexCount = 0.0;
+    for (const InfluenceBucket& bucket : buckets) {
+        work += double(bucket.vertexCount) * bucket.influences;
+        vertexCount += bucket.vertexCount;
+    }
+    return vertexCount > 0.0 ? float(work / vertexCount) : 0.0f;
+}
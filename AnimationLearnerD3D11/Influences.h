@@ -0,0 +1,83 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <assimp/matrix4x4.h>
+#include "Vertex.h"
+
+// 加载时的骨骼影响处理：从 aiBone 收集每个顶点的全部 (骨骼, 权重)，保留权重最大的 N 个并重新归一化。
+// N 按资源选择：4 个影响足够时只用 Vertex 自带的 4 个槽位，否则增加 VertexInfluences 顶点流扩展到 8 个
+
+struct BoneInfluence
+{
+    uint32_t bone;
+    float weight;
+};
+
+// 单个顶点丢弃的权重（占总权重的比例）超过该值时，资源改用 8 个影响
+#define INFLUENCE_PRUNE_TOLERANCE 0.01f
+
+struct InfluenceStats
+{
+    int influenceCount = 4;          // 采用的每顶点影响数
+    int maxSourceInfluences = 0;     // 源数据中单个顶点的最多影响数
+    size_t unweightedVertices = 0;   // 没有任何骨骼影响的顶点
+    size_t prunedVertices = 0;       // 影响数超过 influenceCount、被裁剪的顶点
+    float maxDroppedWeight = 0.0f;   // 被裁剪顶点丢弃的权重比例，最大值
+    float meanDroppedWeight = 0.0f;  // 同上，平均值（只统计被裁剪的顶点）
+};
+
+// 裁剪到 4 个影响时，若有顶点丢弃的权重比例超过 tolerance 返回 8，否则返回 4
+int ChooseInfluenceCount(const std::vector<std::vector<BoneInfluence>>& influences,
+    float tolerance = INFLUENCE_PRUNE_TOLERANCE);
+
+// 每个顶点按权重降序（同权重按骨骼下标）取前 influenceCount 个，归一化到和为 1 后写入 vertices；
+// influenceCount 为 8 时第 5~8 个写入 extra（大小与 vertices 相同），为 4 时清空 extra
+void ApplyInfluences(const std::vector<std::vector<BoneInfluence>>& influences, int influenceCount,
+    std::vector<Vertex>& vertices, std::vector<VertexInfluences>& extra, InfluenceStats& stats);
+
+// 用未裁剪的全部影响（归一化）与裁剪后的影响分别蒙皮，返回顶点位置的最大距离（模型单位）
+float MeasurePruningError(const std::vector<std::vector<BoneInfluence>>& influences,
+    const std::vector<Vertex>& vertices, const std::vector<VertexInfluences>& extra, const aiMatrix4x4* palette);
+
+// 影响数分桶：1、2、3、4 个影响各一桶，5~8 个影响合为一桶按 8 个处理。
+// 每桶使用循环次数固定的蒙皮实现（CPU 模板特化 / 着色器 MAX_INFLUENCES 变体）
+#define INFLUENCE_BUCKET_COUNT 5
+
+inline int InfluenceBucketIndex(int influences)
+{
+    return influences <= 4 ? (influences > 0 ? influences - 1 : 0) : 4;
+}
+
+// 该桶的蒙皮实现处理的影响数
+inline int InfluenceBucketSize(int bucket)
+{
+    return bucket < 4 ? bucket + 1 : 8;
+}
+
+// 顶点实际使用的影响数（ApplyInfluences 之后权重降序，遇到 0 即结束）；没有影响的顶点算 1 个
+int CountInfluences(const Vertex& vertex, const VertexInfluences* extra);
+
+// 按影响数排好序的一段连续顶点
+struct InfluenceBucket
+{
+    uint32_t vertexStart = 0;
+    uint32_t vertexCount = 0;
+    int influences = 4;     // 该段顶点用 InfluenceBucketSize 个影响蒙皮；0 表示刚性段
+    int rigidBone = -1;     // 刚性段的骨骼：段内顶点都以权重 1 绑定在它上面，整段只用这一个矩阵
+};
+
+// 刚性段检测：按三角形连通的顶点组中，所有顶点都只受同一个骨骼影响的组（装甲、机械部件等）。
+// 输出每个顶点所属刚性段的骨骼，不属于刚性段为 -1
+void FindRigidVertices(const std::vector<Vertex>& vertices, const std::vector<VertexInfluences>& extra,
+    const std::vector<uint32_t>& indices, std::vector<int>& rigidBone);
+
+// 把顶点按影响数桶稳定排序（extra 同步重排，indices 重映射），输出非空的桶。
+// rigidSegments 为 true 时刚性段的顶点按骨骼排在最前面，每个骨骼一个 influences 为 0 的桶。
+// vertexRemap 非空时输出原顶点 -> 新顶点的映射，供其他按顶点存放的数据（如变形目标）跟随
+void SortVerticesByInfluenceCount(std::vector<Vertex>& vertices, std::vector<VertexInfluences>& extra,
+    std::vector<uint32_t>& indices, bool rigidSegments, std::vector<InfluenceBucket>& buckets,
+    std::vector<uint32_t>* vertexRemap = nullptr);
+
+// 分桶后每个顶点平均执行的影响循环次数（刚性段为 0），与固定 influenceCount 次相比即节省的工作量
+float AverageBucketInfluences(const std::vector<InfluenceBucket>& buckets);
@@ -0,0 +1,190 @@
+﻿#include "JobSystem.h"
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+    // 当前线程的 worker 下标，-1 表示不在 ParallelFor 中
+    thread_local int t_workerIndex = -1;
+
+    uint64_t PackRange(size_t begin, size_t end)
+    {
+        return (uint64_t(end) << 32) | uint64_t(begin);
+    }
+
+    void UnpackRange(uint64_t job, size_t& begin, size_t& end)
+    {
+        begin = size_t(job & 0xffffffffu);
+        end = size_t(job >> 32);
+    }
+}
+
+void WorkStealingDeque::Push(uint64_t job)
+{
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    assert(b - top_.load(std::memory_order_acquire) < kCapacity);
+    buffer_[b & (kCapacity - 1)].store(job, std::memory_order_relaxed);
+    bottom_.store(b + 1, std::memory_order_release);
+}
+
+bool WorkStealingDeque::Pop(uint64_t& job)
+{
+    int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+
+    if (t > b) {
+        // 队列为空
+        bottom_.store(b + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    job = buffer_[b & (kCapacity - 1)].load(std::memory_order_relaxed);
+    if (t == b) {
+        // 只剩最后一个，与窃取者竞争
+        bool won = top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+        return won;
+    }
+    return true;
+}
+
+bool WorkStealingDeque::Steal(uint64_t& job)
+{
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t >= b)
+        return false;
+
+    job = buffer_[t & (kCapacity - 1)].load(std::memory_order_relaxed);
+    return top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+JobSystem::JobSystem(unsigned int workerCount)
+{
+    if (workerCount == 0)
+        workerCount = std::max(1u, std::thread::hardware_concurrency());
+
+    for (unsigned int i = 0; i < workerCount; ++i)
+        deques_.push_back(std::unique_ptr<WorkStealingDeque>(new WorkStealingDeque()));
+
+    // 0 号 worker 是调用 ParallelFor 的线程
+    for (unsigned int i = 1; i < workerCount; ++i)
+        threads_.emplace_back(&JobSystem::WorkerMain, this, int(i));
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_.store(true);
+        ++generation_;
+    }
+    wake_.notify_all();
+    for (std::thread& thread : threads_)
+        thread.join();
+}
+
+void JobSystem::Dispatch(size_t count, size_t grain, JobFunc func, void* data)
+{
+    if (count == 0)
+        return;
+
+    // 单线程或嵌套调用：直接在当前线程执行
+    if (threads_.empty() || t_workerIndex >= 0) {
+        func(data, 0, count, std::max(t_workerIndex, 0));
+        return;
+    }
+
+    assert(count <= 0xffffffffu);
+
+    ParallelForContext ctx;
+    ctx.func = func;
+    ctx.data = data;
+    ctx.grain = std::max<size_t>(grain, 1);
+    ctx.remaining.store(count, std::memory_order_relaxed);
+
+    active_.store(&ctx, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++generation_;
+    }
+    wake_.notify_all();
+
+    // 调用线程作为 0 号 worker 参与，直到所有区间完成
+    t_workerIndex = 0;
+    uint32_t rng = 0x9e3779b9u;
+    deques_[0]->Push(PackRange(0, count));
+    while (ctx.remaining.load(std::memory_order_acquire) > 0) {
+        uint64_t job;
+        if (FindJob(0, job, rng))
+            Execute(&ctx, job, 0);
+        else
+            std::this_thread::yield();
+    }
+    t_workerIndex = -1;
+
+    active_.store(nullptr, std::memory_order_release);
+}
+
+void JobSystem::WorkerMain(int worker)
+{
+    t_workerIndex = worker;
+    uint32_t rng = 0x9e3779b9u * uint32_t(worker + 1);
+    uint64_t seenGeneration = 0;
+
+    while (!quit_.load(std::memory_order_acquire)) {
+        if (active_.load(std::memory_order_acquire)) {
+            // 拿到任务后重新读取 active_：任务未完成前它所属的 ParallelFor 不会结束，
+            // 而先前读到的指针可能已属于上一次派发
+            uint64_t job;
+            if (FindJob(worker, job, rng))
+                Execute(active_.load(std::memory_order_acquire), job, worker);
+            else
+                std::this_thread::yield();
+            continue;
+        }
+
+        // 没有进行中的 ParallelFor，睡眠直到下一次派发
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [&] { return quit_.load() || generation_ != seenGeneration; });
+        seenGeneration = generation_;
+    }
+}
+
+bool JobSystem::FindJob(int worker, uint64_t& job, uint32_t& rng)
+{
+    if (deques_[worker]->Pop(job))
+        return true;
+
+    // 从随机位置开始轮询其他 worker 进行窃取
+    int count = int(deques_.size());
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    int start = int(rng % uint32_t(count));
+    for (int i = 0; i < count; ++i) {
+        int victim = (start + i) % count;
+        if (victim != worker && deques_[victim]->Steal(job))
+            return true;
+    }
+    return false;
+}
+
+void JobSystem::Execute(ParallelForContext* ctx, uint64_t job, int worker)
+{
+    size_t begin, end;
+    UnpackRange(job, begin, end);
+
+    // 大区间对半拆分，后半段放回自己的队列供其他 worker 窃取
+    while (end - begin > ctx->grain) {
+        size_t mid = begin + (end - begin) / 2;
+        deques_[worker]->Push(PackRange(mid, end));
+        end = mid;
+    }
+
+    ctx->func(ctx->data, begin, end, worker);
+    ctx->remaining.fetch_sub(end - begin, std::memory_order_acq_rel);
+}
@@ -0,0 +1,81 @@
+﻿#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Chase-Lev 工作窃取双端队列：所有者在底部 push/pop，其他线程从顶部 steal，全程无锁。
+// 元素是打包成 64 位的 [begin, end) 区间，容量固定（二分拆分使深度只有 O(log n)）。
+class WorkStealingDeque
+{
+public:
+    static const int kCapacity = 256;
+
+    void Push(uint64_t job);
+    bool Pop(uint64_t& job);
+    bool Steal(uint64_t& job);
+
+private:
+    std::atomic<int64_t> top_{ 0 };
+    char padding0_[64 - sizeof(std::atomic<int64_t>)];
+    std::atomic<int64_t> bottom_{ 0 };
+    char padding1_[64 - sizeof(std::atomic<int64_t>)];
+    std::atomic<uint64_t> buffer_[kCapacity];
+};
+
+// 工作窃取线程池。调用 ParallelFor 的线程作为 0 号 worker 一起干活，
+// 每个 worker 一个双端队列，区间按 grain 二分拆分后由空闲 worker 窃取。
+// 同一时刻只支持一个 ParallelFor；在 worker 内部嵌套调用会直接串行执行。
+class JobSystem
+{
+public:
+    // workerCount 包含调用线程，0 表示使用全部硬件线程
+    explicit JobSystem(unsigned int workerCount = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    int WorkerCount() const { return int(deques_.size()); }
+
+    // func(begin, end, workerIndex) 处理 [begin, end)；workerIndex 可用于索引每个 worker 的临时内存
+    template<typename Func>
+    void ParallelFor(size_t count, size_t grain, Func&& func)
+    {
+        using FuncType = typename std::remove_reference<Func>::type;
+        Dispatch(count, grain, [](void* data, size_t begin, size_t end, int worker) {
+            (*static_cast<FuncType*>(data))(begin, end, worker);
+        }, &func);
+    }
+
+private:
+    typedef void (*JobFunc)(void* data, size_t begin, size_t end, int worker);
+
+    struct ParallelForContext
+    {
+        JobFunc func;
+        void* data;
+        size_t grain;
+        std::atomic<size_t> remaining;
+    };
+
+    void Dispatch(size_t count, size_t grain, JobFunc func, void* data);
+    void WorkerMain(int worker);
+    bool FindJob(int worker, uint64_t& job, uint32_t& rng);
+    void Execute(ParallelForContext* ctx, uint64_t job, int worker);
+
+    std::vector<std::unique_ptr<WorkStealingDeque>> deques_;
+    std::vector<std::thread> threads_;
+
+    std::atomic<ParallelForContext*> active_{ nullptr };
+    std::atomic<bool> quit_{ false };
+
+    // 只用于唤醒空闲线程，不在任务执行路径上
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    uint64_t generation_ = 0;
+};
@@ -0,0 +1,462 @@
+﻿#include "MeshLod.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+
+namespace
+{
+    // 对称矩阵 A、向量 b、常数 c 表示的二次型 p^T A p + 2 b·p + c，即到一组平面的面积加权距离平方和；w 为总面积
+    struct Quadric
+    {
+        double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+        double b0 = 0, b1 = 0, b2 = 0;
+        double c = 0;
+        double w = 0;
+    };
+
+    void AddQuadric(Quadric& q, const Quadric& r)
+    {
+        q.a00 += r.a00; q.a01 += r.a01; q.a02 += r.a02;
+        q.a11 += r.a11; q.a12 += r.a12; q.a22 += r.a22;
+        q.b0 += r.b0; q.b1 += r.b1; q.b2 += r.b2;
+        q.c += r.c;
+        q.w += r.w;
+    }
+
+    Float3 Sub(const Float3& a, const Float3& b)
+    {
+        return { a.x - b.x, a.y - b.y, a.z - b.z };
+    }
+
+    Float3 Cross(const Float3& a, const Float3& b)
+    {
+        return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+    }
+
+    float Dot(const Float3& a, const Float3& b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    // 三角形所在平面的二次型，按面积加权
+    Quadric TriangleQuadric(const Float3& p0, const Float3& p1, const Float3& p2)
+    {
+        Quadric q;
+        Float3 n = Cross(Sub(p1, p0), Sub(p2, p0));
+        double length = std::sqrt(double(Dot(n, n)));
+        if (length <= 0.0)
+            return q;
+        double nx = n.x / length, ny = n.y / length, nz = n.z / length;
+        double d = -(nx * p0.x + ny * p0.y + nz * p0.z);
+        double area = length * 0.5;
+        q.a00 = area * nx * nx; q.a01 = area * nx * ny; q.a02 = area * nx * nz;
+        q.a11 = area * ny * ny; q.a12 = area * ny * nz; q.a22 = area * nz * nz;
+        q.b0 = area * nx * d; q.b1 = area * ny * d; q.b2 = area * nz * d;
+        q.c = area * d * d;
+        q.w = area;
+        return q;
+    }
+
+    // 把顶点移到 p 的误差：加权平均距离平方
+    double QuadricError(const Quadric& q, const Float3& p)
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double e = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z
+            + 2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z)
+            + 2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) + q.c;
+        return q.w > 0.0 ? std::max(e, 0.0) / q.w : 0.0;
+    }
+
+    // 每个顶点归一化、按骨骼下标排序的影响，扁平存放
+    struct InfluenceTable
+    {
+        std::vector<uint32_t> offsets;
+        std::vector<BoneInfluence> data;
+    };
+
+    void BuildInfluenceTable(const std::vector<BoneInfluence>* influences, size_t vertexCount, InfluenceTable& table)
+    {
+        table.offsets.assign(vertexCount + 1, 0);
+        table.data.clear();
+        for (size_t v = 0; v < vertexCount; ++v) {
+            size_t begin = table.data.size();
+            float total = 0.0f;
+            for (const BoneInfluence& influence : influences[v]) {
+                if (influence.weight > 0.0f) {
+                    table.data.push_back(influence);
+                    total += influence.weight;
+                }
+            }
+            for (size_t i = begin; i < table.data.size(); ++i)
+                table.data[i].weight /= total;
+            std::sort(table.data.begin() + begin, table.data.end(),
+                [](const BoneInfluence& a, const BoneInfluence& b) { return a.bone < b.bone; });
+            table.offsets[v + 1] = uint32_t(table.data.size());
+        }
+    }
+
+    float InfluenceDistance(const InfluenceTable& table, uint32_t a, uint32_t b)
+    {
+        const BoneInfluence* ia = table.data.data() + table.offsets[a];
+        const BoneInfluence* ea = table.data.data() + table.offsets[a + 1];
+        const BoneInfluence* ib = table.data.data() + table.offsets[b];
+        const BoneInfluence* eb = table.data.data() + table.offsets[b + 1];
+        float sum = 0.0f;
+        while (ia != ea || ib != eb) {
+            if (ib == eb || (ia != ea && ia->bone < ib->bone))
+                sum += (ia++)->weight;
+            else if (ia == ea || ib->bone < ia->bone)
+                sum += (ib++)->weight;
+            else
+                sum += std::fabs((ia++)->weight - (ib++)->weight);
+        }
+        return sum * 0.5f;
+    }
+
+    // 位置相同的顶点编为同一个位置号；一个位置上有多个顶点（UV / 法线接缝）时在 seam 中标记这些顶点
+    void WeldPositions(const Vertex* vertices, size_t vertexCount, std::vector<uint32_t>& positionId,
+        std::vector<unsigned char>& seam)
+    {
+        std::vector<uint32_t> order(vertexCount);
+        std::iota(order.begin(), order.end(), 0u);
+        auto less = [&](uint32_t a, uint32_t b) {
+            const Float3& p = vertices[a].position;
+            const Float3& q = vertices[b].position;
+            if (p.x != q.x) return p.x < q.x;
+            if (p.y != q.y) return p.y < q.y;
+            if (p.z != q.z) return p.z < q.z;
+            return a < b;
+        };
+        std::sort(order.begin(), order.end(), less);
+
+        positionId.assign(vertexCount, 0);
+        seam.assign(vertexCount, 0);
+        size_t groupStart = 0;
+        for (size_t i = 1; i <= vertexCount; ++i) {
+            if (i < vertexCount) {
+                const Float3& p = vertices[order[i]].position;
+                const Float3& q = vertices[order[groupStart]].position;
+                if (p.x == q.x && p.y == q.y && p.z == q.z)
+                    continue;
+            }
+            for (size_t k = groupStart; k < i; ++k) {
+                positionId[order[k]] = order[groupStart];
+                seam[order[k]] = i - groupStart > 1;
+            }
+            groupStart = i;
+        }
+    }
+
+    // 开放边界（只被一个三角形使用的边）与非流形边（被三个以上三角形使用）的端点，按位置号判断
+    void MarkBorderVertices(const uint32_t* indices, size_t indexCount, const std::vector<uint32_t>& positionId,
+        std::vector<unsigned char>& locked)
+    {
+        std::vector<uint64_t> edges;
+        edges.reserve(indexCount);
+        for (size_t i = 0; i < indexCount; i += 3) {
+            for (int k = 0; k < 3; ++k) {
+                uint32_t a = positionId[indices[i + k]];
+                uint32_t b = positionId[indices[i + (k + 1) % 3]];
+                edges.push_back((uint64_t(std::min(a, b)) << 32) | std::max(a, b));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+
+        std::vector<unsigned char> borderPosition(positionId.size(), 0);
+        for (size_t i = 0; i < edges.size();) {
+            size_t j = i;
+            while (j < edges.size() && edges[j] == edges[i])
+                ++j;
+            if (j - i != 2) {
+                borderPosition[uint32_t(edges[i] >> 32)] = 1;
+                borderPosition[uint32_t(edges[i] & 0xffffffffu)] = 1;
+            }
+            i = j;
+        }
+        for (size_t v = 0; v < positionId.size(); ++v)
+            if (borderPosition[positionId[v]])
+                locked[v] = 1;
+    }
+
+    // 顶点 -> 相邻三角形（CSR）
+    void BuildAdjacency(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+        std::vector<uint32_t>& offsets, std::vector<uint32_t>& triangles)
+    {
+        offsets.assign(vertexCount + 1, 0);
+        for (size_t i = 0; i < indexCount; ++i)
+            ++offsets[indices[i] + 1];
+        for (size_t v = 0; v < vertexCount; ++v)
+            offsets[v + 1] += offsets[v];
+        triangles.resize(indexCount);
+        std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indexCount; ++i)
+            triangles[cursor[indices[i]]++] = uint32_t(i / 3);
+    }
+
+    struct Collapse
+    {
+        double cost;
+        uint32_t from;
+        uint32_t to;
+    };
+}
+
+size_t SimplifySkinnedMesh(const Vertex* vertices, const std::vector<BoneInfluence>* influences, size_t vertexCount,
+    const uint32_t* indices, size_t indexCount, size_t targetIndexCount, const SimplifyOptions& options,
+    uint32_t* out, SimplifyStats* stats)
+{
+    SimplifyStats localStats;
+    SimplifyStats& result = stats ? *stats : localStats;
+    result = SimplifyStats();
+
+    // 去掉退化三角形
+    size_t count = 0;
+    for (size_t i = 0; i + 2 < indexCount; i += 3) {
+        uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        if (a == b || b == c || a == c)
+            continue;
+        out[count++] = a;
+        out[count++] = b;
+        out[count++] = c;
+    }
+    if (count <= targetIndexCount || vertexCount == 0)
+        return count;
+
+    // 接缝和边界上的顶点不动：接缝两侧的顶点各自折叠会把 UV 撕开，边界顶点折叠会使轮廓收缩
+    std::vector<uint32_t> positionId;
+    std::vector<unsigned char> locked;
+    WeldPositions(vertices, vertexCount, positionId, locked);
+    MarkBorderVertices(out, count, positionId, locked);
+    result.lockedVertices = size_t(std::count(locked.begin(), locked.end(), 1));
+
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < count; i += 3) {
+        Quadric q = TriangleQuadric(vertices[out[i]].position, vertices[out[i + 1]].position, vertices[out[i + 2]].position);
+        for (int k = 0; k < 3; ++k)
+            AddQuadric(quadrics[out[i + k]], q);
+    }
+
+    InfluenceTable influenceTable;
+    if (influences)
+        BuildInfluenceTable(influences, vertexCount, influenceTable);
+
+    std::vector<uint32_t> offsets, triangles;
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> collapseTo(vertexCount);
+    std::vector<unsigned char> touched(vertexCount);
+    double maxErrorSq = double(options.maxError) * double(options.maxError);
+
+    // 每一轮为每个可移动顶点选代价最小的相邻目标，按代价从小到大执行互不相邻的折叠，然后重写索引
+    while (count > targetIndexCount) {
+        BuildAdjacency(out, count, vertexCount, offsets, triangles);
+
+        collapses.clear();
+        for (uint32_t u = 0; u < vertexCount; ++u) {
+            if (locked[u] || offsets[u] == offsets[u + 1])
+                continue;
+            double bestCost = DBL_MAX;
+            uint32_t best = u;
+            for (uint32_t t = offsets[u]; t < offsets[u + 1]; ++t) {
+                const uint32_t* tri = &out[triangles[t] * 3];
+                for (int k = 0; k < 3; ++k) {
+                    uint32_t v = tri[k];
+                    if (v == u)
+                        continue;
+                    if (influences && InfluenceDistance(influenceTable, u, v) > options.maxInfluenceDistance) {
+                        ++result.rejectedInfluence;
+                        continue;
+                    }
+                    double cost = QuadricError(quadrics[u], vertices[v].position);
+                    if (cost < bestCost || (cost == bestCost && v < best)) {
+                        bestCost = cost;
+                        best = v;
+                    }
+                }
+            }
+            if (best != u)
+                collapses.push_back({ bestCost, u, best });
+        }
+        if (collapses.empty())
+            break;
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+            return a.cost < b.cost || (a.cost == b.cost && a.from < b.from);
+        });
+
+        std::iota(collapseTo.begin(), collapseTo.end(), 0u);
+        std::fill(touched.begin(), touched.end(), 0);
+        size_t triangleCount = count / 3;
+        size_t targetTriangles = targetIndexCount / 3;
+        size_t performed = 0;
+        for (const Collapse& collapse : collapses) {
+            if (triangleCount <= targetTriangles)
+                break;
+            if (maxErrorSq > 0.0 && collapse.cost > maxErrorSq)
+                break;
+            uint32_t u = collapse.from, v = collapse.to;
+            if (touched[u] || touched[v])
+                continue;
+
+            // u 移到 v 后，不含 v 的相邻三角形法线不能反向
+            bool flips = false;
+            size_t removed = 0;
+            for (uint32_t t = offsets[u]; t < offsets[u + 1] && !flips; ++t) {
+                const uint32_t* tri = &out[triangles[t] * 3];
+                if (tri[0] == v || tri[1] == v || tri[2] == v) {
+                    ++removed;
+                    continue;
+                }
+                Float3 p[3], q[3];
+                for (int k = 0; k < 3; ++k) {
+                    p[k] = vertices[tri[k]].position;
+                    q[k] = tri[k] == u ? vertices[v].position : p[k];
+                }
+                Float3 before = Cross(Sub(p[1], p[0]), Sub(p[2], p[0]));
+                Float3 after = Cross(Sub(q[1], q[0]), Sub(q[2], q[0]));
+                flips = Dot(before, after) <= 0.0f;
+            }
+            if (flips) {
+                ++result.rejectedFlip;
+                continue;
+            }
+
+            collapseTo[u] = v;
+            AddQuadric(quadrics[v], quadrics[u]);
+            // 本轮内不再改动 u 周围的三角形，保证后续的翻转检查基于当前几何
+            for (uint32_t t = offsets[u]; t < offsets[u + 1]; ++t) {
+                const uint32_t* tri = &out[triangles[t] * 3];
+                touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1;
+            }
+            triangleCount -= removed;
+            result.error = std::max(result.error, float(std::sqrt(collapse.cost)));
+            ++result.collapses;
+            ++performed;
+        }
+        if (performed == 0)
+            break;
+
+        size_t written = 0;
+        for (size_t i = 0; i < count; i += 3) {
+            uint32_t a = collapseTo[out[i]], b = collapseTo[out[i + 1]], c = collapseTo[out[i + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            out[written++] = a;
+            out[written++] = b;
+            out[written++] = c;
+        }
+        count = written;
+    }
+    return count;
+}
+
+std::vector<MeshLodSettings> DefaultMeshLodSettings()
+{
+    std::vector<MeshLodSettings> settings(3);
+    settings[0].triangleRatio = 0.5f;
+    settings[0].influenceCount = 4;
+    settings[0].screenSize = 0.5f;
+    settings[1].triangleRatio = 0.25f;
+    settings[1].influenceCount = 2;
+    settings[1].screenSize = 0.25f;
+    settings[2].triangleRatio = 0.125f;
+    settings[2].influenceCount = 1;
+    settings[2].screenSize = 0.12f;
+    return settings;
+}
+
+void BuildMeshLodChain(const std::vector<Vertex>& vertices, const std::vector<std::vector<BoneInfluence>>& influences,
+    const std::vector<uint32_t>& indices, const std::vector<MeshSourceRange>& sources,
+    const std::vector<MeshLodSettings>& settings, MeshLodChain& out, JobSystem* jobs)
+{
+    size_t levelCount = std::min<size_t>(settings.size(), MESH_LOD_MAX_LEVELS);
+    out.levels.assign(levelCount, MeshLodLevel());
+
+    Float3 lo = { FLT_MAX, FLT_MAX, FLT_MAX }, hi = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (const Vertex& vertex : vertices) {
+        const Float3& p = vertex.position;
+        lo.x = std::min(lo.x, p.x); lo.y = std::min(lo.y, p.y); lo.z = std::min(lo.z, p.z);
+        hi.x = std::max(hi.x, p.x); hi.y = std::max(hi.y, p.y); hi.z = std::max(hi.z, p.z);
+    }
+    out.center = vertices.empty() ? Float3{ 0.0f, 0.0f, 0.0f } : Float3{ (lo.x + hi.x) * 0.5f, (lo.y + hi.y) * 0.5f, (lo.z + hi.z) * 0.5f };
+    float radiusSq = 0.0f;
+    for (const Vertex& vertex : vertices) {
+        Float3 d = Sub(vertex.position, out.center);
+        radiusSq = std::max(radiusSq, Dot(d, d));
+    }
+    out.radius = std::sqrt(radiusSq);
+
+    struct Task
+    {
+        std::vector<uint32_t> indices;  // 相对源网格的 vertexStart
+        SimplifyStats stats;
+    };
+    std::vector<Task> tasks(sources.size() * levelCount);
+    bool hasInfluences = influences.size() >= vertices.size() && !vertices.empty();
+
+    auto simplify = [&](size_t begin, size_t end, int) {
+        std::vector<uint32_t> local;
+        for (size_t i = begin; i < end; ++i) {
+            const MeshSourceRange& source = sources[i / levelCount];
+            const MeshLodSettings& level = settings[i % levelCount];
+            local.resize(source.indexCount);
+            for (uint32_t k = 0; k < source.indexCount; ++k)
+                local[k] = indices[source.indexStart + k] - source.vertexStart;
+            size_t target = size_t(float(source.indexCount / 3) * level.triangleRatio) * 3;
+
+            Task& task = tasks[i];
+            task.indices.resize(source.indexCount);
+            size_t count = SimplifySkinnedMesh(&vertices[source.vertexStart],
+                hasInfluences ? &influences[source.vertexStart] : nullptr, source.vertexCount,
+                local.data(), local.size(), target, SimplifyOptions(), task.indices.data(), &task.stats);
+            task.indices.resize(count);
+        }
+    };
+    if (jobs)
+        jobs->ParallelFor(tasks.size(), 1, simplify);
+    else
+        simplify(0, tasks.size(), 0);
+
+    // 按级别合并各源网格，只保留被引用的顶点（按首次引用顺序），再按本级的影响数裁剪
+    std::vector<uint32_t> newIndex;
+    for (size_t l = 0; l < levelCount; ++l) {
+        MeshLodLevel& level = out.levels[l];
+        level.influenceCount = std::max(1, std::min(settings[l].influenceCount, 8));
+        level.screenSize = settings[l].screenSize;
+        std::vector<std::vector<BoneInfluence>> levelInfluences;
+        for (size_t s = 0; s < sources.size(); ++s) {
+            const MeshSourceRange& source = sources[s];
+            const Task& task = tasks[s * levelCount + l];
+            level.error = std::max(level.error, task.stats.error);
+            newIndex.assign(source.vertexCount, UINT32_MAX);
+            for (uint32_t index : task.indices) {
+                if (newIndex[index] == UINT32_MAX) {
+                    newIndex[index] = uint32_t(level.vertices.size());
+                    level.vertices.push_back(vertices[source.vertexStart + index]);
+                    if (hasInfluences)
+                        levelInfluences.push_back(influences[source.vertexStart + index]);
+                }
+                level.indices.push_back(newIndex[index]);
+            }
+        }
+        if (hasInfluences)
+            ApplyInfluences(levelInfluences, level.influenceCount, level.vertices, level.extraInfluences, level.influenceStats);
+    }
+}
+
+float ProjectedScreenSize(float radius, float distance, float fovY)
+{
+    // 相机在包围球内时按占满屏幕处理
+    if (distance <= radius)
+        return FLT_MAX;
+    return radius / (distance * std::tan(fovY * 0.5f));
+}
+
+int SelectMeshLod(const MeshLodChain& chain, float screenSize)
+{
+    int lod = 0;
+    for (size_t i = 0; i < chain.levels.size(); ++i)
+        if (screenSize < chain.levels[i].screenSize)
+            lod = int(i) + 1;
+    return lod;
+}
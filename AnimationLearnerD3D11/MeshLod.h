@@ -0,0 +1,89 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Influences.h"
+#include "Vertex.h"
+
+class JobSystem;
+
+// 加载时为蒙皮网格生成 LOD 链（相当于离线烘焙）：二次误差度量（QEM）的边折叠简化，顶点只折叠到已有的相邻顶点上，
+// 因此不产生新顶点、不需要插值骨骼权重；只允许折叠到骨骼影响相近的顶点，UV 接缝与开放边界上的顶点锁定不动。
+// 每级 LOD 有自己的影响数裁剪，运行时按包围球在屏幕上的尺寸选择
+
+// LOD 链的级数上限（不含原网格）
+#define MESH_LOD_MAX_LEVELS 3
+// 允许折叠的最大影响差异：两个顶点归一化权重之差的 L1 范数的一半（0 为完全相同，1 为没有共同骨骼）
+#define LOD_INFLUENCE_TOLERANCE 0.35f
+
+struct SimplifyOptions
+{
+    float maxInfluenceDistance = LOD_INFLUENCE_TOLERANCE;
+    float maxError = 0.0f;      // 单次折叠允许的最大几何误差（模型单位），0 为不限
+};
+
+struct SimplifyStats
+{
+    size_t collapses = 0;
+    size_t lockedVertices = 0;      // 接缝与边界顶点
+    size_t rejectedInfluence = 0;   // 因影响差异过大放弃的候选边
+    size_t rejectedFlip = 0;        // 因会翻转三角形放弃的折叠
+    float error = 0.0f;             // 已执行折叠的最大几何误差（到原始面的加权 RMS 距离，模型单位）
+};
+
+// 把三角形列表简化到不超过 targetIndexCount 个索引（锁定顶点太多或超过 maxError 时会停在更多的索引上）。
+// influences 与 vertices 一一对应（未裁剪的全部影响），为空时不限制影响差异。
+// 输出的索引仍引用原顶点，写入 out（至少 indexCount 个），返回输出的索引数
+size_t SimplifySkinnedMesh(const Vertex* vertices, const std::vector<BoneInfluence>* influences, size_t vertexCount,
+    const uint32_t* indices, size_t indexCount, size_t targetIndexCount, const SimplifyOptions& options,
+    uint32_t* out, SimplifyStats* stats = nullptr);
+
+// 一级 LOD 的生成参数
+struct MeshLodSettings
+{
+    float triangleRatio = 0.5f;     // 相对原网格的三角形比例
+    int influenceCount = 4;         // 本级每顶点的影响数（不超过原网格的影响数）
+    float screenSize = 0.5f;        // 包围球直径占屏幕高度的比例小于它时切换到本级
+};
+
+// 默认三级：1/2、1/4、1/8 的三角形，4 / 2 / 1 个影响，屏幕尺寸 0.5 / 0.25 / 0.12
+std::vector<MeshLodSettings> DefaultMeshLodSettings();
+
+struct MeshLodLevel
+{
+    std::vector<Vertex> vertices;                   // 只含本级引用的顶点，影响已裁剪到 influenceCount
+    std::vector<VertexInfluences> extraInfluences;  // influenceCount 大于 4 时的第 5~8 个影响，否则为空
+    std::vector<uint32_t> indices;
+    int influenceCount = 4;
+    float screenSize = 0.0f;
+    float error = 0.0f;             // 各源网格简化误差的最大值
+    InfluenceStats influenceStats;
+};
+
+// 导入时的一个 aiMesh 在合并后的顶点 / 索引数组中的区间；各源网格独立简化，可并行
+struct MeshSourceRange
+{
+    uint32_t vertexStart = 0;
+    uint32_t vertexCount = 0;
+    uint32_t indexStart = 0;
+    uint32_t indexCount = 0;
+};
+
+struct MeshLodChain
+{
+    std::vector<MeshLodLevel> levels;   // LOD1..N；LOD0 即原网格
+    Float3 center;                      // 绑定姿态的包围球
+    float radius = 0.0f;
+};
+
+// 每个（源网格, LOD 级别）一个任务，都从原网格开始简化，提供 jobs 时并行执行；结果按级别合并并各自裁剪影响。
+// influences 为每个顶点未裁剪的全部影响
+void BuildMeshLodChain(const std::vector<Vertex>& vertices, const std::vector<std::vector<BoneInfluence>>& influences,
+    const std::vector<uint32_t>& indices, const std::vector<MeshSourceRange>& sources,
+    const std::vector<MeshLodSettings>& settings, MeshLodChain& out, JobSystem* jobs = nullptr);
+
+// 半径 radius 的包围球在 distance 处、垂直视场角 fovY（弧度）下，直径占屏幕高度的比例
+float ProjectedScreenSize(float radius, float distance, float fovY);
+
+// 按屏幕尺寸选级：返回 0 为原网格，k 为 chain.levels[k - 1]
+int SelectMeshLod(const MeshLodChain& chain, float screenSize);
@@ -0,0 +1,282 @@
+﻿#include "MeshPartition.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include "Influences.h"
+
+namespace
+{
+    // 一个三角形最多引用 3 x 8 个骨骼
+    const int kMaxTriangleBones = 24;
+
+    struct TriangleBones
+    {
+        int bones[kMaxTriangleBones];
+        int count = 0;
+    };
+
+    void AddBones(const uint32_t* boneIndices, const float* boneWeights, TriangleBones& out)
+    {
+        for (int i = 0; i < 4; ++i) {
+            if (boneWeights[i] == 0.0f)
+                continue;
+            int bone = int(boneIndices[i]);
+            if (std::find(out.bones, out.bones + out.count, bone) == out.bones + out.count)
+                out.bones[out.count++] = bone;
+        }
+    }
+
+    void CollectTriangleBones(const std::vector<Vertex>& vertices, const std::vector<VertexInfluences>& extraInfluences,
+        const uint32_t* tri, TriangleBones& out)
+    {
+        out.count = 0;
+        for (int corner = 0; corner < 3; ++corner) {
+            const Vertex& v = vertices[tri[corner]];
+            AddBones(v.boneIndices, v.boneWeights, out);
+            if (!extraInfluences.empty()) {
+                const VertexInfluences& ex = extraInfluences[tri[corner]];
+                AddBones(ex.boneIndices, ex.boneWeights, out);
+            }
+        }
+    }
+
+    // 未分桶时整个子网格一次 draw
+    void AddSingleDraw(SkinnedSubmesh& submesh, bool hasExtraInfluences)
+    {
+        InfluenceDraw draw;
+        draw.indexStart = submesh.indexStart;
+        draw.indexCount = submesh.indexCount;
+        draw.influences = hasExtraInfluences ? 8 : 4;
+        submesh.draws.push_back(draw);
+    }
+
+    // 权重为 0 的槽位指向局部槽位 0，不影响结果
+    void RemapBones(uint32_t* boneIndices, const float* boneWeights, const std::vector<int>& localSlot)
+    {
+        for (int i = 0; i < 4; ++i) {
+            int slot = boneWeights[i] != 0.0f ? localSlot[boneIndices[i]] : 0;
+            boneIndices[i] = uint32_t(slot);
+        }
+    }
+}
+
+void PartitionMeshByBones(const std::vector<Vertex>& vertices, const std::vector<VertexInfluences>& extraInfluences,
+    const std::vector<uint32_t>& indices, int paletteBudget, PartitionedMesh& out)
+{
+    assert(paletteBudget >= kMaxTriangleBones);
+    out = PartitionedMesh();
+
+    int boneCount = 0;
+    for (const Vertex& v : vertices)
+        for (int i = 0; i < 4; ++i)
+            if (v.boneWeights[i] != 0.0f)
+                boneCount = std::max(boneCount, int(v.boneIndices[i]) + 1);
+    for (const VertexInfluences& ex : extraInfluences)
+        for (int i = 0; i < 4; ++i)
+            if (ex.boneWeights[i] != 0.0f)
+                boneCount = std::max(boneCount, int(ex.boneIndices[i]) + 1);
+
+    // 放得下：一个子网格，局部槽位即全局下标
+    if (boneCount <= paletteBudget) {
+        out.vertices = vertices;
+        out.extraInfluences = extraInfluences;
+        out.indices = indices;
+        out.sourceVertices.resize(vertices.size());
+        for (size_t v = 0; v < vertices.size(); ++v)
+            out.sourceVertices[v] = uint32_t(v);
+        SkinnedSubmesh submesh;
+        submesh.indexCount = uint32_t(indices.size());
+        submesh.vertexCount = uint32_t(vertices.size());
+        for (int b = 0; b < boneCount; ++b)
+            submesh.bonePalette.push_back(b);
+        AddSingleDraw(submesh, !extraInfluences.empty());
+        out.submeshes.push_back(submesh);
+        return;
+    }
+
+    size_t triangleCount = indices.size() / 3;
+    std::vector<TriangleBones> triangleBones(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t)
+        CollectTriangleBones(vertices, extraInfluences, &indices[t * 3], triangleBones[t]);
+
+    std::vector<uint32_t> remaining(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t)
+        remaining[t] = uint32_t(t);
+
+    std::vector<int> localSlot(boneCount, -1);          // 全局骨骼 -> 当前子网格的槽位
+    std::vector<int> vertexRemap(vertices.size(), -1);  // 原顶点 -> 当前子网格中的新顶点
+    std::vector<uint32_t> taken;
+    std::vector<unsigned char> used(triangleCount, 0);
+    std::vector<unsigned char> referenced(vertices.size(), 0);
+
+    while (!remaining.empty()) {
+        SkinnedSubmesh submesh;
+        taken.clear();
+
+        // 门槛 k 从 0 逐步放宽：每轮只接受新增骨骼不超过 k 的三角形；
+        // 放宽之后再扫一遍 k = 0，把因新骨骼而变得“免费”的三角形收进来
+        for (int k = 0; k <= kMaxTriangleBones; ++k) {
+            for (int pass = 0; pass < (k == 0 ? 1 : 2); ++pass) {
+                int threshold = pass == 0 ? k : 0;
+                for (uint32_t t : remaining) {
+                    if (used[t])
+                        continue;
+                    const TriangleBones& tb = triangleBones[t];
+                    int newBones = 0;
+                    for (int i = 0; i < tb.count; ++i)
+                        newBones += localSlot[tb.bones[i]] < 0 ? 1 : 0;
+                    if (newBones > threshold || int(submesh.bonePalette.size()) + newBones > paletteBudget)
+                        continue;
+
+                    for (int i = 0; i < tb.count; ++i) {
+                        if (localSlot[tb.bones[i]] < 0) {
+                            localSlot[tb.bones[i]] = int(submesh.bonePalette.size());
+                            submesh.bonePalette.push_back(tb.bones[i]);
+                        }
+                    }
+                    used[t] = 1;
+                    taken.push_back(t);
+                }
+            }
+            if (int(submesh.bonePalette.size()) == paletteBudget)
+                break;
+        }
+
+        // 按原顺序输出三角形，保留原有的顶点缓存局部性；顶点按首次使用的顺序复制
+        std::sort(taken.begin(), taken.end());
+        submesh.indexStart = uint32_t(out.indices.size());
+        submesh.vertexStart = uint32_t(out.vertices.size());
+        std::vector<uint32_t> submeshVertices;
+        for (uint32_t t : taken) {
+            for (int corner = 0; corner < 3; ++corner) {
+                uint32_t original = indices[t * 3 + corner];
+                if (vertexRemap[original] < 0) {
+                    vertexRemap[original] = int(out.vertices.size());
+                    submeshVertices.push_back(original);
+                    out.sourceVertices.push_back(original);
+
+                    Vertex v = vertices[original];
+                    RemapBones(v.boneIndices, v.boneWeights, localSlot);
+                    out.vertices.push_back(v);
+                    if (!extraInfluences.empty()) {
+                        VertexInfluences ex = extraInfluences[original];
+                        RemapBones(ex.boneIndices, ex.boneWeights, localSlot);
+                        out.extraInfluences.push_back(ex);
+                    }
+
+                    if (referenced[original])
+                        ++out.duplicatedVertices;
+                    referenced[original] = 1;
+                }
+                out.indices.push_back(uint32_t(vertexRemap[original]));
+            }
+        }
+        submesh.indexCount = uint32_t(out.indices.size()) - submesh.indexStart;
+        submesh.vertexCount = uint32_t(out.vertices.size()) - submesh.vertexStart;
+        AddSingleDraw(submesh, !extraInfluences.empty());
+
+        // 清理本子网格的临时映射
+        for (uint32_t original : submeshVertices)
+            vertexRemap[original] = -1;
+        for (int bone : submesh.bonePalette)
+            localSlot[bone] = -1;
+        out.submeshes.push_back(std::move(submesh));
+
+        remaining.erase(std::remove_if(remaining.begin(), remaining.end(),
+            [&](uint32_t t) { return used[t] != 0; }), remaining.end());
+    }
+}
+
+float BucketTrianglesByInfluence(PartitionedMesh& mesh, bool rigidSegments)
+{
+    bool hasExtra = !mesh.extraInfluences.empty();
+    std::vector<int> vertexBucket(mesh.vertices.size());
+    for (size_t v = 0; v < mesh.vertices.size(); ++v)
+        vertexBucket[v] = InfluenceBucketIndex(CountInfluences(mesh.vertices[v], hasExtra ? &mesh.extraInfluences[v] : nullptr));
+
+    // 各子网格的顶点互不共享，刚性段不会跨子网格；骨骼为局部槽位
+    std::vector<int> rigidBone;
+    if (rigidSegments)
+        FindRigidVertices(mesh.vertices, mesh.extraInfluences, mesh.indices, rigidBone);
+
+    double work = 0.0;
+    std::vector<uint32_t> sorted;
+    std::vector<size_t> keyStart, next;
+    for (SkinnedSubmesh& submesh : mesh.submeshes) {
+        uint32_t* tris = mesh.indices.data() + submesh.indexStart;
+        size_t triangleCount = submesh.indexCount / 3;
+
+        // 排序键：刚性三角形为局部骨骼槽位，其余为 paletteSize + 桶下标；计数排序，键内保持原有三角形顺序
+        size_t paletteSize = rigidSegments ? submesh.bonePalette.size() : 0;
+        size_t keyCount = paletteSize + INFLUENCE_BUCKET_COUNT;
+        keyStart.assign(keyCount + 1, 0);
+        std::vector<size_t> triangleKey(triangleCount);
+        for (size_t t = 0; t < triangleCount; ++t) {
+            const uint32_t* tri = tris + t * 3;
+            if (rigidSegments && rigidBone[tri[0]] >= 0)
+                triangleKey[t] = size_t(rigidBone[tri[0]]);
+            else
+                triangleKey[t] = paletteSize + size_t(std::max(vertexBucket[tri[0]], std::max(vertexBucket[tri[1]], vertexBucket[tri[2]])));
+            ++keyStart[triangleKey[t] + 1];
+        }
+        for (size_t k = 0; k < keyCount; ++k)
+            keyStart[k + 1] += keyStart[k];
+
+        sorted.assign(triangleCount * 3, 0);
+        next.assign(keyStart.begin(), keyStart.end() - 1);
+        for (size_t t = 0; t < triangleCount; ++t) {
+            size_t target = next[triangleKey[t]]++;
+            std::copy(tris + t * 3, tris + t * 3 + 3, sorted.begin() + target * 3);
+        }
+        std::copy(sorted.begin(), sorted.end(), tris);
+
+        submesh.draws.clear();
+        for (size_t k = 0; k < keyCount; ++k) {
+            if (keyStart[k + 1] == keyStart[k])
+                continue;
+            InfluenceDraw draw;
+            draw.indexStart = submesh.indexStart + uint32_t(keyStart[k] * 3);
+            draw.indexCount = uint32_t((keyStart[k + 1] - keyStart[k]) * 3);
+            if (k < paletteSize) {
+                draw.influences = 0;
+                draw.rigidBone = int(k);
+            }
+            else {
+                draw.influences = InfluenceBucketSize(int(k - paletteSize));
+            }
+            submesh.draws.push_back(draw);
+            work += double(draw.indexCount) * draw.influences;
+        }
+    }
+    return mesh.indices.empty() ? 0.0f : float(work / double(mesh.indices.size()));
+}
+
+void BuildSubmeshIndexBuffer(const PartitionedMesh& mesh, SubmeshIndexBuffer& out)
+{
+    out = SubmeshIndexBuffer();
+    for (const SkinnedSubmesh& submesh : mesh.submeshes) {
+        SubmeshIndexRange range;
+        range.byteOffset = uint32_t(out.data.size());
+        range.wide = submesh.vertexCount > 0x10000u;
+        out.submeshes.push_back(range);
+        out.wideSubmeshes += range.wide ? 1 : 0;
+
+        size_t indexSize = range.wide ? sizeof(uint32_t) : sizeof(uint16_t);
+        out.data.resize(out.data.size() + submesh.indexCount * indexSize);
+        uint8_t* dst = out.data.data() + range.byteOffset;
+        for (uint32_t i = 0; i < submesh.indexCount; ++i) {
+            uint32_t index = mesh.indices[submesh.indexStart + i];
+            assert(index >= submesh.vertexStart && index < submesh.vertexStart + submesh.vertexCount);
+            uint32_t local = index - submesh.vertexStart;
+            if (range.wide) {
+                std::memcpy(dst + i * sizeof(uint32_t), &local, sizeof(uint32_t));
+            }
+            else {
+                uint16_t narrow = uint16_t(local);
+                std::memcpy(dst + i * sizeof(uint16_t), &narrow, sizeof(uint16_t));
+            }
+        }
+        // 下一个子网格可能是 32 位索引，偏移保持 4 字节对齐
+        out.data.resize((out.data.size() + 3) & ~size_t(3));
+    }
+}
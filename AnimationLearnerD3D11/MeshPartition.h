@@ -0,0 +1,69 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Vertex.h"
+
+// 常量缓冲区中的调色板容量（BoneMatrixBuffer 与着色器中的数组长度）
+#define BONE_PALETTE_CAPACITY 128
+
+// 子网格内的一段三角形，用 influences 个影响的着色器变体绘制（一次 DrawIndexed）。
+// influences 为 0 时是刚性段，整段用局部槽位 rigidBone 的一个矩阵变换
+struct InfluenceDraw
+{
+    uint32_t indexStart = 0;
+    uint32_t indexCount = 0;
+    int influences = 4;
+    int rigidBone = -1;
+};
+
+// 一个子网格：使用自己的局部调色板，按影响数分成一次或多次 draw
+struct SkinnedSubmesh
+{
+    uint32_t indexStart = 0;
+    uint32_t indexCount = 0;
+    uint32_t vertexStart = 0;       // 子网格的顶点在 PartitionedMesh::vertices 中连续存放
+    uint32_t vertexCount = 0;
+    std::vector<int> bonePalette;   // 局部槽位 -> 全局骨骼下标
+    std::vector<InfluenceDraw> draws;
+};
+
+struct PartitionedMesh
+{
+    std::vector<Vertex> vertices;   // 骨骼下标已重映射为所属子网格的局部槽位
+    std::vector<VertexInfluences> extraInfluences;  // 8 影响资源的第 5~8 个影响，同样已重映射；否则为空
+    std::vector<uint32_t> indices;
+    std::vector<SkinnedSubmesh> submeshes;
+    size_t duplicatedVertices = 0;  // 被多个子网格引用而复制出的顶点数
+    std::vector<uint32_t> sourceVertices;   // 每个顶点来自 PartitionMeshByBones 输入的哪个顶点（复制出的顶点共享同一个）
+};
+
+// 子网格在打包索引缓冲区中的位置
+struct SubmeshIndexRange
+{
+    uint32_t byteOffset = 0;    // 绑定索引缓冲区时的偏移，按 4 字节对齐
+    bool wide = false;          // 32 位索引；否则 16 位
+};
+
+// 按子网格打包的 GPU 索引缓冲区：索引相对子网格的 vertexStart（绘制时作为 BaseVertexLocation），
+// 顶点数不超过 65536 的子网格使用 16 位索引。子网格内 draw 的起始索引为 draw.indexStart - submesh.indexStart
+struct SubmeshIndexBuffer
+{
+    std::vector<uint8_t> data;
+    std::vector<SubmeshIndexRange> submeshes;   // 与 PartitionedMesh::submeshes 一一对应
+    size_t wideSubmeshes = 0;
+};
+
+// 把合并后的网格按三角形划分为若干子网格，使每个子网格引用的骨骼数不超过 paletteBudget。
+// 贪心地优先加入不引入新骨骼的三角形，以减少子网格数（draw 数）和跨子网格复制的顶点。
+// 所有骨骼下标都小于预算时只生成一个子网格，顶点原样保留。extraInfluences 为空或与 vertices 一一对应
+void PartitionMeshByBones(const std::vector<Vertex>& vertices, const std::vector<VertexInfluences>& extraInfluences,
+    const std::vector<uint32_t>& indices, int paletteBudget, PartitionedMesh& out);
+
+// 在每个子网格内把三角形按三个顶点中最大的影响数分桶（桶内保持原顺序），重建各子网格的 draws。
+// 每桶用对应 MAX_INFLUENCES 的着色器变体绘制；rigidSegments 为 true 时刚性段（见 FindRigidVertices）的三角形
+// 按骨骼排在最前面，每个骨骼一次刚性 draw。返回平均每个顶点着色器调用执行的影响循环次数（按索引计，刚性为 0）
+float BucketTrianglesByInfluence(PartitionedMesh& mesh, bool rigidSegments);
+
+// 由 mesh.indices 生成按子网格打包、相对 vertexStart 的索引缓冲区
+void BuildSubmeshIndexBuffer(const PartitionedMesh& mesh, SubmeshIndexBuffer& out);
@@ -0,0 +1,224 @@
+﻿#include "MeshPartition.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// MeshPartition 的独立测试，不参与工程的构建（vcxproj 中 ExcludedFromBuild）。
+// MeshPartition.cpp 经由 Influences.cpp 依赖 CPU 蒙皮，任意平台上：
+//   g++ -std=c++14 -pthread -IThirdParty/include MeshPartitionTest.cpp MeshPartition.cpp Influences.cpp Skinning.cpp JobSystem.cpp PackedVertex.cpp && ./a.out
+// 全部通过时返回 0
+
+namespace
+{
+    int g_failures = 0;
+
+    void Check(bool condition, const char* test, const char* what)
+    {
+        if (!condition) {
+            std::printf("[MeshPartitionTest] %s: %s\n", test, what);
+            ++g_failures;
+        }
+    }
+
+    // 三角形旋转到最小下标在前（保持绕序）后排序，比较两份索引是否为同一组三角形
+    std::vector<uint32_t> CanonicalTriangles(const std::vector<uint32_t>& indices)
+    {
+        std::vector<std::vector<uint32_t>> triangles;
+        for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+            std::vector<uint32_t> tri(indices.begin() + t, indices.begin() + t + 3);
+            std::rotate(tri.begin(), std::min_element(tri.begin(), tri.end()), tri.end());
+            triangles.push_back(tri);
+        }
+        std::sort(triangles.begin(), triangles.end());
+        std::vector<uint32_t> flat;
+        for (const std::vector<uint32_t>& tri : triangles)
+            flat.insert(flat.end(), tri.begin(), tri.end());
+        return flat;
+    }
+
+    // side x side 个顶点的平面网格，骨骼按 20 x 15 的格子铺在网格上（共 300 个），
+    // 每个顶点绑定所在格子及其右、上、右上三个格子的骨骼
+    void MakeBoneGrid(int side, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+    {
+        const int bonesX = 20, bonesY = 15;
+        const float weights[4] = { 0.4f, 0.3f, 0.2f, 0.1f };
+        vertices.clear();
+        indices.clear();
+        for (int y = 0; y < side; ++y) {
+            for (int x = 0; x < side; ++x) {
+                Vertex v;
+                v.position = { float(x), float(y), 0.0f };
+                v.normal = { 0.0f, 0.0f, 1.0f };
+                v.texcoord = { float(x) / side, float(y) / side };
+                int bx = x * bonesX / side, by = y * bonesY / side;
+                for (int i = 0; i < 4; ++i) {
+                    int cx = std::min(bonesX - 1, bx + (i & 1));
+                    int cy = std::min(bonesY - 1, by + (i >> 1));
+                    v.boneIndices[i] = uint32_t(cy * bonesX + cx);
+                    v.boneWeights[i] = weights[i];
+                }
+                vertices.push_back(v);
+            }
+        }
+        for (int y = 0; y + 1 < side; ++y) {
+            for (int x = 0; x + 1 < side; ++x) {
+                uint32_t v = uint32_t(y * side + x), row = uint32_t(side);
+                uint32_t quad[6] = { v, v + 1, v + row, v + 1, v + row + 1, v + row };
+                indices.insert(indices.end(), quad, quad + 6);
+            }
+        }
+    }
+
+    // 4 万顶点、300 个骨骼的网格超过 128 的调色板容量，必须拆分
+    void TestSplitGrid()
+    {
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        MakeBoneGrid(200, vertices, indices);
+
+        PartitionedMesh mesh;
+        PartitionMeshByBones(vertices, {}, indices, BONE_PALETTE_CAPACITY, mesh);
+        size_t draws = 0;
+        for (const SkinnedSubmesh& submesh : mesh.submeshes)
+            draws += submesh.draws.size();
+        std::printf("[MeshPartitionTest] 300-bone grid: %zu submeshes, %zu draws, %zu duplicated vertices of %zu\n",
+            mesh.submeshes.size(), draws, mesh.duplicatedVertices, vertices.size());
+
+        Check(mesh.submeshes.size() == 4 && draws == 4, "split grid", "expected 4 submeshes with one draw each");
+        // 复制的顶点不超过 2.5%（当前为 917 个，2.3%）
+        Check(mesh.duplicatedVertices * 40 <= vertices.size(), "split grid", "more than 2.5% of the vertices duplicated");
+        Check(mesh.vertices.size() == vertices.size() + mesh.duplicatedVertices, "split grid", "vertex count does not add up");
+        Check(mesh.sourceVertices.size() == mesh.vertices.size(), "split grid", "sourceVertices size mismatch");
+
+        std::vector<uint32_t> sourceIndices;
+        for (const SkinnedSubmesh& submesh : mesh.submeshes) {
+            Check(!submesh.bonePalette.empty() && submesh.bonePalette.size() <= BONE_PALETTE_CAPACITY,
+                "split grid", "submesh palette over budget");
+            for (uint32_t i = submesh.indexStart; i < submesh.indexStart + submesh.indexCount; ++i) {
+                uint32_t index = mesh.indices[i];
+                if (index < submesh.vertexStart || index >= submesh.vertexStart + submesh.vertexCount) {
+                    Check(false, "split grid", "index outside its submesh's vertex range");
+                    continue;
+                }
+                sourceIndices.push_back(mesh.sourceVertices[index]);
+            }
+            // 局部槽位经调色板映射回来必须是原来的骨骼和权重
+            for (uint32_t v = submesh.vertexStart; v < submesh.vertexStart + submesh.vertexCount; ++v) {
+                const Vertex& local = mesh.vertices[v];
+                const Vertex& source = vertices[mesh.sourceVertices[v]];
+                for (int i = 0; i < 4; ++i) {
+                    bool sameBone = local.boneIndices[i] < submesh.bonePalette.size() &&
+                        uint32_t(submesh.bonePalette[local.boneIndices[i]]) == source.boneIndices[i];
+                    if (!sameBone || local.boneWeights[i] != source.boneWeights[i]) {
+                        Check(false, "split grid", "local palette slot does not map back to the source bone");
+                        break;
+                    }
+                }
+            }
+        }
+        Check(CanonicalTriangles(sourceIndices) == CanonicalTriangles(indices), "split grid",
+            "triangles lost, duplicated or rewound");
+    }
+
+    // 骨骼数不超过预算时只有一个子网格，顶点与索引原样保留
+    void TestFitsBudget()
+    {
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        MakeBoneGrid(40, vertices, indices);
+
+        PartitionedMesh mesh;
+        PartitionMeshByBones(vertices, {}, indices, 300, mesh);
+        Check(mesh.submeshes.size() == 1 && mesh.duplicatedVertices == 0, "fits budget", "mesh was split");
+        Check(mesh.indices == indices && mesh.vertices.size() == vertices.size(), "fits budget", "mesh was modified");
+        bool sameBones = true;
+        for (size_t v = 0; v < vertices.size() && v < mesh.vertices.size(); ++v)
+            sameBones = sameBones && std::equal(vertices[v].boneIndices, vertices[v].boneIndices + 4, mesh.vertices[v].boneIndices);
+        Check(sameBones, "fits budget", "bone indices remapped");
+    }
+
+    // 只有索引与子网格区间的网格：每个子网格 vertexCount 个顶点，三角形按固定步长在子网格内取顶点，
+    // 覆盖子网格的第一个和最后一个顶点
+    void AddIndexOnlySubmesh(PartitionedMesh& mesh, uint32_t vertexCount, uint32_t triangleCount)
+    {
+        SkinnedSubmesh submesh;
+        submesh.indexStart = uint32_t(mesh.indices.size());
+        submesh.vertexStart = mesh.submeshes.empty() ? 0 :
+            mesh.submeshes.back().vertexStart + mesh.submeshes.back().vertexCount;
+        submesh.vertexCount = vertexCount;
+        for (uint32_t t = 0; t < triangleCount; ++t) {
+            uint32_t a = uint32_t((uint64_t(t) * 7919u) % vertexCount);
+            uint32_t tri[3] = { a, (a + 1) % vertexCount, vertexCount - 1 - a };
+            for (uint32_t corner : tri)
+                mesh.indices.push_back(submesh.vertexStart + corner);
+        }
+        submesh.indexCount = uint32_t(mesh.indices.size()) - submesh.indexStart;
+        mesh.submeshes.push_back(submesh);
+    }
+
+    // 16 / 32 位索引的拆分：顶点数不超过 65536 的子网格用 16 位（局部下标最大 0xffff），以上用 32 位；
+    // 每段从 4 字节对齐的偏移开始，解码后加上 vertexStart 即原索引
+    void TestSubmeshIndexBuffer()
+    {
+        PartitionedMesh mesh;
+        AddIndexOnlySubmesh(mesh, 1000, 333);       // 999 个索引，16 位时末尾需要补齐
+        AddIndexOnlySubmesh(mesh, 0x10000, 4001);   // 恰好 65536 个顶点，仍为 16 位
+        AddIndexOnlySubmesh(mesh, 0x10001, 1001);   // 超出一个，32 位
+        AddIndexOnlySubmesh(mesh, 70000, 5000);     // 宽子网格
+        AddIndexOnlySubmesh(mesh, 3, 1);            // 紧跟在 32 位之后的 16 位奇数个索引
+
+        SubmeshIndexBuffer buffer;
+        BuildSubmeshIndexBuffer(mesh, buffer);
+        Check(buffer.submeshes.size() == mesh.submeshes.size(), "index buffer", "one range per submesh");
+        if (buffer.submeshes.size() != mesh.submeshes.size())
+            return;
+
+        const bool expectWide[5] = { false, false, true, true, false };
+        size_t expectedOffset = 0;
+        bool exact = true;
+        for (size_t s = 0; s < mesh.submeshes.size(); ++s) {
+            const SkinnedSubmesh& submesh = mesh.submeshes[s];
+            const SubmeshIndexRange& range = buffer.submeshes[s];
+            Check(range.wide == expectWide[s], "index buffer", "wrong 16 / 32-bit choice at the 0x10000 boundary");
+            Check(range.byteOffset % 4 == 0, "index buffer", "section offset not 4-byte aligned");
+            Check(range.byteOffset == expectedOffset, "index buffer", "sections not packed back to back");
+
+            size_t indexSize = range.wide ? sizeof(uint32_t) : sizeof(uint16_t);
+            expectedOffset = (range.byteOffset + submesh.indexCount * indexSize + 3) & ~size_t(3);
+            if (range.byteOffset + submesh.indexCount * indexSize > buffer.data.size()) {
+                Check(false, "index buffer", "section runs past the end of the buffer");
+                continue;
+            }
+            uint32_t maxLocal = 0;
+            for (uint32_t i = 0; i < submesh.indexCount; ++i) {
+                uint32_t local;
+                if (range.wide) {
+                    std::memcpy(&local, &buffer.data[range.byteOffset + i * 4], sizeof(local));
+                }
+                else {
+                    uint16_t narrow;
+                    std::memcpy(&narrow, &buffer.data[range.byteOffset + i * 2], sizeof(narrow));
+                    local = narrow;
+                }
+                maxLocal = std::max(maxLocal, local);
+                exact = exact && local + submesh.vertexStart == mesh.indices[submesh.indexStart + i];
+            }
+            Check(maxLocal == submesh.vertexCount - 1, "index buffer", "largest local index not round-tripped");
+        }
+        Check(exact, "index buffer", "decoded index + vertexStart differs from the source index");
+        Check(buffer.wideSubmeshes == 2, "index buffer", "wideSubmeshes miscounted");
+        Check(buffer.data.size() == expectedOffset, "index buffer", "buffer size is not the aligned sum of the sections");
+        std::printf("[MeshPartitionTest] index buffer: %zu bytes for %zu indices (%zu wide submeshes)\n",
+            buffer.data.size(), mesh.indices.size(), buffer.wideSubmeshes);
+    }
+}
+
+int main()
+{
+    TestSplitGrid();
+    TestFitsBudget();
+    TestSubmeshIndexBuffer();
+    std::printf("[MeshPartitionTest] %s\n", g_failures ? "FAILED" : "passed");
+    return g_failures ? 1 : 0;
+}
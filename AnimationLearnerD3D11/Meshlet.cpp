@@ -0,0 +1,187 @@
+﻿#include "Meshlet.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+    // 每个 worker 处理的 meshlet 数
+    const size_t kBoundsGrain = 256;
+
+    // 收集顶点权重非零的骨骼，局部槽位换算为全局下标
+    template<typename Influences>
+    void CollectBones(const Influences& influences, const std::vector<int>& bonePalette,
+        std::vector<uint32_t>& stamp, uint32_t generation, std::vector<uint32_t>& bones)
+    {
+        for (int k = 0; k < 4; ++k) {
+            if (influences.boneWeights[k] <= 0.0f)
+                continue;
+            uint32_t slot = influences.boneIndices[k];
+            uint32_t bone = slot < bonePalette.size() ? uint32_t(bonePalette[slot]) : slot;
+            if (bone >= stamp.size())
+                stamp.resize(bone + 1, 0);
+            if (stamp[bone] != generation) {
+                stamp[bone] = generation;
+                bones.push_back(bone);
+            }
+        }
+    }
+
+    // 结束当前 meshlet：求绑定包围球、整理骨骼集合
+    void FinishMeshlet(const PartitionedMesh& mesh, const std::vector<uint32_t>& vertices,
+        std::vector<uint32_t>& bones, Meshlet& meshlet, MeshletMesh& out)
+    {
+        Float3 lo = { FLT_MAX, FLT_MAX, FLT_MAX };
+        Float3 hi = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        for (uint32_t v : vertices) {
+            const Float3& p = mesh.vertices[v].position;
+            lo.x = std::min(lo.x, p.x); lo.y = std::min(lo.y, p.y); lo.z = std::min(lo.z, p.z);
+            hi.x = std::max(hi.x, p.x); hi.y = std::max(hi.y, p.y); hi.z = std::max(hi.z, p.z);
+        }
+        meshlet.center = { (lo.x + hi.x) * 0.5f, (lo.y + hi.y) * 0.5f, (lo.z + hi.z) * 0.5f };
+        float radius2 = 0.0f;
+        for (uint32_t v : vertices) {
+            const Float3& p = mesh.vertices[v].position;
+            float dx = p.x - meshlet.center.x, dy = p.y - meshlet.center.y, dz = p.z - meshlet.center.z;
+            radius2 = std::max(radius2, dx * dx + dy * dy + dz * dz);
+        }
+        meshlet.radius = std::sqrt(radius2);
+        meshlet.vertexCount = uint32_t(vertices.size());
+
+        std::sort(bones.begin(), bones.end());
+        meshlet.boneStart = uint32_t(out.bones.size());
+        meshlet.boneCount = uint32_t(bones.size());
+        out.bones.insert(out.bones.end(), bones.begin(), bones.end());
+        out.meshlets.push_back(meshlet);
+    }
+
+    // 两种调色板的前三行在内存中都是连续的 12 个 float，只是骨骼间的步长不同
+    void ComputeBoundsRange(const MeshletMesh& mesh, const float* palette, size_t boneStride,
+        MeshletBounds* out, size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i) {
+            const Meshlet& meshlet = mesh.meshlets[i];
+            const Float3& c = meshlet.center;
+            float r = meshlet.radius;
+            float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+            float hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+            for (uint32_t b = 0; b < meshlet.boneCount; ++b) {
+                const float* m = palette + size_t(mesh.bones[meshlet.boneStart + b]) * boneStride;
+                for (int row = 0; row < 3; ++row) {
+                    const float* a = m + row * 4;
+                    // 球经线性部分变换后在该轴上的半径恰为 r * |第 row 行|
+                    float center = a[0] * c.x + a[1] * c.y + a[2] * c.z + a[3];
+                    float extent = r * std::sqrt(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+                    lo[row] = std::min(lo[row], center - extent);
+                    hi[row] = std::max(hi[row], center + extent);
+                }
+            }
+            // 没有骨骼影响的簇（权重全为 0）不会被蒙皮移动，保留绑定包围球
+            if (meshlet.boneCount == 0) {
+                lo[0] = c.x - r; lo[1] = c.y - r; lo[2] = c.z - r;
+                hi[0] = c.x + r; hi[1] = c.y + r; hi[2] = c.z + r;
+            }
+            out[i].min = { lo[0], lo[1], lo[2] };
+            out[i].max = { hi[0], hi[1], hi[2] };
+        }
+    }
+
+    void ComputeBounds(const MeshletMesh& mesh, const float* palette, size_t boneStride, MeshletBounds* out, JobSystem* jobs)
+    {
+        size_t count = mesh.meshlets.size();
+        if (jobs && count > kBoundsGrain) {
+            jobs->ParallelFor(count, kBoundsGrain, [&](size_t begin, size_t end, int) {
+                ComputeBoundsRange(mesh, palette, boneStride, out, begin, end);
+            });
+        }
+        else {
+            ComputeBoundsRange(mesh, palette, boneStride, out, 0, count);
+        }
+    }
+}
+
+void BuildMeshlets(const PartitionedMesh& mesh, MeshletMesh& out)
+{
+    out.meshlets.clear();
+    out.bones.clear();
+
+    // 顶点是否已在当前 meshlet 中、骨骼是否已收集，都按代数比较，免清零
+    std::vector<uint32_t> vertexStamp(mesh.vertices.size(), 0);
+    std::vector<uint32_t> boneStamp;
+    uint32_t generation = 0;
+    std::vector<uint32_t> vertices;
+    std::vector<uint32_t> bones;
+    vertices.reserve(MESHLET_MAX_VERTICES);
+
+    for (size_t s = 0; s < mesh.submeshes.size(); ++s) {
+        const SkinnedSubmesh& submesh = mesh.submeshes[s];
+        for (size_t d = 0; d < submesh.draws.size(); ++d) {
+            const InfluenceDraw& draw = submesh.draws[d];
+            Meshlet meshlet;
+            meshlet.submesh = uint32_t(s);
+            meshlet.draw = uint32_t(d);
+            meshlet.indexStart = draw.indexStart;
+            ++generation;
+            vertices.clear();
+            bones.clear();
+
+            for (uint32_t i = draw.indexStart; i < draw.indexStart + draw.indexCount; i += 3) {
+                const uint32_t* tri = &mesh.indices[i];
+                int newVertices = 0;
+                for (int k = 0; k < 3; ++k) {
+                    if (vertexStamp[tri[k]] != generation && (k < 1 || tri[k] != tri[0]) && (k < 2 || tri[k] != tri[1]))
+                        ++newVertices;
+                }
+                if (meshlet.triangleCount > 0 && (meshlet.triangleCount + 1 > MESHLET_MAX_TRIANGLES ||
+                    vertices.size() + newVertices > MESHLET_MAX_VERTICES)) {
+                    FinishMeshlet(mesh, vertices, bones, meshlet, out);
+                    meshlet.indexStart = i;
+                    meshlet.triangleCount = 0;
+                    ++generation;
+                    vertices.clear();
+                    bones.clear();
+                }
+
+                for (int k = 0; k < 3; ++k) {
+                    uint32_t v = tri[k];
+                    if (vertexStamp[v] == generation)
+                        continue;
+                    vertexStamp[v] = generation;
+                    vertices.push_back(v);
+                    CollectBones(mesh.vertices[v], submesh.bonePalette, boneStamp, generation, bones);
+                    if (!mesh.extraInfluences.empty())
+                        CollectBones(mesh.extraInfluences[v], submesh.bonePalette, boneStamp, generation, bones);
+                }
+                ++meshlet.triangleCount;
+            }
+            if (meshlet.triangleCount > 0)
+                FinishMeshlet(mesh, vertices, bones, meshlet, out);
+        }
+    }
+}
+
+void ComputeMeshletBounds(const MeshletMesh& mesh, const aiMatrix4x4* palette, MeshletBounds* out, JobSystem* jobs)
+{
+    static_assert(sizeof(aiMatrix4x4) == 16 * sizeof(float), "aiMatrix4x4 must be 16 packed floats");
+    ComputeBounds(mesh, &palette->a1, 16, out, jobs);
+}
+
+void ComputeMeshletBounds(const MeshletMesh& mesh, const BoneMatrix3x4* palette, MeshletBounds* out, JobSystem* jobs)
+{
+    ComputeBounds(mesh, palette->rows[0], 12, out, jobs);
+}
+
+bool MeshletBoundsVisible(const MeshletBounds& bounds, const float planes[6][4])
+{
+    for (int i = 0; i < 6; ++i) {
+        const float* p = planes[i];
+        // 取包围盒在平面法线方向上最远的角点，它在外侧则整个盒子在外侧
+        float x = p[0] >= 0.0f ? bounds.max.x : bounds.min.x;
+        float y = p[1] >= 0.0f ? bounds.max.y : bounds.min.y;
+        float z = p[2] >= 0.0f ? bounds.max.z : bounds.min.z;
+        if (p[0] * x + p[1] * y + p[2] * z + p[3] < 0.0f)
+            return false;
+    }
+    return true;
+}
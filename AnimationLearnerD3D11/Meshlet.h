@@ -0,0 +1,59 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "BonePalette.h"
+#include "MeshPartition.h"
+
+class JobSystem;
+
+// 子网格级别的剔除：加载时把三角形切成小簇（meshlet），记录影响每簇的骨骼；
+// 每帧由这些骨骼的蒙皮矩阵求出保守的包围盒，视锥外的簇不绘制
+
+// 每个 meshlet 的顶点数与三角形数上限（与常见 mesh shader 的 64/124 一致）
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// draw 内连续的一段三角形，可直接作为 DrawIndexed 的子区间绘制
+struct Meshlet
+{
+    uint32_t submesh = 0;
+    uint32_t draw = 0;              // 所属子网格 draws 中的下标
+    uint32_t indexStart = 0;        // PartitionedMesh::indices 中的位置
+    uint32_t triangleCount = 0;
+    uint32_t vertexCount = 0;       // 引用的不同顶点数
+    uint32_t boneStart = 0;         // MeshletMesh::bones 中的区间
+    uint32_t boneCount = 0;
+    Float3 center;                  // 绑定姿态下的包围球
+    float radius = 0.0f;
+};
+
+struct MeshletMesh
+{
+    std::vector<Meshlet> meshlets;  // 按子网格、draw 的顺序排列，覆盖全部三角形
+    std::vector<uint32_t> bones;    // 每个 meshlet 的骨骼集合（全局骨骼下标，升序）
+};
+
+// 模型空间的轴对齐包围盒
+struct MeshletBounds
+{
+    Float3 min;
+    Float3 max;
+};
+
+// 在每个 draw 内按当前三角形顺序（顶点缓存优化后空间上相邻）顺序扫描，加入下一个三角形会超过
+// MESHLET_MAX_VERTICES / MESHLET_MAX_TRIANGLES 时开始新的 meshlet。
+// 骨骼集合为簇内顶点权重非零的骨骼（含 extraInfluences），局部槽位经子网格的 bonePalette 换算为全局下标
+void BuildMeshlets(const PartitionedMesh& mesh, MeshletMesh& out);
+
+// 线性混合蒙皮的位置是各骨骼变换结果的凸组合，而每个 M_b * p 都落在绑定包围球经 M_b 变换后的球内；
+// 对簇内每个骨骼取这个球的包围盒再求并集即为保守边界（DQS 的结果不在凸包内，不适用）。
+// palette 为按全局骨骼下标的完整调色板；提供 jobs 时按 meshlet 并行
+void ComputeMeshletBounds(const MeshletMesh& mesh, const aiMatrix4x4* palette, MeshletBounds* out, JobSystem* jobs = nullptr);
+
+// 同上，3x4 仿射调色板
+void ComputeMeshletBounds(const MeshletMesh& mesh, const BoneMatrix3x4* palette, MeshletBounds* out, JobSystem* jobs = nullptr);
+
+// planes 为模型空间的 6 个平面 (a, b, c, d)，内侧满足 a*x + b*y + c*z + d >= 0；
+// 包围盒完全在某个平面外侧时返回 false
+bool MeshletBoundsVisible(const MeshletBounds& bounds, const float planes[6][4]);
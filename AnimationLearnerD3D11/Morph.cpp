@@ -0,0 +1,280 @@
+﻿#include "Morph.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include "Animation.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MORPH_X86 1
+#include <immintrin.h>
+#endif
+
+// 与 Skinning.cpp 相同：GCC/Clang 按函数打开 AVX2 目标特性，运行时由 IsSkinningKernelSupported 检查
+#if defined(MORPH_X86) && !defined(_MSC_VER)
+#define MORPH_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define MORPH_TARGET_AVX2
+#endif
+
+#if defined(MORPH_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define MORPH_HAS_SSE 1
+#endif
+
+namespace
+{
+    static_assert(offsetof(MorphDelta, normal) == 4 * sizeof(float), "MorphDelta must be 8 packed floats");
+
+    // 位置与法线增量作为连续的 8 个 float 处理
+    inline float* DeltaFloats(MorphDelta& delta)
+    {
+        return delta.position;
+    }
+
+    inline const float* DeltaFloats(const MorphDelta& delta)
+    {
+        return delta.position;
+    }
+
+    void AccumulateScalar(const MorphTarget& target, float weight, MorphDelta* dense)
+    {
+        for (size_t i = 0; i < target.vertices.size(); ++i) {
+            const float* src = DeltaFloats(target.deltas[i]);
+            float* dst = DeltaFloats(dense[target.vertices[i]]);
+            for (int k = 0; k < 8; ++k)
+                dst[k] += weight * src[k];
+        }
+    }
+
+#if defined(MORPH_HAS_SSE)
+    void AccumulateSSE(const MorphTarget& target, float weight, MorphDelta* dense)
+    {
+        __m128 w = _mm_set1_ps(weight);
+        for (size_t i = 0; i < target.vertices.size(); ++i) {
+            const float* src = DeltaFloats(target.deltas[i]);
+            float* dst = DeltaFloats(dense[target.vertices[i]]);
+            _mm_storeu_ps(dst, _mm_add_ps(_mm_loadu_ps(dst), _mm_mul_ps(w, _mm_loadu_ps(src))));
+            _mm_storeu_ps(dst + 4, _mm_add_ps(_mm_loadu_ps(dst + 4), _mm_mul_ps(w, _mm_loadu_ps(src + 4))));
+        }
+    }
+#endif
+
+#if defined(MORPH_X86)
+    // 一个增量正好一个 256 位寄存器，每个顶点一次 FMA
+    MORPH_TARGET_AVX2
+    void AccumulateAVX2(const MorphTarget& target, float weight, MorphDelta* dense)
+    {
+        __m256 w = _mm256_set1_ps(weight);
+        for (size_t i = 0; i < target.vertices.size(); ++i) {
+            const float* src = DeltaFloats(target.deltas[i]);
+            float* dst = DeltaFloats(dense[target.vertices[i]]);
+            _mm256_storeu_ps(dst, _mm256_fmadd_ps(w, _mm256_loadu_ps(src), _mm256_loadu_ps(dst)));
+        }
+    }
+#endif
+
+    void AccumulateTarget(const MorphTarget& target, float weight, MorphDelta* dense, SkinningKernel kernel)
+    {
+        switch (kernel) {
+#if defined(MORPH_X86)
+        case SkinningKernel::AVX2:
+            AccumulateAVX2(target, weight, dense);
+            return;
+#endif
+#if defined(MORPH_HAS_SSE)
+        case SkinningKernel::SSE:
+            AccumulateSSE(target, weight, dense);
+            return;
+#endif
+        default:
+            AccumulateScalar(target, weight, dense);
+            return;
+        }
+    }
+
+    void RebuildTouchedVertices(MorphTargetSet& set)
+    {
+        std::vector<unsigned char> touched(set.vertexCount, 0);
+        for (const MorphTarget& target : set.targets)
+            for (uint32_t v : target.vertices)
+                touched[v] = 1;
+        set.touchedVertices.clear();
+        for (size_t v = 0; v < set.vertexCount; ++v)
+            if (touched[v])
+                set.touchedVertices.push_back(uint32_t(v));
+    }
+
+    float Length(const float* v)
+    {
+        return std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    }
+}
+
+size_t AddMorphTargets(const aiMesh* mesh, uint32_t baseVertex, MorphTargetSet& set)
+{
+    size_t firstTarget = set.targets.size();
+    set.vertexCount = std::max(set.vertexCount, size_t(baseVertex) + mesh->mNumVertices);
+
+    for (unsigned int a = 0; a < mesh->mNumAnimMeshes; ++a) {
+        const aiAnimMesh* animMesh = mesh->mAnimMeshes[a];
+        MorphTarget target;
+        target.name = animMesh->mName.length > 0 ? animMesh->mName.C_Str() : mesh->mName.C_Str() + std::string("#") + std::to_string(a);
+        target.defaultWeight = animMesh->mWeight;
+
+        bool hasPositions = animMesh->HasPositions();
+        bool hasNormals = animMesh->HasNormals() && mesh->HasNormals();
+        unsigned int count = std::min(animMesh->mNumVertices, mesh->mNumVertices);
+        for (unsigned int v = 0; v < count; ++v) {
+            MorphDelta delta;
+            if (hasPositions) {
+                aiVector3D d = animMesh->mVertices[v] - mesh->mVertices[v];
+                delta.position[0] = d.x; delta.position[1] = d.y; delta.position[2] = d.z;
+            }
+            if (hasNormals) {
+                aiVector3D d = animMesh->mNormals[v] - mesh->mNormals[v];
+                delta.normal[0] = d.x; delta.normal[1] = d.y; delta.normal[2] = d.z;
+            }
+
+            bool zero = true;
+            for (int k = 0; k < 3; ++k)
+                zero = zero && std::fabs(delta.position[k]) <= MORPH_DELTA_EPSILON && std::fabs(delta.normal[k]) <= MORPH_DELTA_EPSILON;
+            if (zero)
+                continue;
+            target.vertices.push_back(baseVertex + v);
+            target.deltas.push_back(delta);
+            target.maxDisplacement = std::max(target.maxDisplacement, Length(delta.position));
+        }
+        set.targets.push_back(std::move(target));
+    }
+
+    RebuildTouchedVertices(set);
+    return firstTarget;
+}
+
+void AddMorphWeightTracks(const aiMeshMorphAnim* channel, size_t firstTarget, size_t targetCount, MorphTargetSet& set)
+{
+    if (channel->mNumKeys == 0)
+        return;
+    targetCount = std::min(targetCount, set.targets.size() - std::min(firstTarget, set.targets.size()));
+
+    // 先给每个目标补齐每一帧（未列出为 0），相邻帧可以直接插值
+    for (size_t t = 0; t < targetCount; ++t) {
+        std::vector<MorphWeightKey>& track = set.targets[firstTarget + t].weights;
+        track.assign(channel->mNumKeys, MorphWeightKey());
+        for (unsigned int k = 0; k < channel->mNumKeys; ++k)
+            track[k].mTime = channel->mKeys[k].mTime;
+    }
+    for (unsigned int k = 0; k < channel->mNumKeys; ++k) {
+        const aiMeshMorphKey& key = channel->mKeys[k];
+        for (unsigned int i = 0; i < key.mNumValuesAndWeights; ++i) {
+            if (key.mValues[i] < targetCount)
+                set.targets[firstTarget + key.mValues[i]].weights[k].mValue = float(key.mWeights[i]);
+        }
+    }
+}
+
+void SampleMorphWeights(const MorphTargetSet& set, float animTime, float* weights)
+{
+    for (size_t t = 0; t < set.targets.size(); ++t) {
+        const std::vector<MorphWeightKey>& keys = set.targets[t].weights;
+        if (keys.empty()) {
+            weights[t] = set.targets[t].defaultWeight;
+            continue;
+        }
+        if (keys.size() == 1) {
+            weights[t] = keys[0].mValue;
+            continue;
+        }
+        size_t i = FindKeyIndex(keys, animTime);
+        float t0 = float(keys[i].mTime);
+        float t1 = float(keys[i + 1].mTime);
+        float factor = t1 > t0 ? std::min(std::max((animTime - t0) / (t1 - t0), 0.0f), 1.0f) : 0.0f;
+        weights[t] = keys[i].mValue + (keys[i + 1].mValue - keys[i].mValue) * factor;
+    }
+}
+
+void RemapMorphTargets(const MorphTargetSet& in, const std::vector<uint32_t>& sourceVertices, MorphTargetSet& out)
+{
+    // 原顶点 -> 新顶点的一对多映射，按原顶点分组（CSR）
+    std::vector<uint32_t> start(in.vertexCount + 1, 0);
+    for (uint32_t source : sourceVertices)
+        if (source < in.vertexCount)
+            ++start[source + 1];
+    for (size_t v = 0; v < in.vertexCount; ++v)
+        start[v + 1] += start[v];
+    std::vector<uint32_t> copies(start.back());
+    std::vector<uint32_t> next(start.begin(), start.end() - 1);
+    for (size_t v = 0; v < sourceVertices.size(); ++v)
+        if (sourceVertices[v] < in.vertexCount)
+            copies[next[sourceVertices[v]]++] = uint32_t(v);
+
+    out = MorphTargetSet();
+    out.vertexCount = sourceVertices.size();
+    std::vector<std::pair<uint32_t, MorphDelta>> entries;
+    for (const MorphTarget& target : in.targets) {
+        MorphTarget remapped;
+        remapped.name = target.name;
+        remapped.defaultWeight = target.defaultWeight;
+        remapped.weights = target.weights;
+        remapped.maxDisplacement = target.maxDisplacement;
+
+        // 保持升序，累加时写入沿缓存行前进
+        entries.clear();
+        for (size_t i = 0; i < target.vertices.size(); ++i) {
+            uint32_t source = target.vertices[i];
+            for (uint32_t c = start[source]; c < start[source + 1]; ++c)
+                entries.push_back(std::make_pair(copies[c], target.deltas[i]));
+        }
+        std::sort(entries.begin(), entries.end(),
+            [](const std::pair<uint32_t, MorphDelta>& a, const std::pair<uint32_t, MorphDelta>& b) { return a.first < b.first; });
+        remapped.vertices.reserve(entries.size());
+        remapped.deltas.reserve(entries.size());
+        for (const auto& entry : entries) {
+            remapped.vertices.push_back(entry.first);
+            remapped.deltas.push_back(entry.second);
+        }
+        out.targets.push_back(std::move(remapped));
+    }
+    RebuildTouchedVertices(out);
+}
+
+void ComputeMorphDisplacementBounds(const MorphTargetSet& set, std::vector<float>& out)
+{
+    out.assign(set.vertexCount, 0.0f);
+    for (const MorphTarget& target : set.targets)
+        for (size_t i = 0; i < target.vertices.size(); ++i)
+            out[target.vertices[i]] += Length(target.deltas[i].position);
+}
+
+size_t AccumulateMorphDeltas(const MorphTargetSet& set, const float* weights, MorphDelta* dense, SkinningKernel kernel)
+{
+    if (!IsSkinningKernelSupported(kernel))
+        kernel = SkinningKernel::Scalar;
+
+    for (uint32_t v : set.touchedVertices)
+        dense[v] = MorphDelta();
+
+    size_t active = 0;
+    for (size_t t = 0; t < set.targets.size(); ++t) {
+        if (std::fabs(weights[t]) < MORPH_WEIGHT_EPSILON || set.targets[t].vertices.empty())
+            continue;
+        AccumulateTarget(set.targets[t], weights[t], dense, kernel);
+        ++active;
+    }
+    return active;
+}
+
+void ApplyMorphDeltas(const Vertex* vertices, size_t count, const MorphDelta* dense, Vertex* out)
+{
+    for (size_t v = 0; v < count; ++v) {
+        Vertex vert = vertices[v];
+        const MorphDelta& d = dense[v];
+        vert.position.x += d.position[0];
+        vert.position.y += d.position[1];
+        vert.position.z += d.position[2];
+        Float3 n = { vert.normal.x + d.normal[0], vert.normal.y + d.normal[1], vert.normal.z + d.normal[2] };
+        float length = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+        if (length > 0.0f)
+            vert.normal = { n.x / length, n.y / length, n.z / length };
+        out[v] = vert;
+    }
+}
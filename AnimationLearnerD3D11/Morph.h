@@ -0,0 +1,77 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <assimp/anim.h>
+#include <assimp/mesh.h>
+#include "Skinning.h"
+#include "Vertex.h"
+
+// 变形目标（blend shape）：aiMesh::mAnimMeshes 存的是整网格的绝对位置/法线，这里转成只含非零增量的稀疏列表；
+// 每帧按权重把各目标的增量累加到一个稠密的增量数组（只清零被任何目标触及的顶点），跳过权重接近 0 的目标。
+// 结果在蒙皮之前叠加到绑定姿态的位置和法线上（GPU 为顶点流槽2）
+
+// 权重绝对值小于它的目标本帧不参与累加
+#define MORPH_WEIGHT_EPSILON 1e-3f
+// 位置和法线增量的各分量绝对值都不超过它的顶点视为未被该目标改变
+#define MORPH_DELTA_EPSILON 1e-6f
+
+// 一个顶点的位置与法线增量，w 分量为 0。32 字节正好一个 AVX 寄存器，也是槽2顶点流的格式
+struct MorphDelta
+{
+    float position[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    float normal[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+};
+
+static_assert(sizeof(MorphDelta) == 32, "MorphDelta must match the D3D11 input layout");
+
+// 权重关键帧，字段名与 assimp 的关键帧一致，可以直接用 FindKeyIndex 查找
+struct MorphWeightKey
+{
+    double mTime = 0.0;
+    float mValue = 0.0f;
+};
+
+struct MorphTarget
+{
+    std::string name;
+    std::vector<uint32_t> vertices;     // 增量非零的顶点，升序
+    std::vector<MorphDelta> deltas;     // 与 vertices 一一对应
+    float defaultWeight = 0.0f;         // 没有权重轨道时使用（aiAnimMesh::mWeight）
+    std::vector<MorphWeightKey> weights;    // 权重轨道，为空时用 defaultWeight
+    float maxDisplacement = 0.0f;       // 权重为 1 时最大的位置增量长度
+};
+
+struct MorphTargetSet
+{
+    std::vector<MorphTarget> targets;
+    std::vector<uint32_t> touchedVertices;  // 被任一目标改变的顶点（升序），每帧累加前只清零这些
+    size_t vertexCount = 0;                 // 稠密增量数组的长度
+};
+
+// 读取 mesh 的全部 aiAnimMesh，顶点下标加上 baseVertex（合并后的网格中的位置），追加到 set；
+// 返回该 mesh 第一个目标在 set.targets 中的下标
+size_t AddMorphTargets(const aiMesh* mesh, uint32_t baseVertex, MorphTargetSet& set);
+
+// 把 aiMeshMorphAnim 的关键帧（每帧列出若干目标及其权重）拆成每个目标一条轨道。
+// 目标下标 mValues[i] 相对 firstTarget（AddMorphTargets 的返回值），超出 targetCount 的忽略；
+// 某帧未列出的目标在该帧的权重为 0
+void AddMorphWeightTracks(const aiMeshMorphAnim* channel, size_t firstTarget, size_t targetCount, MorphTargetSet& set);
+
+// 与骨骼通道相同的采样：FindKeyIndex 找到区间后线性插值，时间在首尾之外时取端点值。weights 至少 targets.size() 个
+void SampleMorphWeights(const MorphTargetSet& set, float animTime, float* weights);
+
+// 顶点重排、复制（子网格划分）后重建：sourceVertices[新顶点] = 原顶点，一个原顶点可以对应多个新顶点
+void RemapMorphTargets(const MorphTargetSet& in, const std::vector<uint32_t>& sourceVertices, MorphTargetSet& out);
+
+// 每个顶点在权重不超过 1 时可能的最大位移：各目标位置增量长度之和，用于放大静态包围体。out 长度为 vertexCount
+void ComputeMorphDisplacementBounds(const MorphTargetSet& set, std::vector<float>& out);
+
+// 把 touchedVertices 清零后累加 |weight| >= MORPH_WEIGHT_EPSILON 的目标：dense[v] += weight * delta。
+// dense 至少 vertexCount 个，未被任何目标触及的顶点保持不变（应为 0）。返回参与累加的目标数
+size_t AccumulateMorphDeltas(const MorphTargetSet& set, const float* weights, MorphDelta* dense,
+    SkinningKernel kernel = BestSkinningKernel());
+
+// 供 CPU 端使用：out[v] 为 vertices[v] 叠加增量后的顶点（法线重新归一化），out 可以与 vertices 相同
+void ApplyMorphDeltas(const Vertex* vertices, size_t count, const MorphDelta* dense, Vertex* out);
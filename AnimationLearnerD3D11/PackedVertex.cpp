@@ -0,0 +1,413 @@
+﻿#include "PackedVertex.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    float SignNotZero(float v)
+    {
+        return v >= 0.0f ? 1.0f : -1.0f;
+    }
+
+    int16_t ToSnorm16(float v)
+    {
+        return int16_t(std::lround(std::min(std::max(v, -1.0f), 1.0f) * 32767.0f));
+    }
+
+    // 与 D3D 的 SNORM 解码一致：-32768 也映射为 -1
+    float FromSnorm16(int16_t v)
+    {
+        return std::max(float(v) / 32767.0f, -1.0f);
+    }
+
+    uint16_t ToUnorm16(float v)
+    {
+        return uint16_t(std::lround(std::min(std::max(v, 0.0f), 1.0f) * 65535.0f));
+    }
+
+    // 把 [0, 1] 权重量化到 [0, maxValue]：各分量先四舍五入，再把分量之和修正为四个权重实际之和的量化值。
+    // 8 影响顶点的前 4 个权重之和小于 1，不能补到 maxValue。修正只改舍入误差最大的分量，每个分量最多一个单位，
+    // 源权重为 0 的槽位（下标写 0）始终为 0
+    void QuantizeWeights(const float* weights, uint32_t maxValue, uint32_t* out)
+    {
+        float errors[4];
+        bool adjusted[4] = {};
+        int64_t sum = 0;
+        float total = 0.0f;
+        for (int i = 0; i < 4; ++i) {
+            float scaled = std::min(std::max(weights[i], 0.0f), 1.0f) * float(maxValue);
+            out[i] = uint32_t(std::lround(scaled));
+            errors[i] = float(out[i]) - scaled;
+            sum += out[i];
+            total += scaled;
+        }
+        int64_t target = std::min(int64_t(std::llround(total)), int64_t(maxValue));
+        // 多出的单位从向上舍入最多的分量减去，不足的单位加给向下舍入最多的非零分量
+        while (sum != target) {
+            bool over = sum > target;
+            int best = -1;
+            for (int i = 0; i < 4; ++i) {
+                bool candidate = !adjusted[i] && (over ? out[i] > 0 : weights[i] > 0.0f && out[i] < maxValue);
+                if (candidate && (best < 0 || (over ? errors[i] > errors[best] : errors[i] < errors[best])))
+                    best = i;
+            }
+            if (best < 0)
+                break;
+            out[best] = over ? out[best] - 1 : out[best] + 1;
+            adjusted[best] = true;
+            sum += over ? -1 : 1;
+        }
+    }
+
+    float Distance(const Float3& a, const Float3& b)
+    {
+        float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+        return std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+}
+
+PackedVertexFormat MakePackedVertexFormat(bool quantizedPosition, bool wideBoneIndices, bool wideWeights)
+{
+    PackedVertexFormat format;
+    format.quantizedPosition = quantizedPosition;
+    format.wideBoneIndices = wideBoneIndices;
+    format.wideWeights = wideWeights;
+
+    uint32_t offset = 0;
+    format.positionOffset = offset;
+    offset += quantizedPosition ? 8 : 12;
+    format.normalOffset = offset;
+    offset += 4;
+    format.texcoordOffset = offset;
+    offset += 4;
+    format.boneIndicesOffset = offset;
+    offset += wideBoneIndices ? 8 : 4;
+    format.boneWeightsOffset = offset;
+    offset += wideWeights ? 8 : 4;
+    format.stride = offset;
+    return format;
+}
+
+uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t exponent = (bits >> 23) & 0xffu;
+    uint32_t mantissa = bits & 0x7fffffu;
+
+    if (exponent == 0xffu)  // Inf / NaN
+        return uint16_t(sign | 0x7c00u | (mantissa ? 0x200u : 0u));
+
+    int halfExponent = int(exponent) - 127 + 15;
+    if (halfExponent >= 0x1f)  // 溢出为 Inf
+        return uint16_t(sign | 0x7c00u);
+
+    if (halfExponent <= 0) {
+        // 非规格化数或下溢为 0
+        if (halfExponent < -10)
+            return uint16_t(sign);
+        mantissa |= 0x800000u;
+        uint32_t shift = uint32_t(14 - halfExponent);
+        uint32_t halfMantissa = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1u);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (halfMantissa & 1u)))
+            ++halfMantissa;
+        return uint16_t(sign | halfMantissa);
+    }
+
+    uint32_t half = sign | (uint32_t(halfExponent) << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1fffu;
+    // 就近舍入到偶数；进位可能进到指数位，结果仍然正确（最大时变为 Inf）
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u)))
+        ++half;
+    return uint16_t(half);
+}
+
+float HalfToFloat(uint16_t value)
+{
+    uint32_t sign = uint32_t(value & 0x8000u) << 16;
+    uint32_t exponent = (value >> 10) & 0x1fu;
+    uint32_t mantissa = value & 0x3ffu;
+    uint32_t bits;
+
+    if (exponent == 0) {
+        if (mantissa == 0) {
+            bits = sign;
+        }
+        else {
+            // 非规格化数：规格化后再转换
+            int e = -1;
+            do {
+                ++e;
+                mantissa <<= 1;
+            } while ((mantissa & 0x400u) == 0);
+            bits = sign | (uint32_t(127 - 15 - e) << 23) | ((mantissa & 0x3ffu) << 13);
+        }
+    }
+    else if (exponent == 0x1f) {
+        bits = sign | 0x7f800000u | (mantissa << 13);
+    }
+    else {
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    }
+
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+void EncodeOctahedral(const Float3& n, int16_t out[2])
+{
+    float l1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    if (l1 <= 0.0f) {
+        out[0] = out[1] = 0;
+        return;
+    }
+    float x = n.x / l1;
+    float y = n.y / l1;
+    // 下半球沿对角线折到外侧的四个三角形
+    if (n.z < 0.0f) {
+        float foldedX = (1.0f - std::fabs(y)) * SignNotZero(x);
+        float foldedY = (1.0f - std::fabs(x)) * SignNotZero(y);
+        x = foldedX;
+        y = foldedY;
+    }
+    out[0] = ToSnorm16(x);
+    out[1] = ToSnorm16(y);
+}
+
+Float3 DecodeOctahedral(const int16_t in[2])
+{
+    float x = FromSnorm16(in[0]);
+    float y = FromSnorm16(in[1]);
+    float z = 1.0f - std::fabs(x) - std::fabs(y);
+    if (z < 0.0f) {
+        float unfoldedX = (1.0f - std::fabs(y)) * SignNotZero(x);
+        float unfoldedY = (1.0f - std::fabs(x)) * SignNotZero(y);
+        x = unfoldedX;
+        y = unfoldedY;
+    }
+    float length = std::sqrt(x * x + y * y + z * z);
+    return { x / length, y / length, z / length };
+}
+
+void PackVertices(const Vertex* vertices, size_t count, const PackedVertexFormat& format, PackedVertexBuffer& out,
+    const std::vector<PositionQuantization>& ranges)
+{
+    out.format = format;
+    out.count = count;
+    out.data.assign(count * format.stride, 0);
+    out.positionRanges.clear();
+
+    if (format.quantizedPosition) {
+        out.positionRanges = ranges;
+        if (out.positionRanges.empty()) {
+            PositionQuantization whole;
+            whole.vertexCount = uint32_t(count);
+            out.positionRanges.push_back(whole);
+        }
+        for (PositionQuantization& range : out.positionRanges) {
+            assert(size_t(range.vertexStart) + range.vertexCount <= count);
+            range.scale = 1.0f;
+            range.offset = { 0.0f, 0.0f, 0.0f };
+            range.maxError = 0.0f;
+            if (range.vertexCount == 0)
+                continue;
+            const Vertex* first = vertices + range.vertexStart;
+            Float3 lo = first->position, hi = first->position;
+            for (uint32_t v = 1; v < range.vertexCount; ++v) {
+                const Float3& p = first[v].position;
+                lo = { std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z) };
+                hi = { std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z) };
+            }
+            float extent = std::max(std::max(hi.x - lo.x, hi.y - lo.y), hi.z - lo.z);
+            range.offset = lo;
+            range.scale = extent > 0.0f ? extent : 1.0f;   // 退化为一个点时避免除以 0
+        }
+    }
+
+    uint32_t maxIndex = format.wideBoneIndices ? 0xffffu : 0xffu;
+    size_t rangeIndex = 0;
+    for (size_t v = 0; v < count; ++v) {
+        const Vertex& vert = vertices[v];
+        uint8_t* dst = out.data.data() + v * format.stride;
+
+        if (format.quantizedPosition) {
+            while (v >= size_t(out.positionRanges[rangeIndex].vertexStart) + out.positionRanges[rangeIndex].vertexCount)
+                ++rangeIndex;
+            PositionQuantization& range = out.positionRanges[rangeIndex];
+            const Float3& p = vert.position;
+            uint16_t q[4] = {
+                ToUnorm16((p.x - range.offset.x) / range.scale),
+                ToUnorm16((p.y - range.offset.y) / range.scale),
+                ToUnorm16((p.z - range.offset.z) / range.scale),
+                0,
+            };
+            std::memcpy(dst + format.positionOffset, q, sizeof(q));
+
+            // 按解码方式计算误差，与 UnpackVertices 的结果一致
+            Float3 decoded = {
+                float(q[0]) / 65535.0f * range.scale + range.offset.x,
+                float(q[1]) / 65535.0f * range.scale + range.offset.y,
+                float(q[2]) / 65535.0f * range.scale + range.offset.z,
+            };
+            range.maxError = std::max(range.maxError, Distance(p, decoded));
+        }
+        else {
+            std::memcpy(dst + format.positionOffset, &vert.position, sizeof(Float3));
+        }
+
+        int16_t normal[2];
+        EncodeOctahedral(vert.normal, normal);
+        std::memcpy(dst + format.normalOffset, normal, sizeof(normal));
+
+        uint16_t texcoord[2] = { FloatToHalf(vert.texcoord.x), FloatToHalf(vert.texcoord.y) };
+        std::memcpy(dst + format.texcoordOffset, texcoord, sizeof(texcoord));
+
+        uint32_t weights[4];
+        QuantizeWeights(vert.boneWeights, format.wideWeights ? 0xffffu : 0xffu, weights);
+        for (int i = 0; i < 4; ++i) {
+            // 权重为 0 的槽位下标无关紧要，写 0 以免超出格式范围
+            uint32_t bone = vert.boneWeights[i] != 0.0f ? vert.boneIndices[i] : 0;
+            assert(bone <= maxIndex);
+            (void)maxIndex;
+            if (format.wideBoneIndices) {
+                uint16_t index = uint16_t(bone);
+                std::memcpy(dst + format.boneIndicesOffset + i * 2, &index, sizeof(index));
+            }
+            else {
+                dst[format.boneIndicesOffset + i] = uint8_t(bone);
+            }
+            if (format.wideWeights) {
+                uint16_t weight = uint16_t(weights[i]);
+                std::memcpy(dst + format.boneWeightsOffset + i * 2, &weight, sizeof(weight));
+            }
+            else {
+                dst[format.boneWeightsOffset + i] = uint8_t(weights[i]);
+            }
+        }
+    }
+}
+
+void UnpackVertices(const PackedVertexBuffer& packed, size_t first, size_t count, Vertex* out)
+{
+    const PackedVertexFormat& format = packed.format;
+    size_t rangeIndex = 0;
+    for (size_t v = 0; v < count; ++v) {
+        const uint8_t* src = packed.data.data() + (first + v) * format.stride;
+        Vertex& vert = out[v];
+
+        if (format.quantizedPosition) {
+            const std::vector<PositionQuantization>& ranges = packed.positionRanges;
+            while (first + v >= size_t(ranges[rangeIndex].vertexStart) + ranges[rangeIndex].vertexCount)
+                ++rangeIndex;
+            const PositionQuantization& range = ranges[rangeIndex];
+            uint16_t q[4];
+            std::memcpy(q, src + format.positionOffset, sizeof(q));
+            vert.position = {
+                float(q[0]) / 65535.0f * range.scale + range.offset.x,
+                float(q[1]) / 65535.0f * range.scale + range.offset.y,
+                float(q[2]) / 65535.0f * range.scale + range.offset.z,
+            };
+        }
+        else {
+            std::memcpy(&vert.position, src + format.positionOffset, sizeof(Float3));
+        }
+
+        int16_t normal[2];
+        std::memcpy(normal, src + format.normalOffset, sizeof(normal));
+        vert.normal = DecodeOctahedral(normal);
+
+        uint16_t texcoord[2];
+        std::memcpy(texcoord, src + format.texcoordOffset, sizeof(texcoord));
+        vert.texcoord = { HalfToFloat(texcoord[0]), HalfToFloat(texcoord[1]) };
+
+        for (int i = 0; i < 4; ++i) {
+            if (format.wideBoneIndices) {
+                uint16_t index;
+                std::memcpy(&index, src + format.boneIndicesOffset + i * 2, sizeof(index));
+                vert.boneIndices[i] = index;
+            }
+            else {
+                vert.boneIndices[i] = src[format.boneIndicesOffset + i];
+            }
+            if (format.wideWeights) {
+                uint16_t weight;
+                std::memcpy(&weight, src + format.boneWeightsOffset + i * 2, sizeof(weight));
+                vert.boneWeights[i] = float(weight) / 65535.0f;
+            }
+            else {
+                vert.boneWeights[i] = float(src[format.boneWeightsOffset + i]) / 255.0f;
+            }
+        }
+    }
+}
+
+float MaxQuantizationError(const PackedVertexBuffer& packed)
+{
+    float maxError = 0.0f;
+    for (const PositionQuantization& range : packed.positionRanges)
+        maxError = std::max(maxError, range.maxError);
+    return maxError;
+}
+
+aiMatrix4x4 FoldPositionQuantization(const aiMatrix4x4& m, const PositionQuantization& quantization)
+{
+    // M * T(offset) * S(scale)：前三列乘 scale，平移列加上 M 变换后的 offset
+    const Float3& o = quantization.offset;
+    float s = quantization.scale;
+    aiMatrix4x4 r = m;
+    r.a1 *= s; r.a2 *= s; r.a3 *= s;
+    r.b1 *= s; r.b2 *= s; r.b3 *= s;
+    r.c1 *= s; r.c2 *= s; r.c3 *= s;
+    r.d1 *= s; r.d2 *= s; r.d3 *= s;
+    r.a4 += m.a1 * o.x + m.a2 * o.y + m.a3 * o.z;
+    r.b4 += m.b1 * o.x + m.b2 * o.y + m.b3 * o.z;
+    r.c4 += m.c1 * o.x + m.c2 * o.y + m.c3 * o.z;
+    r.d4 += m.d1 * o.x + m.d2 * o.y + m.d3 * o.z;
+    return r;
+}
+
+BoneMatrix3x4 FoldPositionQuantization(const BoneMatrix3x4& m, const PositionQuantization& quantization)
+{
+    const Float3& o = quantization.offset;
+    float s = quantization.scale;
+    BoneMatrix3x4 r = m;
+    for (int row = 0; row < 3; ++row) {
+        r.rows[row][0] = m.rows[row][0] * s;
+        r.rows[row][1] = m.rows[row][1] * s;
+        r.rows[row][2] = m.rows[row][2] * s;
+        r.rows[row][3] = m.rows[row][3] + m.rows[row][0] * o.x + m.rows[row][1] * o.y + m.rows[row][2] * o.z;
+    }
+    return r;
+}
+
+PackingError MeasurePackingError(const std::vector<Vertex>& vertices, const PackedVertexBuffer& packed)
+{
+    PackingError error;
+    Vertex decoded;
+    for (size_t v = 0; v < vertices.size() && v < packed.count; ++v) {
+        UnpackVertices(packed, v, 1, &decoded);
+        const Vertex& original = vertices[v];
+
+        error.position = std::max(error.position, Distance(original.position, decoded.position));
+
+        const Float3& a = original.normal;
+        float lengthSq = a.x * a.x + a.y * a.y + a.z * a.z;
+        if (lengthSq > 0.0f) {
+            float cosine = (a.x * decoded.normal.x + a.y * decoded.normal.y + a.z * decoded.normal.z) / std::sqrt(lengthSq);
+            float degrees = std::acos(std::min(std::max(cosine, -1.0f), 1.0f)) * 57.2957795f;
+            error.normalDegrees = std::max(error.normalDegrees, degrees);
+        }
+
+        error.texcoord = std::max(error.texcoord, std::max(std::fabs(original.texcoord.x - decoded.texcoord.x),
+            std::fabs(original.texcoord.y - decoded.texcoord.y)));
+        for (int i = 0; i < 4; ++i)
+            error.weight = std::max(error.weight, std::fabs(original.boneWeights[i] - decoded.boneWeights[i]));
+    }
+    return error;
+}
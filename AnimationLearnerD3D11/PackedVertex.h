@@ -0,0 +1,83 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "BonePalette.h"
+#include "Vertex.h"
+
+// 压缩蒙皮顶点：八面体编码的 SNORM16 法线、半精度 UV、8/16 位骨骼下标、UNORM8/16 权重，位置可选量化为所在网格包围盒内的 UNORM16。
+// 默认（8 位下标、UNORM8 权重、float 位置）每顶点 28 字节，量化位置时 24 字节，Vertex 为 64 字节。
+// 第 5~8 个影响仍使用 VertexInfluences 顶点流，不在压缩格式中
+
+struct PackedVertexFormat
+{
+    bool quantizedPosition = false;  // 位置存为所在区间包围盒内的 UNORM16 x4（w 未用），否则 float3
+    bool wideBoneIndices = false;    // 16 位骨骼下标（调色板超过 256 项时需要），否则 8 位
+    bool wideWeights = false;        // UNORM16 权重，否则 UNORM8
+
+    // 各属性的字节偏移与每顶点字节数，由 MakePackedVertexFormat 计算
+    uint32_t positionOffset = 0;
+    uint32_t normalOffset = 0;
+    uint32_t texcoordOffset = 0;
+    uint32_t boneIndicesOffset = 0;
+    uint32_t boneWeightsOffset = 0;
+    uint32_t stride = 0;
+};
+
+PackedVertexFormat MakePackedVertexFormat(bool quantizedPosition, bool wideBoneIndices, bool wideWeights);
+
+// 位置量化误差的默认上限（模型单位），超过时放弃量化、位置保留 float3
+#define POSITION_QUANTIZATION_TOLERANCE 0.01f
+
+// 一段顶点（通常是一个子网格）的位置量化：p = q * scale + offset，q 在 [0, 1]。
+// 三个轴共用 scale（取包围盒最长边），还原折进蒙皮矩阵后法线只被整体缩放，归一化后不变
+struct PositionQuantization
+{
+    uint32_t vertexStart = 0;
+    uint32_t vertexCount = 0;
+    float scale = 1.0f;
+    Float3 offset = { 0.0f, 0.0f, 0.0f };
+    float maxError = 0.0f;      // 本段量化后的最大位置误差
+};
+
+struct PackedVertexBuffer
+{
+    PackedVertexFormat format;
+    size_t count = 0;
+    std::vector<uint8_t> data;                          // count * format.stride 字节
+    std::vector<PositionQuantization> positionRanges;   // 量化位置时按顶点顺序覆盖全部顶点，否则为空
+};
+
+// 压缩前后的最大误差
+struct PackingError
+{
+    float position = 0.0f;        // 模型单位
+    float normalDegrees = 0.0f;
+    float texcoord = 0.0f;
+    float weight = 0.0f;
+};
+
+// 权重解码后的和等于原四个权重之和的量化值（4 影响时为 1），权重为 0 的槽位仍为 0；骨骼下标超出格式范围时断言。
+// 量化位置时 ranges 给出各自计算包围盒的顶点区间（只读 vertexStart / vertexCount，按顺序覆盖全部顶点），为空时整体一段
+void PackVertices(const Vertex* vertices, size_t count, const PackedVertexFormat& format, PackedVertexBuffer& out,
+    const std::vector<PositionQuantization>& ranges = std::vector<PositionQuantization>());
+
+// 各量化区间中最大的位置误差，未量化时为 0
+float MaxQuantizationError(const PackedVertexBuffer& packed);
+
+// 把位置还原右乘进蒙皮矩阵：M' = M * T(offset) * S(scale)，着色器直接用 [0, 1] 的 q 蒙皮，不再逐顶点还原
+aiMatrix4x4 FoldPositionQuantization(const aiMatrix4x4& m, const PositionQuantization& quantization);
+BoneMatrix3x4 FoldPositionQuantization(const BoneMatrix3x4& m, const PositionQuantization& quantization);
+
+// 解码 [first, first + count) 到 Vertex，CPU 端各蒙皮路径用它读取压缩数据
+void UnpackVertices(const PackedVertexBuffer& packed, size_t first, size_t count, Vertex* out);
+
+PackingError MeasurePackingError(const std::vector<Vertex>& vertices, const PackedVertexBuffer& packed);
+
+// IEEE 754 半精度转换（就近舍入）
+uint16_t FloatToHalf(float value);
+float HalfToFloat(uint16_t value);
+
+// 八面体编码：单位向量投影到八面体再展开到 [-1, 1]^2，存为两个 SNORM16
+void EncodeOctahedral(const Float3& n, int16_t out[2]);
+Float3 DecodeOctahedral(const int16_t in[2]);
@@ -0,0 +1,405 @@
+﻿#include "PackedVertex.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// PackedVertex 的独立测试，不参与工程的构建（vcxproj 中 ExcludedFromBuild）。只用到 assimp 的头文件，任意平台上：
+//   g++ -std=c++14 -IThirdParty/include PackedVertexTest.cpp PackedVertex.cpp && ./a.out
+// 全部通过时返回 0
+
+namespace
+{
+    int g_failures = 0;
+
+    void Check(bool condition, const char* test, const char* what)
+    {
+        if (!condition) {
+            std::printf("[PackedVertexTest] %s: %s\n", test, what);
+            ++g_failures;
+        }
+    }
+
+    // [0, 1) 的均匀分布；不用 std::uniform_real_distribution，它的结果依赖标准库实现
+    float Uniform(std::mt19937& rng)
+    {
+        return float(rng() >> 8) / 16777216.0f;
+    }
+
+    Float3 RandomDirection(std::mt19937& rng)
+    {
+        for (;;) {
+            Float3 d = { Uniform(rng) * 2.0f - 1.0f, Uniform(rng) * 2.0f - 1.0f, Uniform(rng) * 2.0f - 1.0f };
+            float lengthSq = d.x * d.x + d.y * d.y + d.z * d.z;
+            if (lengthSq > 1e-4f && lengthSq <= 1.0f) {
+                float length = std::sqrt(lengthSq);
+                return { d.x / length, d.y / length, d.z / length };
+            }
+        }
+    }
+
+    // 两个方向的夹角（度），用 atan2 在双精度下计算，小角度时不受 acos 精度限制
+    double AngleDegrees(const Float3& a, const Float3& b)
+    {
+        double cx = double(a.y) * b.z - double(a.z) * b.y;
+        double cy = double(a.z) * b.x - double(a.x) * b.z;
+        double cz = double(a.x) * b.y - double(a.y) * b.x;
+        double dot = double(a.x) * b.x + double(a.y) * b.y + double(a.z) * b.z;
+        return std::atan2(std::sqrt(cx * cx + cy * cy + cz * cz), dot) * 57.29577951308232;
+    }
+
+    uint32_t FloatBits(float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    // 八面体法线：坐标轴、八个卦限的对角线（包括下半球的折叠）和随机方向，解码后的夹角不超过 SNORM16 的精度
+    void TestOctahedral()
+    {
+        std::vector<Float3> directions = {
+            { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+        };
+        for (int octant = 0; octant < 8; ++octant) {
+            float k = 1.0f / std::sqrt(3.0f);
+            directions.push_back({ octant & 1 ? -k : k, octant & 2 ? -k : k, octant & 4 ? -k : k });
+        }
+        std::mt19937 rng(39);
+        for (int i = 0; i < 20000; ++i)
+            directions.push_back(RandomDirection(rng));
+
+        double maxDegrees = 0.0;
+        float maxLengthError = 0.0f;
+        for (const Float3& n : directions) {
+            int16_t encoded[2];
+            EncodeOctahedral(n, encoded);
+            Float3 decoded = DecodeOctahedral(encoded);
+            maxDegrees = std::max(maxDegrees, AngleDegrees(n, decoded));
+            float length = std::sqrt(decoded.x * decoded.x + decoded.y * decoded.y + decoded.z * decoded.z);
+            maxLengthError = std::max(maxLengthError, std::fabs(length - 1.0f));
+        }
+        std::printf("[PackedVertexTest] octahedral: max error %.2e deg over %zu directions\n", maxDegrees, directions.size());
+        Check(maxDegrees < 0.01, "octahedral", "normal error above 0.01 degrees");
+        Check(maxLengthError < 1e-6f, "octahedral", "decoded normal not unit length");
+
+        // 坐标轴必须精确还原（z < 0 的折叠不能把 -z 映射到别处）
+        for (int axis = 0; axis < 6; ++axis) {
+            int16_t encoded[2];
+            EncodeOctahedral(directions[axis], encoded);
+            Float3 decoded = DecodeOctahedral(encoded);
+            Check(decoded.x == directions[axis].x && decoded.y == directions[axis].y && decoded.z == directions[axis].z,
+                "octahedral", "axis direction not exact");
+        }
+
+        // 零向量编码为 (0, 0)，解码为 +z
+        int16_t zero[2] = { 1, 1 };
+        EncodeOctahedral({ 0.0f, 0.0f, 0.0f }, zero);
+        Check(zero[0] == 0 && zero[1] == 0, "octahedral", "zero vector not encoded as (0, 0)");
+    }
+
+    // 半精度：特殊值、舍入到偶数、所有有限半精度数的往返，以及 [0, 1] 内 UV 的误差
+    void TestHalf()
+    {
+        Check(FloatToHalf(0.0f) == 0x0000 && FloatToHalf(-0.0f) == 0x8000, "half", "signed zero");
+        Check(FloatToHalf(1.0f) == 0x3c00 && FloatToHalf(0.5f) == 0x3800 && FloatToHalf(-2.0f) == 0xc000, "half", "exact values");
+        Check(FloatToHalf(65504.0f) == 0x7bff, "half", "largest finite value");
+        Check(FloatToHalf(65520.0f) == 0x7c00 && FloatToHalf(-1e10f) == 0xfc00, "half", "overflow not Inf");
+        Check(FloatToHalf(std::ldexp(1.0f, -14)) == 0x0400, "half", "smallest normal");
+        Check(FloatToHalf(std::ldexp(1.0f, -24)) == 0x0001, "half", "smallest denormal");
+        Check(FloatToHalf(std::ldexp(1.0f, -26)) == 0x0000, "half", "underflow not zero");
+        Check((FloatToHalf(std::nanf("")) & 0x7fff) > 0x7c00, "half", "NaN not preserved");
+        // 1 + 2^-11 在 1 与 1 + 2^-10 正中间，舍入到偶数 1；1 + 3 * 2^-11 舍入到 1 + 2^-9
+        Check(FloatToHalf(1.0f + std::ldexp(1.0f, -11)) == 0x3c00, "half", "tie not rounded to even (down)");
+        Check(FloatToHalf(1.0f + 3.0f * std::ldexp(1.0f, -11)) == 0x3c02, "half", "tie not rounded to even (up)");
+
+        bool roundTrip = true;
+        for (uint32_t bits = 0; bits < 0x10000u; ++bits) {
+            if ((bits & 0x7c00u) == 0x7c00u && (bits & 0x3ffu))
+                continue;   // NaN
+            roundTrip = roundTrip && FloatToHalf(HalfToFloat(uint16_t(bits))) == bits;
+        }
+        Check(roundTrip, "half", "half -> float -> half not exact");
+        Check(FloatBits(HalfToFloat(0x8000)) == 0x80000000u, "half", "negative zero not decoded");
+
+        // [0, 1] 内的 UV：误差不超过 [0.5, 1) 间距的一半 2^-12
+        std::mt19937 rng(40);
+        float maxError = 0.0f;
+        for (int i = 0; i < 100000; ++i) {
+            float uv = Uniform(rng);
+            maxError = std::max(maxError, std::fabs(HalfToFloat(FloatToHalf(uv)) - uv));
+        }
+        std::printf("[PackedVertexTest] half: max UV error %.2e\n", maxError);
+        Check(maxError <= std::ldexp(1.0f, -12), "half", "UV error above 2^-12");
+    }
+
+    // 权重：和修正为原四个权重之和的量化值，每个分量最多偏离一个单位加舍入，权重为 0 的槽位保持为 0
+    void CheckWeights(const std::vector<Vertex>& vertices, bool wideWeights, const char* test)
+    {
+        PackedVertexBuffer packed;
+        PackVertices(vertices.data(), vertices.size(), MakePackedVertexFormat(false, false, wideWeights), packed);
+        std::vector<Vertex> decoded(vertices.size());
+        UnpackVertices(packed, 0, vertices.size(), decoded.data());
+
+        double maxValue = wideWeights ? 65535.0 : 255.0;
+        bool sums = true, zeros = true, indices = true;
+        double maxUnits = 0.0;
+        for (size_t v = 0; v < vertices.size(); ++v) {
+            double total = 0.0;
+            long long quantizedSum = 0;
+            for (int i = 0; i < 4; ++i) {
+                double weight = vertices[v].boneWeights[i];
+                long long quantized = std::llround(decoded[v].boneWeights[i] * maxValue);
+                total += float(weight * maxValue);
+                quantizedSum += quantized;
+                maxUnits = std::max(maxUnits, std::fabs(double(quantized) - weight * maxValue));
+                if (weight == 0.0f)
+                    zeros = zeros && quantized == 0;
+                else
+                    indices = indices && decoded[v].boneIndices[i] == vertices[v].boneIndices[i];
+            }
+            sums = sums && quantizedSum == std::min<long long>(std::llround(total), (long long)maxValue);
+        }
+        std::printf("[PackedVertexTest] %s: max weight error %.3f units\n", test, maxUnits);
+        Check(sums, test, "weight sum not corrected to the quantized source sum");
+        Check(zeros, test, "zero weight decoded as non-zero");
+        Check(indices, test, "bone index changed");
+        Check(maxUnits <= 1.5 + 1e-3, test, "weight off by more than 1.5 units");
+    }
+
+    std::vector<Vertex> WeightCases()
+    {
+        const float cases[][4] = {
+            { 1.0f, 0.0f, 0.0f, 0.0f },
+            { 0.25f, 0.25f, 0.25f, 0.25f },
+            { 1.0f / 3.0f, 1.0f / 3.0f, 1.0f / 3.0f, 0.0f },
+            { 0.998f, 0.001f, 0.001f, 0.0f },       // 小权重向下舍入为 0 时由修正补回
+            { 0.0f, 0.5f, 0.0f, 0.5f },             // 中间有空槽位
+            { 0.4f, 0.2f, 0.1f, 0.1f },             // 8 影响顶点的前 4 个，和为 0.8
+            { 0.0f, 0.0f, 0.0f, 0.0f },
+        };
+        std::vector<Vertex> vertices;
+        for (const float* weights : cases) {
+            Vertex v;
+            v.normal = { 0.0f, 0.0f, 1.0f };
+            for (int i = 0; i < 4; ++i) {
+                v.boneIndices[i] = uint32_t(10 + i);
+                v.boneWeights[i] = weights[i];
+            }
+            vertices.push_back(v);
+        }
+        // 随机归一化的 1~4 个影响，按降序排列（与 ApplyInfluences 的输出一致）
+        std::mt19937 rng(41);
+        for (int n = 0; n < 20000; ++n) {
+            Vertex v;
+            v.normal = { 0.0f, 0.0f, 1.0f };
+            int influences = 1 + int(rng() % 4);
+            float weights[4] = {}, total = 0.0f;
+            for (int i = 0; i < influences; ++i) {
+                weights[i] = Uniform(rng) + 1e-3f;
+                total += weights[i];
+            }
+            std::sort(weights, weights + 4, [](float a, float b) { return a > b; });
+            for (int i = 0; i < 4; ++i) {
+                v.boneIndices[i] = rng() % 256;
+                v.boneWeights[i] = weights[i] / total;
+            }
+            vertices.push_back(v);
+        }
+        return vertices;
+    }
+
+    void TestWeights()
+    {
+        std::vector<Vertex> vertices = WeightCases();
+        CheckWeights(vertices, false, "UNORM8 weights");
+        CheckWeights(vertices, true, "UNORM16 weights");
+    }
+
+    // 整个顶点的往返：float 位置原样保留，16 位骨骼下标支持超过 255 的下标，各属性误差在上面的范围内
+    void TestRoundTrip()
+    {
+        std::mt19937 rng(42);
+        std::vector<Vertex> vertices(20000);
+        for (Vertex& v : vertices) {
+            v.position = { Uniform(rng) * 200.0f - 100.0f, Uniform(rng) * 200.0f, Uniform(rng) * 50.0f };
+            v.normal = RandomDirection(rng);
+            v.texcoord = { Uniform(rng), Uniform(rng) };
+            v.boneIndices[0] = rng() % 1000;
+            v.boneIndices[1] = rng() % 1000;
+            v.boneWeights[0] = 0.75f;
+            v.boneWeights[1] = 0.25f;
+        }
+
+        for (int wide = 0; wide < 2; ++wide) {
+            const char* test = wide ? "round trip (16-bit weights)" : "round trip (8-bit weights)";
+            PackedVertexFormat format = MakePackedVertexFormat(false, true, wide != 0);
+            Check(format.stride == (wide ? 36u : 32u), test, "unexpected stride");
+            PackedVertexBuffer packed;
+            PackVertices(vertices.data(), vertices.size(), format, packed);
+            Check(packed.data.size() == vertices.size() * format.stride && packed.positionRanges.empty(), test, "buffer size");
+
+            std::vector<Vertex> decoded(vertices.size());
+            UnpackVertices(packed, 0, vertices.size(), decoded.data());
+            bool positions = true, indices = true;
+            for (size_t v = 0; v < vertices.size(); ++v) {
+                positions = positions && std::memcmp(&decoded[v].position, &vertices[v].position, sizeof(Float3)) == 0;
+                indices = indices && decoded[v].boneIndices[0] == vertices[v].boneIndices[0] &&
+                    decoded[v].boneIndices[1] == vertices[v].boneIndices[1];
+            }
+            Check(positions, test, "float position changed");
+            Check(indices, test, "16-bit bone index changed");
+
+            // 从中间解码一段与整体解码一致
+            Vertex middle[3];
+            UnpackVertices(packed, 1000, 3, middle);
+            Check(std::memcmp(middle, &decoded[1000], sizeof(middle)) == 0, test, "partial decode differs");
+
+            PackingError error = MeasurePackingError(vertices, packed);
+            Check(error.position == 0.0f, test, "position error");
+            Check(error.texcoord <= std::ldexp(1.0f, -12), test, "texcoord error");
+            Check(error.weight <= (wide ? 1.0f / 65535.0f : 1.0f / 255.0f), test, "weight error");
+        }
+    }
+
+    Float3 Transform(const aiMatrix4x4& m, const Float3& p)
+    {
+        return {
+            m.a1 * p.x + m.a2 * p.y + m.a3 * p.z + m.a4,
+            m.b1 * p.x + m.b2 * p.y + m.b3 * p.z + m.b4,
+            m.c1 * p.x + m.c2 * p.y + m.c3 * p.z + m.c4,
+        };
+    }
+
+    Float3 Transform(const BoneMatrix3x4& m, const Float3& p)
+    {
+        Float3 r;
+        float* out[3] = { &r.x, &r.y, &r.z };
+        for (int row = 0; row < 3; ++row)
+            *out[row] = m.rows[row][0] * p.x + m.rows[row][1] * p.y + m.rows[row][2] * p.z + m.rows[row][3];
+        return r;
+    }
+
+    float MaxComponentDifference(const Float3& a, const Float3& b)
+    {
+        return std::max(std::max(std::fabs(a.x - b.x), std::fabs(a.y - b.y)), std::fabs(a.z - b.z));
+    }
+
+    // 按区间量化位置：200、10、1 个单位的三个包围盒各自计算 scale / offset，误差随盒子大小缩小，
+    // 不超过半个量化步长的对角线 sqrt(3) / 2 * scale / 65535（约 2.6e-3、1.3e-4、1.3e-5）加上解码的浮点舍入；
+    // 把还原折进蒙皮矩阵后直接变换 [0, 1] 的 q，与先解码再蒙皮的结果只差浮点舍入
+    void TestPositionQuantization()
+    {
+        const float extents[3] = { 200.0f, 10.0f, 1.0f };
+        const Float3 origins[3] = { { -100.0f, 0.0f, -50.0f }, { -5.0f, 2.0f, 1.0f }, { 0.5f, -0.25f, 0.0f } };
+        const uint32_t rangeSize = 2000;
+
+        std::mt19937 rng(43);
+        std::vector<Vertex> vertices(3 * rangeSize);
+        std::vector<PositionQuantization> ranges(3);
+        for (int box = 0; box < 3; ++box) {
+            ranges[box].vertexStart = box * rangeSize;
+            ranges[box].vertexCount = rangeSize;
+            for (uint32_t v = 0; v < rangeSize; ++v) {
+                Vertex& vert = vertices[box * rangeSize + v];
+                // 长边沿 x，另两轴更扁，检查三轴共用 scale
+                vert.position = {
+                    origins[box].x + Uniform(rng) * extents[box],
+                    origins[box].y + Uniform(rng) * extents[box] * 0.5f,
+                    origins[box].z + Uniform(rng) * extents[box] * 0.25f,
+                };
+                vert.normal = { 0.0f, 1.0f, 0.0f };
+                vert.boneWeights[0] = 1.0f;
+            }
+            // 固定包围盒的两个角，scale 恰为长边
+            vertices[box * rangeSize].position = origins[box];
+            vertices[box * rangeSize + 1].position = {
+                origins[box].x + extents[box], origins[box].y + extents[box] * 0.5f, origins[box].z + extents[box] * 0.25f };
+        }
+
+        PackedVertexBuffer packed;
+        PackVertices(vertices.data(), vertices.size(), MakePackedVertexFormat(true, false, false), packed, ranges);
+        Check(packed.format.stride == 24 && packed.positionRanges.size() == 3, "quantized positions", "layout");
+        if (packed.positionRanges.size() != 3)
+            return;
+
+        std::vector<Vertex> decoded(vertices.size());
+        UnpackVertices(packed, 0, vertices.size(), decoded.data());
+        for (int box = 0; box < 3; ++box) {
+            const PositionQuantization& range = packed.positionRanges[box];
+            float measured = 0.0f;
+            for (uint32_t v = range.vertexStart; v < range.vertexStart + range.vertexCount; ++v) {
+                const Float3& a = vertices[v].position;
+                const Float3& b = decoded[v].position;
+                measured = std::max(measured, std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) + (a.z - b.z) * (a.z - b.z)));
+            }
+            const Float3& o = range.offset;
+            float magnitude = std::max(std::max(std::fabs(o.x), std::fabs(o.y)), std::fabs(o.z)) + range.scale;
+            float tolerance = std::sqrt(3.0f) * (0.5f * range.scale / 65535.0f + 2.0f * FLT_EPSILON * magnitude);
+            std::printf("[PackedVertexTest] quantized positions: %g-unit box, max error %.2e (bound %.2e)\n",
+                extents[box], range.maxError, tolerance);
+            Check(range.maxError == measured, "quantized positions", "recorded maxError differs from the decoded error");
+            Check(range.maxError <= tolerance, "quantized positions", "error above half a quantization step");
+            Check(std::fabs(range.scale - extents[box]) <= extents[box] * FLT_EPSILON * 4.0f, "quantized positions", "scale is not the longest edge");
+        }
+        Check(MaxQuantizationError(packed) == packed.positionRanges[0].maxError, "quantized positions", "MaxQuantizationError");
+
+        // 蒙皮矩阵：绕任意轴旋转加平移，平移量级与模型相当
+        std::vector<aiMatrix4x4> palette;
+        for (int b = 0; b < 16; ++b) {
+            Float3 axis = RandomDirection(rng);
+            aiMatrix4x4 rotation, translation;
+            aiMatrix4x4::Rotation(Uniform(rng) * 6.2831853f, aiVector3D(axis.x, axis.y, axis.z), rotation);
+            aiMatrix4x4::Translation(aiVector3D(Uniform(rng) * 100.0f - 50.0f, Uniform(rng) * 100.0f, Uniform(rng) * 20.0f), translation);
+            palette.push_back(translation * rotation);
+        }
+
+        // 误差按每行各项绝对值之和的若干个 FLT_EPSILON 计（两种计算顺序各自的舍入）
+        float maxDifference = 0.0f, maxRelative = 0.0f;
+        for (int box = 0; box < 3; ++box) {
+            const PositionQuantization& range = packed.positionRanges[box];
+            for (const aiMatrix4x4& m : palette) {
+                aiMatrix4x4 folded = FoldPositionQuantization(m, range);
+                BoneMatrix3x4 m3x4, folded3x4;
+                StoreBoneMatrix3x4(m, m3x4);
+                folded3x4 = FoldPositionQuantization(m3x4, range);
+                for (uint32_t v = range.vertexStart; v < range.vertexStart + range.vertexCount; v += 7) {
+                    uint16_t q[4];
+                    std::memcpy(q, packed.data.data() + v * packed.format.stride + packed.format.positionOffset, sizeof(q));
+                    Float3 unit = { float(q[0]) / 65535.0f, float(q[1]) / 65535.0f, float(q[2]) / 65535.0f };
+                    const Float3& p = decoded[v].position;
+                    Float3 reference = Transform(m, p);
+                    float difference = std::max(MaxComponentDifference(Transform(folded, unit), reference),
+                        MaxComponentDifference(Transform(folded3x4, unit), reference));
+                    const Float3& o = range.offset;
+                    float terms = 0.0f;
+                    const float rows[3][4] = { { m.a1, m.a2, m.a3, m.a4 }, { m.b1, m.b2, m.b3, m.b4 }, { m.c1, m.c2, m.c3, m.c4 } };
+                    for (const float* row : rows) {
+                        terms = std::max(terms, std::fabs(row[0]) * (std::fabs(o.x) + std::fabs(p.x)) +
+                            std::fabs(row[1]) * (std::fabs(o.y) + std::fabs(p.y)) +
+                            std::fabs(row[2]) * (std::fabs(o.z) + std::fabs(p.z)) + std::fabs(row[3]));
+                    }
+                    maxDifference = std::max(maxDifference, difference);
+                    maxRelative = std::max(maxRelative, difference / (terms * FLT_EPSILON));
+                }
+            }
+        }
+        std::printf("[PackedVertexTest] quantized positions: folded palette vs. decode-then-skin max difference %.2e (%.2f FLT_EPSILON)\n",
+            maxDifference, maxRelative);
+        Check(maxRelative <= 8.0f, "quantized positions", "folded palette differs from decode-then-skin beyond rounding");
+    }
+}
+
+int main()
+{
+    TestOctahedral();
+    TestHalf();
+    TestWeights();
+    TestRoundTrip();
+    TestPositionQuantization();
+    std::printf("[PackedVertexTest] %s\n", g_failures ? "FAILED" : "passed");
+    return g_failures ? 1 : 0;
+}
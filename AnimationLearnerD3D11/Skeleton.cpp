@@ -0,0 +1,547 @@
+﻿#include "Skeleton.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    // 只折叠单子节点、不挂 mesh 的辅助节点，这样的链相乘后与原层级严格等价
+    bool IsFoldableHelper(const aiNode* node)
+    {
+        return std::strstr(node->mName.C_Str(), FBX_PIVOT_HELPER_TAG) != nullptr
+            && node->mNumChildren == 1 && node->mNumMeshes == 0;
+    }
+
+    bool NearlyEqual(const aiVector3D& a, const aiVector3D& b)
+    {
+        const float eps = 1e-5f;
+        return std::fabs(a.x - b.x) <= eps && std::fabs(a.y - b.y) <= eps && std::fabs(a.z - b.z) <= eps;
+    }
+
+    // 元素最大误差除以 max(1, 参考矩阵元素的最大绝对值)：旋转部分近似绝对误差，大平移按量级相对化
+    float MatrixError(const aiMatrix4x4& a, const aiMatrix4x4& reference)
+    {
+        float error = 0.0f, magnitude = 1.0f;
+        for (int r = 0; r < 4; ++r) {
+            for (int c = 0; c < 4; ++c) {
+                error = std::max(error, std::fabs(a[r][c] - reference[r][c]));
+                magnitude = std::max(magnitude, std::fabs(reference[r][c]));
+            }
+        }
+        return error / magnitude;
+    }
+
+    aiMatrix4x4 SampleChain(const std::vector<const aiNode*>& chain,
+        const std::map<std::string, BoneAnimCache>& boneAnimCache, float animTime)
+    {
+        aiMatrix4x4 local;
+        for (const aiNode* node : chain)
+            local = local * SampleLocalTransform(node, boneAnimCache, animTime);
+        return local;
+    }
+
+    // 把辅助节点链 + 所属关节上的所有通道重采样成一条 TRS 轨道，返回轨道下标。
+    // foldError 为折叠轨道在关键帧及其间的 1/4、1/2、3/4 处与原链乘积的最大误差（MatrixError），单节点时为 0
+    int FoldChainTracks(
+        const std::vector<const aiNode*>& chain,
+        const std::map<std::string, BoneAnimCache>& boneAnimCache,
+        std::vector<BoneAnimCache>& tracks,
+        float& foldError)
+    {
+        foldError = 0.0f;
+        std::vector<const BoneAnimCache*> channels;
+        for (const aiNode* node : chain) {
+            auto it = boneAnimCache.find(node->mName.C_Str());
+            if (it != boneAnimCache.end())
+                channels.push_back(&it->second);
+        }
+        if (channels.empty())
+            return -1;
+
+        // 没有辅助节点，直接沿用原通道
+        if (chain.size() == 1) {
+            tracks.push_back(*channels[0]);
+            return int(tracks.size() - 1);
+        }
+
+        // 所有通道关键帧时间的并集
+        std::vector<double> times;
+        for (const BoneAnimCache* cache : channels) {
+            for (const aiVectorKey& k : cache->positions) times.push_back(k.mTime);
+            for (const aiQuatKey& k : cache->rotations) times.push_back(k.mTime);
+            for (const aiVectorKey& k : cache->scalings) times.push_back(k.mTime);
+        }
+        std::sort(times.begin(), times.end());
+        times.erase(std::unique(times.begin(), times.end(),
+            [](double a, double b) { return b - a < 1e-4; }), times.end());
+
+        BoneAnimCache folded;
+        for (double time : times) {
+            aiMatrix4x4 local = SampleChain(chain, boneAnimCache, float(time));
+
+            aiVector3D scale, pos;
+            aiQuaternion rot;
+            local.Decompose(scale, rot, pos);
+
+            // 保持四元数连续，避免相邻关键帧走长弧
+            if (!folded.rotations.empty()) {
+                const aiQuaternion& prev = folded.rotations.back().mValue;
+                if (prev.w * rot.w + prev.x * rot.x + prev.y * rot.y + prev.z * rot.z < 0.0f)
+                    rot = aiQuaternion(-rot.w, -rot.x, -rot.y, -rot.z);
+            }
+
+            folded.positions.push_back(aiVectorKey(time, pos));
+            folded.rotations.push_back(aiQuatKey(time, rot));
+            folded.scalings.push_back(aiVectorKey(time, scale));
+        }
+
+        // 恒定分量只保留一个关键帧
+        auto collapseConstant = [](std::vector<aiVectorKey>& keys) {
+            for (const aiVectorKey& k : keys)
+                if (!NearlyEqual(k.mValue, keys[0].mValue)) return;
+            keys.resize(1);
+        };
+        collapseConstant(folded.positions);
+        collapseConstant(folded.scalings);
+
+        // 关键帧之间各分量分别插值，枢轴旋转等情况下与原链的乘积不再相等
+        for (size_t k = 0; k < times.size(); ++k) {
+            int steps = k + 1 < times.size() ? 4 : 1;
+            for (int s = 0; s < steps; ++s) {
+                float time = float(k + 1 < times.size() ? times[k] + (times[k + 1] - times[k]) * s / steps : times[k]);
+                aiVector3D pos, scale;
+                aiQuaternion rot;
+                SampleBoneAnim(folded, time, pos, rot, scale);
+                foldError = std::max(foldError, MatrixError(ComposeTRS(pos, rot, scale), SampleChain(chain, boneAnimCache, time)));
+            }
+        }
+
+        tracks.push_back(std::move(folded));
+        return int(tracks.size() - 1);
+    }
+
+    // tracks 按 SkeletonJoint::track 索引：skeleton.tracks 或同一骨架的另一段片段
+    aiMatrix4x4 SampleJointLocal(const Skeleton& skeleton, const std::vector<BoneAnimCache>& tracks, int index, float animTime)
+    {
+        const SkeletonJoint& joint = skeleton.joints[index];
+        if (joint.track < 0)
+            return joint.bindLocal;
+
+        aiVector3D pos, scale;
+        aiQuaternion rot;
+        SampleBoneAnim(tracks[joint.track], animTime, pos, rot, scale);
+        return ComposeTRS(pos, rot, scale);
+    }
+
+    aiMatrix4x4 SampleJointLocal(const Skeleton& skeleton, int index, float animTime)
+    {
+        return SampleJointLocal(skeleton, skeleton.tracks, index, animTime);
+    }
+
+    // 采样一个关节，值有变化才写入并标脏；返回是否变化
+    bool SampleJointIntoPose(const Skeleton& skeleton, int index, float animTime, SkeletonPose& pose)
+    {
+        if (skeleton.joints[index].track < 0)
+            return false;
+
+        aiMatrix4x4 local = SampleJointLocal(skeleton, index, animTime);
+        if (local == pose.locals[index])
+            return false;
+
+        pose.locals[index] = local;
+        pose.dirty[index] = 1;
+        return true;
+    }
+
+    // 调色板输出：三种格式选其一
+    struct PaletteTarget
+    {
+        aiMatrix4x4* matrices;
+        BoneMatrix3x4* affine;
+        BoneDualQuat* dualQuats;
+        BoneScale* scales;
+        int maxBones;
+
+        bool Valid() const { return matrices || affine || dualQuats; }
+
+        void Store(int boneIndex, const aiMatrix4x4& m) const
+        {
+            if (matrices)
+                matrices[boneIndex] = m;
+            else if (affine)
+                StoreBoneMatrix3x4(m, affine[boneIndex]);
+            else
+                StoreBoneDualQuat(m, dualQuats[boneIndex], scales ? &scales[boneIndex] : nullptr);
+        }
+    };
+
+    // 更新单个关节：父关节脏则自身也脏，脏关节重算全局变换和调色板项
+    void UpdateJoint(const Skeleton& skeleton, SkeletonPose& pose, int index,
+        const PaletteTarget& palette, PoseUpdateResult& result)
+    {
+        const SkeletonJoint& joint = skeleton.joints[index];
+        if (joint.parent >= 0 && pose.dirty[joint.parent])
+            pose.dirty[index] = 1;
+        if (!pose.dirty[index])
+            return;
+
+        pose.globals[index] = joint.parent >= 0 ? pose.globals[joint.parent] * pose.locals[index] : pose.locals[index];
+        ++result.updatedJoints;
+
+        if (palette.Valid() && joint.boneIndex >= 0 && joint.boneIndex < palette.maxBones) {
+            palette.Store(joint.boneIndex, pose.globals[index] * joint.offset);
+            result.firstBone = std::min(result.firstBone, joint.boneIndex);
+            result.lastBone = std::max(result.lastBone, joint.boneIndex);
+        }
+    }
+
+    void BuildJoints(
+        const aiNode* node,
+        int parent,
+        std::vector<const aiNode*>& chain,
+        const std::map<std::string, BoneAnimCache>& boneAnimCache,
+        const std::map<std::string, int>& boneNameToIndex,
+        const std::map<std::string, aiMatrix4x4>& boneOffsetMatrices,
+        Skeleton& skeleton)
+    {
+        // 辅助节点：记入链中，继续往下找所属关节
+        if (IsFoldableHelper(node)) {
+            chain.push_back(node);
+            BuildJoints(node->mChildren[0], parent, chain, boneAnimCache, boneNameToIndex, boneOffsetMatrices, skeleton);
+            chain.pop_back();
+            return;
+        }
+
+        chain.push_back(node);
+
+        // 折叠进本关节的节点；折叠误差过大时只剩关节自身
+        std::vector<const aiNode*> folded = chain;
+        float foldError = 0.0f;
+        int track = FoldChainTracks(folded, boneAnimCache, skeleton.tracks, foldError);
+        if (foldError > SKELETON_FOLD_TOLERANCE) {
+            // 丢弃折叠轨道，辅助节点各自成为不参与蒙皮的关节，保持原层级
+            skeleton.tracks.pop_back();
+            for (size_t link = 0; link + 1 < folded.size(); ++link) {
+                SkeletonJoint helper;
+                helper.name = folded[link]->mName.C_Str();
+                helper.parent = parent;
+                helper.bindLocal = folded[link]->mTransformation;
+                helper.track = FoldChainTracks({ folded[link] }, boneAnimCache, skeleton.tracks, foldError);
+                parent = int(skeleton.joints.size());
+                skeleton.jointIndex[helper.name] = parent;
+                skeleton.joints.push_back(std::move(helper));
+            }
+            skeleton.unfoldedHelperNodes += int(folded.size()) - 1;
+            folded.erase(folded.begin(), folded.end() - 1);
+            track = FoldChainTracks(folded, boneAnimCache, skeleton.tracks, foldError);
+        }
+
+        SkeletonJoint joint;
+        joint.name = node->mName.C_Str();
+        joint.parent = parent;
+        for (const aiNode* link : folded)
+            joint.bindLocal = joint.bindLocal * link->mTransformation;
+        joint.track = track;
+
+        auto idxIt = boneNameToIndex.find(joint.name);
+        if (idxIt != boneNameToIndex.end()) {
+            joint.boneIndex = idxIt->second;
+            joint.offset = boneOffsetMatrices.at(joint.name);
+            skeleton.boneCount = std::max(skeleton.boneCount, joint.boneIndex + 1);
+        }
+
+        skeleton.foldedHelperNodes += int(folded.size()) - 1;
+        chain.pop_back();
+
+        int self = int(skeleton.joints.size());
+        skeleton.jointIndex[joint.name] = self;
+        skeleton.joints.push_back(std::move(joint));
+
+        std::vector<const aiNode*> childChain;
+        for (unsigned int i = 0; i < node->mNumChildren; ++i)
+            BuildJoints(node->mChildren[i], self, childChain, boneAnimCache, boneNameToIndex, boneOffsetMatrices, skeleton);
+    }
+
+    PoseUpdateResult UpdatePose(const Skeleton& skeleton, SkeletonPose& pose,
+        const PaletteTarget& palette, JobSystem* jobs)
+    {
+        PoseUpdateResult result;
+        if (!pose.anyDirty)
+            return result;
+        result.firstBone = palette.maxBones;
+
+        if (jobs && !skeleton.chunks.empty()) {
+            // 1. 主干串行（按前序，父先子后）
+            for (int index : skeleton.trunkJoints)
+                UpdateJoint(skeleton, pose, index, palette, result);
+
+            // 2. 各子树块只依赖主干，互不相干，可并行；每个关节的运算与串行路径完全相同
+            PoseUpdateResult empty;
+            empty.firstBone = palette.maxBones;
+            pose.chunkResults.assign(skeleton.chunks.size(), empty);
+            jobs->ParallelFor(skeleton.chunks.size(), 1, [&](size_t begin, size_t end, int) {
+                for (size_t c = begin; c < end; ++c) {
+                    const SkeletonChunk& chunk = skeleton.chunks[c];
+                    for (int index = chunk.begin; index < chunk.end; ++index)
+                        UpdateJoint(skeleton, pose, index, palette, pose.chunkResults[c]);
+                }
+            });
+
+            for (const PoseUpdateResult& chunkResult : pose.chunkResults) {
+                result.updatedJoints += chunkResult.updatedJoints;
+                result.firstBone = std::min(result.firstBone, chunkResult.firstBone);
+                result.lastBone = std::max(result.lastBone, chunkResult.lastBone);
+            }
+        }
+        else {
+            // 父关节总在前面，脏标记沿扁平顺序传给子孙
+            for (size_t i = 0; i < skeleton.joints.size(); ++i)
+                UpdateJoint(skeleton, pose, int(i), palette, result);
+        }
+
+        std::fill(pose.dirty.begin(), pose.dirty.end(), 0);
+        pose.anyDirty = false;
+        return result;
+    }
+}
+
+void BuildSkeleton(
+    const aiNode* root,
+    const std::map<std::string, BoneAnimCache>& boneAnimCache,
+    const std::map<std::string, int>& boneNameToIndex,
+    const std::map<std::string, aiMatrix4x4>& boneOffsetMatrices,
+    Skeleton& skeleton)
+{
+    skeleton = Skeleton();
+    if (!root) return;
+
+    std::vector<const aiNode*> chain;
+    BuildJoints(root, -1, chain, boneAnimCache, boneNameToIndex, boneOffsetMatrices, skeleton);
+
+    if (skeleton.joints.size() >= SKELETON_PARALLEL_JOINT_THRESHOLD)
+        PartitionSkeleton(skeleton, SKELETON_CHUNK_TARGET_SIZE);
+}
+
+void PartitionSkeleton(Skeleton& skeleton, int chunkTargetSize)
+{
+    skeleton.trunkJoints.clear();
+    skeleton.chunks.clear();
+
+    // 前序数组中每棵子树是连续区间 [i, subtreeEnd[i])
+    int count = int(skeleton.joints.size());
+    std::vector<int> subtreeEnd(count);
+    for (int i = 0; i < count; ++i)
+        subtreeEnd[i] = i + 1;
+    for (int i = count - 1; i >= 0; --i) {
+        int parent = skeleton.joints[i].parent;
+        if (parent >= 0)
+            subtreeEnd[parent] = std::max(subtreeEnd[parent], subtreeEnd[i]);
+    }
+
+    int i = 0;
+    while (i < count) {
+        if (subtreeEnd[i] - i > chunkTargetSize) {
+            // 子树太大：自身进主干，下一个前序关节就是它的第一个孩子
+            skeleton.trunkJoints.push_back(i);
+            ++i;
+            continue;
+        }
+
+        // 整棵子树成块；与上一块首尾相接且合并后不超目标大小时合并（中间没有主干关节）
+        if (!skeleton.chunks.empty() && skeleton.chunks.back().end == i
+            && subtreeEnd[i] - skeleton.chunks.back().begin <= chunkTargetSize)
+            skeleton.chunks.back().end = subtreeEnd[i];
+        else
+            skeleton.chunks.push_back({ i, subtreeEnd[i] });
+        i = subtreeEnd[i];
+    }
+}
+
+void EvaluateSkeleton(const Skeleton& skeleton, float animTime, std::vector<aiMatrix4x4>& globals)
+{
+    globals.resize(skeleton.joints.size());
+    for (size_t i = 0; i < skeleton.joints.size(); ++i) {
+        aiMatrix4x4 local = SampleJointLocal(skeleton, int(i), animTime);
+        int parent = skeleton.joints[i].parent;
+        globals[i] = parent >= 0 ? globals[parent] * local : local;
+    }
+}
+
+void InitSkeletonPose(const Skeleton& skeleton, SkeletonPose& pose)
+{
+    size_t count = skeleton.joints.size();
+    pose.locals.resize(count);
+    pose.globals.resize(count);
+    pose.dirty.assign(count, 1);
+    for (size_t i = 0; i < count; ++i)
+        pose.locals[i] = skeleton.joints[i].bindLocal;
+    pose.anyDirty = count > 0;
+    pose.sampledTime = -1.0f;
+}
+
+void SampleSkeletonPose(const Skeleton& skeleton, float animTime, SkeletonPose& pose, JobSystem* jobs)
+{
+    if (animTime == pose.sampledTime)
+        return;
+    pose.sampledTime = animTime;
+
+    size_t count = skeleton.joints.size();
+    if (jobs && count >= SKELETON_PARALLEL_JOINT_THRESHOLD) {
+        std::atomic<bool> changed(false);
+        jobs->ParallelFor(count, SKELETON_CHUNK_TARGET_SIZE, [&](size_t begin, size_t end, int) {
+            bool any = false;
+            for (size_t i = begin; i < end; ++i)
+                any |= SampleJointIntoPose(skeleton, int(i), animTime, pose);
+            if (any)
+                changed.store(true, std::memory_order_relaxed);
+        });
+        pose.anyDirty |= changed.load();
+        return;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+        pose.anyDirty |= SampleJointIntoPose(skeleton, int(i), animTime, pose);
+}
+
+void SetJointLocal(SkeletonPose& pose, int joint, const aiMatrix4x4& local)
+{
+    pose.locals[joint] = local;
+    pose.dirty[joint] = 1;
+    pose.anyDirty = true;
+}
+
+void ClearJointOverride(const Skeleton& skeleton, SkeletonPose& pose, int joint)
+{
+    aiMatrix4x4 local = pose.sampledTime >= 0.0f ? SampleJointLocal(skeleton, joint, pose.sampledTime)
+        : skeleton.joints[joint].bindLocal;
+    SetJointLocal(pose, joint, local);
+}
+
+PoseUpdateResult UpdateSkeletonPose(const Skeleton& skeleton, SkeletonPose& pose,
+    aiMatrix4x4* palette, int maxBones, JobSystem* jobs)
+{
+    PaletteTarget target = { palette, nullptr, nullptr, nullptr, maxBones };
+    return UpdatePose(skeleton, pose, target, jobs);
+}
+
+PoseUpdateResult UpdateSkeletonPose(const Skeleton& skeleton, SkeletonPose& pose,
+    BoneMatrix3x4* palette, int maxBones, JobSystem* jobs)
+{
+    PaletteTarget target = { nullptr, palette, nullptr, nullptr, maxBones };
+    return UpdatePose(skeleton, pose, target, jobs);
+}
+
+PoseUpdateResult UpdateSkeletonPose(const Skeleton& skeleton, SkeletonPose& pose,
+    BoneDualQuat* palette, BoneScale* scales, int maxBones, JobSystem* jobs)
+{
+    PaletteTarget target = { nullptr, nullptr, palette, scales, maxBones };
+    return UpdatePose(skeleton, pose, target, jobs);
+}
+
+int FindJoint(const Skeleton& skeleton, const std::string& name)
+{
+    auto it = skeleton.jointIndex.find(name);
+    return it != skeleton.jointIndex.end() ? it->second : -1;
+}
+
+aiMatrix4x4 QueryJointGlobal(const Skeleton& skeleton, int joint, float animTime)
+{
+    return QueryJointGlobal(skeleton, skeleton.tracks, joint, animTime);
+}
+
+aiMatrix4x4 QueryJointGlobal(const Skeleton& skeleton, const std::vector<BoneAnimCache>& clipTracks, int joint, float clipTime)
+{
+    // 自下而上：global = local(root) * ... * local(joint)
+    aiMatrix4x4 global = SampleJointLocal(skeleton, clipTracks, joint, clipTime);
+    for (int p = skeleton.joints[joint].parent; p >= 0; p = skeleton.joints[p].parent)
+        global = SampleJointLocal(skeleton, clipTracks, p, clipTime) * global;
+    return global;
+}
+
+void QueryJointGlobals(const Skeleton& skeleton, const int* joints, size_t count, float animTime,
+    JointQueryScratch& scratch, aiMatrix4x4* outGlobals)
+{
+    QueryJointGlobals(skeleton, skeleton.tracks, joints, count, animTime, scratch, outGlobals);
+}
+
+void QueryJointGlobals(const Skeleton& skeleton, const std::vector<BoneAnimCache>& clipTracks, const int* joints, size_t count,
+    float clipTime, JointQueryScratch& scratch, aiMatrix4x4* outGlobals)
+{
+    size_t jointCount = skeleton.joints.size();
+    if (scratch.stamp.size() != jointCount) {
+        scratch.stamp.assign(jointCount, 0);
+        scratch.globals.resize(jointCount);
+        scratch.generation = 0;
+    }
+    if (++scratch.generation == 0) {
+        std::fill(scratch.stamp.begin(), scratch.stamp.end(), 0);
+        scratch.generation = 1;
+    }
+
+    // 1. 收集祖先链的并集，遇到已收集的关节即停止（其祖先必然已收集）
+    scratch.order.clear();
+    for (size_t q = 0; q < count; ++q) {
+        for (int j = joints[q]; j >= 0 && scratch.stamp[j] != scratch.generation; j = skeleton.joints[j].parent) {
+            scratch.stamp[j] = scratch.generation;
+            scratch.order.push_back(j);
+        }
+    }
+
+    // 2. 前序下标升序即父先子后，逐个合成
+    std::sort(scratch.order.begin(), scratch.order.end());
+    for (int j : scratch.order) {
+        aiMatrix4x4 local = SampleJointLocal(skeleton, clipTracks, j, clipTime);
+        int parent = skeleton.joints[j].parent;
+        scratch.globals[j] = parent >= 0 ? scratch.globals[parent] * local : local;
+    }
+
+    for (size_t q = 0; q < count; ++q)
+        outGlobals[q] = scratch.globals[joints[q]];
+}
+
+float VerifySkeletonAgainstHierarchy(
+    const Skeleton& skeleton,
+    const aiNode* root,
+    const std::map<std::string, BoneAnimCache>& boneAnimCache,
+    float animDuration)
+{
+    float maxError = 0.0f;
+    std::vector<aiMatrix4x4> globals;
+    std::map<std::string, aiMatrix4x4> reference;
+
+    // 半帧步长，既覆盖关键帧本身也覆盖关键帧之间的插值
+    for (float t = 0.0f; t <= animDuration; t += 0.5f) {
+        EvaluateSkeleton(skeleton, t, globals);
+        reference.clear();
+        CollectAnimatedNodeTransforms(root, aiMatrix4x4(), boneAnimCache, t, reference);
+
+        for (size_t i = 0; i < skeleton.joints.size(); ++i)
+            maxError = std::max(maxError, MatrixError(globals[i], reference.at(skeleton.joints[i].name)));
+    }
+    return maxError;
+}
+
+float MaxSkinningScaleDeviation(const Skeleton& skeleton, float animDuration)
+{
+    std::vector<aiMatrix4x4> globals;
+    float maxDeviation = 0.0f;
+    for (float t = 0.0f; t <= animDuration; t += 0.5f) {
+        EvaluateSkeleton(skeleton, t, globals);
+
+        for (size_t i = 0; i < skeleton.joints.size(); ++i) {
+            const SkeletonJoint& joint = skeleton.joints[i];
+            if (joint.boneIndex < 0)
+                continue;
+
+            aiVector3D scale, position;
+            aiQuaternion rotation;
+            (globals[i] * joint.offset).Decompose(scale, rotation, position);
+            maxDeviation = std::max(maxDeviation, std::fabs(scale.x - 1.0f));
+            maxDeviation = std::max(maxDeviation, std::fabs(scale.y - 1.0f));
+            maxDeviation = std::max(maxDeviation, std::fabs(scale.z - 1.0f));
+        }
+    }
+    return maxDeviation;
+}
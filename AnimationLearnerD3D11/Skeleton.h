@@ -0,0 +1,153 @@
+﻿#pragma once
+#include <vector>
+#include <map>
+#include <string>
+#include <assimp/scene.h>
+#include "Animation.h"
+#include "BonePalette.h"
+
+class JobSystem;
+
+// Assimp FBX 导入器为枢轴/预旋转插入的辅助节点名标记，如 "Hips_$AssimpFbx$_PreRotation"
+#define FBX_PIVOT_HELPER_TAG "_$AssimpFbx$_"
+
+// 折叠后的轨道只在关键帧上与原链严格相等，关键帧之间是对 TRS 分别插值。
+// 关键帧之间的相对误差（见 VerifySkeletonAgainstHierarchy）超过该值时不折叠，辅助节点保留为独立关节
+#define SKELETON_FOLD_TOLERANCE 1e-4f
+
+struct SkeletonJoint
+{
+    std::string name;
+    int parent = -1;          // 父关节下标，根为 -1；父关节总排在子关节之前
+    aiMatrix4x4 bindLocal;    // 无动画时的本地变换（已折入上方的辅助节点）
+    int track = -1;           // Skeleton::tracks 下标，-1 表示没有动画
+    int boneIndex = -1;       // 蒙皮调色板下标，-1 表示不参与蒙皮
+    aiMatrix4x4 offset;       // 骨骼 offset（逆绑定）矩阵
+};
+
+// 前序数组中的一段连续区间 [begin, end)，由若干棵完整子树组成，子树根的父关节都在主干上
+struct SkeletonChunk
+{
+    int begin;
+    int end;
+};
+
+// 关节数达到该值时，姿态更新自动拆成子树块并行执行。
+// 阈值和块大小是估计值，尚未在多核机器上测量，可按 --bench 的 large skeleton 结果调整
+#define SKELETON_PARALLEL_JOINT_THRESHOLD 256
+// 每个子树块的目标关节数
+#define SKELETON_CHUNK_TARGET_SIZE 64
+
+// 扁平化骨架：节点树按前序（深度优先）展开，每个真实关节一个节点、一条 TRS 轨道
+struct Skeleton
+{
+    std::vector<SkeletonJoint> joints;
+    std::vector<BoneAnimCache> tracks;
+    std::map<std::string, int> jointIndex;
+    int foldedHelperNodes = 0;   // 被折叠掉的 $AssimpFbx$ 辅助节点数
+    int unfoldedHelperNodes = 0; // 折叠误差超过 SKELETON_FOLD_TOLERANCE、保留为独立关节的辅助节点数
+    int boneCount = 0;           // 调色板大小（最大 boneIndex + 1）
+
+    // 大骨架并行划分：先串行算主干关节（块的祖先），再并行算各子树块
+    std::vector<int> trunkJoints;
+    std::vector<SkeletonChunk> chunks;
+};
+
+// 一次增量更新的结果；[firstBone, lastBone] 为被改写的调色板区间，用于缩小上传范围
+struct PoseUpdateResult
+{
+    int updatedJoints = 0;
+    int firstBone = 0;
+    int lastBone = -1;
+
+    bool PaletteChanged() const { return lastBone >= firstBone; }
+};
+
+// 骨架姿态：本地/全局变换 + 每个关节的脏标记
+struct SkeletonPose
+{
+    std::vector<aiMatrix4x4> locals;
+    std::vector<aiMatrix4x4> globals;
+    std::vector<unsigned char> dirty;   // 本地变换已修改，自身及子孙的全局变换需要重算
+    bool anyDirty = false;
+    float sampledTime = -1.0f;          // 上次采样的动画时间，时间不变时跳过采样
+    std::vector<PoseUpdateResult> chunkResults; // 并行更新时每个子树块的结果
+};
+
+// 祖先链查询的临时数据，可跨调用复用以避免分配
+struct JointQueryScratch
+{
+    std::vector<unsigned int> stamp;     // 本次查询是否已收集该关节（按代数比较，免清零）
+    unsigned int generation = 0;
+    std::vector<int> order;              // 需要计算的关节（升序即父先子后）
+    std::vector<aiMatrix4x4> globals;
+};
+
+// 从 Assimp 节点树构建扁平骨架，并把 $AssimpFbx$ 辅助节点链及其拆分的通道折叠进所属关节
+// （关键帧之间误差超过 SKELETON_FOLD_TOLERANCE 的链不折叠）；关节数超过阈值时同时生成并行用的子树块划分
+void BuildSkeleton(
+    const aiNode* root,
+    const std::map<std::string, BoneAnimCache>& boneAnimCache,
+    const std::map<std::string, int>& boneNameToIndex,
+    const std::map<std::string, aiMatrix4x4>& boneOffsetMatrices,
+    Skeleton& skeleton);
+
+// 按扁平顺序计算每个关节在 animTime 的全局变换
+void EvaluateSkeleton(const Skeleton& skeleton, float animTime, std::vector<aiMatrix4x4>& globals);
+
+// 用绑定姿态初始化，所有关节标脏
+void InitSkeletonPose(const Skeleton& skeleton, SkeletonPose& pose);
+
+// 采样动画写入本地变换，只有值真正变化的关节才标脏；大骨架且提供 jobs 时按关节并行采样
+void SampleSkeletonPose(const Skeleton& skeleton, float animTime, SkeletonPose& pose, JobSystem* jobs = nullptr);
+
+// 程序化修改某个关节（IK、注视等）的本地变换并标脏。有轨道的关节在下次采样到不同时刻时被动画覆盖；
+// 没有轨道的关节采样时不会写入，覆盖一直保留，直到 ClearJointOverride 或 InitSkeletonPose
+void SetJointLocal(SkeletonPose& pose, int joint, const aiMatrix4x4& local);
+
+// 撤销 SetJointLocal：有轨道的关节回到上次采样时刻（pose.sampledTime）的动画值，没有轨道或尚未采样时回到绑定姿态
+void ClearJointOverride(const Skeleton& skeleton, SkeletonPose& pose, int joint);
+
+// 按扁平顺序线性扫描，只重算脏关节及其子孙的全局变换和调色板项，随后清除脏标记。
+// 骨架有子树块划分且提供 jobs 时，主干串行、各子树块并行，结果与串行逐位一致
+PoseUpdateResult UpdateSkeletonPose(const Skeleton& skeleton, SkeletonPose& pose,
+    aiMatrix4x4* palette, int maxBones, JobSystem* jobs = nullptr);
+
+// 同上，调色板直接写成 3x4 仿射格式
+PoseUpdateResult UpdateSkeletonPose(const Skeleton& skeleton, SkeletonPose& pose,
+    BoneMatrix3x4* palette, int maxBones, JobSystem* jobs = nullptr);
+
+// 同上，调色板写成对偶四元数；scales 不为空时同时输出每个骨骼的缩放（见 MaxSkinningScaleDeviation）
+PoseUpdateResult UpdateSkeletonPose(const Skeleton& skeleton, SkeletonPose& pose,
+    BoneDualQuat* palette, BoneScale* scales, int maxBones, JobSystem* jobs = nullptr);
+
+// 把骨架划分为主干 + 子树块（BuildSkeleton 在关节数超过阈值时自动调用）
+void PartitionSkeleton(Skeleton& skeleton, int chunkTargetSize);
+
+// 按名字查关节下标，找不到返回 -1
+int FindJoint(const Skeleton& skeleton, const std::string& name);
+
+// 只采样并合成 joint 的祖先链，得到它在 animTime 的全局变换（不影响当前姿态，可查询未播放的片段）
+aiMatrix4x4 QueryJointGlobal(const Skeleton& skeleton, int joint, float animTime);
+
+// 批量查询：多个关节共享的祖先只采样、合成一次，结果按 joints 顺序写入 outGlobals
+void QueryJointGlobals(const Skeleton& skeleton, const int* joints, size_t count, float animTime,
+    JointQueryScratch& scratch, aiMatrix4x4* outGlobals);
+
+// 同上，查询任意片段的任意时刻：clipTracks 按 SkeletonJoint::track 索引（与 skeleton.tracks 同一套轨道下标，
+// 如同一骨架的另一个动画）。只读 skeleton 的层级和绑定变换，中间结果只写 scratch，与正在播放的片段和姿态无关
+aiMatrix4x4 QueryJointGlobal(const Skeleton& skeleton, const std::vector<BoneAnimCache>& clipTracks, int joint, float clipTime);
+void QueryJointGlobals(const Skeleton& skeleton, const std::vector<BoneAnimCache>& clipTracks, const int* joints, size_t count,
+    float clipTime, JointQueryScratch& scratch, aiMatrix4x4* outGlobals);
+
+// 在 [0, animDuration] 上逐半帧对比折叠后的骨架与未折叠的原始层级，返回全局矩阵元素的最大误差，
+// 按矩阵元素量级相对化（除以 max(1, 参考矩阵元素的最大绝对值)），可直接与 SKELETON_FOLD_TOLERANCE 比较
+float VerifySkeletonAgainstHierarchy(
+    const Skeleton& skeleton,
+    const aiNode* root,
+    const std::map<std::string, BoneAnimCache>& boneAnimCache,
+    float animDuration);
+
+// 在 [0, animDuration] 上逐半帧求蒙皮矩阵的缩放分量与 1 的最大偏差。
+// 根节点的单位换算缩放会被 offset 矩阵抵消；只有偏差明显大于 0 时 DQS 才需要单独的缩放调色板
+float MaxSkinningScaleDeviation(const Skeleton& skeleton, float animDuration);
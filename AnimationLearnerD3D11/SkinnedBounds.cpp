@@ -0,0 +1,183 @@
+﻿#include "SkinnedBounds.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+    // 行主序 3x4 仿射矩阵，最后一行恒为 (0, 0, 0, 1)
+    struct Affine
+    {
+        float m[3][4];
+    };
+
+    Affine LoadAffine(const float* rows)
+    {
+        Affine a;
+        for (int r = 0; r < 3; ++r)
+            for (int c = 0; c < 4; ++c)
+                a.m[r][c] = rows[r * 4 + c];
+        return a;
+    }
+
+    Affine Multiply(const Affine& a, const Affine& b)
+    {
+        Affine r;
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                float v = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j];
+                r.m[i][j] = j == 3 ? v + a.m[i][3] : v;
+            }
+        }
+        return r;
+    }
+
+    void Grow(Float3& lo, Float3& hi, const Float3& p)
+    {
+        lo.x = std::min(lo.x, p.x); lo.y = std::min(lo.y, p.y); lo.z = std::min(lo.z, p.z);
+        hi.x = std::max(hi.x, p.x); hi.y = std::max(hi.y, p.y); hi.z = std::max(hi.z, p.z);
+    }
+
+    // 顶点在某个骨骼空间中的位置；位移 d 的球经 offset 变换后在各轴上的半径为 d * |第 row 行|
+    void AddVertex(BoneBounds& bounds, const aiMatrix4x4& offset, const Float3& p, float d)
+    {
+        const float* m = &offset.a1;
+        float q[3], extent[3];
+        for (int row = 0; row < 3; ++row) {
+            const float* a = m + row * 4;
+            q[row] = a[0] * p.x + a[1] * p.y + a[2] * p.z + a[3];
+            extent[row] = d * std::sqrt(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+        }
+        Grow(bounds.min, bounds.max, { q[0] - extent[0], q[1] - extent[1], q[2] - extent[2] });
+        Grow(bounds.min, bounds.max, { q[0] + extent[0], q[1] + extent[1], q[2] + extent[2] });
+    }
+
+    // 两种调色板的前三行在内存中都是连续的 12 个 float，只是骨骼间的步长不同
+    void ComputeBounds(const BoneBoundsSet& set, const float* palette, size_t boneStride, const aiMatrix4x4& world, SkinnedBounds& out)
+    {
+        Affine worldAffine = LoadAffine(&world.a1);
+        float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+        float hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+        // 先求每个盒子变换后的中心和半长（Arvo：新半长 = |M| * 旧半长），并集与包围球共用
+        // 每帧调用（人群中每个角色一次），临时数组按线程复用，热路径上不分配
+        size_t boxCount = set.bones.size() + (set.hasStatic ? 1 : 0);
+        thread_local std::vector<float> boxes;
+        boxes.resize(boxCount * 6);
+        for (size_t i = 0; i < boxCount; ++i) {
+            Affine transform;
+            Float3 bmin, bmax;
+            if (i < set.bones.size()) {
+                const BoneBounds& bounds = set.bones[i];
+                Affine bone = Multiply(LoadAffine(palette + size_t(bounds.bone) * boneStride), LoadAffine(&bounds.boneToBind.a1));
+                transform = Multiply(worldAffine, bone);
+                bmin = bounds.min;
+                bmax = bounds.max;
+            }
+            else {
+                transform = worldAffine;
+                bmin = set.staticMin;
+                bmax = set.staticMax;
+            }
+            float c[3] = { (bmin.x + bmax.x) * 0.5f, (bmin.y + bmax.y) * 0.5f, (bmin.z + bmax.z) * 0.5f };
+            float e[3] = { (bmax.x - bmin.x) * 0.5f, (bmax.y - bmin.y) * 0.5f, (bmax.z - bmin.z) * 0.5f };
+            float* box = &boxes[i * 6];
+            for (int row = 0; row < 3; ++row) {
+                const float* a = transform.m[row];
+                box[row] = a[0] * c[0] + a[1] * c[1] + a[2] * c[2] + a[3];
+                box[3 + row] = std::fabs(a[0]) * e[0] + std::fabs(a[1]) * e[1] + std::fabs(a[2]) * e[2];
+                lo[row] = std::min(lo[row], box[row] - box[3 + row]);
+                hi[row] = std::max(hi[row], box[row] + box[3 + row]);
+            }
+        }
+        if (boxCount == 0) {
+            out = SkinnedBounds();
+            return;
+        }
+
+        out.min = { lo[0], lo[1], lo[2] };
+        out.max = { hi[0], hi[1], hi[2] };
+        out.center = { (lo[0] + hi[0]) * 0.5f, (lo[1] + hi[1]) * 0.5f, (lo[2] + hi[2]) * 0.5f };
+        // 包围盒的外接球是上限；各盒子离球心最远的角点通常更近
+        float halfDiagonal = 0.5f * std::sqrt((hi[0] - lo[0]) * (hi[0] - lo[0]) + (hi[1] - lo[1]) * (hi[1] - lo[1]) + (hi[2] - lo[2]) * (hi[2] - lo[2]));
+        float radius2 = 0.0f;
+        const float center[3] = { out.center.x, out.center.y, out.center.z };
+        for (size_t i = 0; i < boxCount; ++i) {
+            const float* box = &boxes[i * 6];
+            float d2 = 0.0f;
+            for (int k = 0; k < 3; ++k) {
+                float d = std::fabs(box[k] - center[k]) + box[3 + k];
+                d2 += d * d;
+            }
+            radius2 = std::max(radius2, d2);
+        }
+        out.radius = std::min(halfDiagonal, std::sqrt(radius2));
+    }
+}
+
+void BuildBoneBounds(const std::vector<Vertex>& vertices, const std::vector<VertexInfluences>& extraInfluences,
+    const Skeleton& skeleton, const float* displacement, BoneBoundsSet& out)
+{
+    out = BoneBoundsSet();
+    std::vector<aiMatrix4x4> offsets(skeleton.boneCount);
+    std::vector<unsigned char> known(skeleton.boneCount, 0);
+    for (const SkeletonJoint& joint : skeleton.joints) {
+        if (joint.boneIndex >= 0) {
+            offsets[joint.boneIndex] = joint.offset;
+            known[joint.boneIndex] = 1;
+        }
+    }
+
+    const Float3 emptyMin = { FLT_MAX, FLT_MAX, FLT_MAX };
+    const Float3 emptyMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    std::vector<BoneBounds> bones(skeleton.boneCount);
+    std::vector<unsigned char> used(skeleton.boneCount, 0);
+    for (BoneBounds& bounds : bones) {
+        bounds.min = emptyMin;
+        bounds.max = emptyMax;
+    }
+    out.staticMin = emptyMin;
+    out.staticMax = emptyMax;
+
+    bool hasExtra = !extraInfluences.empty();
+    for (size_t v = 0; v < vertices.size(); ++v) {
+        const Vertex& vert = vertices[v];
+        float d = displacement ? displacement[v] : 0.0f;
+        bool weighted = false;
+        for (int i = 0; i < (hasExtra ? 8 : 4); ++i) {
+            uint32_t bone = i < 4 ? vert.boneIndices[i] : extraInfluences[v].boneIndices[i - 4];
+            float weight = i < 4 ? vert.boneWeights[i] : extraInfluences[v].boneWeights[i - 4];
+            if (weight <= 0.0f || bone >= bones.size())
+                continue;
+            AddVertex(bones[bone], offsets[bone], vert.position, d);
+            used[bone] = 1;
+            weighted = true;
+        }
+        if (!weighted) {
+            out.hasStatic = true;
+            Grow(out.staticMin, out.staticMax, { vert.position.x - d, vert.position.y - d, vert.position.z - d });
+            Grow(out.staticMin, out.staticMax, { vert.position.x + d, vert.position.y + d, vert.position.z + d });
+        }
+    }
+
+    for (int b = 0; b < skeleton.boneCount; ++b) {
+        if (!used[b])
+            continue;
+        BoneBounds& bounds = bones[b];
+        bounds.bone = uint32_t(b);
+        // 没有关节的骨骼下标不会出现在调色板中有意义的位置，offset 为单位矩阵，盒子即绑定空间
+        bounds.boneToBind = known[b] ? aiMatrix4x4(offsets[b]).Inverse() : aiMatrix4x4();
+        out.bones.push_back(bounds);
+    }
+}
+
+void ComputeSkinnedBounds(const BoneBoundsSet& set, const aiMatrix4x4* palette, const aiMatrix4x4& world, SkinnedBounds& out)
+{
+    static_assert(sizeof(aiMatrix4x4) == 16 * sizeof(float), "aiMatrix4x4 must be 16 packed floats");
+    ComputeBounds(set, &palette->a1, 16, world, out);
+}
+
+void ComputeSkinnedBounds(const BoneBoundsSet& set, const BoneMatrix3x4* palette, const aiMatrix4x4& world, SkinnedBounds& out)
+{
+    ComputeBounds(set, palette->rows[0], 12, world, out);
+}
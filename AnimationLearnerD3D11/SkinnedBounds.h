@@ -0,0 +1,50 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "BonePalette.h"
+#include "Skeleton.h"
+#include "Vertex.h"
+
+// 整个角色的包围体：加载时为每个骨骼求它影响的顶点在骨骼空间中的包围盒，
+// 每帧只用调色板变换这几十个盒子再求并集，代价与骨骼数成正比、与顶点数无关。
+// 线性混合蒙皮的位置是各骨骼变换结果的凸组合，每个 M_b * p 都在骨骼 b 的盒子变换后的范围内，所以结果是保守的
+// （DQS 不在凸包内，不适用）
+
+// 一个骨骼影响的顶点（权重非零）在骨骼空间（offset * 绑定位置）中的包围盒
+struct BoneBounds
+{
+    uint32_t bone = 0;          // 调色板下标
+    Float3 min;
+    Float3 max;
+    aiMatrix4x4 boneToBind;     // offset 的逆：palette[bone] * boneToBind 即骨骼当前的全局变换
+};
+
+struct BoneBoundsSet
+{
+    std::vector<BoneBounds> bones;  // 只含影响了至少一个顶点的骨骼
+    bool hasStatic = false;         // 存在没有任何权重的顶点，它们不随骨骼移动
+    Float3 staticMin;
+    Float3 staticMax;
+};
+
+// 世界空间的轴对齐包围盒与包围球
+struct SkinnedBounds
+{
+    Float3 min = { 0.0f, 0.0f, 0.0f };
+    Float3 max = { 0.0f, 0.0f, 0.0f };
+    Float3 center = { 0.0f, 0.0f, 0.0f };
+    float radius = 0.0f;
+};
+
+// vertices 使用全局骨骼下标（未划分子网格），extraInfluences 为空或一一对应；offset 矩阵取自 skeleton 的关节。
+// displacement 非空时为每个顶点在蒙皮之前可能的最大位移（如变形目标，见 ComputeMorphDisplacementBounds），盒子相应放大
+void BuildBoneBounds(const std::vector<Vertex>& vertices, const std::vector<VertexInfluences>& extraInfluences,
+    const Skeleton& skeleton, const float* displacement, BoneBoundsSet& out);
+
+// 由本帧的调色板求世界空间包围体：world * palette[b] * boneToBind 变换各骨骼的盒子后求并集；
+// 包围球取以包围盒中心为球心、包住各骨骼变换后盒子的最小半径
+void ComputeSkinnedBounds(const BoneBoundsSet& set, const aiMatrix4x4* palette, const aiMatrix4x4& world, SkinnedBounds& out);
+
+// 同上，3x4 仿射调色板
+void ComputeSkinnedBounds(const BoneBoundsSet& set, const BoneMatrix3x4* palette, const aiMatrix4x4& world, SkinnedBounds& out);
@@ -0,0 +1,388 @@
+﻿#include "SkinnedBvh.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+    // 每个 worker 一次处理的叶子 / 节点 / 射线数
+    const size_t kRefitGrain = 256;
+    const size_t kRayGrain = 64;
+    // 遍历栈：每层最多留下一个未处理的兄弟节点，再加上刚压入的两个子节点
+    const int kStackSize = BVH_MAX_DEPTH + 1;
+
+    struct Box
+    {
+        Float3 min = { FLT_MAX, FLT_MAX, FLT_MAX };
+        Float3 max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+        void Grow(const Float3& p)
+        {
+            min.x = std::min(min.x, p.x); min.y = std::min(min.y, p.y); min.z = std::min(min.z, p.z);
+            max.x = std::max(max.x, p.x); max.y = std::max(max.y, p.y); max.z = std::max(max.z, p.z);
+        }
+
+        // 空盒（min > max）按分量取 min / max 时不改变结果
+        void Grow(const Box& b)
+        {
+            min.x = std::min(min.x, b.min.x); min.y = std::min(min.y, b.min.y); min.z = std::min(min.z, b.min.z);
+            max.x = std::max(max.x, b.max.x); max.y = std::max(max.y, b.max.y); max.z = std::max(max.z, b.max.z);
+        }
+
+        float HalfArea() const
+        {
+            float dx = max.x - min.x, dy = max.y - min.y, dz = max.z - min.z;
+            return dx < 0.0f ? 0.0f : dx * dy + dy * dz + dz * dx;
+        }
+    };
+
+    inline float Axis(const Float3& p, int axis)
+    {
+        return axis == 0 ? p.x : (axis == 1 ? p.y : p.z);
+    }
+
+    struct BuildTriangle
+    {
+        Box bounds;
+        Float3 centroid;
+    };
+
+    struct Builder
+    {
+        SkinnedBvh& bvh;
+        std::vector<BuildTriangle> triangles;
+        std::vector<int> depth;
+
+        explicit Builder(SkinnedBvh& out) : bvh(out) {}
+
+        void MakeLeaf(uint32_t node, uint32_t first, uint32_t count)
+        {
+            bvh.nodes[node].leftOrFirst = first;
+            bvh.nodes[node].count = count;
+        }
+
+        void Subdivide(uint32_t node, uint32_t first, uint32_t count)
+        {
+            Box bounds, centroids;
+            for (uint32_t i = first; i < first + count; ++i) {
+                bounds.Grow(triangles[bvh.triangles[i]].bounds);
+                centroids.Grow(triangles[bvh.triangles[i]].centroid);
+            }
+            bvh.nodes[node].min = bounds.min;
+            bvh.nodes[node].max = bounds.max;
+            if (count <= BVH_MAX_LEAF_TRIANGLES || depth[node] >= BVH_MAX_DEPTH) {
+                MakeLeaf(node, first, count);
+                return;
+            }
+
+            // 分箱 SAH：每个轴 BVH_SAH_BINS 个箱，评估箱之间的 BVH_SAH_BINS - 1 个切分位置
+            int bestAxis = -1, bestSplit = 0;
+            float bestCost = FLT_MAX;
+            for (int axis = 0; axis < 3; ++axis) {
+                float lo = Axis(centroids.min, axis), hi = Axis(centroids.max, axis);
+                if (hi <= lo)
+                    continue;
+                Box binBounds[BVH_SAH_BINS];
+                uint32_t binCount[BVH_SAH_BINS] = {};
+                float scale = float(BVH_SAH_BINS) / (hi - lo);
+                for (uint32_t i = first; i < first + count; ++i) {
+                    const BuildTriangle& tri = triangles[bvh.triangles[i]];
+                    int bin = std::min(BVH_SAH_BINS - 1, int((Axis(tri.centroid, axis) - lo) * scale));
+                    binBounds[bin].Grow(tri.bounds);
+                    ++binCount[bin];
+                }
+                float leftArea[BVH_SAH_BINS - 1];
+                uint32_t leftCount[BVH_SAH_BINS - 1];
+                Box left;
+                uint32_t running = 0;
+                for (int b = 0; b < BVH_SAH_BINS - 1; ++b) {
+                    left.Grow(binBounds[b]);
+                    running += binCount[b];
+                    leftArea[b] = left.HalfArea();
+                    leftCount[b] = running;
+                }
+                Box right;
+                running = 0;
+                for (int b = BVH_SAH_BINS - 1; b > 0; --b) {
+                    right.Grow(binBounds[b]);
+                    running += binCount[b];
+                    if (leftCount[b - 1] == 0 || running == 0)
+                        continue;
+                    float cost = leftArea[b - 1] * float(leftCount[b - 1]) + right.HalfArea() * float(running);
+                    if (cost < bestCost) {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestSplit = b;
+                    }
+                }
+            }
+
+            // 质心全部重合，无法再分
+            if (bestAxis < 0) {
+                MakeLeaf(node, first, count);
+                return;
+            }
+
+            float lo = Axis(centroids.min, bestAxis);
+            float scale = float(BVH_SAH_BINS) / (Axis(centroids.max, bestAxis) - lo);
+            uint32_t* begin = bvh.triangles.data() + first;
+            uint32_t* middle = std::partition(begin, begin + count, [&](uint32_t t) {
+                return std::min(BVH_SAH_BINS - 1, int((Axis(triangles[t].centroid, bestAxis) - lo) * scale)) < bestSplit;
+            });
+            uint32_t leftCount = uint32_t(middle - begin);
+
+            uint32_t left = uint32_t(bvh.nodes.size());
+            bvh.nodes.resize(bvh.nodes.size() + 2);
+            depth.resize(bvh.nodes.size(), depth[node] + 1);
+            bvh.nodes[node].leftOrFirst = left;
+            bvh.nodes[node].count = 0;
+            Subdivide(left, first, leftCount);
+            Subdivide(left + 1, first + leftCount, count - leftCount);
+        }
+    };
+
+    void RefitLeaves(SkinnedBvh& bvh, const Float3* positions, size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i) {
+            BvhNode& node = bvh.nodes[bvh.leaves[i]];
+            Box box;
+            const uint32_t* tri = &bvh.indices[size_t(node.leftOrFirst) * 3];
+            for (uint32_t k = 0; k < node.count * 3; ++k)
+                box.Grow(positions[tri[k]]);
+            node.min = box.min;
+            node.max = box.max;
+        }
+    }
+
+    void RefitInternal(SkinnedBvh& bvh, const std::vector<uint32_t>& level, size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i) {
+            BvhNode& node = bvh.nodes[level[i]];
+            const BvhNode& a = bvh.nodes[node.leftOrFirst];
+            const BvhNode& b = bvh.nodes[node.leftOrFirst + 1];
+            node.min = { std::min(a.min.x, b.min.x), std::min(a.min.y, b.min.y), std::min(a.min.z, b.min.z) };
+            node.max = { std::max(a.max.x, b.max.x), std::max(a.max.y, b.max.y), std::max(a.max.z, b.max.z) };
+        }
+    }
+
+    // 射线与包围盒的进入距离，未相交返回 FLT_MAX
+    inline float IntersectBox(const BvhNode& node, const Float3& origin, const Float3& invDir, float tMax)
+    {
+        float tx1 = (node.min.x - origin.x) * invDir.x, tx2 = (node.max.x - origin.x) * invDir.x;
+        float ty1 = (node.min.y - origin.y) * invDir.y, ty2 = (node.max.y - origin.y) * invDir.y;
+        float tz1 = (node.min.z - origin.z) * invDir.z, tz2 = (node.max.z - origin.z) * invDir.z;
+        float tNear = std::max(std::max(std::min(tx1, tx2), std::min(ty1, ty2)), std::max(std::min(tz1, tz2), 0.0f));
+        float tFar = std::min(std::min(std::max(tx1, tx2), std::max(ty1, ty2)), std::min(std::max(tz1, tz2), tMax));
+        return tNear <= tFar ? tNear : FLT_MAX;
+    }
+
+    // Möller–Trumbore，双面
+    inline bool IntersectTriangle(const BvhRay& ray, const Float3& p0, const Float3& p1, const Float3& p2,
+        float tMax, float& t, float& u, float& v)
+    {
+        Float3 e1 = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+        Float3 e2 = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+        const Float3& d = ray.direction;
+        Float3 h = { d.y * e2.z - d.z * e2.y, d.z * e2.x - d.x * e2.z, d.x * e2.y - d.y * e2.x };
+        float det = e1.x * h.x + e1.y * h.y + e1.z * h.z;
+        if (std::fabs(det) < 1e-12f)
+            return false;
+        float invDet = 1.0f / det;
+        Float3 s = { ray.origin.x - p0.x, ray.origin.y - p0.y, ray.origin.z - p0.z };
+        u = (s.x * h.x + s.y * h.y + s.z * h.z) * invDet;
+        if (u < 0.0f || u > 1.0f)
+            return false;
+        Float3 q = { s.y * e1.z - s.z * e1.y, s.z * e1.x - s.x * e1.z, s.x * e1.y - s.y * e1.x };
+        v = (d.x * q.x + d.y * q.y + d.z * q.z) * invDet;
+        if (v < 0.0f || u + v > 1.0f)
+            return false;
+        t = (e2.x * q.x + e2.y * q.y + e2.z * q.z) * invDet;
+        return t >= 0.0f && t < tMax;
+    }
+
+    inline float SafeInverse(float x)
+    {
+        return std::fabs(x) > 1e-20f ? 1.0f / x : (x >= 0.0f ? FLT_MAX : -FLT_MAX);
+    }
+
+    // 三个顶点各自的影响按重心坐标加权累加，取总权重最大的骨骼
+    int DominantBone(const Vertex* vertices, const VertexInfluences* extra, const uint32_t* tri, float u, float v)
+    {
+        uint32_t bones[24];
+        float weights[24];
+        int count = 0;
+        const float bary[3] = { 1.0f - u - v, u, v };
+        for (int k = 0; k < 3; ++k) {
+            for (int i = 0; i < (extra ? 8 : 4); ++i) {
+                uint32_t bone = i < 4 ? vertices[tri[k]].boneIndices[i] : extra[tri[k]].boneIndices[i - 4];
+                float weight = (i < 4 ? vertices[tri[k]].boneWeights[i] : extra[tri[k]].boneWeights[i - 4]) * bary[k];
+                if (weight <= 0.0f)
+                    continue;
+                int slot = 0;
+                while (slot < count && bones[slot] != bone)
+                    ++slot;
+                if (slot == count) {
+                    bones[count] = bone;
+                    weights[count++] = 0.0f;
+                }
+                weights[slot] += weight;
+            }
+        }
+        int best = -1;
+        float bestWeight = 0.0f;
+        for (int i = 0; i < count; ++i) {
+            if (weights[i] > bestWeight) {
+                bestWeight = weights[i];
+                best = int(bones[i]);
+            }
+        }
+        return best;
+    }
+
+    void IntersectRange(const SkinnedBvh& bvh, const Float3* positions, const Vertex* vertices, const VertexInfluences* extra,
+        const BvhRay* rays, BvhHit* hits, size_t begin, size_t end)
+    {
+        assert(bvh.maxDepth < kStackSize);
+        uint32_t stack[kStackSize];
+        float stackNear[kStackSize];       // 入栈时的进入距离，出栈时已比最近命中远的节点直接跳过
+        for (size_t r = begin; r < end; ++r) {
+            const BvhRay& ray = rays[r];
+            BvhHit hit;
+            float tMax = ray.tMax;
+            Float3 invDir = { SafeInverse(ray.direction.x), SafeInverse(ray.direction.y), SafeInverse(ray.direction.z) };
+            uint32_t hitSlot = 0;
+
+            int top = 0;
+            if (!bvh.nodes.empty() && IntersectBox(bvh.nodes[0], ray.origin, invDir, tMax) != FLT_MAX) {
+                stack[top] = 0;
+                stackNear[top++] = 0.0f;
+            }
+            while (top > 0) {
+                --top;
+                if (stackNear[top] > tMax)
+                    continue;
+                const BvhNode& node = bvh.nodes[stack[top]];
+                if (node.count > 0) {
+                    for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i) {
+                        const uint32_t* tri = &bvh.indices[size_t(i) * 3];
+                        float t, u, v;
+                        if (IntersectTriangle(ray, positions[tri[0]], positions[tri[1]], positions[tri[2]], tMax, t, u, v)) {
+                            tMax = t;
+                            hit.t = t;
+                            hit.u = u;
+                            hit.v = v;
+                            hit.triangle = bvh.triangles[i];
+                            hitSlot = i;
+                        }
+                    }
+                    continue;
+                }
+                // 近的子节点后入栈、先处理，尽早缩短 tMax
+                uint32_t a = node.leftOrFirst, b = node.leftOrFirst + 1;
+                float ta = IntersectBox(bvh.nodes[a], ray.origin, invDir, tMax);
+                float tb = IntersectBox(bvh.nodes[b], ray.origin, invDir, tMax);
+                if (ta > tb) {
+                    std::swap(a, b);
+                    std::swap(ta, tb);
+                }
+                // 树深不超过 maxDepth 时栈不会溢出（见 kStackSize）
+                assert(top + 2 <= kStackSize);
+                if (tb != FLT_MAX) {
+                    stack[top] = b;
+                    stackNear[top++] = tb;
+                }
+                if (ta != FLT_MAX) {
+                    stack[top] = a;
+                    stackNear[top++] = ta;
+                }
+            }
+
+            if (hit.triangle != BVH_NO_HIT && vertices)
+                hit.bone = DominantBone(vertices, extra, &bvh.indices[size_t(hitSlot) * 3], hit.u, hit.v);
+            hits[r] = hit;
+        }
+    }
+}
+
+void BuildSkinnedBvh(const Float3* positions, size_t vertexCount, const uint32_t* indices, size_t indexCount, SkinnedBvh& out)
+{
+    out = SkinnedBvh();
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0 || vertexCount == 0)
+        return;
+
+    Builder builder(out);
+    builder.triangles.resize(triangleCount);
+    out.triangles.resize(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        BuildTriangle& tri = builder.triangles[t];
+        for (int k = 0; k < 3; ++k)
+            tri.bounds.Grow(positions[indices[t * 3 + k]]);
+        tri.centroid = { (tri.bounds.min.x + tri.bounds.max.x) * 0.5f, (tri.bounds.min.y + tri.bounds.max.y) * 0.5f,
+            (tri.bounds.min.z + tri.bounds.max.z) * 0.5f };
+        out.triangles[t] = uint32_t(t);
+    }
+
+    out.nodes.reserve(triangleCount * 2);
+    out.nodes.resize(1);
+    builder.depth.assign(1, 0);
+    builder.Subdivide(0, 0, uint32_t(triangleCount));
+
+    out.indices.resize(triangleCount * 3);
+    for (size_t i = 0; i < triangleCount; ++i)
+        for (int k = 0; k < 3; ++k)
+            out.indices[i * 3 + k] = indices[size_t(out.triangles[i]) * 3 + k];
+
+    int maxDepth = 0;
+    for (int d : builder.depth)
+        maxDepth = std::max(maxDepth, d);
+    out.maxDepth = maxDepth;
+    out.levels.assign(maxDepth + 1, std::vector<uint32_t>());
+    for (size_t n = 0; n < out.nodes.size(); ++n) {
+        if (out.nodes[n].count > 0)
+            out.leaves.push_back(uint32_t(n));
+        else
+            out.levels[maxDepth - builder.depth[n]].push_back(uint32_t(n));
+    }
+    out.levels.erase(std::remove_if(out.levels.begin(), out.levels.end(),
+        [](const std::vector<uint32_t>& level) { return level.empty(); }), out.levels.end());
+}
+
+void RefitSkinnedBvh(SkinnedBvh& bvh, const Float3* positions, JobSystem* jobs)
+{
+    if (jobs && bvh.leaves.size() > kRefitGrain) {
+        jobs->ParallelFor(bvh.leaves.size(), kRefitGrain, [&](size_t begin, size_t end, int) {
+            RefitLeaves(bvh, positions, begin, end);
+        });
+    }
+    else {
+        RefitLeaves(bvh, positions, 0, bvh.leaves.size());
+    }
+
+    // 每层只依赖更深一层的结果；靠近根的几层节点很少，直接串行
+    for (const std::vector<uint32_t>& level : bvh.levels) {
+        if (jobs && level.size() > kRefitGrain) {
+            jobs->ParallelFor(level.size(), kRefitGrain, [&](size_t begin, size_t end, int) {
+                RefitInternal(bvh, level, begin, end);
+            });
+        }
+        else {
+            RefitInternal(bvh, level, 0, level.size());
+        }
+    }
+}
+
+void IntersectRays(const SkinnedBvh& bvh, const Float3* positions, const Vertex* vertices, const VertexInfluences* extraInfluences,
+    const BvhRay* rays, size_t rayCount, BvhHit* hits, JobSystem* jobs)
+{
+    if (jobs && rayCount > kRayGrain) {
+        jobs->ParallelFor(rayCount, kRayGrain, [&](size_t begin, size_t end, int) {
+            IntersectRange(bvh, positions, vertices, extraInfluences, rays, hits, begin, end);
+        });
+    }
+    else {
+        IntersectRange(bvh, positions, vertices, extraInfluences, rays, hits, 0, rayCount);
+    }
+}
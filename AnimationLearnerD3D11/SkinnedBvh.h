@@ -0,0 +1,70 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Vertex.h"
+
+class JobSystem;
+
+// 蒙皮网格的三角形 BVH：拓扑（树结构、叶子中的三角形）只在加载时按绑定姿态用分箱 SAH 建一次，
+// 每帧由 CPU 蒙皮后的位置自底向上重算节点包围盒（refit），不重建。
+// 动作幅度大时树的质量会比重建差一些，但 refit 只是线性扫描，适合每帧做拾取、命中判定等射线查询
+
+// 叶子最多容纳的三角形数（所有三角形质心重合、或到达 BVH_MAX_DEPTH 时例外）
+#define BVH_MAX_LEAF_TRIANGLES 4
+// 树的最大深度（根为 0），到达时直接成为叶子；求交的遍历栈按它定长，最多 BVH_MAX_DEPTH + 1 项
+#define BVH_MAX_DEPTH 63
+// 每个轴上 SAH 评估的分箱数
+#define BVH_SAH_BINS 12
+// 未命中时 BvhHit::triangle 的值
+#define BVH_NO_HIT 0xffffffffu
+
+// 32 字节：count > 0 为叶子，三角形为 SkinnedBvh::triangles 的 [first, first + count)；
+// 否则为内部节点，两个子节点相邻存放在 leftOrFirst、leftOrFirst + 1
+struct BvhNode
+{
+    Float3 min;
+    uint32_t leftOrFirst = 0;
+    Float3 max;
+    uint32_t count = 0;
+};
+
+static_assert(sizeof(BvhNode) == 32, "BvhNode should be two 16-byte halves");
+
+struct SkinnedBvh
+{
+    std::vector<BvhNode> nodes;             // nodes[0] 为根
+    std::vector<uint32_t> triangles;        // 叶子顺序 -> 原三角形下标
+    std::vector<uint32_t> indices;          // 按叶子顺序复制的三角形索引，refit 和求交时连续读取
+    std::vector<uint32_t> leaves;           // 所有叶子节点
+    std::vector<std::vector<uint32_t>> levels;  // 内部节点按深度分组，最深的在前；同一层可以并行 refit
+    int maxDepth = 0;                       // 叶子的最大深度（根为 0），不超过 BVH_MAX_DEPTH；refit 不改变拓扑
+};
+
+struct BvhRay
+{
+    Float3 origin;
+    Float3 direction;           // 不需要归一化，t 以 direction 的长度为单位
+    float tMax = 3.402823466e+38f;
+};
+
+// 命中点 = (1 - u - v) * p0 + u * p1 + v * p2；bone 为三个顶点的权重按重心坐标加权后最大的全局骨骼下标
+struct BvhHit
+{
+    uint32_t triangle = BVH_NO_HIT;     // 原三角形下标（indices 中的第 triangle * 3 个索引起）
+    float t = 0.0f;
+    float u = 0.0f;
+    float v = 0.0f;
+    int bone = -1;
+};
+
+// 由绑定姿态（或任意一帧）的顶点位置建树
+void BuildSkinnedBvh(const Float3* positions, size_t vertexCount, const uint32_t* indices, size_t indexCount, SkinnedBvh& out);
+
+// 用蒙皮后的位置重算所有节点的包围盒：先并行算叶子，再逐层向上并行合并；jobs 为空时在当前线程执行
+void RefitSkinnedBvh(SkinnedBvh& bvh, const Float3* positions, JobSystem* jobs = nullptr);
+
+// 批量射线查询，每条射线取最近的交点（双面）。vertices / extraInfluences 用于求 dominant bone，
+// 为空时 hit.bone 为 -1。提供 jobs 时按射线分组并行
+void IntersectRays(const SkinnedBvh& bvh, const Float3* positions, const Vertex* vertices, const VertexInfluences* extraInfluences,
+    const BvhRay* rays, size_t rayCount, BvhHit* hits, JobSystem* jobs = nullptr);
@@ -0,0 +1,707 @@
+﻿#include "Skinning.h"
+#include <algorithm>
+#include <cmath>
+#include "JobSystem.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SKINNING_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC 不需要 /arch:AVX2 就能使用 AVX2 内建函数；GCC/Clang 需要按函数打开目标特性
+#if defined(SKINNING_X86) && !defined(_MSC_VER)
+#define SKINNING_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define SKINNING_TARGET_AVX2
+#endif
+
+// x64 上 SSE2 是基线；32 位 x86 需要编译器本身开启 SSE2
+#if defined(SKINNING_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define SKINNING_HAS_SSE 1
+#endif
+
+namespace
+{
+    void NormalizeOrZero(Float3& n)
+    {
+        float lengthSq = n.x * n.x + n.y * n.y + n.z * n.z;
+        if (lengthSq > 0.0f) {
+            float invLength = 1.0f / std::sqrt(lengthSq);
+            n.x *= invLength;
+            n.y *= invLength;
+            n.z *= invLength;
+        }
+    }
+
+    // 第 i 个影响：前 4 个在 Vertex 里，第 5~8 个在第二个顶点流 extra 中
+    inline uint32_t InfluenceBone(const Vertex& vert, const VertexInfluences* extra, int i)
+    {
+        return i < 4 ? vert.boneIndices[i] : extra->boneIndices[i - 4];
+    }
+
+    inline float InfluenceWeight(const Vertex& vert, const VertexInfluences* extra, int i)
+    {
+        return i < 4 ? vert.boneWeights[i] : extra->boneWeights[i - 4];
+    }
+
+    // palette 指向首个骨骼矩阵的第一行，stride 为相邻骨骼之间的 float 数（4x4 为 16，3x4 为 12）。
+    // Influences 为每个顶点的影响数（4 或 8），循环次数在编译期确定
+    template<int Influences>
+    void SkinScalar(const Vertex* vertices, const VertexInfluences* extra, size_t count, const float* palette, size_t stride,
+        Float3* outPositions, Float3* outNormals)
+    {
+        for (size_t v = 0; v < count; ++v) {
+            const Vertex& vert = vertices[v];
+            const VertexInfluences* ex = Influences > 4 ? extra + v : nullptr;
+            const Float3& p = vert.position;
+            const Float3& n = vert.normal;
+
+            Float3 pos = { 0.0f, 0.0f, 0.0f };
+            Float3 nrm = { 0.0f, 0.0f, 0.0f };
+            for (int i = 0; i < Influences; ++i) {
+                const float* m = palette + InfluenceBone(vert, ex, i) * stride;
+                float w = InfluenceWeight(vert, ex, i);
+
+                pos.x += w * (m[0] * p.x + m[1] * p.y + m[2] * p.z + m[3]);
+                pos.y += w * (m[4] * p.x + m[5] * p.y + m[6] * p.z + m[7]);
+                pos.z += w * (m[8] * p.x + m[9] * p.y + m[10] * p.z + m[11]);
+
+                nrm.x += w * (m[0] * n.x + m[1] * n.y + m[2] * n.z);
+                nrm.y += w * (m[4] * n.x + m[5] * n.y + m[6] * n.z);
+                nrm.z += w * (m[8] * n.x + m[9] * n.y + m[10] * n.z);
+            }
+
+            NormalizeOrZero(nrm);
+            outPositions[v] = pos;
+            outNormals[v] = nrm;
+        }
+    }
+
+    // 刚性段：所有顶点使用同一个矩阵 m（前三行），没有调色板查找和权重运算
+    void SkinRigidScalar(const Vertex* vertices, size_t count, const float* m, Float3* outPositions, Float3* outNormals)
+    {
+        for (size_t v = 0; v < count; ++v) {
+            const Float3& p = vertices[v].position;
+            const Float3& n = vertices[v].normal;
+            outPositions[v] = {
+                m[0] * p.x + m[1] * p.y + m[2] * p.z + m[3],
+                m[4] * p.x + m[5] * p.y + m[6] * p.z + m[7],
+                m[8] * p.x + m[9] * p.y + m[10] * p.z + m[11],
+            };
+            Float3 nrm = {
+                m[0] * n.x + m[1] * n.y + m[2] * n.z,
+                m[4] * n.x + m[5] * n.y + m[6] * n.z,
+                m[8] * n.x + m[9] * n.y + m[10] * n.z,
+            };
+            NormalizeOrZero(nrm);
+            outNormals[v] = nrm;
+        }
+    }
+
+    Float3 Cross(const Float3& a, const Float3& b)
+    {
+        return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+    }
+
+    // 在绑定空间按权重混合各骨骼的缩放；法线按缩放的逆变换
+    template<int Influences>
+    void BlendBoneScales(const Vertex& vert, const VertexInfluences* ex, const BoneScale* scales, Float3& p, Float3& n)
+    {
+        Float3 ps = { 0.0f, 0.0f, 0.0f };
+        Float3 ns = { 0.0f, 0.0f, 0.0f };
+        for (int i = 0; i < Influences; ++i) {
+            const float* s = scales[InfluenceBone(vert, ex, i)].scale;
+            float w = InfluenceWeight(vert, ex, i);
+            ps.x += w * s[0] * p.x;
+            ps.y += w * s[1] * p.y;
+            ps.z += w * s[2] * p.z;
+            ns.x += s[0] != 0.0f ? w * n.x / s[0] : 0.0f;
+            ns.y += s[1] != 0.0f ? w * n.y / s[1] : 0.0f;
+            ns.z += s[2] != 0.0f ? w * n.z / s[2] : 0.0f;
+        }
+        p = ps;
+        n = ns;
+    }
+
+    template<int Influences>
+    void SkinDualQuatScalar(const Vertex* vertices, const VertexInfluences* extra, size_t count, const BoneDualQuat* palette, const BoneScale* scales,
+        Float3* outPositions, Float3* outNormals)
+    {
+        for (size_t v = 0; v < count; ++v) {
+            const Vertex& vert = vertices[v];
+            const VertexInfluences* ex = Influences > 4 ? extra + v : nullptr;
+            Float3 p = vert.position;
+            Float3 n = vert.normal;
+            if (scales)
+                BlendBoneScales<Influences>(vert, ex, scales, p, n);
+
+            // 与第一个影响骨骼取同一半球后线性混合（q 与 -q 表示同一旋转）
+            const float* pivot = palette[vert.boneIndices[0]].real;
+            float real[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            float dual[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            for (int i = 0; i < Influences; ++i) {
+                const BoneDualQuat& dq = palette[InfluenceBone(vert, ex, i)];
+                float w = InfluenceWeight(vert, ex, i);
+                if (dq.real[0] * pivot[0] + dq.real[1] * pivot[1] + dq.real[2] * pivot[2] + dq.real[3] * pivot[3] < 0.0f)
+                    w = -w;
+                for (int c = 0; c < 4; ++c) {
+                    real[c] += w * dq.real[c];
+                    dual[c] += w * dq.dual[c];
+                }
+            }
+
+            float lengthSq = real[0] * real[0] + real[1] * real[1] + real[2] * real[2] + real[3] * real[3];
+            if (lengthSq > 0.0f) {
+                float invLength = 1.0f / std::sqrt(lengthSq);
+                for (int c = 0; c < 4; ++c) {
+                    real[c] *= invLength;
+                    dual[c] *= invLength;
+                }
+            }
+
+            // p' = p + 2 r x (r x p + w p) + 2 (w d - dw r + r x d)
+            Float3 r = { real[0], real[1], real[2] };
+            Float3 d = { dual[0], dual[1], dual[2] };
+            float rw = real[3], dw = dual[3];
+
+            Float3 rp = Cross(r, p);
+            Float3 rotP = Cross(r, { rp.x + rw * p.x, rp.y + rw * p.y, rp.z + rw * p.z });
+            Float3 rd = Cross(r, d);
+            Float3 pos = {
+                p.x + 2.0f * (rotP.x + rw * d.x - dw * r.x + rd.x),
+                p.y + 2.0f * (rotP.y + rw * d.y - dw * r.y + rd.y),
+                p.z + 2.0f * (rotP.z + rw * d.z - dw * r.z + rd.z),
+            };
+
+            Float3 rn = Cross(r, n);
+            Float3 rotN = Cross(r, { rn.x + rw * n.x, rn.y + rw * n.y, rn.z + rw * n.z });
+            Float3 nrm = { n.x + 2.0f * rotN.x, n.y + 2.0f * rotN.y, n.z + 2.0f * rotN.z };
+
+            NormalizeOrZero(nrm);
+            outPositions[v] = pos;
+            outNormals[v] = nrm;
+        }
+    }
+
+#if defined(SKINNING_HAS_SSE)
+    // 已混合的三行矩阵 r0, r1, r2 乘以 v（v.w 为 1 时是点，为 0 时是方向），返回 (x, y, z, 0)
+    inline __m128 TransformRows(__m128 r0, __m128 r1, __m128 r2, __m128 v)
+    {
+        __m128 x = _mm_mul_ps(r0, v);
+        __m128 y = _mm_mul_ps(r1, v);
+        __m128 z = _mm_mul_ps(r2, v);
+        __m128 w = _mm_setzero_ps();
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        return _mm_add_ps(_mm_add_ps(x, y), _mm_add_ps(z, w));
+    }
+
+    inline void StoreFloat3(Float3& out, __m128 v)
+    {
+        float tmp[4];
+        _mm_storeu_ps(tmp, v);
+        out.x = tmp[0];
+        out.y = tmp[1];
+        out.z = tmp[2];
+    }
+
+    inline void StoreNormalized(Float3& out, __m128 n)
+    {
+        __m128 sq = _mm_mul_ps(n, n);
+        __m128 lengthSq = _mm_add_ss(_mm_add_ss(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(1, 1, 1, 1))),
+            _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 2, 2, 2)));
+        if (_mm_cvtss_f32(lengthSq) > 0.0f) {
+            __m128 length = _mm_sqrt_ss(lengthSq);
+            n = _mm_div_ps(n, _mm_shuffle_ps(length, length, 0));
+        }
+        StoreFloat3(out, n);
+    }
+
+    template<int Influences>
+    void SkinSSE(const Vertex* vertices, const VertexInfluences* extra, size_t count, const float* palette, size_t stride,
+        Float3* outPositions, Float3* outNormals)
+    {
+        for (size_t v = 0; v < count; ++v) {
+            const Vertex& vert = vertices[v];
+            const VertexInfluences* ex = Influences > 4 ? extra + v : nullptr;
+
+            // 先按权重混合调色板的前三行（第四行恒为 0 0 0 1，不参与）
+            __m128 r0 = _mm_setzero_ps();
+            __m128 r1 = _mm_setzero_ps();
+            __m128 r2 = _mm_setzero_ps();
+            for (int i = 0; i < Influences; ++i) {
+                const float* m = palette + InfluenceBone(vert, ex, i) * stride;
+                __m128 w = _mm_set1_ps(InfluenceWeight(vert, ex, i));
+                r0 = _mm_add_ps(r0, _mm_mul_ps(w, _mm_loadu_ps(m + 0)));
+                r1 = _mm_add_ps(r1, _mm_mul_ps(w, _mm_loadu_ps(m + 4)));
+                r2 = _mm_add_ps(r2, _mm_mul_ps(w, _mm_loadu_ps(m + 8)));
+            }
+
+            const Float3& p = vert.position;
+            const Float3& n = vert.normal;
+            StoreFloat3(outPositions[v], TransformRows(r0, r1, r2, _mm_setr_ps(p.x, p.y, p.z, 1.0f)));
+            StoreNormalized(outNormals[v], TransformRows(r0, r1, r2, _mm_setr_ps(n.x, n.y, n.z, 0.0f)));
+        }
+    }
+
+    // 矩阵三行在循环外加载一次
+    void SkinRigidSSE(const Vertex* vertices, size_t count, const float* m, Float3* outPositions, Float3* outNormals)
+    {
+        __m128 r0 = _mm_loadu_ps(m + 0);
+        __m128 r1 = _mm_loadu_ps(m + 4);
+        __m128 r2 = _mm_loadu_ps(m + 8);
+        for (size_t v = 0; v < count; ++v) {
+            const Float3& p = vertices[v].position;
+            const Float3& n = vertices[v].normal;
+            StoreFloat3(outPositions[v], TransformRows(r0, r1, r2, _mm_setr_ps(p.x, p.y, p.z, 1.0f)));
+            StoreNormalized(outNormals[v], TransformRows(r0, r1, r2, _mm_setr_ps(n.x, n.y, n.z, 0.0f)));
+        }
+    }
+
+    // (a.yzx * b.zxy - a.zxy * b.yzx)，w 分量为 0
+    inline __m128 Cross3(__m128 a, __m128 b)
+    {
+        __m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 c = _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b));
+        return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+    }
+
+    // 四个分量之和广播到所有通道
+    inline __m128 Dot4(__m128 a, __m128 b)
+    {
+        __m128 m = _mm_mul_ps(a, b);
+        m = _mm_add_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_add_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+    }
+
+    inline __m128 SplatW(__m128 v)
+    {
+        return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+
+    // 用单位四元数 (r, rw) 旋转 v：v + 2 r x (r x v + rw v)
+    inline __m128 RotateByQuat(__m128 real, __m128 v)
+    {
+        __m128 inner = _mm_add_ps(Cross3(real, v), _mm_mul_ps(SplatW(real), v));
+        __m128 rotated = Cross3(real, inner);
+        return _mm_add_ps(v, _mm_add_ps(rotated, rotated));
+    }
+
+    template<int Influences>
+    void SkinDualQuatSSE(const Vertex* vertices, const VertexInfluences* extra, size_t count, const BoneDualQuat* palette, const BoneScale* scales,
+        Float3* outPositions, Float3* outNormals)
+    {
+        const __m128 xyzMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+        for (size_t v = 0; v < count; ++v) {
+            const Vertex& vert = vertices[v];
+            const VertexInfluences* ex = Influences > 4 ? extra + v : nullptr;
+            Float3 p = vert.position;
+            Float3 n = vert.normal;
+            if (scales)
+                BlendBoneScales<Influences>(vert, ex, scales, p, n);
+
+            // 与第一个影响骨骼取同一半球后线性混合
+            __m128 pivot = _mm_loadu_ps(palette[vert.boneIndices[0]].real);
+            __m128 real = _mm_setzero_ps();
+            __m128 dual = _mm_setzero_ps();
+            for (int i = 0; i < Influences; ++i) {
+                const BoneDualQuat& dq = palette[InfluenceBone(vert, ex, i)];
+                __m128 r = _mm_loadu_ps(dq.real);
+                __m128 w = _mm_set1_ps(InfluenceWeight(vert, ex, i));
+                // 点积为负时把权重的符号位翻转
+                __m128 negative = _mm_cmplt_ps(Dot4(r, pivot), _mm_setzero_ps());
+                w = _mm_xor_ps(w, _mm_and_ps(negative, _mm_set1_ps(-0.0f)));
+                real = _mm_add_ps(real, _mm_mul_ps(w, r));
+                dual = _mm_add_ps(dual, _mm_mul_ps(w, _mm_loadu_ps(dq.dual)));
+            }
+
+            __m128 lengthSq = Dot4(real, real);
+            if (_mm_cvtss_f32(lengthSq) > 0.0f) {
+                __m128 length = _mm_sqrt_ps(lengthSq);
+                real = _mm_div_ps(real, length);
+                dual = _mm_div_ps(dual, length);
+            }
+
+            // 平移 t = 2 (rw d - dw r + r x d)
+            __m128 t = _mm_sub_ps(_mm_mul_ps(SplatW(real), dual), _mm_mul_ps(SplatW(dual), real));
+            t = _mm_and_ps(_mm_add_ps(t, Cross3(real, dual)), xyzMask);
+            t = _mm_add_ps(t, t);
+
+            __m128 pos = _mm_add_ps(RotateByQuat(real, _mm_setr_ps(p.x, p.y, p.z, 0.0f)), t);
+            __m128 nrm = _mm_and_ps(RotateByQuat(real, _mm_setr_ps(n.x, n.y, n.z, 0.0f)), xyzMask);
+            StoreFloat3(outPositions[v], pos);
+            StoreNormalized(outNormals[v], nrm);
+        }
+    }
+#endif
+
+#if defined(SKINNING_X86)
+    template<int Influences>
+    SKINNING_TARGET_AVX2
+    void SkinAVX2(const Vertex* vertices, const VertexInfluences* extra, size_t count, const float* palette, size_t stride,
+        Float3* outPositions, Float3* outNormals)
+    {
+        for (size_t v = 0; v < count; ++v) {
+            const Vertex& vert = vertices[v];
+            const VertexInfluences* ex = Influences > 4 ? extra + v : nullptr;
+
+            // 第 0、1 行放在一个 256 位寄存器里，第 2 行单独用 128 位
+            __m256 r01 = _mm256_setzero_ps();
+            __m128 r2 = _mm_setzero_ps();
+            for (int i = 0; i < Influences; ++i) {
+                const float* m = palette + InfluenceBone(vert, ex, i) * stride;
+                float weight = InfluenceWeight(vert, ex, i);
+                r01 = _mm256_fmadd_ps(_mm256_set1_ps(weight), _mm256_loadu_ps(m), r01);
+                r2 = _mm_fmadd_ps(_mm_set1_ps(weight), _mm_loadu_ps(m + 8), r2);
+            }
+
+            const Float3& p = vert.position;
+            const Float3& n = vert.normal;
+            __m128 pos = _mm_setr_ps(p.x, p.y, p.z, 1.0f);
+            __m128 nrm = _mm_setr_ps(n.x, n.y, n.z, 0.0f);
+
+            // 一次乘法同时得到两行与点/方向的逐分量积，再用 hadd 归约
+            __m256 p01 = _mm256_mul_ps(r01, _mm256_set_m128(pos, pos));
+            __m256 n01 = _mm256_mul_ps(r01, _mm256_set_m128(nrm, nrm));
+            __m128 p2 = _mm_mul_ps(r2, pos);
+            __m128 n2 = _mm_mul_ps(r2, nrm);
+
+            // hadd(hadd(a, b), hadd(c, d)) = (sum a, sum b, sum c, sum d)
+            __m128 p0 = _mm256_castps256_ps128(p01);
+            __m128 p1 = _mm256_extractf128_ps(p01, 1);
+            __m128 n0 = _mm256_castps256_ps128(n01);
+            __m128 n1 = _mm256_extractf128_ps(n01, 1);
+            __m128 zero = _mm_setzero_ps();
+            __m128 skinnedPos = _mm_hadd_ps(_mm_hadd_ps(p0, p1), _mm_hadd_ps(p2, zero));
+            __m128 skinnedNrm = _mm_hadd_ps(_mm_hadd_ps(n0, n1), _mm_hadd_ps(n2, zero));
+
+            float tmp[4];
+            _mm_storeu_ps(tmp, skinnedPos);
+            outPositions[v] = { tmp[0], tmp[1], tmp[2] };
+
+            __m128 lengthSq = _mm_dp_ps(skinnedNrm, skinnedNrm, 0x7f);
+            if (_mm_cvtss_f32(lengthSq) > 0.0f)
+                skinnedNrm = _mm_div_ps(skinnedNrm, _mm_sqrt_ps(lengthSq));
+            _mm_storeu_ps(tmp, skinnedNrm);
+            outNormals[v] = { tmp[0], tmp[1], tmp[2] };
+        }
+    }
+
+    bool CpuSupportsAVX2()
+    {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) return false;
+
+        // 需要 OSXSAVE + AVX（leaf 1 ECX 27/28）且操作系统保存了 YMM 状态
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        bool fma = (info[2] & (1 << 12)) != 0;
+        if (!osxsave || !avx || !fma) return false;
+        if ((_xgetbv(0) & 0x6) != 0x6) return false;
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+    }
+#endif
+
+    template<int Influences>
+    void SkinWithKernel(const Vertex* vertices, const VertexInfluences* extra, size_t count, const float* palette, size_t stride,
+        Float3* outPositions, Float3* outNormals, SkinningKernel kernel)
+    {
+        // 不支持的实现退回标量版本
+        if (!IsSkinningKernelSupported(kernel))
+            kernel = SkinningKernel::Scalar;
+
+        switch (kernel) {
+#if defined(SKINNING_X86)
+        case SkinningKernel::AVX2:
+            SkinAVX2<Influences>(vertices, extra, count, palette, stride, outPositions, outNormals);
+            return;
+#endif
+#if defined(SKINNING_HAS_SSE)
+        case SkinningKernel::SSE:
+            SkinSSE<Influences>(vertices, extra, count, palette, stride, outPositions, outNormals);
+            return;
+#endif
+        default:
+            SkinScalar<Influences>(vertices, extra, count, palette, stride, outPositions, outNormals);
+            return;
+        }
+    }
+
+    // 按运行时的影响数选择特化版本；influences 为 5~8 时按 8 个处理（extra 不能为空）
+    void SkinWithKernel(int influences, const Vertex* vertices, const VertexInfluences* extra, size_t count,
+        const float* palette, size_t stride, Float3* outPositions, Float3* outNormals, SkinningKernel kernel)
+    {
+        switch (influences) {
+        case 1: SkinWithKernel<1>(vertices, extra, count, palette, stride, outPositions, outNormals, kernel); return;
+        case 2: SkinWithKernel<2>(vertices, extra, count, palette, stride, outPositions, outNormals, kernel); return;
+        case 3: SkinWithKernel<3>(vertices, extra, count, palette, stride, outPositions, outNormals, kernel); return;
+        case 4: SkinWithKernel<4>(vertices, extra, count, palette, stride, outPositions, outNormals, kernel); return;
+        default: SkinWithKernel<8>(vertices, extra, count, palette, stride, outPositions, outNormals, kernel); return;
+        }
+    }
+
+    void SkinRigidWithKernel(const Vertex* vertices, size_t count, const float* m,
+        Float3* outPositions, Float3* outNormals, SkinningKernel kernel)
+    {
+#if defined(SKINNING_HAS_SSE)
+        // 只有一个矩阵，瓶颈在顶点读写，AVX2 也使用 SSE 实现
+        if (kernel != SkinningKernel::Scalar) {
+            SkinRigidSSE(vertices, count, m, outPositions, outNormals);
+            return;
+        }
+#endif
+        SkinRigidScalar(vertices, count, m, outPositions, outNormals);
+    }
+
+    template<int Influences>
+    void SkinDualQuatWithKernel(const Vertex* vertices, const VertexInfluences* extra, size_t count, const BoneDualQuat* palette,
+        const BoneScale* scales, Float3* outPositions, Float3* outNormals, SkinningKernel kernel)
+    {
+#if defined(SKINNING_HAS_SSE)
+        // 四元数运算只有 4 个通道，AVX2 也使用 SSE 实现
+        if (kernel != SkinningKernel::Scalar) {
+            SkinDualQuatSSE<Influences>(vertices, extra, count, palette, scales, outPositions, outNormals);
+            return;
+        }
+#endif
+        SkinDualQuatScalar<Influences>(vertices, extra, count, palette, scales, outPositions, outNormals);
+    }
+
+    void SkinDualQuatWithKernel(int influences, const Vertex* vertices, const VertexInfluences* extra, size_t count,
+        const BoneDualQuat* palette, const BoneScale* scales, Float3* outPositions, Float3* outNormals, SkinningKernel kernel)
+    {
+        switch (influences) {
+        case 1: SkinDualQuatWithKernel<1>(vertices, extra, count, palette, scales, outPositions, outNormals, kernel); return;
+        case 2: SkinDualQuatWithKernel<2>(vertices, extra, count, palette, scales, outPositions, outNormals, kernel); return;
+        case 3: SkinDualQuatWithKernel<3>(vertices, extra, count, palette, scales, outPositions, outNormals, kernel); return;
+        case 4: SkinDualQuatWithKernel<4>(vertices, extra, count, palette, scales, outPositions, outNormals, kernel); return;
+        default: SkinDualQuatWithKernel<8>(vertices, extra, count, palette, scales, outPositions, outNormals, kernel); return;
+        }
+    }
+
+    // skinRange(begin, end) 蒙皮 [begin, end) 区间的顶点
+    template<typename SkinRange>
+    void SkinChunked(JobSystem* jobs, size_t count, SkinRange&& skinRange)
+    {
+        if (!jobs || count <= SKINNING_CHUNK_VERTICES) {
+            skinRange(size_t(0), count);
+            return;
+        }
+
+        // 以块为单位分发，块边界固定，各块写入互不重叠的输出区间
+        size_t chunkCount = (count + SKINNING_CHUNK_VERTICES - 1) / SKINNING_CHUNK_VERTICES;
+        jobs->ParallelFor(chunkCount, 1, [&](size_t beginChunk, size_t endChunk, int) {
+            skinRange(beginChunk * SKINNING_CHUNK_VERTICES, std::min(count, endChunk * SKINNING_CHUNK_VERTICES));
+        });
+    }
+
+    // 分桶蒙皮：块边界与桶边界无关，每块按与之相交的桶分段调用 skinBucket(bucket, begin, end)
+    template<typename SkinBucket>
+    void SkinBucketsChunked(JobSystem* jobs, const InfluenceBucket* buckets, size_t bucketCount, SkinBucket&& skinBucket)
+    {
+        size_t count = 0;
+        for (size_t b = 0; b < bucketCount; ++b)
+            count = std::max(count, size_t(buckets[b].vertexStart) + buckets[b].vertexCount);
+
+        SkinChunked(jobs, count, [&](size_t begin, size_t end) {
+            for (size_t b = 0; b < bucketCount; ++b) {
+                size_t bucketBegin = std::max(begin, size_t(buckets[b].vertexStart));
+                size_t bucketEnd = std::min(end, size_t(buckets[b].vertexStart) + buckets[b].vertexCount);
+                if (bucketBegin < bucketEnd)
+                    skinBucket(buckets[b], bucketBegin, bucketEnd);
+            }
+        });
+    }
+
+    // 压缩顶点按小块解码到栈上（256 个顶点 16KB，留在 L1），再交给 skinDecoded(decoded, first, count)
+    template<typename SkinDecoded>
+    void SkinPackedChunked(JobSystem* jobs, const PackedVertexBuffer& packed, SkinDecoded&& skinDecoded)
+    {
+        SkinChunked(jobs, packed.count, [&](size_t begin, size_t end) {
+            Vertex decoded[PACKED_DECODE_VERTICES];
+            for (size_t first = begin; first < end; first += PACKED_DECODE_VERTICES) {
+                size_t count = std::min(end - first, size_t(PACKED_DECODE_VERTICES));
+                UnpackVertices(packed, first, count, decoded);
+                skinDecoded(decoded, first, count);
+            }
+        });
+    }
+}
+
+const char* SkinningKernelName(SkinningKernel kernel)
+{
+    switch (kernel) {
+    case SkinningKernel::SSE: return "SSE";
+    case SkinningKernel::AVX2: return "AVX2";
+    default: return "Scalar";
+    }
+}
+
+bool IsSkinningKernelSupported(SkinningKernel kernel)
+{
+    switch (kernel) {
+    case SkinningKernel::Scalar:
+        return true;
+    case SkinningKernel::SSE:
+#if defined(SKINNING_HAS_SSE)
+        return true;
+#else
+        return false;
+#endif
+    case SkinningKernel::AVX2:
+#if defined(SKINNING_X86)
+    {
+        static const bool supported = CpuSupportsAVX2();
+        return supported;
+    }
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+SkinningKernel BestSkinningKernel()
+{
+    if (IsSkinningKernelSupported(SkinningKernel::AVX2)) return SkinningKernel::AVX2;
+    if (IsSkinningKernelSupported(SkinningKernel::SSE)) return SkinningKernel::SSE;
+    return SkinningKernel::Scalar;
+}
+
+void SkinVertices(const Vertex* vertices, size_t count, const aiMatrix4x4* palette,
+    Float3* outPositions, Float3* outNormals, SkinningKernel kernel, const VertexInfluences* extraInfluences)
+{
+    SkinWithKernel(extraInfluences ? 8 : 4, vertices, extraInfluences, count, &palette->a1, 16, outPositions, outNormals, kernel);
+}
+
+void SkinVertices(const Vertex* vertices, size_t count, const BoneMatrix3x4* palette,
+    Float3* outPositions, Float3* outNormals, SkinningKernel kernel, const VertexInfluences* extraInfluences)
+{
+    SkinWithKernel(extraInfluences ? 8 : 4, vertices, extraInfluences, count, &palette->rows[0][0], 12,
+        outPositions, outNormals, kernel);
+}
+
+void SkinVertices(const Vertex* vertices, size_t count, const aiMatrix4x4* palette,
+    Float3* outPositions, Float3* outNormals)
+{
+    SkinVertices(vertices, count, palette, outPositions, outNormals, BestSkinningKernel());
+}
+
+void SkinVertices(const Vertex* vertices, size_t count, const BoneDualQuat* palette, const BoneScale* scales,
+    Float3* outPositions, Float3* outNormals, SkinningKernel kernel, const VertexInfluences* extraInfluences)
+{
+    if (!IsSkinningKernelSupported(kernel))
+        kernel = SkinningKernel::Scalar;
+    SkinDualQuatWithKernel(extraInfluences ? 8 : 4, vertices, extraInfluences, count, palette, scales,
+        outPositions, outNormals, kernel);
+}
+
+void SkinVerticesParallel(JobSystem* jobs, const Vertex* vertices, size_t count, const aiMatrix4x4* palette,
+    Float3* outPositions, Float3* outNormals, SkinningKernel kernel, const VertexInfluences* extraInfluences)
+{
+    SkinChunked(jobs, count, [&](size_t begin, size_t end) {
+        SkinVertices(vertices + begin, end - begin, palette, outPositions + begin, outNormals + begin, kernel,
+            extraInfluences ? extraInfluences + begin : nullptr);
+    });
+}
+
+void SkinVerticesParallel(JobSystem* jobs, const Vertex* vertices, size_t count, const BoneMatrix3x4* palette,
+    Float3* outPositions, Float3* outNormals, SkinningKernel kernel, const VertexInfluences* extraInfluences)
+{
+    SkinChunked(jobs, count, [&](size_t begin, size_t end) {
+        SkinVertices(vertices + begin, end - begin, palette, outPositions + begin, outNormals + begin, kernel,
+            extraInfluences ? extraInfluences + begin : nullptr);
+    });
+}
+
+void SkinVerticesParallel(JobSystem* jobs, const Vertex* vertices, size_t count, const BoneDualQuat* palette,
+    const BoneScale* scales, Float3* outPositions, Float3* outNormals, SkinningKernel kernel,
+    const VertexInfluences* extraInfluences)
+{
+    SkinChunked(jobs, count, [&](size_t begin, size_t end) {
+        SkinVertices(vertices + begin, end - begin, palette, scales, outPositions + begin, outNormals + begin, kernel,
+            extraInfluences ? extraInfluences + begin : nullptr);
+    });
+}
+
+void SkinVerticesBucketed(JobSystem* jobs, const Vertex* vertices, const VertexInfluences* extraInfluences,
+    const InfluenceBucket* buckets, size_t bucketCount, const aiMatrix4x4* palette,
+    Float3* outPositions, Float3* outNormals, SkinningKernel kernel)
+{
+    SkinBucketsChunked(jobs, buckets, bucketCount, [&](const InfluenceBucket& bucket, size_t begin, size_t end) {
+        if (bucket.influences == 0)
+            SkinRigidWithKernel(vertices + begin, end - begin, &palette[bucket.rigidBone].a1,
+                outPositions + begin, outNormals + begin, kernel);
+        else
+            SkinWithKernel(bucket.influences, vertices + begin, extraInfluences ? extraInfluences + begin : nullptr,
+                end - begin, &palette->a1, 16, outPositions + begin, outNormals + begin, kernel);
+    });
+}
+
+void SkinVerticesBucketed(JobSystem* jobs, const Vertex* vertices, const VertexInfluences* extraInfluences,
+    const InfluenceBucket* buckets, size_t bucketCount, const BoneMatrix3x4* palette,
+    Float3* outPositions, Float3* outNormals, SkinningKernel kernel)
+{
+    SkinBucketsChunked(jobs, buckets, bucketCount, [&](const InfluenceBucket& bucket, size_t begin, size_t end) {
+        if (bucket.influences == 0)
+            SkinRigidWithKernel(vertices + begin, end - begin, &palette[bucket.rigidBone].rows[0][0],
+                outPositions + begin, outNormals + begin, kernel);
+        else
+            SkinWithKernel(bucket.influences, vertices + begin, extraInfluences ? extraInfluences + begin : nullptr,
+                end - begin, &palette->rows[0][0], 12, outPositions + begin, outNormals + begin, kernel);
+    });
+}
+
+void SkinVerticesBucketed(JobSystem* jobs, const Vertex* vertices, const VertexInfluences* extraInfluences,
+    const InfluenceBucket* buckets, size_t bucketCount, const BoneDualQuat* palette, const BoneScale* scales,
+    Float3* outPositions, Float3* outNormals, SkinningKernel kernel)
+{
+    if (!IsSkinningKernelSupported(kernel))
+        kernel = SkinningKernel::Scalar;
+    SkinBucketsChunked(jobs, buckets, bucketCount, [&](const InfluenceBucket& bucket, size_t begin, size_t end) {
+        // 刚性段的顶点只有一个权重为 1 的影响，按 1 个影响处理即可得到同一结果
+        SkinDualQuatWithKernel(std::max(bucket.influences, 1), vertices + begin,
+            extraInfluences ? extraInfluences + begin : nullptr, end - begin, palette, scales,
+            outPositions + begin, outNormals + begin, kernel);
+    });
+}
+
+void SkinPackedVertices(JobSystem* jobs, const PackedVertexBuffer& packed, const aiMatrix4x4* palette,
+    Float3* outPositions, Float3* outNormals, SkinningKernel kernel, const VertexInfluences* extraInfluences)
+{
+    SkinPackedChunked(jobs, packed, [&](const Vertex* decoded, size_t first, size_t count) {
+        SkinVertices(decoded, count, palette, outPositions + first, outNormals + first, kernel,
+            extraInfluences ? extraInfluences + first : nullptr);
+    });
+}
+
+void SkinPackedVertices(JobSystem* jobs, const PackedVertexBuffer& packed, const BoneMatrix3x4* palette,
+    Float3* outPositions, Float3* outNormals, SkinningKernel kernel, const VertexInfluences* extraInfluences)
+{
+    SkinPackedChunked(jobs, packed, [&](const Vertex* decoded, size_t first, size_t count) {
+        SkinVertices(decoded, count, palette, outPositions + first, outNormals + first, kernel,
+            extraInfluences ? extraInfluences + first : nullptr);
+    });
+}
+
+void SkinPackedVertices(JobSystem* jobs, const PackedVertexBuffer& packed, const BoneDualQuat* palette,
+    const BoneScale* scales, Float3* outPositions, Float3* outNormals, SkinningKernel kernel,
+    const VertexInfluences* extraInfluences)
+{
+    SkinPackedChunked(jobs, packed, [&](const Vertex* decoded, size_t first, size_t count) {
+        SkinVertices(decoded, count, palette, scales, outPositions + first, outNormals + first, kernel,
+            extraInfluences ? extraInfluences + first : nullptr);
+    });
+}
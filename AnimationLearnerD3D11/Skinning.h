@@ -0,0 +1,94 @@
+﻿#pragma once
+#include <cstddef>
+#include "BonePalette.h"
+#include "Influences.h"
+#include "PackedVertex.h"
+#include "Vertex.h"
+
+class JobSystem;
+
+// CPU 端线性混合蒙皮（LBS），与 PhongShader.hlsl 的 VSMain 使用同一套数学：
+//   position' = sum(w_i * M_i * (p, 1))
+//   normal'   = normalize(sum(w_i * M_i3x3 * n))
+// 其中 M_i 是调色板中的 aiMatrix4x4（即 BoneMatrixBuffer 的内容）或 BoneMatrix3x4。
+// 用于无窗口校验 GPU 结果，以及碰撞、导出姿态网格等需要 CPU 端蒙皮结果的地方。
+
+enum class SkinningKernel
+{
+    Scalar,
+    SSE,    // SSE2，每个顶点先混合 3x4 矩阵再变换
+    AVX2,   // AVX2 + FMA，两行矩阵合并成一个 256 位寄存器混合
+};
+
+const char* SkinningKernelName(SkinningKernel kernel);
+
+// 当前 CPU 和编译器是否能运行该实现（AVX2 在运行时通过 CPUID 检测）
+bool IsSkinningKernelSupported(SkinningKernel kernel);
+
+// 当前机器上最快的实现
+SkinningKernel BestSkinningKernel();
+
+// 蒙皮 vertices[0, count)，结果写入 outPositions / outNormals（各 count 个）。
+// 标量版本逐骨骼变换再加权，与着色器的运算顺序相同；SIMD 版本先加权混合矩阵，结果只有舍入级差异。
+// extraInfluences 不为空时是与 vertices 一一对应的第 5~8 个影响（见 Influences.h），每个顶点混合 8 个骨骼
+void SkinVertices(const Vertex* vertices, size_t count, const aiMatrix4x4* palette,
+    Float3* outPositions, Float3* outNormals, SkinningKernel kernel, const VertexInfluences* extraInfluences = nullptr);
+
+// 3x4 仿射调色板版本，每个骨骼少读 16 字节
+void SkinVertices(const Vertex* vertices, size_t count, const BoneMatrix3x4* palette,
+    Float3* outPositions, Float3* outNormals, SkinningKernel kernel, const VertexInfluences* extraInfluences = nullptr);
+
+// 对偶四元数蒙皮（DQS）：各骨骼对偶四元数与第一个影响骨骼取同一半球后按权重混合、归一化，再做刚体变换，
+// 避免 LBS 在扭转关节处的“糖果纸”塌陷。scales 不为空时先在绑定空间按权重混合各骨骼的缩放。
+// 四元数运算只有 4 个通道，AVX2 使用 SSE 实现
+void SkinVertices(const Vertex* vertices, size_t count, const BoneDualQuat* palette, const BoneScale* scales,
+    Float3* outPositions, Float3* outNormals, SkinningKernel kernel, const VertexInfluences* extraInfluences = nullptr);
+
+// 使用 BestSkinningKernel()
+void SkinVertices(const Vertex* vertices, size_t count, const aiMatrix4x4* palette,
+    Float3* outPositions, Float3* outNormals);
+
+// 并行蒙皮时每块的顶点数：输入 64KB + 输出 24KB，按单核 L2 的容量选取。
+// 尚未在多核机器上测量扩展性，可按 --bench 的 parallel skinning 结果调整
+#define SKINNING_CHUNK_VERTICES 1024
+
+// 把顶点数组切成 SKINNING_CHUNK_VERTICES 大小的块，在 jobs 上并行蒙皮。
+// 结果写入调用方提供的缓冲区，调用过程中不分配内存；jobs 为空时在当前线程执行
+void SkinVerticesParallel(JobSystem* jobs, const Vertex* vertices, size_t count, const aiMatrix4x4* palette,
+    Float3* outPositions, Float3* outNormals, SkinningKernel kernel, const VertexInfluences* extraInfluences = nullptr);
+
+void SkinVerticesParallel(JobSystem* jobs, const Vertex* vertices, size_t count, const BoneMatrix3x4* palette,
+    Float3* outPositions, Float3* outNormals, SkinningKernel kernel, const VertexInfluences* extraInfluences = nullptr);
+
+void SkinVerticesParallel(JobSystem* jobs, const Vertex* vertices, size_t count, const BoneDualQuat* palette,
+    const BoneScale* scales, Float3* outPositions, Float3* outNormals, SkinningKernel kernel,
+    const VertexInfluences* extraInfluences = nullptr);
+
+// 分桶蒙皮：顶点已按影响数排序（SortVerticesByInfluenceCount），每个桶调用循环次数固定的特化版本，
+// 只有一两个影响的顶点不再执行完整的 4 次循环；刚性段（influences 为 0）整段只用 rigidBone 一个矩阵变换，
+// 开销接近静态网格（DQS 的刚性段按 1 个影响处理）。按 SKINNING_CHUNK_VERTICES 分块，jobs 为空时在当前线程执行
+void SkinVerticesBucketed(JobSystem* jobs, const Vertex* vertices, const VertexInfluences* extraInfluences,
+    const InfluenceBucket* buckets, size_t bucketCount, const aiMatrix4x4* palette,
+    Float3* outPositions, Float3* outNormals, SkinningKernel kernel);
+
+void SkinVerticesBucketed(JobSystem* jobs, const Vertex* vertices, const VertexInfluences* extraInfluences,
+    const InfluenceBucket* buckets, size_t bucketCount, const BoneMatrix3x4* palette,
+    Float3* outPositions, Float3* outNormals, SkinningKernel kernel);
+
+void SkinVerticesBucketed(JobSystem* jobs, const Vertex* vertices, const VertexInfluences* extraInfluences,
+    const InfluenceBucket* buckets, size_t bucketCount, const BoneDualQuat* palette, const BoneScale* scales,
+    Float3* outPositions, Float3* outNormals, SkinningKernel kernel);
+
+// 压缩顶点（PackedVertex.h）的蒙皮：每块按 PACKED_DECODE_VERTICES 个顶点解码到栈上再调用上面的实现，
+// 结果与先整体解码再蒙皮逐位一致。extraInfluences 同上，仍是未压缩的第 5~8 个影响
+#define PACKED_DECODE_VERTICES 256
+
+void SkinPackedVertices(JobSystem* jobs, const PackedVertexBuffer& packed, const aiMatrix4x4* palette,
+    Float3* outPositions, Float3* outNormals, SkinningKernel kernel, const VertexInfluences* extraInfluences = nullptr);
+
+void SkinPackedVertices(JobSystem* jobs, const PackedVertexBuffer& packed, const BoneMatrix3x4* palette,
+    Float3* outPositions, Float3* outNormals, SkinningKernel kernel, const VertexInfluences* extraInfluences = nullptr);
+
+void SkinPackedVertices(JobSystem* jobs, const PackedVertexBuffer& packed, const BoneDualQuat* palette,
+    const BoneScale* scales, Float3* outPositions, Float3* outNormals, SkinningKernel kernel,
+    const VertexInfluences* extraInfluences = nullptr);
@@ -0,0 +1,285 @@
+﻿// 蒙皮着色器变体。PhongShader.hlsl 是默认的 4x4 调色板版本；
+// 这里用宏切换调色板格式等选项，由 InitShaders 按 App 的设置编译：
+//   BONE_PALETTE_3X4  调色板为行主序 3x4 仿射矩阵（BoneMatrix3x4），每骨骼 48 字节
+//   SKINNING_DQS      对偶四元数蒙皮，调色板为 BoneDualQuat（real, dual 两个 float4），每骨骼 32 字节
+//   DQS_SCALE         DQS 时额外读取槽 2 的每骨骼缩放（BoneScale），在绑定空间先混合缩放
+//   MAX_INFLUENCES    每顶点影响数，4（默认）或 8；8 时第 5~8 个影响来自顶点流槽 1（VertexInfluences）
+//   RIGID_SEGMENT     刚性段：整个 draw 只用常量缓冲区中 rigidBoneIndex 一个骨骼，不读取顶点的骨骼下标和权重
+//   PACKED_VERTEX     压缩顶点（PackedVertex.h）：法线为八面体编码的 SNORM16 x2，UV、下标、权重由输入布局的格式转换
+//   QUANTIZED_POSITION 在着色器中用常量缓冲区的 positionScale / positionOffset 还原子网格包围盒内的 UNORM16 位置。
+//                     只有 DQS 需要：矩阵调色板已把还原折进每个骨骼矩阵（FoldPositionQuantization），顶点直接用 [0, 1] 的位置
+//   MORPH_TARGETS     变形目标：槽 2 为本帧累加好的位置 / 法线增量（MorphDelta），在蒙皮之前叠加。
+//                     位置增量与顶点位置同一空间（折进调色板时 CPU 端已除以子网格的缩放）
+
+#ifndef BONE_PALETTE_3X4
+#define BONE_PALETTE_3X4 0
+#endif
+#ifndef SKINNING_DQS
+#define SKINNING_DQS 0
+#endif
+#ifndef DQS_SCALE
+#define DQS_SCALE 0
+#endif
+#ifndef MAX_INFLUENCES
+#define MAX_INFLUENCES 4
+#endif
+#ifndef RIGID_SEGMENT
+#define RIGID_SEGMENT 0
+#endif
+#ifndef PACKED_VERTEX
+#define PACKED_VERTEX 0
+#endif
+#ifndef QUANTIZED_POSITION
+#define QUANTIZED_POSITION 0
+#endif
+#ifndef MORPH_TARGETS
+#define MORPH_TARGETS 0
+#endif
+
+cbuffer ConstantBuffer : register(b0)
+{
+    float4x4 world;
+    float4x4 view;
+    float4x4 proj;
+    float3 lightDir;
+    uint targetBoneIndex;
+    uint rigidBoneIndex;
+    float4 positionScale;
+    float4 positionOffset;
+};
+
+cbuffer BoneMatrixBuffer : register(b1)
+{
+#if SKINNING_DQS
+    // boneDualQuats[2 * i] 为实部，[2 * i + 1] 为对偶部
+    float4 boneDualQuats[256];
+#elif BONE_PALETTE_3X4
+    // 每行一个寄存器，内存中即 aiMatrix4x4 的前三行
+    row_major float3x4 boneMatrices[128];
+#else
+    // CPU 端按 aiMatrix4x4 行写入，按列主序读取后即为其转置
+    float4x4 boneMatrices[128];
+#endif
+};
+
+#if SKINNING_DQS && DQS_SCALE
+cbuffer BoneScaleBuffer : register(b2)
+{
+    float4 boneScales[128];
+};
+#endif
+
+struct VSInput
+{
+    float3 position : POSITION;
+#if PACKED_VERTEX
+    float2 normal : NORMAL;
+#else
+    float3 normal : NORMAL;
+#endif
+    float2 texcoord : TEXCOORD;
+    uint4 boneIndices : BONEINDICES;
+    float4 boneWeights : BONEWEIGHTS;
+#if MAX_INFLUENCES > 4
+    // 槽 1 的 VertexInfluences：输入布局中语义索引为 1 的 BONEINDICES / BONEWEIGHTS，偏移 0 和 16
+    uint4 boneIndices1 : BONEINDICES1;
+    float4 boneWeights1 : BONEWEIGHTS1;
+#endif
+#if MORPH_TARGETS
+    float4 morphPosition : MORPHPOSITION;
+    float4 morphNormal : MORPHNORMAL;
+#endif
+};
+
+struct VSOutput
+{
+    float4 position : SV_POSITION;
+    float3 normal : NORMAL;
+    float highlight : TEXCOORD0;   // 当前高亮骨骼对该顶点的权重
+};
+
+// 第 i 个影响；循环都已展开，i 是编译期常量
+uint InfluenceBone(VSInput input, int i)
+{
+#if MAX_INFLUENCES > 4
+    return i < 4 ? input.boneIndices[i] : input.boneIndices1[i - 4];
+#else
+    return input.boneIndices[i];
+#endif
+}
+
+float InfluenceWeight(VSInput input, int i)
+{
+#if MAX_INFLUENCES > 4
+    return i < 4 ? input.boneWeights[i] : input.boneWeights1[i - 4];
+#else
+    return input.boneWeights[i];
+#endif
+}
+
+// 顶点的模型空间位置和法线，压缩格式在这里解码
+float3 InputPosition(VSInput input)
+{
+#if PACKED_VERTEX && QUANTIZED_POSITION
+    float3 position = input.position * positionScale.xyz + positionOffset.xyz;
+#else
+    float3 position = input.position;
+#endif
+#if MORPH_TARGETS
+    position += input.morphPosition.xyz;
+#endif
+    return position;
+}
+
+float3 InputNormal(VSInput input)
+{
+#if PACKED_VERTEX
+    // 与 PackedVertex.cpp 的 DecodeOctahedral 相同：下半球沿对角线展开
+    float2 e = input.normal;
+    float3 n = float3(e, 1.0f - abs(e.x) - abs(e.y));
+    if (n.z < 0.0f)
+        n.xy = (1.0f - abs(n.yx)) * (n.xy >= 0.0f ? 1.0f : -1.0f);
+    n = normalize(n);
+#else
+    float3 n = input.normal;
+#endif
+#if MORPH_TARGETS
+    n += input.morphNormal.xyz;
+#endif
+    return n;
+}
+
+// 法线按缩放的倒数变换；与 Skinning.cpp 的 BlendBoneScales 相同，缩放为 0 的分量不贡献法线
+float3 InverseScale(float3 scale)
+{
+    return scale != 0.0f ? 1.0f / scale : 0.0f;
+}
+
+// 用单位四元数 q 旋转 v
+float3 RotateByQuat(float4 q, float3 v)
+{
+    return v + 2.0f * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+#if RIGID_SEGMENT
+// 刚性段：所有顶点以权重 1 绑定在 rigidBoneIndex 上，与静态网格一样每个 draw 一个变换
+void SkinVertex(VSInput input, out float3 position, out float3 normal)
+{
+#if SKINNING_DQS
+    position = InputPosition(input);
+    normal = InputNormal(input);
+#if DQS_SCALE
+    float3 scale = boneScales[rigidBoneIndex].xyz;
+    position *= scale;
+    normal *= InverseScale(scale);
+#endif
+    float4 real = boneDualQuats[2 * rigidBoneIndex];
+    float4 dual = boneDualQuats[2 * rigidBoneIndex + 1];
+    float3 translation = 2.0f * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));
+    position = RotateByQuat(real, position) + translation;
+    normal = RotateByQuat(real, normal);
+#elif BONE_PALETTE_3X4
+    position = mul(boneMatrices[rigidBoneIndex], float4(InputPosition(input), 1.0f));
+    normal = mul((float3x3)boneMatrices[rigidBoneIndex], InputNormal(input));
+#else
+    position = mul(float4(InputPosition(input), 1.0f), boneMatrices[rigidBoneIndex]).xyz;
+    normal = mul(InputNormal(input), (float3x3)boneMatrices[rigidBoneIndex]);
+#endif
+}
+#elif SKINNING_DQS
+// 与 Skinning.cpp 中 CPU 参考实现相同的对偶四元数蒙皮
+void SkinVertex(VSInput input, out float3 position, out float3 normal)
+{
+    position = InputPosition(input);
+    normal = InputNormal(input);
+#if DQS_SCALE
+    position = float3(0.0f, 0.0f, 0.0f);
+    normal = float3(0.0f, 0.0f, 0.0f);
+    [unroll]
+    for (int s = 0; s < MAX_INFLUENCES; ++s)
+    {
+        float3 scale = boneScales[InfluenceBone(input, s)].xyz;
+        position += InfluenceWeight(input, s) * scale * InputPosition(input);
+        normal += InfluenceWeight(input, s) * InputNormal(input) * InverseScale(scale);
+    }
+#endif
+
+    // 与第一个影响骨骼取同一半球后线性混合
+    float4 pivot = boneDualQuats[2 * input.boneIndices.x];
+    float4 real = float4(0.0f, 0.0f, 0.0f, 0.0f);
+    float4 dual = float4(0.0f, 0.0f, 0.0f, 0.0f);
+    [unroll]
+    for (int i = 0; i < MAX_INFLUENCES; ++i)
+    {
+        uint index = InfluenceBone(input, i);
+        float4 r = boneDualQuats[2 * index];
+        float weight = dot(r, pivot) < 0.0f ? -InfluenceWeight(input, i) : InfluenceWeight(input, i);
+        real += weight * r;
+        dual += weight * boneDualQuats[2 * index + 1];
+    }
+
+    float magnitude = sqrt(dot(real, real));
+    if (magnitude > 0.0f)
+    {
+        real /= magnitude;
+        dual /= magnitude;
+    }
+
+    float3 translation = 2.0f * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));
+    position = RotateByQuat(real, position) + translation;
+    normal = RotateByQuat(real, normal);
+}
+#else
+// 与 Skinning.cpp 中 CPU 参考实现相同的线性混合蒙皮
+void SkinVertex(VSInput input, out float3 position, out float3 normal)
+{
+    position = float3(0.0f, 0.0f, 0.0f);
+    normal = float3(0.0f, 0.0f, 0.0f);
+
+    [unroll]
+    for (int i = 0; i < MAX_INFLUENCES; ++i)
+    {
+        uint index = InfluenceBone(input, i);
+        float weight = InfluenceWeight(input, i);
+#if BONE_PALETTE_3X4
+        position += weight * mul(boneMatrices[index], float4(InputPosition(input), 1.0f));
+        normal += weight * mul((float3x3)boneMatrices[index], InputNormal(input));
+#else
+        position += weight * mul(float4(InputPosition(input), 1.0f), boneMatrices[index]).xyz;
+        normal += weight * mul(InputNormal(input), (float3x3)boneMatrices[index]);
+#endif
+    }
+}
+#endif
+
+VSOutput VSMain(VSInput input)
+{
+    float3 skinnedPosition, skinnedNormal;
+    SkinVertex(input, skinnedPosition, skinnedNormal);
+
+    VSOutput output;
+    float4 worldPosition = mul(float4(skinnedPosition, 1.0f), world);
+    output.position = mul(mul(worldPosition, view), proj);
+    output.normal = mul(skinnedNormal, (float3x3)world);
+
+#if RIGID_SEGMENT
+    output.highlight = rigidBoneIndex == targetBoneIndex ? 1.0f : 0.0f;
+#else
+    output.highlight = 0.0f;
+    [unroll]
+    for (int i = 0; i < MAX_INFLUENCES; ++i)
+        output.highlight += InfluenceBone(input, i) == targetBoneIndex ? InfluenceWeight(input, i) : 0.0f;
+#endif
+    return output;
+}
+
+// 与 PhongShader.hlsl 的光照相同：0.1 环境光加白色漫反射，再按高亮骨骼的权重向红色混合
+float4 PSMain(VSOutput input) : SV_TARGET
+{
+    float3 lightDirection = normalize(lightDir);
+    float3 n = normalize(input.normal);
+    float diffuseIntensity = saturate(dot(n, -lightDirection));
+    float3 baseColor = float3(0.1f, 0.1f, 0.1f) + float3(1.0f, 1.0f, 1.0f) * diffuseIntensity;
+    float3 finalColor = lerp(baseColor, float3(1.0f, 0.0f, 0.0f), saturate(input.highlight) * 0.5f);
+    return float4(finalColor, 1.0f);
+}
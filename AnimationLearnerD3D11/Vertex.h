@@ -0,0 +1,34 @@
+﻿#pragma once
+#include <cstdint>
+
+// 与 DirectX::XMFLOAT2 / XMFLOAT3 内存布局一致，不依赖 Windows 头文件，便于在其他平台上处理顶点数据
+struct Float2
+{
+    float x, y;
+};
+
+struct Float3
+{
+    float x, y, z;
+};
+
+// 蒙皮顶点，布局与 InitShaders 中的输入布局一一对应（64 字节）
+struct Vertex {
+    Float3 position;
+    Float3 normal;
+    Float2 texcoord;
+
+    uint32_t boneIndices[4] = { 0 };
+    float boneWeights[4] = { 0 };
+};
+
+static_assert(sizeof(Vertex) == 64, "Vertex must match the D3D11 input layout");
+
+// 第 5~8 个骨骼影响，只有需要 8 影响的资源才创建，作为第二个顶点流（slot 1）与 Vertex 一一对应
+struct VertexInfluences
+{
+    uint32_t boneIndices[4] = { 0 };
+    float boneWeights[4] = { 0 };
+};
+
+static_assert(sizeof(VertexInfluences) == 32, "VertexInfluences must match the D3D11 input layout");
@@ -0,0 +1,316 @@
+﻿#include "VertexCache.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    // 剩余相邻三角形数超过它时按它计分
+    const int kMaxValence = 32;
+
+    // Forsyth 的评分表：刚用过的三个顶点固定 0.75（避免总是紧跟刚输出的三角形），
+    // 其余按在缓存中的位置衰减；剩余三角形少的顶点加分，尽早把它用完
+    struct ScoreTables
+    {
+        float cache[VERTEX_CACHE_OPTIMIZE_SIZE];
+        float valence[kMaxValence + 1];
+
+        ScoreTables()
+        {
+            for (int i = 0; i < VERTEX_CACHE_OPTIMIZE_SIZE; ++i) {
+                if (i < 3)
+                    cache[i] = 0.75f;
+                else
+                    cache[i] = std::pow(1.0f - float(i - 3) / float(VERTEX_CACHE_OPTIMIZE_SIZE - 3), 1.5f);
+            }
+            valence[0] = 0.0f;
+            for (int i = 1; i <= kMaxValence; ++i)
+                valence[i] = 2.0f / std::sqrt(float(i));
+        }
+    };
+
+    const ScoreTables& GetScoreTables()
+    {
+        static const ScoreTables tables;
+        return tables;
+    }
+
+    float VertexScore(const ScoreTables& tables, int cachePosition, uint32_t remaining)
+    {
+        if (remaining == 0)
+            return -1.0f;   // 已没有未输出的三角形
+        float score = cachePosition >= 0 ? tables.cache[cachePosition] : 0.0f;
+        return score + tables.valence[std::min<uint32_t>(remaining, kMaxValence)];
+    }
+}
+
+VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, int cacheSize)
+{
+    VertexCacheStats stats;
+    stats.triangles = indexCount / 3;
+
+    // 时间戳模拟 FIFO：顶点进入缓存后再有 cacheSize 次未命中就被挤出
+    std::vector<uint32_t> timestamp(vertexCount, 0);
+    uint32_t time = uint32_t(cacheSize) + 1;
+    std::vector<unsigned char> seen(vertexCount, 0);
+    for (size_t i = 0; i < indexCount; ++i) {
+        uint32_t v = indices[i];
+        if (time - timestamp[v] > uint32_t(cacheSize)) {
+            timestamp[v] = time++;
+            ++stats.misses;
+        }
+        if (!seen[v]) {
+            seen[v] = 1;
+            ++stats.uniqueVertices;
+        }
+    }
+
+    stats.acmr = stats.triangles ? float(stats.misses) / float(stats.triangles) : 0.0f;
+    stats.atvr = stats.uniqueVertices ? float(stats.misses) / float(stats.uniqueVertices) : 0.0f;
+    return stats;
+}
+
+void OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+        return;
+    const ScoreTables& tables = GetScoreTables();
+
+    // 每个顶点相邻的未输出三角形（CSR），输出后从列表中删除
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i)
+        ++remaining[indices[i]];
+    std::vector<uint32_t> adjacencyStart(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v)
+        adjacencyStart[v + 1] = adjacencyStart[v] + remaining[v];
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    {
+        std::vector<uint32_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+        for (size_t t = 0; t < triangleCount; ++t)
+            for (int corner = 0; corner < 3; ++corner)
+                adjacency[fill[indices[t * 3 + corner]]++] = uint32_t(t);
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        vertexScore[v] = VertexScore(tables, -1, remaining[v]);
+
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<unsigned char> emitted(triangleCount, 0);
+    size_t best = 0;
+    for (size_t t = 0; t < triangleCount; ++t) {
+        const uint32_t* tri = &indices[t * 3];
+        triangleScore[t] = vertexScore[tri[0]] + vertexScore[tri[1]] + vertexScore[tri[2]];
+        if (triangleScore[t] > triangleScore[best])
+            best = t;
+    }
+
+    std::vector<uint32_t> output;
+    output.reserve(triangleCount * 3);
+    uint32_t cache[VERTEX_CACHE_OPTIMIZE_SIZE + 3];
+    uint32_t newCache[VERTEX_CACHE_OPTIMIZE_SIZE + 3];
+    int cacheCount = 0;
+    size_t cursor = 0;   // 缓存中没有候选时，从这里按原顺序找下一个未输出的三角形
+
+    for (size_t step = 0; step < triangleCount; ++step) {
+        const uint32_t* tri = &indices[best * 3];
+        output.insert(output.end(), tri, tri + 3);
+        emitted[best] = 1;
+
+        // 从三个顶点的相邻列表中删除该三角形
+        for (int corner = 0; corner < 3; ++corner) {
+            uint32_t v = tri[corner];
+            uint32_t* list = &adjacency[adjacencyStart[v]];
+            uint32_t count = remaining[v];
+            for (uint32_t i = 0; i < count; ++i) {
+                if (list[i] == best) {
+                    list[i] = list[count - 1];
+                    break;
+                }
+            }
+            remaining[v] = count - 1;
+        }
+
+        // 三个顶点移到 LRU 缓存最前面
+        int newCount = 0;
+        for (int corner = 0; corner < 3; ++corner) {
+            uint32_t v = tri[corner];
+            bool duplicate = false;
+            for (int i = 0; i < newCount; ++i)
+                duplicate = duplicate || newCache[i] == v;
+            if (!duplicate)
+                newCache[newCount++] = v;
+        }
+        for (int i = 0; i < cacheCount; ++i) {
+            uint32_t v = cache[i];
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                newCache[newCount++] = v;
+        }
+
+        // 更新缓存内及被挤出顶点的评分，再更新它们相邻三角形的评分，同时找出下一个三角形
+        for (int i = 0; i < newCount; ++i) {
+            uint32_t v = newCache[i];
+            cachePosition[v] = i < VERTEX_CACHE_OPTIMIZE_SIZE ? i : -1;
+            vertexScore[v] = VertexScore(tables, cachePosition[v], remaining[v]);
+        }
+        float bestScore = -1.0f;
+        bool found = false;
+        for (int i = 0; i < newCount; ++i) {
+            uint32_t v = newCache[i];
+            const uint32_t* list = &adjacency[adjacencyStart[v]];
+            for (uint32_t k = 0; k < remaining[v]; ++k) {
+                uint32_t t = list[k];
+                const uint32_t* other = &indices[t * 3];
+                triangleScore[t] = vertexScore[other[0]] + vertexScore[other[1]] + vertexScore[other[2]];
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = t;
+                    found = true;
+                }
+            }
+        }
+
+        cacheCount = std::min(newCount, VERTEX_CACHE_OPTIMIZE_SIZE);
+        std::copy(newCache, newCache + cacheCount, cache);
+
+        if (!found) {
+            while (cursor < triangleCount && emitted[cursor])
+                ++cursor;
+            if (cursor == triangleCount)
+                break;
+            best = cursor;
+        }
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void OptimizeMeshVertexCache(PartitionedMesh& mesh)
+{
+    // 每个 draw 先把引用的顶点压缩成局部编号，优化的临时数组只与 draw 的大小有关
+    std::vector<int> localIndex(mesh.vertices.size(), -1);
+    std::vector<uint32_t> globalIndex;
+    std::vector<uint32_t> localIndices;
+    for (const SkinnedSubmesh& submesh : mesh.submeshes) {
+        for (const InfluenceDraw& draw : submesh.draws) {
+            uint32_t* indices = &mesh.indices[draw.indexStart];
+            globalIndex.clear();
+            localIndices.resize(draw.indexCount);
+            for (uint32_t i = 0; i < draw.indexCount; ++i) {
+                uint32_t v = indices[i];
+                if (localIndex[v] < 0) {
+                    localIndex[v] = int(globalIndex.size());
+                    globalIndex.push_back(v);
+                }
+                localIndices[i] = uint32_t(localIndex[v]);
+            }
+
+            OptimizeVertexCache(localIndices.data(), localIndices.size(), globalIndex.size());
+
+            for (uint32_t i = 0; i < draw.indexCount; ++i)
+                indices[i] = globalIndex[localIndices[i]];
+            for (uint32_t v : globalIndex)
+                localIndex[v] = -1;
+        }
+    }
+}
+
+VertexFetchStats AnalyzeVertexFetch(const uint32_t* indices, size_t indexCount, size_t vertexCount, size_t vertexSize)
+{
+    VertexFetchStats stats;
+    size_t lineCount = (vertexCount * vertexSize + VERTEX_FETCH_LINE_SIZE - 1) / VERTEX_FETCH_LINE_SIZE;
+
+    // 两级都用时间戳模拟 FIFO（见 AnalyzeVertexCache）
+    std::vector<uint32_t> vertexStamp(vertexCount, 0);
+    uint32_t vertexTime = VERTEX_CACHE_FIFO_SIZE + 1;
+    std::vector<uint32_t> lineStamp(lineCount, 0);
+    uint32_t lineTime = VERTEX_FETCH_CACHE_LINES + 1;
+    std::vector<unsigned char> seen(vertexCount, 0);
+    size_t uniqueVertices = 0;
+
+    for (size_t i = 0; i < indexCount; ++i) {
+        uint32_t v = indices[i];
+        if (!seen[v]) {
+            seen[v] = 1;
+            ++uniqueVertices;
+        }
+        if (vertexTime - vertexStamp[v] <= VERTEX_CACHE_FIFO_SIZE)
+            continue;
+        vertexStamp[v] = vertexTime++;
+
+        size_t firstLine = v * vertexSize / VERTEX_FETCH_LINE_SIZE;
+        size_t lastLine = (v * vertexSize + vertexSize - 1) / VERTEX_FETCH_LINE_SIZE;
+        for (size_t line = firstLine; line <= lastLine; ++line) {
+            if (lineTime - lineStamp[line] > VERTEX_FETCH_CACHE_LINES) {
+                lineStamp[line] = lineTime++;
+                stats.bytesFetched += VERTEX_FETCH_LINE_SIZE;
+            }
+        }
+    }
+
+    stats.overfetch = uniqueVertices ? float(stats.bytesFetched) / float(uniqueVertices * vertexSize) : 0.0f;
+    return stats;
+}
+
+std::vector<uint32_t> BuildVertexFetchRemap(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+    const std::vector<VertexRange>& ranges)
+{
+    std::vector<VertexRange> allRanges = ranges;
+    if (allRanges.empty()) {
+        VertexRange whole;
+        whole.count = uint32_t(vertexCount);
+        allRanges.push_back(whole);
+    }
+
+    // 每个顶点所属区间，以及区间内下一个可用的新编号
+    std::vector<int> owner(vertexCount, -1);
+    std::vector<uint32_t> next(allRanges.size());
+    for (size_t r = 0; r < allRanges.size(); ++r) {
+        next[r] = allRanges[r].start;
+        for (uint32_t v = allRanges[r].start; v < allRanges[r].start + allRanges[r].count; ++v)
+            owner[v] = int(r);
+    }
+
+    const uint32_t unassigned = ~0u;
+    std::vector<uint32_t> remap(vertexCount, unassigned);
+    for (size_t i = 0; i < indexCount; ++i) {
+        uint32_t v = indices[i];
+        if (remap[v] == unassigned) {
+            assert(owner[v] >= 0);
+            remap[v] = next[owner[v]]++;
+        }
+    }
+    for (size_t v = 0; v < vertexCount; ++v) {
+        if (remap[v] == unassigned) {
+            assert(owner[v] >= 0);
+            remap[v] = next[owner[v]]++;
+        }
+    }
+    return remap;
+}
+
+void RemapIndices(uint32_t* indices, size_t indexCount, const std::vector<uint32_t>& remap)
+{
+    for (size_t i = 0; i < indexCount; ++i)
+        indices[i] = remap[indices[i]];
+}
+
+void OptimizeMeshVertexFetch(PartitionedMesh& mesh)
+{
+    std::vector<VertexRange> ranges;
+    for (const SkinnedSubmesh& submesh : mesh.submeshes) {
+        VertexRange range;
+        range.start = submesh.vertexStart;
+        range.count = submesh.vertexCount;
+        ranges.push_back(range);
+    }
+
+    std::vector<uint32_t> remap = BuildVertexFetchRemap(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size(), ranges);
+    ApplyVertexRemap(mesh.vertices, remap);
+    ApplyVertexRemap(mesh.extraInfluences, remap);
+    ApplyVertexRemap(mesh.sourceVertices, remap);
+    RemapIndices(mesh.indices.data(), mesh.indices.size(), remap);
+}
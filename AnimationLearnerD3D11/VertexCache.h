@@ -0,0 +1,76 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "MeshPartition.h"
+
+// 后变换顶点缓存优化与顶点取数优化。蒙皮顶点着色器要混合整个调色板，每次缓存命中都省下一次完整的顶点着色器调用；
+// 三角形重排后再按首次使用顺序给顶点重新编号，使顶点读取在缓存行上连续
+
+// 统计用的 FIFO 缓存大小（与多数 GPU 的后变换缓存行为接近）
+#define VERTEX_CACHE_FIFO_SIZE 16
+// 优化时 Forsyth 评分使用的 LRU 缓存大小
+#define VERTEX_CACHE_OPTIMIZE_SIZE 32
+// 顶点取数统计的缓存行大小与缓存容量（行数）
+#define VERTEX_FETCH_LINE_SIZE 64
+#define VERTEX_FETCH_CACHE_LINES 256
+
+struct VertexCacheStats
+{
+    size_t triangles = 0;
+    size_t misses = 0;           // 顶点着色器调用次数
+    size_t uniqueVertices = 0;
+    float acmr = 0.0f;           // 平均每个三角形的缓存未命中数（0.5 ~ 3，越小越好）
+    float atvr = 0.0f;           // 未命中数 / 被引用的顶点数（1 为每个顶点只变换一次）
+};
+
+// 在 cacheSize 项的 FIFO 缓存上模拟三角形列表 indices 的顶点着色器调用
+VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+    int cacheSize = VERTEX_CACHE_FIFO_SIZE);
+
+// Forsyth 线性速度算法：每步从缓存中的顶点相邻的三角形里选评分最高的输出，评分由顶点在 LRU 缓存中的位置和
+// 剩余未输出的相邻三角形数决定；缓存里没有候选时按原顺序取下一个未输出的三角形。
+// 原地重排三角形，保持每个三角形的顶点顺序（绕序），结果只取决于输入
+void OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+// 对每个子网格的每个 draw 分别优化：三角形只在 draw 内重排，draws 的区间不变
+void OptimizeMeshVertexCache(PartitionedMesh& mesh);
+
+struct VertexFetchStats
+{
+    size_t bytesFetched = 0;     // 后变换缓存未命中的顶点读取的缓存行字节数
+    float overfetch = 0.0f;      // bytesFetched / (被引用的顶点数 * vertexSize)，1 为每个字节只读一次
+};
+
+// 先模拟 FIFO 后变换缓存，未命中的顶点按 vertexSize 字节的步长读取所在缓存行，缓存行在 FIFO 行缓存中命中时不重复计数
+VertexFetchStats AnalyzeVertexFetch(const uint32_t* indices, size_t indexCount, size_t vertexCount, size_t vertexSize);
+
+// 一段连续的顶点（子网格、影响数桶）
+struct VertexRange
+{
+    uint32_t start = 0;
+    uint32_t count = 0;
+};
+
+// 在每个区间内按 indices 中首次引用的顺序重新编号顶点，未被引用的排在区间末尾；顶点不跨区间移动，
+// 依赖连续区间的结构（子网格、分桶、位置量化区间）保持有效。ranges 需覆盖全部顶点，为空时整体一段。
+// 返回 remap[旧下标] = 新下标
+std::vector<uint32_t> BuildVertexFetchRemap(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+    const std::vector<VertexRange>& ranges);
+
+// items[i] 移到 items[remap[i]]；items 为空时不变（如 4 影响资源的 extraInfluences）
+template<typename T>
+void ApplyVertexRemap(std::vector<T>& items, const std::vector<uint32_t>& remap)
+{
+    if (items.empty())
+        return;
+    std::vector<T> reordered(items.size());
+    for (size_t i = 0; i < items.size(); ++i)
+        reordered[remap[i]] = items[i];
+    items.swap(reordered);
+}
+
+void RemapIndices(uint32_t* indices, size_t indexCount, const std::vector<uint32_t>& remap);
+
+// 每个子网格内按 draw 顺序的首次使用重新编号顶点，同步重排 extraInfluences、sourceVertices 并改写 indices
+void OptimizeMeshVertexFetch(PartitionedMesh& mesh);
@@ -0,0 +1,225 @@
+﻿#include "VertexCache.h"
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// VertexCache 的独立测试（后变换缓存优化与顶点按首次使用重新编号），只依赖标准库，不参与工程的构建（vcxproj 中 ExcludedFromBuild）。任意平台上：
+//   g++ -std=c++14 VertexCacheTest.cpp VertexCache.cpp && ./a.out
+// 全部通过时返回 0
+
+namespace
+{
+    int g_failures = 0;
+
+    void Check(bool condition, const char* test, const char* what)
+    {
+        if (!condition) {
+            std::printf("[VertexCacheTest] %s: %s\n", test, what);
+            ++g_failures;
+        }
+    }
+
+    // 三角形旋转到最小下标在前（保持绕序）后排序，比较两份索引是否为同一组三角形
+    std::vector<uint32_t> CanonicalTriangles(const std::vector<uint32_t>& indices)
+    {
+        std::vector<std::vector<uint32_t>> triangles;
+        for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+            std::vector<uint32_t> tri(indices.begin() + t, indices.begin() + t + 3);
+            std::rotate(tri.begin(), std::min_element(tri.begin(), tri.end()), tri.end());
+            triangles.push_back(tri);
+        }
+        std::sort(triangles.begin(), triangles.end());
+        std::vector<uint32_t> flat;
+        for (const std::vector<uint32_t>& tri : triangles)
+            flat.insert(flat.end(), tri.begin(), tri.end());
+        return flat;
+    }
+
+    // side x side 个格子的网格，每格两个三角形；三角形顺序用固定种子打乱
+    std::vector<uint32_t> ShuffledGrid(uint32_t side, size_t& vertexCount)
+    {
+        uint32_t row = side + 1;
+        vertexCount = size_t(row) * row;
+        std::vector<uint32_t> indices;
+        for (uint32_t y = 0; y < side; ++y) {
+            for (uint32_t x = 0; x < side; ++x) {
+                uint32_t v = y * row + x;
+                uint32_t quad[6] = { v, v + 1, v + row, v + 1, v + row + 1, v + row };
+                indices.insert(indices.end(), quad, quad + 6);
+            }
+        }
+        // 自己做 Fisher-Yates：std::shuffle 的结果依赖标准库实现
+        std::mt19937 rng(12345);
+        for (size_t t = indices.size() / 3 - 1; t > 0; --t) {
+            size_t other = size_t(rng() % (t + 1));
+            for (int corner = 0; corner < 3; ++corner)
+                std::swap(indices[t * 3 + corner], indices[other * 3 + corner]);
+        }
+        return indices;
+    }
+
+    void TestShuffledGrid()
+    {
+        size_t vertexCount = 0;
+        std::vector<uint32_t> indices = ShuffledGrid(64, vertexCount);
+        std::vector<uint32_t> before = CanonicalTriangles(indices);
+        VertexCacheStats statsBefore = AnalyzeVertexCache(indices.data(), indices.size(), vertexCount);
+
+        OptimizeVertexCache(indices.data(), indices.size(), vertexCount);
+        VertexCacheStats statsAfter = AnalyzeVertexCache(indices.data(), indices.size(), vertexCount);
+
+        Check(CanonicalTriangles(indices) == before, "shuffled grid", "triangle multiset or winding changed");
+        Check(statsAfter.acmr <= statsBefore.acmr, "shuffled grid", "ACMR increased");
+        std::printf("[VertexCacheTest] shuffled grid: ACMR %.3f -> %.3f\n", statsBefore.acmr, statsAfter.acmr);
+
+        // 已优化的结果再优化一次不应变差
+        OptimizeVertexCache(indices.data(), indices.size(), vertexCount);
+        VertexCacheStats statsAgain = AnalyzeVertexCache(indices.data(), indices.size(), vertexCount);
+        Check(CanonicalTriangles(indices) == before, "shuffled grid", "second pass changed the triangles");
+        Check(statsAgain.acmr <= statsBefore.acmr, "shuffled grid", "second pass ACMR above the shuffled input");
+    }
+
+    // 顶点编号用固定种子打乱（同样自己做 Fisher-Yates）
+    void ShuffleVertices(std::vector<uint32_t>& indices, size_t vertexCount)
+    {
+        std::vector<uint32_t> permutation(vertexCount);
+        for (size_t v = 0; v < vertexCount; ++v)
+            permutation[v] = uint32_t(v);
+        std::mt19937 rng(54321);
+        for (size_t v = vertexCount - 1; v > 0; --v)
+            std::swap(permutation[v], permutation[size_t(rng() % (v + 1))]);
+        for (uint32_t& index : indices)
+            index = permutation[index];
+    }
+
+    bool IsPermutation(const std::vector<uint32_t>& remap)
+    {
+        std::vector<unsigned char> seen(remap.size(), 0);
+        for (uint32_t v : remap) {
+            if (v >= remap.size() || seen[v])
+                return false;
+            seen[v] = 1;
+        }
+        return true;
+    }
+
+    // 顶点编号打乱的网格：先做缓存优化，再按首次使用重新编号，24 字节（压缩顶点）的 overfetch 逐步下降
+    void TestVertexFetchRemap()
+    {
+        size_t vertexCount = 0;
+        std::vector<uint32_t> indices = ShuffledGrid(120, vertexCount);
+        ShuffleVertices(indices, vertexCount);
+        const size_t vertexSize = 24;
+        VertexFetchStats shuffled = AnalyzeVertexFetch(indices.data(), indices.size(), vertexCount, vertexSize);
+        OptimizeVertexCache(indices.data(), indices.size(), vertexCount);
+        VertexFetchStats optimized = AnalyzeVertexFetch(indices.data(), indices.size(), vertexCount, vertexSize);
+        std::vector<uint32_t> before = CanonicalTriangles(indices);
+
+        std::vector<uint32_t> remap = BuildVertexFetchRemap(indices.data(), indices.size(), vertexCount, {});
+        Check(remap.size() == vertexCount && IsPermutation(remap), "vertex fetch", "remap is not a permutation");
+        if (remap.size() != vertexCount || !IsPermutation(remap))
+            return;
+
+        // 顶点数据跟着移动：original[新下标] = 旧下标，改写后的三角形经 original 映射回来应与原来完全相同
+        std::vector<uint32_t> original(vertexCount);
+        for (size_t v = 0; v < vertexCount; ++v)
+            original[v] = uint32_t(v);
+        ApplyVertexRemap(original, remap);
+        std::vector<uint32_t> remapped = indices;
+        RemapIndices(remapped.data(), remapped.size(), remap);
+        std::vector<uint32_t> restored(remapped.size());
+        for (size_t i = 0; i < remapped.size(); ++i)
+            restored[i] = original[remapped[i]];
+        Check(restored == indices, "vertex fetch", "triangles or winding changed by the remap");
+        Check(CanonicalTriangles(restored) == before, "vertex fetch", "triangle multiset changed");
+
+        // 按首次使用编号：索引中第一次出现的顶点依次为 0, 1, 2, ...
+        uint32_t nextNew = 0;
+        bool firstUse = true;
+        for (uint32_t v : remapped) {
+            if (v == nextNew)
+                ++nextNew;
+            else
+                firstUse = firstUse && v < nextNew;
+        }
+        Check(firstUse, "vertex fetch", "vertices not numbered by first use");
+
+        VertexFetchStats renumbered = AnalyzeVertexFetch(remapped.data(), remapped.size(), vertexCount, vertexSize);
+        std::printf("[VertexCacheTest] vertex fetch (24 B): overfetch %.2f -> %.2f (cache) -> %.2f (renumbered)\n",
+            shuffled.overfetch, optimized.overfetch, renumbered.overfetch);
+        Check(optimized.overfetch <= shuffled.overfetch, "vertex fetch", "cache pass increased overfetch");
+        Check(renumbered.overfetch <= optimized.overfetch, "vertex fetch", "renumbering increased overfetch");
+        Check(renumbered.bytesFetched <= optimized.bytesFetched, "vertex fetch", "renumbering fetched more bytes");
+
+        // 已按首次使用编号的索引再做一次得到恒等映射
+        std::vector<uint32_t> again = BuildVertexFetchRemap(remapped.data(), remapped.size(), vertexCount, {});
+        bool identity = true;
+        for (size_t v = 0; v < again.size(); ++v)
+            identity = identity && again[v] == v;
+        Check(identity, "vertex fetch", "renumbering is not idempotent");
+    }
+
+    // 多个区间：顶点只在自己的区间内重新编号，未被引用的顶点排在区间末尾
+    void TestVertexFetchRanges()
+    {
+        // 区间 [0, 4) 与 [4, 10)；顶点 1 和 9 未被引用
+        std::vector<uint32_t> indices = { 3, 0, 2, 8, 5, 4, 2, 3, 0, 7, 6, 8 };
+        std::vector<VertexRange> ranges(2);
+        ranges[0].start = 0;
+        ranges[0].count = 4;
+        ranges[1].start = 4;
+        ranges[1].count = 6;
+        std::vector<uint32_t> remap = BuildVertexFetchRemap(indices.data(), indices.size(), 10, ranges);
+        std::vector<uint32_t> expected = { 1, 3, 2, 0, 6, 5, 8, 7, 4, 9 };
+        Check(remap == expected, "vertex fetch ranges", "unexpected per-range numbering");
+        Check(IsPermutation(remap), "vertex fetch ranges", "remap is not a permutation");
+    }
+
+    void TestEmpty()
+    {
+        OptimizeVertexCache(nullptr, 0, 0);
+        VertexCacheStats stats = AnalyzeVertexCache(nullptr, 0, 0);
+        Check(stats.triangles == 0 && stats.misses == 0 && stats.acmr == 0.0f, "empty", "stats not zero");
+
+        // 不足一个三角形的尾部保持不变
+        std::vector<uint32_t> partial = { 2, 1 };
+        OptimizeVertexCache(partial.data(), partial.size(), 3);
+        Check(partial == std::vector<uint32_t>({ 2, 1 }), "empty", "partial triangle modified");
+    }
+
+    void TestDegenerate()
+    {
+        // 重复顶点的三角形与正常三角形混在一起，同一个三角形出现多次
+        std::vector<uint32_t> indices = {
+            0, 0, 1,
+            2, 2, 2,
+            0, 1, 2,
+            3, 4, 3,
+            0, 1, 2,
+            4, 4, 0,
+            1, 3, 2,
+        };
+        std::vector<uint32_t> before = CanonicalTriangles(indices);
+        OptimizeVertexCache(indices.data(), indices.size(), 5);
+        Check(CanonicalTriangles(indices) == before, "degenerate", "triangle multiset or winding changed");
+
+        // 全部退化
+        std::vector<uint32_t> collapsed(30, 7);
+        OptimizeVertexCache(collapsed.data(), collapsed.size(), 8);
+        Check(collapsed == std::vector<uint32_t>(30, 7), "degenerate", "collapsed triangles changed");
+        VertexCacheStats stats = AnalyzeVertexCache(collapsed.data(), collapsed.size(), 8);
+        Check(stats.misses == 1 && stats.uniqueVertices == 1, "degenerate", "collapsed triangles not a single miss");
+    }
+}
+
+int main()
+{
+    TestShuffledGrid();
+    TestEmpty();
+    TestDegenerate();
+    TestVertexFetchRemap();
+    TestVertexFetchRanges();
+    std::printf("[VertexCacheTest] %s\n", g_failures ? "FAILED" : "passed");
+    return g_failures ? 1 : 0;
+}
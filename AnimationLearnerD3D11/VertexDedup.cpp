@@ -0,0 +1,166 @@
+﻿#include "VertexDedup.h"
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace
+{
+    const uint32_t kNoVertex = 0xffffffffu;
+
+    // 每轴 21 位的格子坐标拼成一个键；越界时回绕，只会多出一些候选，由完整比较排除
+    uint64_t CellKey(int64_t x, int64_t y, int64_t z)
+    {
+        const uint64_t mask = (uint64_t(1) << 21) - 1;
+        return (uint64_t(x) & mask) | ((uint64_t(y) & mask) << 21) | ((uint64_t(z) & mask) << 42);
+    }
+
+    bool Near(float a, float b, float epsilon)
+    {
+        return std::fabs(a - b) <= epsilon;
+    }
+
+    // 权重非零的 (骨骼, 权重) 作为集合比较：接近相等的权重在两个顶点中的排序可能不同
+    int CollectInfluences(const Vertex& vertex, const VertexInfluences* extra, uint32_t* bones, float* weights)
+    {
+        int count = 0;
+        for (int i = 0; i < (extra ? 8 : 4); ++i) {
+            float weight = i < 4 ? vertex.boneWeights[i] : extra->boneWeights[i - 4];
+            if (weight <= 0.0f)
+                continue;
+            bones[count] = i < 4 ? vertex.boneIndices[i] : extra->boneIndices[i - 4];
+            weights[count++] = weight;
+        }
+        return count;
+    }
+
+    bool SameInfluences(const Vertex& a, const VertexInfluences* extraA, const Vertex& b, const VertexInfluences* extraB, float epsilon)
+    {
+        uint32_t bonesA[8], bonesB[8];
+        float weightsA[8], weightsB[8];
+        int countA = CollectInfluences(a, extraA, bonesA, weightsA);
+        int countB = CollectInfluences(b, extraB, bonesB, weightsB);
+        if (countA != countB)
+            return false;
+        for (int i = 0; i < countA; ++i) {
+            int j = 0;
+            while (j < countB && bonesB[j] != bonesA[i])
+                ++j;
+            if (j == countB || !Near(weightsA[i], weightsB[j], epsilon))
+                return false;
+        }
+        return true;
+    }
+
+    bool SameVertex(const Vertex& a, const VertexInfluences* extraA, const Vertex& b, const VertexInfluences* extraB, float epsilon)
+    {
+        return Near(a.position.x, b.position.x, epsilon) && Near(a.position.y, b.position.y, epsilon) &&
+            Near(a.position.z, b.position.z, epsilon) &&
+            Near(a.normal.x, b.normal.x, epsilon) && Near(a.normal.y, b.normal.y, epsilon) && Near(a.normal.z, b.normal.z, epsilon) &&
+            Near(a.texcoord.x, b.texcoord.x, epsilon) && Near(a.texcoord.y, b.texcoord.y, epsilon) &&
+            SameInfluences(a, extraA, b, extraB, epsilon);
+    }
+}
+
+std::vector<uint32_t> DeduplicateVertices(std::vector<Vertex>& vertices, std::vector<VertexInfluences>& extraInfluences,
+    std::vector<uint32_t>& indices, float epsilon, const std::vector<unsigned char>* locked, VertexDedupStats* stats)
+{
+    size_t count = vertices.size();
+    bool hasExtra = !extraInfluences.empty();
+    bool hasLocked = locked && !locked->empty();
+    epsilon = std::max(epsilon, 0.0f);
+    // 格子边长取 2 * epsilon：以顶点为中心、边长 2 * epsilon 的盒子每轴最多跨两个格子，最多查 8 个格子。
+    // 格子坐标用 double 计算，float 在大坐标 / 小格子时的舍入会跨过不止一个格子
+    double inverseCell = 1.0 / std::max(2.0 * double(epsilon), 1e-6);
+
+    // 每个格子一条代表顶点的链表：head 为格子中最后加入的代表，next 串起同格子的其余代表
+    std::unordered_map<uint64_t, uint32_t> head;
+    head.reserve(count);
+    std::vector<uint32_t> next(count, kNoVertex);
+    std::vector<uint32_t> remap(count);
+    std::vector<uint32_t> source;
+    source.reserve(count);
+    size_t lockedCount = 0;
+
+    for (size_t v = 0; v < count; ++v) {
+        const Vertex& vertex = vertices[v];
+        const VertexInfluences* extra = hasExtra ? &extraInfluences[v] : nullptr;
+        bool isLocked = hasLocked && (*locked)[v];
+        const double p[3] = { vertex.position.x, vertex.position.y, vertex.position.z };
+        int64_t lo[3], hi[3];
+        for (int k = 0; k < 3; ++k) {
+            lo[k] = int64_t(std::floor((p[k] - epsilon) * inverseCell));
+            hi[k] = int64_t(std::floor((p[k] + epsilon) * inverseCell));
+        }
+
+        uint32_t match = kNoVertex;
+        for (int64_t z = lo[2]; z <= hi[2] && match == kNoVertex && !isLocked; ++z) {
+            for (int64_t y = lo[1]; y <= hi[1] && match == kNoVertex; ++y) {
+                for (int64_t x = lo[0]; x <= hi[0] && match == kNoVertex; ++x) {
+                    auto it = head.find(CellKey(x, y, z));
+                    for (uint32_t c = it != head.end() ? it->second : kNoVertex; c != kNoVertex; c = next[c]) {
+                        if (SameVertex(vertex, extra, vertices[c], hasExtra ? &extraInfluences[c] : nullptr, epsilon)) {
+                            match = c;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+
+        if (match != kNoVertex) {
+            remap[v] = remap[match];
+            continue;
+        }
+        remap[v] = uint32_t(source.size());
+        source.push_back(uint32_t(v));
+        if (isLocked) {
+            ++lockedCount;
+            continue;
+        }
+        uint64_t key = CellKey(int64_t(std::floor(p[0] * inverseCell)), int64_t(std::floor(p[1] * inverseCell)),
+            int64_t(std::floor(p[2] * inverseCell)));
+        auto inserted = head.insert(std::make_pair(key, uint32_t(v)));
+        if (!inserted.second) {
+            next[v] = inserted.first->second;
+            inserted.first->second = uint32_t(v);
+        }
+    }
+
+    if (stats) {
+        stats->verticesBefore = count;
+        stats->verticesAfter = source.size();
+        stats->lockedVertices = lockedCount;
+        stats->degenerateTriangles = 0;
+    }
+    if (source.size() == count)
+        return source;
+
+    // 保留的顶点只会前移，原地压缩
+    for (size_t i = 0; i < source.size(); ++i) {
+        vertices[i] = vertices[source[i]];
+        if (hasExtra)
+            extraInfluences[i] = extraInfluences[source[i]];
+    }
+    vertices.resize(source.size());
+    if (hasExtra)
+        extraInfluences.resize(source.size());
+    // 原地压缩三角形：只删除因焊接而退化的，导入时已退化的三角形保持不变
+    size_t kept = 0;
+    size_t triangleEnd = indices.size() - indices.size() % 3;
+    for (size_t i = 0; i < triangleEnd; i += 3) {
+        uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        uint32_t ra = remap[a], rb = remap[b], rc = remap[c];
+        bool welded = (ra == rb && a != b) || (rb == rc && b != c) || (ra == rc && a != c);
+        if (welded)
+            continue;
+        indices[kept++] = ra;
+        indices[kept++] = rb;
+        indices[kept++] = rc;
+    }
+    for (size_t i = triangleEnd; i < indices.size(); ++i)
+        indices[kept++] = remap[indices[i]];
+    if (stats)
+        stats->degenerateTriangles = (indices.size() - kept) / 3;
+    indices.resize(kept);
+    return source;
+}
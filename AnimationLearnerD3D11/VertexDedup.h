@@ -0,0 +1,29 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Vertex.h"
+
+// 合并后的顶点去重：aiProcess_JoinIdenticalVertices 只在每个 aiMesh 内部焊接，
+// 多个网格拼成一个顶点数组后，网格之间的接缝和重复顶点仍然各占一份。
+// 按位置做空间哈希找候选，再比较完整的顶点（位置、法线、UV、骨骼下标与权重），各分量之差都不超过 epsilon 才合并
+
+// 默认容差（模型单位 / 法线、UV、权重的分量）
+#define VERTEX_DEDUP_EPSILON 1e-5f
+
+struct VertexDedupStats
+{
+    size_t verticesBefore = 0;
+    size_t verticesAfter = 0;
+    size_t lockedVertices = 0;  // 不参与合并的顶点
+    size_t degenerateTriangles = 0;  // 合并后有两个角落到同一顶点而删除的三角形
+};
+
+// 去重并压缩 vertices / extraInfluences（extraInfluences 为空或一一对应），改写 indices（三角形列表）。
+// 焊接使原本不退化的三角形有两个角落合并为同一顶点时，删除该三角形，其余三角形保持原顺序。
+// 保留的顶点按原顺序排列，每组重复顶点保留第一个；locked 非空时为与 vertices 一一对应的标记，
+// 标记为 1 的顶点（如被变形目标引用的顶点）既不会被合并，也不会吸收别的顶点。
+// 返回 source[新下标] = 旧下标，调用方据此同步其他按顶点存放的数据
+std::vector<uint32_t> DeduplicateVertices(std::vector<Vertex>& vertices, std::vector<VertexInfluences>& extraInfluences,
+    std::vector<uint32_t>& indices, float epsilon = VERTEX_DEDUP_EPSILON, const std::vector<unsigned char>* locked = nullptr,
+    VertexDedupStats* stats = nullptr);